@@ -0,0 +1,118 @@
+#ifndef BOT_CORES_H
+#define BOT_CORES_H
+
+#include <stdint.h>
+#include <new>
+#include <CoreMailbox.h>
+
+/*
+ * Everything the two builds of the Bot have to agree on.
+ *
+ * The M7 (src/main.cpp, env giga_r1_m7) runs bluetooth: it mixes every controller
+ * state into motor drives and publishes them as a DriveCommand.
+ * The M4 (src/m4/main.cpp, env giga_r1_m4) runs the motor control loop and the
+ * failsafe: it applies the newest DriveCommand every tick and publishes its
+ * MotorStatus back. Radio and HCI processing on the M7 never delay a control tick.
+ */
+
+/*
+ * Specifies minimum drive for the motors
+ * Testing revealed values below this fail to drive the motors.
+ *
+ * Due to this, motors should be at 0 control indicates such.
+ * When controls indicate movement, drive should start and scale from this value.
+ *
+ * This determines, a minimum speed, and should be decreased if min speed is too fast.
+ *
+ * With wheel encoders the M4 measures the dead band of each motor at boot and
+ * controls the wheel speed instead, this value is then only the smallest drive
+ * the M7 asks for. Without encoders the M4 drives open loop above it.
+ */
+const int MOTOR_MIN = 70;
+
+/*
+ * Largest drive value, drive values run from -MOTOR_MAX to MOTOR_MAX.
+ */
+const int MOTOR_MAX = 255;
+
+/*
+ * Drive command from the M7 to the M4.
+ */
+struct DriveCommand {
+  //drive of motor 1 (left) and motor 2 (right), negative is reverse
+  int16_t motor1;
+  int16_t motor2;
+  //controller states received so far, the M4 feeds its watchdog whenever this changes
+  uint32_t commands;
+  //movement allowed, only while a controller is connected
+  uint8_t armed;
+};
+
+/*
+ * Control loop and failsafe state from the M4 to the M7, published every tick.
+ */
+struct MotorStatus {
+  //DriveCommand mailbox sequence of the newest command written to the motor pins
+  uint32_t appliedCommand;
+  //armed state of that command
+  uint8_t armed;
+  //duty last written to the motor pins, negative is reverse
+  int16_t motor1Duty;
+  int16_t motor2Duty;
+
+  uint32_t rateHz;
+  uint32_t ticks;
+  uint32_t overruns;
+  uint32_t lastJitterUs;
+  uint32_t maxJitterUs;
+  uint32_t maxTickUs;
+
+  uint32_t commands;
+  uint32_t commandAgeUs;
+  uint32_t maxCommandGapUs;
+  uint32_t commandTimeouts;
+  uint32_t commandRecoveries;
+
+  //wheel speed control, see WheelSpeed.h
+  uint8_t closedLoop;
+  //dead band found at boot, 0 while it is still searched or when there are no encoders
+  int16_t motor1DeadBand;
+  int16_t motor2DeadBand;
+  //measured wheel speeds and what they are set to, encoder counts per second
+  int32_t motor1Speed;
+  int32_t motor2Speed;
+  int32_t motor1Setpoint;
+  int32_t motor2Setpoint;
+};
+
+struct MotorMailboxes {
+  //written by the M7
+  LatestValueMailbox<DriveCommand> command;
+  //written by the M7, a new value asks the M4 to clear its statistics
+  LatestValueMailbox<uint32_t> resetStats;
+  //written by the M4
+  LatestValueMailbox<MotorStatus> status;
+};
+
+/*
+ * The mailboxes sit in the last kilobyte of SRAM4, which both cores can reach.
+ * RPC (OpenAMP) allocates its shared memory from the bottom of SRAM4, and neither
+ * build links anything else there.
+ */
+const uint32_t MOTOR_MAILBOX_ADDRESS = 0x3800FC00;
+const uint32_t MOTOR_MAILBOX_SIZE = 1024;
+
+static_assert(sizeof(MotorMailboxes) <= MOTOR_MAILBOX_SIZE, "motor mailboxes do not fit their memory");
+
+inline MotorMailboxes &motorMailboxes(){
+  return *reinterpret_cast<MotorMailboxes *>(MOTOR_MAILBOX_ADDRESS);
+}
+
+/*
+ * Clears the mailboxes, called by the M7 before it boots the M4.
+ */
+inline void resetMotorMailboxes(){
+  new (&motorMailboxes()) MotorMailboxes();
+}
+
+#endif
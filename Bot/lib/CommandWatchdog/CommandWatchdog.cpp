@@ -0,0 +1,94 @@
+#include "CommandWatchdog.h"
+
+CommandWatchdog::CommandWatchdog(uint32_t timeoutMicros) :
+  _timeoutMicros(timeoutMicros)
+{
+  reset();
+  resetStats();
+}
+
+void CommandWatchdog::setTimeout(uint32_t timeoutMicros){
+  _timeoutMicros = timeoutMicros;
+}
+
+uint32_t CommandWatchdog::timeoutMicros() const {
+  return _timeoutMicros;
+}
+
+void CommandWatchdog::reset(){
+  _lastCommand = 0;
+  _commands = 0;
+  _checkedCommands = 0;
+  _checkedCommand = 0;
+  _fresh = false;
+  _timedOut = false;
+}
+
+void CommandWatchdog::commandReceived(uint32_t nowMicros){
+  _lastCommand = nowMicros;
+  _commands++;
+}
+
+uint32_t CommandWatchdog::ageMicros(uint32_t nowMicros) const {
+  if (_commands == 0){
+    return 0;
+  }
+
+  //the command may have been stamped after nowMicros was read
+  int32_t age = (int32_t)(nowMicros - _lastCommand);
+  return age > 0 ? age : 0;
+}
+
+bool CommandWatchdog::check(uint32_t nowMicros){
+  uint32_t commands = _commands;
+  uint32_t lastCommand = _lastCommand;
+
+  if (commands == 0){
+    return false;
+  }
+
+  if (commands != _checkedCommands){
+    uint32_t gap = lastCommand - _checkedCommand;
+    if (_checkedCommands != 0 && gap > _maxGap){
+      _maxGap = gap;
+    }
+    _checkedCommand = lastCommand;
+  }
+
+  uint32_t age = ageMicros(nowMicros);
+  bool fresh = age < _timeoutMicros;
+
+  if (_fresh && !fresh){
+    _timeouts++;
+    _timedOut = true;
+  } else if (fresh && _timedOut && commands != _checkedCommands){
+    _recoveries++;
+    _timedOut = false;
+  }
+
+  _fresh = fresh;
+  _checkedCommands = commands;
+  return fresh;
+}
+
+uint32_t CommandWatchdog::commands() const {
+  return _commands;
+}
+
+uint32_t CommandWatchdog::timeouts() const {
+  return _timeouts;
+}
+
+uint32_t CommandWatchdog::recoveries() const {
+  return _recoveries;
+}
+
+uint32_t CommandWatchdog::maxGapMicros() const {
+  return _maxGap;
+}
+
+void CommandWatchdog::resetStats(){
+  _timeouts = 0;
+  _recoveries = 0;
+  _maxGap = 0;
+}
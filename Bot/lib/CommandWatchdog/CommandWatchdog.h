@@ -0,0 +1,63 @@
+#ifndef COMMAND_WATCHDOG_H
+#define COMMAND_WATCHDOG_H
+
+#include <stdint.h>
+
+/*
+ * Command freshness watchdog.
+ *
+ * The bluetooth side calls commandReceived() for every drive command, the
+ * control task calls check() every tick. A command is fresh for timeoutMicros
+ * after it arrived, after that the watchdog trips and the control task has to
+ * bring the motors to a stop on its own.
+ *
+ * Until the first command after reset() the watchdog counts as tripped, so
+ * nothing moves on a new connection before the controller has spoken.
+ *
+ * All times are micros() values and are compared with wrap-around safe arithmetic.
+ */
+class CommandWatchdog {
+public:
+  CommandWatchdog(uint32_t timeoutMicros);
+
+  void setTimeout(uint32_t timeoutMicros);
+  uint32_t timeoutMicros() const;
+
+  // forgets the last command, check() is false until the next one
+  void reset();
+
+  // bluetooth side, stamps the command that was just received
+  void commandReceived(uint32_t nowMicros);
+
+  // control side, true while the last command is fresh
+  bool check(uint32_t nowMicros);
+
+  // age of the last command, 0 if there was none
+  uint32_t ageMicros(uint32_t nowMicros) const;
+
+  uint32_t commands() const;
+  // times the watchdog tripped because commands stopped arriving
+  uint32_t timeouts() const;
+  // times fresh commands arrived again after a timeout
+  uint32_t recoveries() const;
+  // longest time between two commands seen by check()
+  uint32_t maxGapMicros() const;
+  void resetStats();
+
+private:
+  uint32_t _timeoutMicros;
+
+  volatile uint32_t _lastCommand;
+  volatile uint32_t _commands;
+
+  uint32_t _checkedCommands;
+  uint32_t _checkedCommand;
+  bool _fresh;
+  bool _timedOut;
+
+  volatile uint32_t _timeouts;
+  volatile uint32_t _recoveries;
+  volatile uint32_t _maxGap;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "ControlLoop.h"
+
+ControlLoop::ControlLoop(uint32_t rateHz) :
+  _nextTick(0),
+  _tickStart(0)
+{
+  setRate(rateHz);
+  resetStats();
+}
+
+void ControlLoop::setRate(uint32_t rateHz)
+{
+  if (rateHz == 0) {
+    rateHz = 1;
+  } else if (rateHz > 1000000) {
+    rateHz = 1000000;
+  }
+
+  _rateHz = rateHz;
+  _periodMicros = 1000000 / rateHz;
+}
+
+uint32_t ControlLoop::rate() const
+{
+  return _rateHz;
+}
+
+uint32_t ControlLoop::periodMicros() const
+{
+  return _periodMicros;
+}
+
+void ControlLoop::start(uint32_t nowMicros)
+{
+  _nextTick = nowMicros;
+}
+
+uint32_t ControlLoop::remaining(uint32_t nowMicros) const
+{
+  int32_t remaining = (int32_t)(_nextTick - nowMicros);
+
+  return (remaining > 0) ? (uint32_t)remaining : 0;
+}
+
+void ControlLoop::beginTick(uint32_t nowMicros)
+{
+  int32_t lateness = (int32_t)(nowMicros - _nextTick);
+
+  if (lateness < 0) {
+    lateness = 0;
+  }
+
+  _tickStart = nowMicros;
+  _lastJitter = lateness;
+
+  if ((uint32_t)lateness > _maxJitter) {
+    _maxJitter = lateness;
+  }
+
+  if ((uint32_t)lateness >= _periodMicros) {
+    // skip the ticks we missed, the next one is due on the original grid
+    _overruns++;
+    _nextTick += ((uint32_t)lateness / _periodMicros) * _periodMicros;
+  }
+
+  _nextTick += _periodMicros;
+  _ticks++;
+}
+
+void ControlLoop::endTick(uint32_t nowMicros)
+{
+  uint32_t duration = nowMicros - _tickStart;
+
+  if (duration > _maxTick) {
+    _maxTick = duration;
+  }
+}
+
+uint32_t ControlLoop::ticks() const
+{
+  return _ticks;
+}
+
+uint32_t ControlLoop::overruns() const
+{
+  return _overruns;
+}
+
+uint32_t ControlLoop::lastJitterMicros() const
+{
+  return _lastJitter;
+}
+
+uint32_t ControlLoop::maxJitterMicros() const
+{
+  return _maxJitter;
+}
+
+uint32_t ControlLoop::maxTickMicros() const
+{
+  return _maxTick;
+}
+
+void ControlLoop::resetStats()
+{
+  _ticks = 0;
+  _overruns = 0;
+  _lastJitter = 0;
+  _maxJitter = 0;
+  _maxTick = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <stdint.h>
+
+/*
+ * Fixed-rate schedule for the motor control task.
+ *
+ * Every tick has an absolute deadline, so time spent inside a tick does not make the
+ * period drift. The lateness of each tick against its deadline is recorded as jitter.
+ * A tick that starts a full period or more after its deadline is counted as an overrun,
+ * and the ticks it missed are skipped instead of being run back to back.
+ *
+ * All times are micros() values and are compared with wrap-around safe arithmetic.
+ */
+class ControlLoop {
+public:
+  ControlLoop(uint32_t rateHz);
+
+  void setRate(uint32_t rateHz);
+  uint32_t rate() const;
+  uint32_t periodMicros() const;
+
+  // (re)starts the schedule with the first tick due at nowMicros
+  void start(uint32_t nowMicros);
+
+  // microseconds until the next tick is due, 0 when it is due now
+  uint32_t remaining(uint32_t nowMicros) const;
+
+  // called around the body of every tick
+  void beginTick(uint32_t nowMicros);
+  void endTick(uint32_t nowMicros);
+
+  uint32_t ticks() const;
+  uint32_t overruns() const;
+  uint32_t lastJitterMicros() const;
+  uint32_t maxJitterMicros() const;
+  uint32_t maxTickMicros() const;
+  void resetStats();
+
+private:
+  uint32_t _rateHz;
+  uint32_t _periodMicros;
+  uint32_t _nextTick;
+  uint32_t _tickStart;
+
+  volatile uint32_t _ticks;
+  volatile uint32_t _overruns;
+  volatile uint32_t _lastJitter;
+  volatile uint32_t _maxJitter;
+  volatile uint32_t _maxTick;
+};
+
+#endif
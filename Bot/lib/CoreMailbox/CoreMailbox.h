@@ -0,0 +1,120 @@
+#ifndef CORE_MAILBOX_H
+#define CORE_MAILBOX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#endif
+
+/*
+ * Latest-value-wins mailbox between the two cores of the GIGA R1, one writer core
+ * and one reader core. It lives in memory both cores can see, see BotCores.h.
+ *
+ * It is a sequence lock: the sequence is odd while a write is in progress and
+ * even once the value is complete. A reader copies the value between two reads of
+ * the sequence and only keeps the copy if the sequence was even and unchanged, so a
+ * write never blocks and a torn value is never used. Plain loads and stores are
+ * enough, there is no read-modify-write that would need an exclusive monitor
+ * shared by both cores.
+ *
+ * published() counts the completed writes, a reader sees a new value when it changes.
+ * Unread values are simply replaced, only the newest command or status matters.
+ *
+ * The M7 has a data cache, so its side cleans the mailbox after every step of a write
+ * and invalidates it before reading. Each mailbox is padded to whole cache lines so
+ * it never shares a line with data the other core writes.
+ */
+const size_t CORE_MAILBOX_CACHE_LINE = 32;
+
+#if defined(__arm__)
+#define CORE_MAILBOX_BARRIER() __asm__ volatile("dmb" ::: "memory")
+#else
+#define CORE_MAILBOX_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+template <typename T>
+class alignas(CORE_MAILBOX_CACHE_LINE) LatestValueMailbox {
+public:
+  LatestValueMailbox() : _sequence(0){
+    memset(_value, 0, sizeof(_value));
+    flush();
+  }
+
+  // writer core only, never waits
+  void publish(const T &value){
+    uint32_t sequence = _sequence;
+
+    _sequence = sequence + 1;
+    flush();
+
+    memcpy(_value, &value, sizeof(T));
+    flush();
+
+    _sequence = sequence + 2;
+    flush();
+  }
+
+  // reader core, false if nothing was published yet or a write was in progress on every attempt
+  bool read(T &value, uint32_t *published = nullptr, int attempts = 4) const{
+    while (attempts-- > 0){
+      invalidate();
+      uint32_t before = _sequence;
+      CORE_MAILBOX_BARRIER();
+
+      if (before == 0){
+        return false;
+      }
+      if (before & 1){
+        continue;
+      }
+
+      T copy;
+      memcpy(&copy, _value, sizeof(T));
+      CORE_MAILBOX_BARRIER();
+
+      invalidate();
+      if (_sequence != before){
+        continue;
+      }
+
+      value = copy;
+      if (published){
+        *published = before >> 1;
+      }
+      return true;
+    }
+
+    return false;
+  }
+
+  // completed writes so far
+  uint32_t published() const{
+    invalidate();
+    return _sequence >> 1;
+  }
+
+private:
+  // makes the writes so far visible to the other core, in order
+  void flush(){
+    CORE_MAILBOX_BARRIER();
+#if defined(CORE_CM7) && defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_CleanDCache_by_Addr((uint32_t *)this, sizeof(*this));
+#endif
+  }
+
+  // drops a cached copy so the next read sees what the other core wrote
+  void invalidate() const{
+#if defined(CORE_CM7) && defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_InvalidateDCache_by_Addr((uint32_t *)this, sizeof(*this));
+#endif
+    CORE_MAILBOX_BARRIER();
+  }
+
+  volatile uint32_t _sequence;
+  uint8_t _value[sizeof(T)];
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "DriveMixer.h"
+
+static constexpr DriveCurveTable CURVE_TABLE = makeDriveCurveTable();
+static constexpr DriveDutyTable DEFAULT_DUTY_TABLE = makeDriveDutyTable(DRIVE_DEFAULT_MOTOR_MIN, DRIVE_DEFAULT_MOTOR_MAX);
+
+static inline int16_t saturate(int16_t command){
+  if (command > DRIVE_MIX_FULL_SCALE){
+    return DRIVE_MIX_FULL_SCALE;
+  }
+  if (command < -DRIVE_MIX_FULL_SCALE){
+    return -DRIVE_MIX_FULL_SCALE;
+  }
+  return command;
+}
+
+DriveMixer::DriveMixer() :
+  _motorMin(DRIVE_DEFAULT_MOTOR_MIN),
+  _motorMax(DRIVE_DEFAULT_MOTOR_MAX),
+  _dutyTable(DEFAULT_DUTY_TABLE)
+{
+}
+
+DriveMixer::DriveMixer(uint8_t motorMin, uint8_t motorMax) :
+  DriveMixer()
+{
+  setMotorRange(motorMin, motorMax);
+}
+
+void DriveMixer::setMotorRange(uint8_t motorMin, uint8_t motorMax){
+  if (motorMin > motorMax){
+    motorMin = motorMax;
+  }
+
+  _motorMin = motorMin;
+  _motorMax = motorMax;
+  _dutyTable = makeDriveDutyTable(motorMin, motorMax);
+}
+
+uint8_t DriveMixer::motorMin() const {
+  return _motorMin;
+}
+
+uint8_t DriveMixer::motorMax() const {
+  return _motorMax;
+}
+
+int16_t DriveMixer::curve(uint16_t axis){
+  if (axis > JOYSTICK_MAX){
+    axis = JOYSTICK_MAX;
+  }
+
+  if (axis < JOYSTICK_MIDDLE){
+    return -CURVE_TABLE.value[(JOYSTICK_MIDDLE - axis) >> DRIVE_CURVE_SHIFT];
+  }
+  return CURVE_TABLE.value[(axis - JOYSTICK_MIDDLE) >> DRIVE_CURVE_SHIFT];
+}
+
+int16_t DriveMixer::duty(int16_t command) const {
+  command = saturate(command);
+
+  if (command < 0){
+    return -_dutyTable.duty[-command >> DRIVE_DUTY_SHIFT];
+  }
+  return _dutyTable.duty[command >> DRIVE_DUTY_SHIFT];
+}
+
+WheelDuty DriveMixer::mix(uint16_t xAxis, uint16_t yAxis) const {
+  int16_t steering = curve(xAxis);
+  int16_t throttle = curve(yAxis);
+
+  WheelDuty wheels;
+  wheels.left = duty(throttle + steering);
+  wheels.right = duty(throttle - steering);
+  return wheels;
+}
@@ -0,0 +1,118 @@
+#ifndef DRIVE_MIXER_H
+#define DRIVE_MIXER_H
+
+#include <stdint.h>
+#include <ControllerState.h>
+
+/*
+ * Differential drive mixer. Turns the 12-bit thumb stick axes into signed
+ * left and right wheel duties, -motorMax to motorMax.
+ *
+ * Both steps of the mix are table lookups:
+ * - the response curve maps an axis deflection to -DRIVE_MIX_FULL_SCALE..DRIVE_MIX_FULL_SCALE,
+ *   with a small dead zone around the middle and a softer response near it
+ * - the duty table maps a mixed wheel command onto motorMin..motorMax, so any
+ *   non-zero command is strong enough to actually turn the motor
+ *
+ * The tables are generated at compile time. mix() only uses shifts, adds,
+ * compares and table loads, no floats or divisions, so it is cheap enough
+ * to run on every control loop tick.
+ */
+
+// magnitude of a wheel command after mixing, before it is turned into a duty
+const int16_t DRIVE_MIX_FULL_SCALE = 1023;
+
+// axis deflection is looked up in steps of 1 << DRIVE_CURVE_SHIFT ADC counts
+const int DRIVE_CURVE_SHIFT = 4;
+const int DRIVE_CURVE_SIZE = ((JOYSTICK_MAX - JOYSTICK_MIDDLE) >> DRIVE_CURVE_SHIFT) + 1;
+
+// steps around the middle of the stick that count as centred
+const int DRIVE_CURVE_DEADZONE = 2;
+
+// share of the cubic term in the response curve, in percent
+const int DRIVE_CURVE_EXPO_PERCENT = 40;
+
+// wheel commands are looked up in steps of 1 << DRIVE_DUTY_SHIFT
+const int DRIVE_DUTY_SHIFT = 2;
+const int DRIVE_DUTY_SIZE = (DRIVE_MIX_FULL_SCALE >> DRIVE_DUTY_SHIFT) + 1;
+
+const uint8_t DRIVE_DEFAULT_MOTOR_MIN = 70;
+const uint8_t DRIVE_DEFAULT_MOTOR_MAX = 255;
+
+struct DriveCurveTable {
+  int16_t value[DRIVE_CURVE_SIZE];
+};
+
+struct DriveDutyTable {
+  uint8_t duty[DRIVE_DUTY_SIZE];
+};
+
+/*
+ * Response curve, index is the axis deflection >> DRIVE_CURVE_SHIFT.
+ * Full deflection either way reaches DRIVE_MIX_FULL_SCALE.
+ */
+constexpr DriveCurveTable makeDriveCurveTable(){
+  DriveCurveTable table = {};
+  const int32_t span = DRIVE_CURVE_SIZE - 2 - DRIVE_CURVE_DEADZONE;
+
+  for (int i = 0; i < DRIVE_CURVE_SIZE; i++){
+    if (i < DRIVE_CURVE_DEADZONE){
+      table.value[i] = 0;
+      continue;
+    }
+
+    int32_t linear = (int32_t)(i - DRIVE_CURVE_DEADZONE) * DRIVE_MIX_FULL_SCALE / span;
+    if (linear > DRIVE_MIX_FULL_SCALE){
+      linear = DRIVE_MIX_FULL_SCALE;
+    }
+    int32_t cubic = linear * linear / DRIVE_MIX_FULL_SCALE * linear / DRIVE_MIX_FULL_SCALE;
+
+    table.value[i] = (linear * (100 - DRIVE_CURVE_EXPO_PERCENT) + cubic * DRIVE_CURVE_EXPO_PERCENT) / 100;
+  }
+
+  return table;
+}
+
+/*
+ * Dead-band compensation, index is the wheel command magnitude >> DRIVE_DUTY_SHIFT.
+ * 0 stays stopped, everything else is spread linearly over motorMin..motorMax.
+ */
+constexpr DriveDutyTable makeDriveDutyTable(uint8_t motorMin, uint8_t motorMax){
+  DriveDutyTable table = {};
+
+  for (int i = 1; i < DRIVE_DUTY_SIZE; i++){
+    table.duty[i] = motorMin + ((int32_t)(i - 1) * (motorMax - motorMin) + (DRIVE_DUTY_SIZE - 2) / 2) / (DRIVE_DUTY_SIZE - 2);
+  }
+
+  return table;
+}
+
+struct WheelDuty {
+  int16_t left;
+  int16_t right;
+};
+
+class DriveMixer {
+public:
+  DriveMixer();
+  DriveMixer(uint8_t motorMin, uint8_t motorMax);
+
+  // rebuilds the duty table, motorMin <= motorMax
+  void setMotorRange(uint8_t motorMin, uint8_t motorMax);
+  uint8_t motorMin() const;
+  uint8_t motorMax() const;
+
+  // y is throttle, x is steering, both raw 12-bit axis readings
+  WheelDuty mix(uint16_t xAxis, uint16_t yAxis) const;
+
+  // the two steps of mix(), exposed for testing
+  static int16_t curve(uint16_t axis);
+  int16_t duty(int16_t command) const;
+
+private:
+  uint8_t _motorMin;
+  uint8_t _motorMax;
+  DriveDutyTable _dutyTable;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "MotionProfile.h"
+
+static int32_t toFixed(int value){
+  return (int32_t)value * (1 << RAMP_FRACTION_BITS);
+}
+
+static int fromFixed(int32_t value){
+  //round to nearest, symmetric around 0
+  int32_t half = 1 << (RAMP_FRACTION_BITS - 1);
+  return value >= 0 ? (value + half) >> RAMP_FRACTION_BITS : -((-value + half) >> RAMP_FRACTION_BITS);
+}
+
+RampGenerator::RampGenerator(uint32_t maxRate, uint32_t maxAcceleration, uint32_t tickRateHz) :
+  _maxRate(maxRate),
+  _maxAcceleration(maxAcceleration),
+  _tickRateHz(tickRateHz > 0 ? tickRateHz : 1),
+  _skipBand(0),
+  _target(0),
+  _position(0),
+  _velocity(0)
+{
+  applyLimits();
+}
+
+void RampGenerator::applyLimits(){
+  _rateStep = ((uint64_t)_maxRate << RAMP_FRACTION_BITS) / _tickRateHz;
+  _accelerationStep = ((uint64_t)_maxAcceleration << RAMP_FRACTION_BITS) / ((uint64_t)_tickRateHz * _tickRateHz);
+
+  //a limit smaller than the fixed point resolution would never move
+  if (_rateStep == 0){
+    _rateStep = 1;
+  }
+  if (_maxAcceleration != 0 && _accelerationStep == 0){
+    _accelerationStep = 1;
+  }
+}
+
+void RampGenerator::setLimits(uint32_t maxRate, uint32_t maxAcceleration){
+  _maxRate = maxRate;
+  _maxAcceleration = maxAcceleration;
+  applyLimits();
+}
+
+void RampGenerator::setTickRate(uint32_t tickRateHz){
+  _tickRateHz = tickRateHz > 0 ? tickRateHz : 1;
+  applyLimits();
+}
+
+void RampGenerator::setSkipBand(int skipBand){
+  _skipBand = skipBand > 0 ? skipBand : 0;
+}
+
+void RampGenerator::setTarget(int target){
+  _target = toFixed(target);
+}
+
+int RampGenerator::target() const {
+  return fromFixed(_target);
+}
+
+int RampGenerator::output() const {
+  return fromFixed(_position);
+}
+
+bool RampGenerator::settled() const {
+  return _position == _target && _velocity == 0;
+}
+
+void RampGenerator::reset(int value){
+  _position = toFixed(value);
+  _target = _position;
+  _velocity = 0;
+}
+
+int RampGenerator::update(){
+  int32_t distance = _target - _position;
+  int32_t direction = distance > 0 ? 1 : (distance < 0 ? -1 : 0);
+
+  //velocity wanted this tick
+  int32_t wanted = direction * _rateStep;
+
+  if (_accelerationStep != 0){
+    //slow down when the distance left is what it takes to stop, v^2 >= 2 * a * d
+    int64_t stopping = (int64_t)_velocity * _velocity;
+    int64_t available = 2 * (int64_t)_accelerationStep * (distance >= 0 ? distance : -distance);
+    bool towardsTarget = (_velocity > 0 && direction > 0) || (_velocity < 0 && direction < 0);
+    if (towardsTarget && stopping >= available){
+      wanted = 0;
+    }
+
+    if (wanted > _velocity + _accelerationStep){
+      wanted = _velocity + _accelerationStep;
+    } else if (wanted < _velocity - _accelerationStep){
+      wanted = _velocity - _accelerationStep;
+    }
+  }
+  _velocity = wanted;
+
+  //land exactly on the target instead of overshooting it
+  int32_t remaining = distance >= 0 ? distance : -distance;
+  int32_t step = _velocity >= 0 ? _velocity : -_velocity;
+  bool arriving = direction != 0 && (_velocity > 0) == (direction > 0) && step >= remaining;
+
+  if (arriving || (direction == 0 && step <= _accelerationStep)){
+    _position = _target;
+    _velocity = 0;
+  } else {
+    _position += _velocity;
+  }
+
+  //jump across the drive values that do not turn the motor
+  int32_t band = toFixed(_skipBand);
+  if (_position != 0 && _position > -band && _position < band){
+    bool leavingZero = (_position > 0 && _target >= band) || (_position < 0 && _target <= -band);
+    _position = leavingZero ? (_position > 0 ? band : -band) : 0;
+    if (!leavingZero && _target == 0){
+      _velocity = 0;
+    }
+  }
+
+  return output();
+}
@@ -0,0 +1,61 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <stdint.h>
+
+/*
+ * Non-blocking ramp generator for one motor drive, advanced once per control loop tick.
+ *
+ * The output follows the target with a limited rate (slew) and, if an acceleration
+ * cap is set, a limited change of that rate. With both limits the output moves on a
+ * trapezoidal profile: it speeds up, cruises at the rate limit and slows down so that
+ * it stops on the target instead of overshooting it.
+ *
+ * Drive values below the skip band do not move the motor, so the output jumps
+ * across (-skipBand, skipBand) instead of ramping through it.
+ *
+ * Rates are in drive units per second, accelerations in drive units per second^2.
+ * Internally everything is fixed point, one drive unit is 1 << RAMP_FRACTION_BITS.
+ */
+const int RAMP_FRACTION_BITS = 16;
+
+class RampGenerator {
+public:
+  // maxAcceleration 0 means only the rate is limited
+  RampGenerator(uint32_t maxRate, uint32_t maxAcceleration, uint32_t tickRateHz);
+
+  void setLimits(uint32_t maxRate, uint32_t maxAcceleration);
+  void setTickRate(uint32_t tickRateHz);
+  void setSkipBand(int skipBand);
+
+  void setTarget(int target);
+  int target() const;
+
+  // moves the output one tick towards the target and returns it
+  int update();
+  int output() const;
+
+  // true once the output reached the target and stopped
+  bool settled() const;
+
+  // jumps straight to value and stops, for emergency stops
+  void reset(int value);
+
+private:
+  void applyLimits();
+
+  uint32_t _maxRate;
+  uint32_t _maxAcceleration;
+  uint32_t _tickRateHz;
+  int _skipBand;
+
+  // per tick, fixed point
+  int32_t _rateStep;
+  int32_t _accelerationStep;
+
+  int32_t _target;
+  int32_t _position;
+  int32_t _velocity;
+};
+
+#endif
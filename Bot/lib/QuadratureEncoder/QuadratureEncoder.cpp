@@ -0,0 +1,116 @@
+#include "QuadratureEncoder.h"
+
+QuadratureEncoder::QuadratureEncoder(uint8_t encoder) :
+  _encoder(encoder),
+  _last(0),
+  _count(0)
+{
+}
+
+bool QuadratureEncoder::begin(){
+  if (!quadratureCounterBegin(_encoder)){
+    return false;
+  }
+
+  _last = quadratureCounterRead(_encoder);
+  _count = 0;
+  return true;
+}
+
+int32_t QuadratureEncoder::count(){
+  uint16_t now = quadratureCounterRead(_encoder);
+
+  //the difference of two 16 bit counts is right as long as it fits in int16_t
+  _count += (int16_t)(uint16_t)(now - _last);
+  _last = now;
+  return _count;
+}
+
+#if defined(ARDUINO_GIGA)
+#include <stm32h7xx_hal.h>
+
+/*
+ * Encoder timers of the GIGA. Each encoder needs channel 1 and 2 of its timer,
+ * on pins that are not taken by the motor PWM:
+ * - motor 1 on TIM1, A on PE9 and B on PE11
+ * - motor 2 on TIM2, A on PA15 and B on PB3
+ * The inputs are filtered over 8 timer clocks against motor noise.
+ */
+struct EncoderTimer {
+  TIM_TypeDef *timer;
+  GPIO_TypeDef *portA;
+  uint16_t pinA;
+  GPIO_TypeDef *portB;
+  uint16_t pinB;
+  uint8_t alternate;
+};
+
+static const EncoderTimer ENCODER_TIMERS[QUADRATURE_ENCODERS] = {
+  { TIM1, GPIOE, GPIO_PIN_9, GPIOE, GPIO_PIN_11, GPIO_AF1_TIM1 },
+  { TIM2, GPIOA, GPIO_PIN_15, GPIOB, GPIO_PIN_3, GPIO_AF1_TIM2 },
+};
+
+static const uint32_t ENCODER_INPUT_FILTER = 0x3;
+
+static void enableClocks(uint8_t encoder){
+  if (encoder == 0){
+    __HAL_RCC_TIM1_CLK_ENABLE();
+    __HAL_RCC_GPIOE_CLK_ENABLE();
+  } else {
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+  }
+}
+
+static void initPin(GPIO_TypeDef *port, uint16_t pin, uint8_t alternate){
+  GPIO_InitTypeDef gpio = {};
+  gpio.Pin = pin;
+  gpio.Mode = GPIO_MODE_AF_PP;
+  gpio.Pull = GPIO_PULLUP;
+  gpio.Speed = GPIO_SPEED_FREQ_LOW;
+  gpio.Alternate = alternate;
+  HAL_GPIO_Init(port, &gpio);
+}
+
+bool quadratureCounterBegin(uint8_t encoder){
+  if (encoder >= QUADRATURE_ENCODERS){
+    return false;
+  }
+
+  const EncoderTimer &config = ENCODER_TIMERS[encoder];
+  enableClocks(encoder);
+  initPin(config.portA, config.pinA, config.alternate);
+  initPin(config.portB, config.pinB, config.alternate);
+
+  TIM_HandleTypeDef handle = {};
+  handle.Instance = config.timer;
+  handle.Init.Prescaler = 0;
+  handle.Init.CounterMode = TIM_COUNTERMODE_UP;
+  handle.Init.Period = 0xffff;
+  handle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  handle.Init.RepetitionCounter = 0;
+  handle.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+  //count both edges of both channels
+  TIM_Encoder_InitTypeDef mode = {};
+  mode.EncoderMode = TIM_ENCODERMODE_TI12;
+  mode.IC1Polarity = TIM_ICPOLARITY_RISING;
+  mode.IC1Selection = TIM_ICSELECTION_DIRECTTI;
+  mode.IC1Prescaler = TIM_ICPSC_DIV1;
+  mode.IC1Filter = ENCODER_INPUT_FILTER;
+  mode.IC2Polarity = TIM_ICPOLARITY_RISING;
+  mode.IC2Selection = TIM_ICSELECTION_DIRECTTI;
+  mode.IC2Prescaler = TIM_ICPSC_DIV1;
+  mode.IC2Filter = ENCODER_INPUT_FILTER;
+
+  if (HAL_TIM_Encoder_Init(&handle, &mode) != HAL_OK){
+    return false;
+  }
+  return HAL_TIM_Encoder_Start(&handle, TIM_CHANNEL_ALL) == HAL_OK;
+}
+
+uint16_t quadratureCounterRead(uint8_t encoder){
+  return (uint16_t)ENCODER_TIMERS[encoder].timer->CNT;
+}
+#endif
@@ -0,0 +1,45 @@
+#ifndef QUADRATURE_ENCODER_H
+#define QUADRATURE_ENCODER_H
+
+#include <stdint.h>
+
+/*
+ * Quadrature encoder of one wheel, counted by a hardware timer.
+ *
+ * The timer runs in encoder mode: its two input capture channels take the A and B
+ * signals and the counter steps on every edge of either, up or down by the phase
+ * between them. No interrupt runs per edge, so the count costs the CPU nothing
+ * however fast the wheel turns, and reading it is a single register load.
+ *
+ * The hardware counter is 16 bits wide. count() extends it to 32 bits, which
+ * works as long as it is read at least once per 32768 edges, far less than
+ * one control loop tick.
+ *
+ * The counters are provided by the board: quadratureCounterBegin() and
+ * quadratureCounterRead() are implemented in QuadratureEncoder.cpp for the GIGA
+ * and by the simulator's Arduino shim on the host, where a motor model turns
+ * the simulated PWM into encoder counts.
+ */
+const uint8_t QUADRATURE_ENCODERS = 2;
+
+// sets up the timer of the encoder, false if there is none
+bool quadratureCounterBegin(uint8_t encoder);
+// raw counter value of the encoder
+uint16_t quadratureCounterRead(uint8_t encoder);
+
+class QuadratureEncoder {
+public:
+  QuadratureEncoder(uint8_t encoder);
+
+  bool begin();
+
+  // edges counted since begin(), forward positive
+  int32_t count();
+
+private:
+  uint8_t _encoder;
+  uint16_t _last;
+  int32_t _count;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include "WheelSpeed.h"
+
+// extra fraction bits of the per tick integral gain, it is a small number
+static const int KI_STEP_EXTRA_BITS = 8;
+
+static int32_t clamp(int32_t value, int32_t limit){
+  if (value > limit){
+    return limit;
+  }
+  if (value < -limit){
+    return -limit;
+  }
+  return value;
+}
+
+WheelSpeedController::WheelSpeedController(int32_t speedMax, int dutyMax, uint32_t tickRateHz) :
+  _speedMax(speedMax > 0 ? speedMax : 1),
+  _dutyMax(dutyMax > 0 ? dutyMax : 1),
+  _tickRateHz(tickRateHz > 0 ? tickRateHz : 1),
+  _deadBand(0),
+  _kiStep(0),
+  _setpointSpeed(0)
+{
+  _gains.kp = 0;
+  _gains.ki = 0;
+  setDeadBand(0);
+  reset(0);
+}
+
+void WheelSpeedController::setGains(const WheelSpeedGains &gains){
+  _gains = gains;
+  _kiStep = ((int64_t)gains.ki << KI_STEP_EXTRA_BITS) / _tickRateHz;
+}
+
+void WheelSpeedController::setDeadBand(int deadBand){
+  if (deadBand < 0){
+    deadBand = 0;
+  } else if (deadBand > _dutyMax){
+    deadBand = _dutyMax;
+  }
+
+  _deadBand = deadBand;
+  _feedForward = ((int64_t)(_dutyMax - deadBand) << WHEEL_GAIN_FRACTION_BITS) / _speedMax;
+}
+
+int WheelSpeedController::deadBand() const {
+  return _deadBand;
+}
+
+void WheelSpeedController::setSetpoint(int setpoint){
+  setpoint = clamp(setpoint, _dutyMax);
+  _setpointSpeed = (int32_t)setpoint * _speedMax / _dutyMax;
+}
+
+int32_t WheelSpeedController::setpointSpeed() const {
+  return _setpointSpeed;
+}
+
+int32_t WheelSpeedController::speed() const {
+  return _speed;
+}
+
+int WheelSpeedController::duty() const {
+  return _duty;
+}
+
+void WheelSpeedController::reset(int32_t count){
+  for (int i = 0; i < WHEEL_SPEED_WINDOW; i++){
+    _counts[i] = count;
+  }
+  _countIndex = 0;
+  _speed = 0;
+  _integral = 0;
+  _duty = 0;
+}
+
+int WheelSpeedController::update(int32_t count){
+  //the oldest count in the window is exactly WHEEL_SPEED_WINDOW ticks old
+  int32_t moved = count - _counts[_countIndex];
+  _counts[_countIndex] = count;
+  _countIndex = (_countIndex + 1) & (WHEEL_SPEED_WINDOW - 1);
+  _speed = (moved * (int32_t)_tickRateHz) >> WHEEL_SPEED_WINDOW_SHIFT;
+
+  //a stopped wheel is not held, that only heats the motor
+  if (_setpointSpeed == 0){
+    _integral = 0;
+    _duty = 0;
+    return 0;
+  }
+
+  int32_t error = _setpointSpeed - _speed;
+  int32_t magnitude = _setpointSpeed > 0 ? _setpointSpeed : -_setpointSpeed;
+  int32_t feedForward = _deadBand + (((int64_t)magnitude * _feedForward) >> WHEEL_GAIN_FRACTION_BITS);
+  if (_setpointSpeed < 0){
+    feedForward = -feedForward;
+  }
+  int32_t proportional = clamp(((int64_t)error * _gains.kp) >> WHEEL_GAIN_FRACTION_BITS, 2 * _dutyMax);
+
+  //all in Q16 duty from here
+  int32_t limit = (int32_t)_dutyMax << WHEEL_GAIN_FRACTION_BITS;
+  int32_t fixed = (feedForward + proportional) * (1 << WHEEL_GAIN_FRACTION_BITS);
+  int32_t integral = clamp(_integral + (int32_t)(((int64_t)error * _kiStep) >> KI_STEP_EXTRA_BITS), limit);
+
+  //anti-windup: no integration further into saturation
+  int32_t output = fixed + integral;
+  if ((output > limit && error > 0) || (output < -limit && error < 0)){
+    integral = _integral;
+    output = fixed + integral;
+  }
+  _integral = integral;
+
+  _duty = clamp(output >> WHEEL_GAIN_FRACTION_BITS, _dutyMax);
+  return _duty;
+}
+
+DeadBandFinder::DeadBandFinder(int dutyMax, uint32_t stepTicks, int32_t moveCounts, uint32_t settleTicks) :
+  _dutyMax(dutyMax),
+  _stepTicks(stepTicks > 0 ? stepTicks : 1),
+  _moveCounts(moveCounts > 0 ? moveCounts : 1),
+  _settleTicks(settleTicks),
+  _running(false),
+  _found(false),
+  _direction(1),
+  _duty(0),
+  _ticks(0),
+  _stepCount(0),
+  _settling(false),
+  _forward(0),
+  _deadBand(0)
+{
+}
+
+void DeadBandFinder::start(int32_t count){
+  _running = true;
+  _found = false;
+  _direction = 1;
+  _duty = 0;
+  _ticks = 0;
+  _stepCount = count;
+  //the motor may still be coasting from before
+  _settling = true;
+  _forward = 0;
+  _deadBand = 0;
+}
+
+void DeadBandFinder::abort(){
+  _running = false;
+  _duty = 0;
+}
+
+bool DeadBandFinder::running() const {
+  return _running;
+}
+
+bool DeadBandFinder::found() const {
+  return _found;
+}
+
+int DeadBandFinder::deadBand() const {
+  return _deadBand;
+}
+
+int DeadBandFinder::update(int32_t count){
+  if (!_running){
+    return 0;
+  }
+
+  _ticks++;
+
+  if (_settling){
+    if (_ticks >= _settleTicks){
+      _settling = false;
+      _ticks = 0;
+      _duty = 1;
+      _stepCount = count;
+    }
+    return 0;
+  }
+
+  if (_ticks < _stepTicks){
+    return _direction * _duty;
+  }
+
+  //moved far enough the right way within this step
+  if ((count - _stepCount) * _direction >= _moveCounts){
+    if (_direction > 0){
+      _forward = _duty;
+      _direction = -1;
+      _duty = 0;
+      _ticks = 0;
+      _settling = true;
+      return 0;
+    }
+
+    _deadBand = _forward > _duty ? _forward : _duty;
+    _found = true;
+    _running = false;
+    return 0;
+  }
+
+  if (_duty >= _dutyMax){
+    //never moved, there is no encoder or no motor
+    abort();
+    return 0;
+  }
+
+  _duty++;
+  _ticks = 0;
+  _stepCount = count;
+  return _direction * _duty;
+}
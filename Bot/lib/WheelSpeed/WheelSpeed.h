@@ -0,0 +1,118 @@
+#ifndef WHEEL_SPEED_H
+#define WHEEL_SPEED_H
+
+#include <stdint.h>
+
+/*
+ * Closed-loop speed control of one wheel, advanced once per control loop tick.
+ *
+ * The speed is measured from the encoder count over the last WHEEL_SPEED_WINDOW
+ * ticks, in encoder counts per second. The duty is a feedforward from the setpoint
+ * plus a PI correction, so battery voltage and load only have to be made up by the
+ * integral term:
+ *
+ *   duty = sign(setpoint) * (deadBand + |setpoint| * (dutyMax - deadBand) / speedMax)
+ *        + kp * error + ki * sum(error) / rateHz
+ *
+ * Anti-windup: the integral only grows while the duty is not saturated in the
+ * direction of the error, and is itself clamped to +-dutyMax.
+ *
+ * Everything is fixed point, gains are Q16 (1 << WHEEL_GAIN_FRACTION_BITS is 1.0)
+ * in duty per count/s. update() is a handful of multiplies and shifts, no division.
+ */
+const int WHEEL_GAIN_FRACTION_BITS = 16;
+
+// ticks the speed is measured over, a power of two
+const int WHEEL_SPEED_WINDOW_SHIFT = 4;
+const int WHEEL_SPEED_WINDOW = 1 << WHEEL_SPEED_WINDOW_SHIFT;
+
+struct WheelSpeedGains {
+  int32_t kp;
+  int32_t ki;
+};
+
+class WheelSpeedController {
+public:
+  // speedMax is the speed a setpoint of dutyMax asks for, in counts per second
+  WheelSpeedController(int32_t speedMax, int dutyMax, uint32_t tickRateHz);
+
+  void setGains(const WheelSpeedGains &gains);
+  void setDeadBand(int deadBand);
+  int deadBand() const;
+
+  // setpoint in drive units, -dutyMax to dutyMax, dutyMax is speedMax
+  void setSetpoint(int setpoint);
+  int32_t setpointSpeed() const;
+
+  // takes the encoder count of this tick and returns the duty to drive the motor with
+  int update(int32_t count);
+
+  int32_t speed() const;
+  int duty() const;
+
+  // forgets the speed history and the integral, count is the encoder count now
+  void reset(int32_t count);
+
+private:
+  int32_t _speedMax;
+  int _dutyMax;
+  uint32_t _tickRateHz;
+  int _deadBand;
+
+  WheelSpeedGains _gains;
+  // Q24, duty per count/s and tick
+  int32_t _kiStep;
+  // Q16, duty per count/s above the dead band
+  int32_t _feedForward;
+
+  int32_t _setpointSpeed;
+  int32_t _counts[WHEEL_SPEED_WINDOW];
+  uint8_t _countIndex;
+  int32_t _speed;
+  int32_t _integral;
+  int _duty;
+};
+
+/*
+ * Finds the dead band of one motor at boot, replaces the old testMotors() sweep.
+ *
+ * The duty is stepped up from 0, one unit every stepTicks ticks, until the encoder
+ * moved by moveCounts within one step. That duty is the smallest one that turns the
+ * motor forward. The motor is then stopped and the same is done in reverse.
+ * The dead band is the larger of the two.
+ *
+ * If the motor never moves up to dutyMax the encoder is taken to be missing and
+ * found() stays false.
+ */
+class DeadBandFinder {
+public:
+  DeadBandFinder(int dutyMax, uint32_t stepTicks, int32_t moveCounts, uint32_t settleTicks);
+
+  void start(int32_t count);
+  void abort();
+  bool running() const;
+  bool found() const;
+  int deadBand() const;
+
+  // takes the encoder count of this tick and returns the duty to drive the motor with
+  int update(int32_t count);
+
+private:
+  int _dutyMax;
+  uint32_t _stepTicks;
+  int32_t _moveCounts;
+  uint32_t _settleTicks;
+
+  bool _running;
+  bool _found;
+  // 1 forward, -1 reverse
+  int _direction;
+  int _duty;
+  uint32_t _ticks;
+  int32_t _stepCount;
+  bool _settling;
+  int _forward;
+  int _deadBand;
+};
+
+#endif
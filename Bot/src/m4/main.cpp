@@ -0,0 +1,347 @@
+#include <Arduino.h>
+#include <RPC.h>
+#include <BotCores.h>
+#include <ControlLoop.h>
+#include <CommandWatchdog.h>
+#include <MotionProfile.h>
+#include <QuadratureEncoder.h>
+#include <WheelSpeed.h>
+
+
+/*
+ * Motor control core (M4) of the Bot.
+ *
+ * Applies the newest DriveCommand from the M7 once per control loop tick and runs
+ * the failsafe. Nothing else runs on this core, so ticks are not delayed by
+ * bluetooth. If the M7 stops publishing commands, for a lost connection or a
+ * stalled radio, the watchdog ramps the motors down on its own.
+ *
+ * With wheel encoders the drive is a wheel speed, held by a PI controller against
+ * battery voltage and load. Without them the drive is the duty, as before.
+ */
+
+/*
+ * 1 when both wheels have quadrature encoders on the TIM1/TIM2 inputs, set in
+ * platformio.ini. The timers start on every GIGA whether or not encoders are
+ * wired, so begin() cannot tell, and without encoders the dead band search would
+ * step both motors up to MOTOR_MAX for nothing before falling back to open loop.
+ */
+#ifndef WHEEL_ENCODERS
+#define WHEEL_ENCODERS 0
+#endif
+
+int MOTOR_1_FWD_PIN = 7;
+int MOTOR_1_RV_PIN = 6;
+
+int MOTOR_2_FWD_PIN = 4;
+int MOTOR_2_RV_PIN = 5;
+
+/*
+ * Duty last written to each motor pin. The control loop only calls analogWrite
+ * on pins whose duty actually changed. -1 forces a write on the first tick.
+ */
+int MOTOR_1_FWD_DUTY = -1;
+int MOTOR_1_RV_DUTY = -1;
+int MOTOR_2_FWD_DUTY = -1;
+int MOTOR_2_RV_DUTY = -1;
+
+/*
+ * Rate of the motor control loop in Hz. Each tick reads the latest drive command
+ * and applies it to the motor pins.
+ */
+const uint32_t CONTROL_LOOP_RATE_HZ = 1000;
+
+ControlLoop controlLoop(CONTROL_LOOP_RATE_HZ);
+
+/*
+ * Longest a drive command is trusted, in microseconds. When no fresh command
+ * arrives within this window the motors are ramped down, without waiting for
+ * the connection to time out. Must stay above the controller's keep-alive interval.
+ */
+const uint32_t COMMAND_TIMEOUT_US = 250000;
+
+CommandWatchdog commandWatchdog(COMMAND_TIMEOUT_US);
+
+/*
+ * Motion limits of each motor. Drive changes by at most MOTOR_SLEW_RATE per second,
+ * and that rate itself changes by at most the acceleration per second, which keeps
+ * current spikes down when the stick is slammed or reversed. The same ramps bring
+ * the motors to a stop after a command timeout.
+ * At these values full drive takes about 0.4 s to reach and 0.3 s to stop from.
+ */
+const uint32_t MOTOR_SLEW_RATE = 1000;
+const uint32_t MOTOR_1_ACCELERATION = 4000;
+const uint32_t MOTOR_2_ACCELERATION = 4000;
+
+RampGenerator motor1Ramp(MOTOR_SLEW_RATE, MOTOR_1_ACCELERATION, CONTROL_LOOP_RATE_HZ);
+RampGenerator motor2Ramp(MOTOR_SLEW_RATE, MOTOR_2_ACCELERATION, CONTROL_LOOP_RATE_HZ);
+
+/*
+ * Wheel speed a drive of MOTOR_MAX asks for, in encoder counts per second.
+ * It sits below what the motors reach on a charged battery, which leaves the
+ * speed controller headroom to make up for a low battery or a load.
+ */
+const int32_t WHEEL_SPEED_MAX = 2400;
+
+/*
+ * PI gains of the wheel speed controllers, Q16 duty per count/s.
+ * kp is 0.04 and ki 0.8 per second, the integral time matches the motors' time
+ * constant of about 50 ms.
+ */
+const WheelSpeedGains WHEEL_SPEED_GAINS = { 2621, 52429 };
+
+QuadratureEncoder motor1Encoder(0);
+QuadratureEncoder motor2Encoder(1);
+
+WheelSpeedController motor1Speed(WHEEL_SPEED_MAX, MOTOR_MAX, CONTROL_LOOP_RATE_HZ);
+WheelSpeedController motor2Speed(WHEEL_SPEED_MAX, MOTOR_MAX, CONTROL_LOOP_RATE_HZ);
+
+/*
+ * Dead band search at boot, see setup(). The duty goes up by one every
+ * DEAD_BAND_STEP_TICKS until the wheel turns by DEAD_BAND_MOVE_COUNTS, forward
+ * then reverse. With a dead band around 70 this takes about 3.5 s.
+ */
+const uint32_t DEAD_BAND_STEP_TICKS = 20;
+const int32_t DEAD_BAND_MOVE_COUNTS = 2;
+const uint32_t DEAD_BAND_SETTLE_TICKS = 300;
+
+DeadBandFinder motor1DeadBand(MOTOR_MAX, DEAD_BAND_STEP_TICKS, DEAD_BAND_MOVE_COUNTS, DEAD_BAND_SETTLE_TICKS);
+DeadBandFinder motor2DeadBand(MOTOR_MAX, DEAD_BAND_STEP_TICKS, DEAD_BAND_MOVE_COUNTS, DEAD_BAND_SETTLE_TICKS);
+
+//encoders fitted and both timers started, CLOSED_LOOP once the dead band search found both motors
+bool ENCODERS = false;
+bool CLOSED_LOOP = false;
+
+//newest command read from the M7 and its mailbox sequence
+DriveCommand COMMAND = {};
+uint32_t COMMAND_SEQUENCE = 0;
+
+//last statistics reset request handled
+uint32_t RESET_STATS_SEQUENCE = 0;
+
+
+/*
+ * Writes duty to pin, unless it is already the last duty written to that pin.
+ */
+void writeDuty(int pin, int duty, int &lastDuty){
+  if (duty != lastDuty){
+    analogWrite(pin, duty);
+    lastDuty = duty;
+  }
+}
+
+/*
+ * Drives one motor with a signed duty, forward positive.
+ */
+void writeDrive(int drive, int fwdPin, int rvPin, int &fwdDuty, int &rvDuty){
+  if (drive < 0){
+    writeDuty(fwdPin, 0, fwdDuty);
+    writeDuty(rvPin, abs(drive), rvDuty);
+  } else {
+    writeDuty(rvPin, 0, rvDuty);
+    writeDuty(fwdPin, drive, fwdDuty);
+  }
+}
+
+/*
+ * Picks up the newest drive command from the M7. A change in the command count
+ * is a fresh controller state, which feeds the watchdog.
+ * A new connection (armed again) starts with a tripped watchdog, so nothing
+ * moves before the controller has spoken.
+ */
+void readCommand(){
+  DriveCommand command;
+  uint32_t sequence;
+
+  if (!motorMailboxes().command.read(command, &sequence) || sequence == COMMAND_SEQUENCE){
+    return;
+  }
+
+  if (command.armed && !COMMAND.armed){
+    commandWatchdog.reset();
+  }
+
+  if (command.armed && command.commands != COMMAND.commands){
+    commandWatchdog.commandReceived(micros());
+  }
+
+  COMMAND = command;
+  COMMAND_SEQUENCE = sequence;
+}
+
+/*
+ * Clears the statistics when the M7 asks for it.
+ */
+void readResetStats(){
+  uint32_t request, sequence;
+
+  if (motorMailboxes().resetStats.read(request, &sequence) && sequence != RESET_STATS_SEQUENCE){
+    RESET_STATS_SEQUENCE = sequence;
+    commandWatchdog.resetStats();
+    controlLoop.resetStats();
+  }
+}
+
+/*
+ * Ends the dead band search. Closed-loop control starts if both motors were
+ * found, otherwise the motors are driven open loop above MOTOR_MIN.
+ */
+void finishDeadBandSearch(int32_t count1, int32_t count2){
+  CLOSED_LOOP = motor1DeadBand.found() && motor2DeadBand.found();
+  if (!CLOSED_LOOP){
+    return;
+  }
+
+  motor1Speed.setDeadBand(motor1DeadBand.deadBand());
+  motor2Speed.setDeadBand(motor2DeadBand.deadBand());
+  motor1Speed.reset(count1);
+  motor2Speed.reset(count2);
+
+  //the speed controllers take care of the dead band, the ramps may pass through it
+  motor1Ramp.setSkipBand(0);
+  motor2Ramp.setSkipBand(0);
+}
+
+/*
+ * Takes drive information, and handles motor control with it.
+ * Runs once per control loop tick. The drive commands are the targets of the motor
+ * ramps, which move the actual drive towards them within the motion limits.
+ * In closed loop the ramp output is the speed setpoint of the wheel.
+ *
+ * If the last command is stale, the motors are ramped down to a stop.
+ * If the command is not armed, all motor movement is stopped at once.
+ * Commands wait until the dead band search after boot is done.
+ */
+void motor_Driver(){
+
+  readCommand();
+
+  int32_t count1 = ENCODERS ? motor1Encoder.count() : 0;
+  int32_t count2 = ENCODERS ? motor2Encoder.count() : 0;
+
+  if (motor1DeadBand.running() || motor2DeadBand.running()){
+    writeDrive(motor1DeadBand.update(count1), MOTOR_1_FWD_PIN, MOTOR_1_RV_PIN, MOTOR_1_FWD_DUTY, MOTOR_1_RV_DUTY);
+    writeDrive(motor2DeadBand.update(count2), MOTOR_2_FWD_PIN, MOTOR_2_RV_PIN, MOTOR_2_FWD_DUTY, MOTOR_2_RV_DUTY);
+
+    if (!motor1DeadBand.running() && !motor2DeadBand.running()){
+      finishDeadBandSearch(count1, count2);
+    }
+    return;
+  }
+
+  if (COMMAND.armed){
+    int target1 = 0;
+    int target2 = 0;
+
+    if (commandWatchdog.check(micros())){
+      target1 = COMMAND.motor1;
+      target2 = COMMAND.motor2;
+    }
+
+    motor1Ramp.setTarget(target1);
+    motor2Ramp.setTarget(target2);
+  } else {
+    motor1Ramp.reset(0);
+    motor2Ramp.reset(0);
+  }
+
+  int drive1 = motor1Ramp.update();
+  int drive2 = motor2Ramp.update();
+
+  if (CLOSED_LOOP){
+    motor1Speed.setSetpoint(drive1);
+    motor2Speed.setSetpoint(drive2);
+    drive1 = motor1Speed.update(count1);
+    drive2 = motor2Speed.update(count2);
+  }
+
+  writeDrive(drive1, MOTOR_1_FWD_PIN, MOTOR_1_RV_PIN, MOTOR_1_FWD_DUTY, MOTOR_1_RV_DUTY);
+  writeDrive(drive2, MOTOR_2_FWD_PIN, MOTOR_2_RV_PIN, MOTOR_2_FWD_DUTY, MOTOR_2_RV_DUTY);
+
+}
+
+/*
+ * Signed duty written to the pins of one motor, forward positive.
+ */
+int16_t appliedDuty(int fwdDuty, int rvDuty){
+  //-1 until the pin was first written
+  return (int16_t)((fwdDuty > 0 ? fwdDuty : 0) - (rvDuty > 0 ? rvDuty : 0));
+}
+
+/*
+ * Publishes the control loop and watchdog state for the M7 to report.
+ */
+void publishStatus(){
+  MotorStatus status;
+
+  status.appliedCommand = COMMAND_SEQUENCE;
+  status.armed = COMMAND.armed;
+  status.motor1Duty = appliedDuty(MOTOR_1_FWD_DUTY, MOTOR_1_RV_DUTY);
+  status.motor2Duty = appliedDuty(MOTOR_2_FWD_DUTY, MOTOR_2_RV_DUTY);
+
+  status.rateHz = controlLoop.rate();
+  status.ticks = controlLoop.ticks();
+  status.overruns = controlLoop.overruns();
+  status.lastJitterUs = controlLoop.lastJitterMicros();
+  status.maxJitterUs = controlLoop.maxJitterMicros();
+  status.maxTickUs = controlLoop.maxTickMicros();
+
+  status.commands = commandWatchdog.commands();
+  status.commandAgeUs = commandWatchdog.ageMicros(micros());
+  status.maxCommandGapUs = commandWatchdog.maxGapMicros();
+  status.commandTimeouts = commandWatchdog.timeouts();
+  status.commandRecoveries = commandWatchdog.recoveries();
+
+  status.closedLoop = CLOSED_LOOP;
+  status.motor1DeadBand = motor1DeadBand.deadBand();
+  status.motor2DeadBand = motor2DeadBand.deadBand();
+  status.motor1Speed = motor1Speed.speed();
+  status.motor2Speed = motor2Speed.speed();
+  status.motor1Setpoint = motor1Speed.setpointSpeed();
+  status.motor2Setpoint = motor2Speed.setpointSpeed();
+
+  motorMailboxes().status.publish(status);
+}
+
+
+void setup() {
+  RPC.begin();
+
+  analogWrite(MOTOR_1_RV_PIN,0);
+  analogWrite(MOTOR_2_RV_PIN,0);
+  analogWrite(MOTOR_1_FWD_PIN,0);
+  analogWrite(MOTOR_2_FWD_PIN,0);
+
+  //open loop, drive values below MOTOR_MIN do not turn the motors, the ramps skip them
+  motor1Ramp.setSkipBand(MOTOR_MIN);
+  motor2Ramp.setSkipBand(MOTOR_MIN);
+
+  motor1Speed.setGains(WHEEL_SPEED_GAINS);
+  motor2Speed.setGains(WHEEL_SPEED_GAINS);
+
+  //both motors creep up to their dead band, forward then reverse, closed loop starts after
+  //without encoders the motors stay stopped and are driven open loop
+  ENCODERS = WHEEL_ENCODERS && motor1Encoder.begin() && motor2Encoder.begin();
+  if (ENCODERS){
+    motor1DeadBand.start(motor1Encoder.count());
+    motor2DeadBand.start(motor2Encoder.count());
+  }
+
+  controlLoop.start(micros());
+}
+
+/*
+ * Waits for the next control loop tick, then runs the motor driver once.
+ * This core has nothing else to do, so the wait is a plain spin.
+ */
+void loop() {
+  while (controlLoop.remaining(micros()) > 0){
+  }
+
+  controlLoop.beginTick(micros());
+  readResetStats();
+  motor_Driver();
+  controlLoop.endTick(micros());
+
+  publishStatus();
+}
@@ -1,274 +1,433 @@
 #include <Scheduler.h>
+#include <RPC.h>
 #include <ArduinoBLE.h>
+#include <BotCores.h>
+#include <BotStatus.h>
+#include <ControllerFleet.h>
+#include <ControllerState.h>
+#include <DriveMixer.h>
+#include <LatencyStats.h>
+#include <LinkProfile.h>
 
 
 /*
- * Values used to determine the speed at which the respective motor is driven. 
- * These values will be sent along either the foward or reverse pins depending on the signal from bluetooth. 
- * A possible way to differentiate between forward and reverse signals, is to make reverse values negative, then take the absolute value
- * before sending to pin. 
- * 
+ * Bluetooth core (M7) of the Bot. The motor control loop and the failsafe run on
+ * the M4, see src/m4/main.cpp and BotCores.h.
  */
-int MOTOR_1_DRIVE = 0;
-int MOTOR_2_DRIVE = 0;
 
 /*
- * Specifies minimum drive for the motors
- * Testing revealed values below this fail to drive the motors.
- * 
- * Due to this, motors should be at 0 control indicates such.
- * When controls indicate movement, drive should start and scale from this value. 
- * 
- * This determines, a minimum speed, and should be decreased if min speed is too fast. 
- * 
+ * Drive command handed to the M4. The motor drives are sent along either the forward
+ * or reverse pins by the M4, negative values are reverse.
+ * Only the bluetooth task writes it, every change is published to the command mailbox.
  */
-int MOTOR_MIN = 70;
+DriveCommand DRIVE_COMMAND = {};
 
-bool SAFETY = false;
+/*
+ * How often the control loop jitter and overrun counts are printed, in milliseconds.
+ */
+const unsigned long CONTROL_LOOP_REPORT_INTERVAL_MS = 5000;
 
-int MOTOR_1_FWD_PIN = 7;
-int MOTOR_1_RV_PIN = 6;
+/*
+ * Latency instrumentation, dumped over Serial when LATENCY_DUMP_COMMAND is received.
+ * - linkLatency: transit above the fastest delivery, packet gaps and lost samples, per fleet slot
+ * - applyLatency: notification received to PWM written by the M4
+ * - endToEndLatency: both of the above added up for every command
+ */
+LinkLatencyTracker linkLatency[FLEET_MAX_CONTROLLERS];
+LatencyHistogram applyLatency;
+LatencyHistogram endToEndLatency;
 
-int MOTOR_2_FWD_PIN = 4;
-int MOTOR_2_RV_PIN = 5;
+//receive time, relative transit time and command mailbox sequence of the newest command, set by the notification handler
+volatile uint32_t COMMAND_RECEIVED_US = 0;
+volatile uint32_t COMMAND_TRANSIT_US = 0;
+volatile uint32_t COMMAND_SEQUENCE = 0;
 
+//command mailbox sequence of the last command whose apply latency was recorded
+uint32_t APPLIED_COMMAND = 0;
 
-char UUID[] = "ENTER UUID HERE";
-char peripheral_name[] = "ENTER NAME HERE"; 
+/*
+ * Connection parameters granted by the bluetooth controller for the driving controller's link,
+ * as reported by the LE Connection Update Complete event. 0 while disconnected.
+ * Interval is in 1.25 ms units, supervision timeout in 10 ms units.
+ */
+volatile uint16_t LINK_INTERVAL = 0;
+volatile uint16_t LINK_LATENCY = 0;
+volatile uint16_t LINK_SUPERVISION_TIMEOUT = 0;
 
-//the indexes for motor 1 and 2 characteristics
-const int characteristicIndex1 = 0;
-const int characteristicIndex2 = 1;
 
+/*
+ * Every controller in range stays connected, the one with the highest priority drives.
+ * DRIVER is its fleet slot, -1 while no controller is connected.
+ */
+ControllerFleet fleet;
+int DRIVER = -1;
 
 /*
- * Takes drive information, and handles motor control with it. 
+ * RSSI of the driver's link as of the last read. The read runs in the background,
+ * each status asks for the one the next status reports, the loop never waits on it.
  */
-void motor_Driver(){
-
-  
-  while (SAFETY){
-    
-
-    //motor 1 drive
-    if (MOTOR_1_DRIVE < 0){
-      analogWrite(MOTOR_1_FWD_PIN,0);
-      analogWrite(MOTOR_1_RV_PIN,abs(MOTOR_1_DRIVE));
-    } else {
-      analogWrite(MOTOR_1_RV_PIN,0);
-      analogWrite(MOTOR_1_FWD_PIN,MOTOR_1_DRIVE);
-    }
+int DRIVER_RSSI = BOT_STATUS_NO_RSSI;
 
-    //motor 2 drive
-    if (MOTOR_2_DRIVE < 0){
-      analogWrite(MOTOR_2_FWD_PIN,0);
-      analogWrite(MOTOR_2_RV_PIN,abs(MOTOR_2_DRIVE));
-    } else {
-      analogWrite(MOTOR_2_RV_PIN,0);
-      analogWrite(MOTOR_2_FWD_PIN,MOTOR_2_DRIVE);
-    }
-  
-    
-  }
-  //stop all motor movement if safety fails
-  analogWrite(MOTOR_1_FWD_PIN,0); 
-  analogWrite(MOTOR_1_RV_PIN,0);
-  analogWrite(MOTOR_2_RV_PIN,0);
-  analogWrite(MOTOR_2_FWD_PIN,0);
-  
+/*
+ * Mixes the thumb stick into left (motor 1) and right (motor 2) wheel duties.
+ * Open loop they are scaled above MOTOR_MIN. Once the M4 runs the wheels in closed
+ * loop they are speed setpoints from 0 up, the speed controllers make up the dead
+ * band they measured, see updateMotorRange.
+ */
+DriveMixer driveMixer(MOTOR_MIN, MOTOR_MAX);
+
+//longest time the fleet waits for bluetooth events before checking the links again
+const unsigned long BLE_POLL_TIMEOUT_MS = 10;
+
+/*
+ * Telemetry back-channel: the Bot serves its status (applied duties, command age,
+ * link RSSI, control loop overruns) and notifies every Controller that subscribed,
+ * at most once every BOT_STATUS_INTERVAL_MS.
+ */
+BLEService botTelemetryService(BOT_TELEMETRY_UUID);
+BLECharacteristic botStatusCharacteristic(BOT_STATUS_UUID, BLERead | BLENotify, BOT_STATUS_SIZE, true);
+BotStatusPublisher botStatusPublisher;
+
+
+/*
+ * Publishes DRIVE_COMMAND to the M4 and returns its mailbox sequence.
+ */
+uint32_t publishDriveCommand(){
+  motorMailboxes().command.publish(DRIVE_COMMAND);
+  return motorMailboxes().command.published();
 }
 
+/*
+ * Lets the mixer start at 0 while the M4 controls the wheel speed, and above
+ * MOTOR_MIN while it drives the motors open loop.
+ */
+void updateMotorRange(const MotorStatus &status){
+  uint8_t motorMin = status.closedLoop ? 0 : MOTOR_MIN;
 
+  if (driveMixer.motorMin() != motorMin){
+    driveMixer.setMotorRange(motorMin, MOTOR_MAX);
+  }
+}
 
 /*
- * Maintains connection to bluetooth peripheral, 
- * and retrieves throttle information. Will continuously update readings
- * as long as connection holds. 
- * 
- * Motor throttle information is stored in drive global variables
- * 
- * If connection drops, will return back to BLEconnection to attempt another connection
+ * Apply latency task, started with the scheduler.
+ * Watches the M4 status for the newest command to show up as applied. The time is
+ * taken here, so it includes up to one pass of this task on top of the real latency.
+ * The status also tells whether the wheels run in closed loop.
  */
-void controlled(BLEDevice peripheral){
-  Serial.println("attempting to connect to device...");
+void watchAppliedCommands(){
+  MotorStatus status;
 
+  if (motorMailboxes().status.read(status)){
+    updateMotorRange(status);
 
-  //attempt to establish connection
-  if (peripheral.connect()){
-    Serial.println("Established connected to peripheral device!");
-  } else {
-    Serial.println("Was unable to establish connection to peripheral device. Returning to retry");
+    uint32_t sequence = COMMAND_SEQUENCE;
+
+    if (sequence != APPLIED_COMMAND && status.appliedCommand == sequence){
+      uint32_t apply = micros() - COMMAND_RECEIVED_US;
+      applyLatency.record(apply);
+      endToEndLatency.record(COMMAND_TRANSIT_US + apply);
+      APPLIED_COMMAND = sequence;
+    }
+  }
+
+  yield();
+}
+
+/*
+ * Periodically prints the control loop timing reported by the M4, started with the scheduler.
+ */
+void reportControlLoop(){
+  delay(CONTROL_LOOP_REPORT_INTERVAL_MS);
+
+  MotorStatus status;
+  if (!motorMailboxes().status.read(status)){
+    Serial.println("Control loop: no status from the M4");
     return;
   }
 
-  //discover peripheral attributes
-  if (peripheral.discoverAttributes()){
-     Serial.println("Found attributes of peripheral device!");
+  Serial.print("Control loop: ");
+  Serial.print(status.rateHz);
+  Serial.print(" Hz, ticks ");
+  Serial.print(status.ticks);
+  Serial.print(", overruns ");
+  Serial.print(status.overruns);
+  Serial.print(", jitter ");
+  Serial.print(status.lastJitterUs);
+  Serial.print(" us (max ");
+  Serial.print(status.maxJitterUs);
+  Serial.print(" us), max tick ");
+  Serial.print(status.maxTickUs);
+  Serial.println(" us");
+
+  Serial.print("Commands: ");
+  Serial.print(status.commands);
+  Serial.print(", age ");
+  Serial.print(status.commandAgeUs);
+  Serial.print(" us, max gap ");
+  Serial.print(status.maxCommandGapUs);
+  Serial.print(" us, timeouts ");
+  Serial.print(status.commandTimeouts);
+  Serial.print(", recoveries ");
+  Serial.println(status.commandRecoveries);
+
+  if (status.closedLoop){
+    Serial.print("Wheels: dead band ");
+    Serial.print(status.motor1DeadBand);
+    Serial.print("/");
+    Serial.print(status.motor2DeadBand);
+    Serial.print(", speed ");
+    Serial.print(status.motor1Speed);
+    Serial.print("/");
+    Serial.print(status.motor2Speed);
+    Serial.print(" of ");
+    Serial.print(status.motor1Setpoint);
+    Serial.print("/");
+    Serial.print(status.motor2Setpoint);
+    Serial.println(" counts/s");
   } else {
-    peripheral.disconnect();
-    Serial.println("Was not able to find attributes of device. Disconnecting...");
-    return;
+    Serial.println("Wheels: open loop");
+  }
+
+  if (LINK_INTERVAL != 0){
+    Serial.print("Link: interval ");
+    Serial.print(connection_interval_us(LINK_INTERVAL));
+    Serial.print(" us, latency ");
+    Serial.print(LINK_LATENCY);
+    Serial.print(", supervision timeout ");
+    Serial.print(supervision_timeout_ms(LINK_SUPERVISION_TIMEOUT));
+    Serial.println(is_realtime_link(LINK_INTERVAL, LINK_LATENCY) ? " ms (realtime)" : " ms (NOT realtime)");
   }
+}
 
-  //the service provided by the peripheral (controller) will have two characteristics, one for each motor
-  BLECharacteristic throttleCharacteristic1 = peripheral.characteristic(UUID,characteristicIndex1);
-  BLECharacteristic throttleCharacteristic2 = peripheral.characteristic(UUID,characteristicIndex2);
+/*
+ * Prints the latency statistics.
+ */
+void dumpLatency(){
+  Serial.println("Latency:");
+  for (int slot = 0; slot < FLEET_MAX_CONTROLLERS; slot++){
+    if (linkLatency[slot].received() == 0){
+      continue;
+    }
+    char name[24];
+    snprintf(name, sizeof(name), "Controller link %d", slot);
+    linkLatency[slot].print(Serial, name);
+  }
+  applyLatency.print(Serial, "Receive to PWM");
+  endToEndLatency.print(Serial, "Input to PWM above fastest", true);
+}
 
-  if (!throttleCharacteristic1 || !throttleCharacteristic2){
-    peripheral.disconnect();
-    Serial.println("Was not able to find throttle characteristic. Disconnecting...");
+/*
+ * Serial command task, started with the scheduler.
+ * LATENCY_DUMP_COMMAND prints the latency statistics, LATENCY_RESET_COMMAND clears them.
+ */
+void serialCommands(){
+  if (!Serial.available()){
+    delay(20);
     return;
-  } else if (!throttleCharacteristic1.canRead() || !throttleCharacteristic2.canRead()){
-    peripheral.disconnect(); 
-    Serial.println("Throttle characteristic is not readable. Disconnecting... ");
   }
 
-  uint16_t throttle1 = 0;
-  uint16_t throttle2 = 0;
-  
-  //loop while connected
-  while (peripheral.connected()){
-    //allow movement while connected
-    SAFETY = true;
-  
-    throttleCharacteristic1.readValue(throttle1);
+  char command = Serial.read();
 
-    throttleCharacteristic2.readValue(throttle2);
-
-    //process data if need be
+  if (command == LATENCY_DUMP_COMMAND){
+    dumpLatency();
+  } else if (command == LATENCY_RESET_COMMAND){
+    for (LinkLatencyTracker &tracker : linkLatency){
+      tracker.reset();
+    }
+    applyLatency.reset();
+    endToEndLatency.reset();
+    //the M4 clears its control loop and watchdog statistics
+    motorMailboxes().resetStats.publish(millis());
+    Serial.println("Latency statistics cleared");
+  }
+}
 
-    MOTOR_1_DRIVE = throttle1;
 
-    MOTOR_2_DRIVE = throttle2;
-    
-  }
 
-  //stop movement if disconnected
-  SAFETY = false;
+/*
+ * Hands the motors to the controller the fleet picks as driver.
+ * 
+ * On every change the motors stop until the new driver's first notification.
+ * The M4 stays armed as long as any controller is connected and restarts its
+ * watchdog when it gets armed, with no controller left the motors are disarmed.
+ */
+void selectDriver(){
+  int driver = fleet.driver();
 
-  Serial.println("Peripheral Disconnected");
-  return;
-  
+  if (driver == DRIVER){
+    return;
+  }
+  DRIVER = driver;
+  DRIVER_RSSI = BOT_STATUS_NO_RSSI;
+
+  DRIVE_COMMAND.motor1 = 0;
+  DRIVE_COMMAND.motor2 = 0;
+  DRIVE_COMMAND.armed = driver >= 0;
+  publishDriveCommand();
+
+  if (driver >= 0){
+    Serial.print("Controller ");
+    Serial.print(driver);
+    Serial.print(" (");
+    Serial.print(fleet.slot(driver).device.address());
+    Serial.println(") is driving");
+  } else {
+    Serial.println("No controller connected, motors stopped");
+  }
 }
 
-
 /*
- * Handles the bluetooth connection after intialization
+ * State handler of the controller fleet, called from BLE polling as soon as each
+ * notification is dispatched. The state is decoded straight from the notification,
+ * no read request is sent. Only the driving controller moves the motors.
+ * 
+ * The y axis is throttle and the x axis is steering, the mixer turns them
+ * into the drive of motor 1 (left) and motor 2 (right).
  */
-void BLEconnection(){
+void controllerStateUpdated(int slot, const ControllerState &state, uint32_t receivedUs){
+  uint32_t transit = linkLatency[slot].on_receive(state.sequence, state.timestamp_us, receivedUs);
 
-  //loop
-  while(true){
+  selectDriver();
+  if (slot != DRIVER){
+    return;
+  }
 
-    BLEDevice peripheral = BLE.available();
+  WheelDuty wheels = driveMixer.mix(state.thumb_stick_x_axis, state.thumb_stick_y_axis);
 
-    //if found peripheral
-    if (peripheral){
-       // discovered a peripheral, print out address, local name, and advertised service
+  DRIVE_COMMAND.motor1 = wheels.left;
+  DRIVE_COMMAND.motor2 = wheels.right;
+  DRIVE_COMMAND.commands++;
 
-      Serial.print("Found ");
-      Serial.print(peripheral.address());
-      Serial.print(" '");
-      Serial.print(peripheral.localName());
-      Serial.print("' ");
-      Serial.print(peripheral.advertisedServiceUuid());
-      Serial.println();
+  COMMAND_RECEIVED_US = receivedUs;
+  COMMAND_TRANSIT_US = transit;
+  COMMAND_SEQUENCE = publishDriveCommand();
+}
 
-      if (peripheral.localName() != peripheral_name) {
-        return;
-      }
 
-      BLE.stopScan();
+/*
+ * Asks for the realtime link profile if the connection is not already running at it.
+ * The controller reports the parameters it actually granted later, see updateLinkParameters.
+ */
+void requestRealtimeLink(BLEDevice peripheral){
+  uint16_t interval, latency, supervisionTimeout;
 
-      controlled(peripheral);
-      
+  if (peripheral.connectionParameters(interval, latency, supervisionTimeout) && is_realtime_link(interval, latency)){
+    return;
+  }
 
-      //if disconnected from peripheral, start scanning again
-      BLE.scanForUuid(UUID);
-      
-    }
-    
+  if (!peripheral.updateConnectionParameters(REALTIME_CONNECTION_INTERVAL, REALTIME_CONNECTION_INTERVAL,
+                                             REALTIME_PERIPHERAL_LATENCY, REALTIME_SUPERVISION_TIMEOUT)){
+    Serial.println("Was unable to request the realtime link profile");
   }
-  
 }
 
-void testMotors(){
-    /*
-     * test motor 1 for 0-255 speed forward 
-     */
-
+/*
+ * Copies the granted connection parameters of the driving controller's link into
+ * the LINK_ globals and prints them when they change.
+ */
+void updateLinkParameters(){
+  uint16_t interval = 0, latency = 0, supervisionTimeout = 0;
 
-  //Ramp up and down motor 1 forward speed
-  
-  for (int i=MOTOR_MIN;i<256;i++){
-    analogWrite(MOTOR_1_FWD_PIN,i);
-    delay(75);
-  }
-  
-  for (int i=255;i>=0;i--){
-
-    if (i < MOTOR_MIN){
-      analogWrite(MOTOR_1_FWD_PIN,0);
-      break;
-    } else {
-      analogWrite(MOTOR_1_FWD_PIN,i);
-      delay(75);
+  if (DRIVER >= 0){
+    BLEDevice peripheral = fleet.slot(DRIVER).device;
+    if (!peripheral.connectionParameters(interval, latency, supervisionTimeout)){
+      return;
     }
   }
 
-   //ramp up and down motor 1 reverse speed
-  for (int i=MOTOR_MIN;i<256;i++){
-    analogWrite(MOTOR_1_RV_PIN,i);
-    delay(75);
-  }
-  
-  for (int i=255;i>=0;i--){
-    if (i< MOTOR_MIN){
-      analogWrite(MOTOR_1_RV_PIN,0);
-      break;
-    } else {
-      analogWrite(MOTOR_1_RV_PIN,i);
-      delay(75);
+  if (interval != LINK_INTERVAL || latency != LINK_LATENCY || supervisionTimeout != LINK_SUPERVISION_TIMEOUT){
+    LINK_INTERVAL = interval;
+    LINK_LATENCY = latency;
+    LINK_SUPERVISION_TIMEOUT = supervisionTimeout;
+
+    if (interval != 0){
+      Serial.print("Link interval is now ");
+      Serial.print(connection_interval_us(interval));
+      Serial.print(" us, latency ");
+      Serial.println(latency);
     }
   }
+}
 
 
-  //ramp up and dowm motor 2 forward speed
- 
-  for (int i=MOTOR_MIN;i<256;i++){
-    analogWrite(MOTOR_2_FWD_PIN,i);
-    delay(75);
+/*
+ * Takes the RSSI read in the background as long as it is still the driver's link.
+ */
+void driverRssiRead(BLEDevice device, int rssi){
+  if (DRIVER >= 0 && device == fleet.slot(DRIVER).device){
+    DRIVER_RSSI = rssi;
   }
-  for (int i=255;i>=0;i--){
-    if (i < MOTOR_MIN){
-      analogWrite(MOTOR_2_FWD_PIN,0);
-      break;
-    } else { 
-      analogWrite(MOTOR_2_FWD_PIN,i);
-      delay(75);
-    }
+}
+
+
+/*
+ * Notifies the Bot's status to the subscribed controllers when the next one is due.
+ * The status is built from the newest M4 status right then, nothing is queued.
+ */
+void publishBotStatus(){
+  uint32_t now = millis();
+
+  if (!botStatusPublisher.due(now) || !botStatusCharacteristic.subscribed()){
+    return;
+  }
+
+  MotorStatus motors;
+  if (!motorMailboxes().status.read(motors)){
+    return;
+  }
+
+  BotStatus status = {};
+  if (motors.armed){
+    status.flags |= BOT_STATUS_ARMED;
   }
-  //ramp up and down motor 2 reverse speed
-  for (int i=MOTOR_MIN;i<256;i++){
-    analogWrite(MOTOR_2_RV_PIN,i);
-    delay(75);
+  if (motors.closedLoop){
+    status.flags |= BOT_STATUS_CLOSED_LOOP;
   }
-  for (int i=255;i>=0;i--){
-
-    if (i < MOTOR_MIN){
-      analogWrite(MOTOR_2_RV_PIN,0);
-      break;
-    } else {
-      analogWrite(MOTOR_2_RV_PIN,i);
-      delay(75);
-    }
+  status.motor1_duty = motors.motor1Duty;
+  status.motor2_duty = motors.motor2Duty;
+  status.command_age_us = motors.commandAgeUs;
+  status.overruns = motors.overruns;
+  status.command_timeouts = motors.commandTimeouts > 0xffff ? 0xffff : motors.commandTimeouts;
+  status.rssi = BOT_STATUS_NO_RSSI;
+  if (DRIVER >= 0){
+    BLEDevice driver = fleet.slot(DRIVER).device;
+    status.rssi = (int8_t)DRIVER_RSSI;
+    driver.requestRssi(driverRssiRead);
   }
 
-  return;
-     
+  botStatusPublisher.publish(status, now);
+
+  uint8_t value[BOT_STATUS_SIZE];
+  encode_bot_status(status, value);
+  botStatusCharacteristic.writeValue(value, sizeof(value));
+}
+
+
+/*
+ * Called by the fleet once a controller is connected, right before subscribing to its state.
+ */
+void controllerConnected(int slot, BLEDevice peripheral){
+  Serial.print("Controller ");
+  Serial.print(slot);
+  Serial.print(" connected: ");
+  Serial.println(peripheral.address());
+
+  requestRealtimeLink(peripheral);
+  linkLatency[slot].restart();
+  selectDriver();
 }
 
+/*
+ * Called by the fleet when a controller's link is gone, another one may take over.
+ */
+void controllerDisconnected(int slot, BLEDevice peripheral){
+  Serial.print("Controller ");
+  Serial.print(slot);
+  Serial.println(" disconnected");
 
+  selectDriver();
+}
 
 
 /*
@@ -280,14 +439,27 @@ int BLEinit(){
     return 1;
   }
 
+  //used when connecting and to accept the controller's own request for the realtime profile
+  BLE.setConnectionInterval(REALTIME_CONNECTION_INTERVAL, REALTIME_CONNECTION_INTERVAL);
+  BLE.setSupervisionTimeout(REALTIME_SUPERVISION_TIMEOUT);
+
+  //a controller that reconnects gets its attribute handles from the cache instead of a full discovery
+  BLE.setGattCache(true);
 
-  if (!BLE.scanForUuid(UUID)){
+  //served to the controllers, which subscribe to it once connected
+  botTelemetryService.addCharacteristic(botStatusCharacteristic);
+  BLE.addService(botTelemetryService);
+
+  fleet.set_policy(FLEET_HIGHEST_PRIORITY);
+  fleet.set_state_handler(controllerStateUpdated);
+  fleet.set_connect_handler(controllerConnected);
+  fleet.set_disconnect_handler(controllerDisconnected);
+
+  if (!fleet.begin()){
     Serial.println("An error occured when scanning");
     return 1;
   }
 
-  
-
   return 0;
 }
 
@@ -295,20 +467,29 @@ int BLEinit(){
 void setup() {
   // put your setup code here, to run once:
   Serial.begin(115200);
-  analogWrite(MOTOR_1_RV_PIN,0);
-  analogWrite(MOTOR_2_RV_PIN,0);
-  analogWrite(MOTOR_1_FWD_PIN,0);
-  analogWrite(MOTOR_2_FWD_PIN,0);
 
-  delay(2000);
+  //the M4 starts disarmed, with wheel encoders it searches the dead bands, then holds the motors stopped
+  resetMotorMailboxes();
+  publishDriveCommand();
+
+  //boots the M4, which runs the motor control loop from then on, bluetooth stays in loop
+  RPC.begin();
+  Scheduler.startLoop(watchAppliedCommands);
+  Scheduler.startLoop(reportControlLoop);
+  Scheduler.startLoop(serialCommands);
 
-  //analogWrite(MOTOR_1_RV_PIN,60);
-  //use scheduler to run bluetooth config here?
-  testMotors();
+  //motors are held stopped by the M4 if bluetooth never comes up
+  if (BLEinit()){
+    while (true){
+      delay(1000);
+    }
+  }
 }
 
 void loop() {
   // put your main code here, to run repeatedly:
-
-  //put function to change motor values here? 
+  //dispatches the notifications of every connected controller and connects new ones
+  fleet.poll(BLE_POLL_TIMEOUT_MS);
+  updateLinkParameters();
+  publishBotStatus();
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <unity.h>
+#include <CommandWatchdog.h>
+
+const uint32_t TIMEOUT = 1000;
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+void test_stale_until_first_command(){
+  CommandWatchdog watchdog(TIMEOUT);
+
+  TEST_ASSERT_FALSE(watchdog.check(0));
+  watchdog.commandReceived(10);
+  TEST_ASSERT_TRUE(watchdog.check(20));
+  TEST_ASSERT_EQUAL_UINT32(0, watchdog.timeouts());
+}
+
+void test_times_out_without_fresh_commands(){
+  CommandWatchdog watchdog(TIMEOUT);
+
+  watchdog.commandReceived(0);
+  TEST_ASSERT_TRUE(watchdog.check(999));
+  TEST_ASSERT_FALSE(watchdog.check(1000));
+  TEST_ASSERT_FALSE(watchdog.check(5000));
+  TEST_ASSERT_EQUAL_UINT32(1, watchdog.timeouts());
+
+  watchdog.commandReceived(6000);
+  TEST_ASSERT_TRUE(watchdog.check(6001));
+  TEST_ASSERT_EQUAL_UINT32(1, watchdog.recoveries());
+  TEST_ASSERT_EQUAL_UINT32(6000, watchdog.maxGapMicros());
+}
+
+void test_command_stamped_after_check_time_is_fresh(){
+  CommandWatchdog watchdog(TIMEOUT);
+
+  watchdog.commandReceived(2000);
+  TEST_ASSERT_TRUE(watchdog.check(1990));
+  TEST_ASSERT_EQUAL_UINT32(0, watchdog.ageMicros(1990));
+}
+
+void test_survives_micros_wrap_around(){
+  CommandWatchdog watchdog(TIMEOUT);
+
+  watchdog.commandReceived(0xFFFFFF00);
+  TEST_ASSERT_TRUE(watchdog.check(0x00000100));
+  TEST_ASSERT_FALSE(watchdog.check(0x00000400));
+}
+
+void test_reset_forgets_the_last_command(){
+  CommandWatchdog watchdog(TIMEOUT);
+
+  watchdog.commandReceived(0);
+  TEST_ASSERT_TRUE(watchdog.check(10));
+  watchdog.reset();
+  TEST_ASSERT_FALSE(watchdog.check(20));
+}
+
+int main(int argc, char **argv){
+  UNITY_BEGIN();
+  RUN_TEST(test_stale_until_first_command);
+  RUN_TEST(test_times_out_without_fresh_commands);
+  RUN_TEST(test_command_stamped_after_check_time_is_fresh);
+  RUN_TEST(test_survives_micros_wrap_around);
+  RUN_TEST(test_reset_forgets_the_last_command);
+  return UNITY_END();
+}
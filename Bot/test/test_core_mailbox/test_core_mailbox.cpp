@@ -0,0 +1,74 @@
+#include <unity.h>
+#include <string.h>
+#include <CoreMailbox.h>
+
+struct Sample {
+  int16_t left;
+  int16_t right;
+  uint32_t count;
+};
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+void test_nothing_to_read_before_the_first_publish(){
+  LatestValueMailbox<Sample> mailbox;
+  Sample sample;
+
+  TEST_ASSERT_FALSE(mailbox.read(sample));
+  TEST_ASSERT_EQUAL_UINT32(0, mailbox.published());
+}
+
+void test_newest_value_wins(){
+  LatestValueMailbox<Sample> mailbox;
+  Sample sample = {10, -10, 1};
+  uint32_t sequence = 0;
+
+  mailbox.publish(sample);
+  sample = {20, -20, 2};
+  mailbox.publish(sample);
+
+  Sample read = {};
+  TEST_ASSERT_TRUE(mailbox.read(read, &sequence));
+  TEST_ASSERT_EQUAL_INT16(20, read.left);
+  TEST_ASSERT_EQUAL_INT16(-20, read.right);
+  TEST_ASSERT_EQUAL_UINT32(2, read.count);
+  TEST_ASSERT_EQUAL_UINT32(2, sequence);
+  TEST_ASSERT_EQUAL_UINT32(2, mailbox.published());
+
+  //reading does not consume the value
+  TEST_ASSERT_TRUE(mailbox.read(read, &sequence));
+  TEST_ASSERT_EQUAL_UINT32(2, sequence);
+}
+
+void test_write_in_progress_is_not_read(){
+  LatestValueMailbox<Sample> mailbox;
+  Sample sample = {1, 2, 3};
+  mailbox.publish(sample);
+
+  //the sequence is the first word, an odd sequence is a write the other core has not finished
+  uint32_t writing = 3;
+  memcpy(static_cast<void *>(&mailbox), &writing, sizeof(writing));
+
+  Sample read = {};
+  TEST_ASSERT_FALSE(mailbox.read(read));
+  TEST_ASSERT_EQUAL_INT16(0, read.left);
+}
+
+void test_mailboxes_fill_whole_cache_lines(){
+  TEST_ASSERT_EQUAL_UINT32(0, sizeof(LatestValueMailbox<uint32_t>) % CORE_MAILBOX_CACHE_LINE);
+  TEST_ASSERT_EQUAL_UINT32(0, sizeof(LatestValueMailbox<Sample[8]>) % CORE_MAILBOX_CACHE_LINE);
+  TEST_ASSERT_EQUAL_UINT32(CORE_MAILBOX_CACHE_LINE, alignof(LatestValueMailbox<Sample>));
+}
+
+int main(int argc, char **argv){
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_to_read_before_the_first_publish);
+  RUN_TEST(test_newest_value_wins);
+  RUN_TEST(test_write_in_progress_is_not_read);
+  RUN_TEST(test_mailboxes_fill_whole_cache_lines);
+  return UNITY_END();
+}
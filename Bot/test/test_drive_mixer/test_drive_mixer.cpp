@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <DriveMixer.h>
+#include <WheelSpeed.h>
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+void test_centred_stick_stops_both_wheels(){
+  DriveMixer mixer;
+  WheelDuty wheels = mixer.mix(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE);
+
+  TEST_ASSERT_EQUAL_INT16(0, wheels.left);
+  TEST_ASSERT_EQUAL_INT16(0, wheels.right);
+}
+
+void test_dead_zone_around_the_middle(){
+  TEST_ASSERT_EQUAL_INT16(0, DriveMixer::curve(JOYSTICK_MIDDLE + 20));
+  TEST_ASSERT_EQUAL_INT16(0, DriveMixer::curve(JOYSTICK_MIDDLE - 20));
+}
+
+void test_full_deflection_reaches_full_scale(){
+  TEST_ASSERT_EQUAL_INT16(DRIVE_MIX_FULL_SCALE, DriveMixer::curve(JOYSTICK_MAX));
+  TEST_ASSERT_EQUAL_INT16(-DRIVE_MIX_FULL_SCALE, DriveMixer::curve(JOYSTICK_MIN));
+}
+
+void test_curve_is_monotonic(){
+  int16_t previous = DriveMixer::curve(JOYSTICK_MIN);
+
+  for (uint16_t axis = JOYSTICK_MIN + 1; axis <= JOYSTICK_MAX; axis++){
+    int16_t value = DriveMixer::curve(axis);
+    TEST_ASSERT_TRUE(value >= previous);
+    previous = value;
+  }
+}
+
+void test_full_throttle_drives_both_wheels_forward(){
+  DriveMixer mixer;
+  WheelDuty forward = mixer.mix(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  WheelDuty reverse = mixer.mix(JOYSTICK_MIDDLE, JOYSTICK_MIN);
+
+  TEST_ASSERT_EQUAL_INT16(DRIVE_DEFAULT_MOTOR_MAX, forward.left);
+  TEST_ASSERT_EQUAL_INT16(DRIVE_DEFAULT_MOTOR_MAX, forward.right);
+  TEST_ASSERT_EQUAL_INT16(-DRIVE_DEFAULT_MOTOR_MAX, reverse.left);
+  TEST_ASSERT_EQUAL_INT16(-DRIVE_DEFAULT_MOTOR_MAX, reverse.right);
+}
+
+void test_steering_spins_in_place(){
+  DriveMixer mixer;
+  WheelDuty wheels = mixer.mix(JOYSTICK_MAX, JOYSTICK_MIDDLE);
+
+  TEST_ASSERT_EQUAL_INT16(DRIVE_DEFAULT_MOTOR_MAX, wheels.left);
+  TEST_ASSERT_EQUAL_INT16(-DRIVE_DEFAULT_MOTOR_MAX, wheels.right);
+}
+
+void test_mix_saturates(){
+  DriveMixer mixer;
+  WheelDuty wheels = mixer.mix(JOYSTICK_MAX, JOYSTICK_MAX);
+
+  TEST_ASSERT_EQUAL_INT16(DRIVE_DEFAULT_MOTOR_MAX, wheels.left);
+  TEST_ASSERT_EQUAL_INT16(0, wheels.right);
+}
+
+void test_any_movement_is_above_motor_min(){
+  DriveMixer mixer(90, 200);
+
+  for (int16_t command = 1; command <= DRIVE_MIX_FULL_SCALE; command++){
+    int16_t forward = mixer.duty(command);
+    int16_t reverse = mixer.duty(-command);
+
+    if (command >= (1 << DRIVE_DUTY_SHIFT)){
+      TEST_ASSERT_TRUE(forward >= 90 && forward <= 200);
+      TEST_ASSERT_TRUE(reverse <= -90 && reverse >= -200);
+    }
+  }
+  TEST_ASSERT_EQUAL_INT16(0, mixer.duty(0));
+  TEST_ASSERT_EQUAL_INT16(200, mixer.duty(DRIVE_MIX_FULL_SCALE));
+}
+
+void test_motor_range_can_change(){
+  DriveMixer mixer;
+  mixer.setMotorRange(120, 180);
+
+  TEST_ASSERT_EQUAL_UINT8(120, mixer.motorMin());
+  TEST_ASSERT_EQUAL_INT16(120, mixer.duty(1 << DRIVE_DUTY_SHIFT));
+  TEST_ASSERT_EQUAL_INT16(180, mixer.duty(DRIVE_MIX_FULL_SCALE));
+}
+
+void test_closed_loop_small_deflection_is_a_small_setpoint(){
+  //closed loop the M7 mixes from 0, the wheel speed controller takes the duty as setpoint
+  DriveMixer mixer(DRIVE_DEFAULT_MOTOR_MIN, DRIVE_DEFAULT_MOTOR_MAX);
+  mixer.setMotorRange(0, DRIVE_DEFAULT_MOTOR_MAX);
+  WheelSpeedController wheel(2400, DRIVE_DEFAULT_MOTOR_MAX, 1000);
+
+  //just past the dead zone of the stick
+  uint16_t axis = JOYSTICK_MIDDLE + ((DRIVE_CURVE_DEADZONE + 2) << DRIVE_CURVE_SHIFT);
+  WheelDuty wheels = mixer.mix(JOYSTICK_MIDDLE, axis);
+  TEST_ASSERT_TRUE(wheels.left > 0);
+
+  wheel.setSetpoint(wheels.left);
+  TEST_ASSERT_TRUE(wheel.setpointSpeed() > 0);
+  TEST_ASSERT_TRUE(wheel.setpointSpeed() < 2400 / 20);
+
+  //open loop the same deflection jumps to MOTOR_MIN
+  mixer.setMotorRange(DRIVE_DEFAULT_MOTOR_MIN, DRIVE_DEFAULT_MOTOR_MAX);
+  TEST_ASSERT_TRUE(mixer.mix(JOYSTICK_MIDDLE, axis).left >= DRIVE_DEFAULT_MOTOR_MIN);
+}
+
+int main(int argc, char **argv){
+  UNITY_BEGIN();
+  RUN_TEST(test_centred_stick_stops_both_wheels);
+  RUN_TEST(test_dead_zone_around_the_middle);
+  RUN_TEST(test_full_deflection_reaches_full_scale);
+  RUN_TEST(test_curve_is_monotonic);
+  RUN_TEST(test_full_throttle_drives_both_wheels_forward);
+  RUN_TEST(test_steering_spins_in_place);
+  RUN_TEST(test_mix_saturates);
+  RUN_TEST(test_any_movement_is_above_motor_min);
+  RUN_TEST(test_motor_range_can_change);
+  RUN_TEST(test_closed_loop_small_deflection_is_a_small_setpoint);
+  return UNITY_END();
+}
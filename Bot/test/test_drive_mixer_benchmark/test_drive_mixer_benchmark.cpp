@@ -0,0 +1,79 @@
+#include <unity.h>
+#include <stdio.h>
+#include <DriveMixer.h>
+
+/*
+ * Times DriveMixer::mix over a sweep of the stick.
+ * Runs on the host (pio test -e native) and on the board (pio test -e giga_r1_m7),
+ * where it has to stay far below the 1000 us control loop period.
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t nowMicros(){
+  return micros();
+}
+#else
+#include <chrono>
+static uint32_t nowMicros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+const uint32_t BENCHMARK_MIXES = 100000;
+
+// budget for one mix, a small fraction of a control loop tick
+const uint32_t MIX_BUDGET_NS = 2000;
+
+volatile int32_t sink = 0;
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+void test_mix_benchmark(){
+  DriveMixer mixer;
+  int32_t sum = 0;
+
+  uint32_t start = nowMicros();
+  for (uint32_t i = 0; i < BENCHMARK_MIXES; i++){
+    uint16_t x = (i * 7) & JOYSTICK_MAX;
+    uint16_t y = (i * 13) & JOYSTICK_MAX;
+    WheelDuty wheels = mixer.mix(x, y);
+    sum += wheels.left - wheels.right;
+  }
+  uint32_t elapsed = nowMicros() - start;
+  sink = sum;
+
+  uint32_t nsPerMix = (uint32_t)((uint64_t)elapsed * 1000 / BENCHMARK_MIXES);
+
+  char message[64];
+  snprintf(message, sizeof(message), "%lu mixes in %lu us, %lu ns per mix",
+           (unsigned long)BENCHMARK_MIXES, (unsigned long)elapsed, (unsigned long)nsPerMix);
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_LESS_THAN_UINT32(MIX_BUDGET_NS, nsPerMix);
+}
+
+int runBenchmarks(){
+  UNITY_BEGIN();
+  RUN_TEST(test_mix_benchmark);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup(){
+  delay(2000);
+  runBenchmarks();
+}
+
+void loop(){
+}
+#else
+int main(int argc, char **argv){
+  return runBenchmarks();
+}
+#endif
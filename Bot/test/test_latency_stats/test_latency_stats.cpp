@@ -0,0 +1,63 @@
+#include <unity.h>
+#include <LatencyStats.h>
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+void test_bucket_edges_round_trip(){
+  for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; i++){
+    TEST_ASSERT_EQUAL_INT(i, LatencyHistogram::bucket(LatencyHistogram::bucket_lower(i)));
+    TEST_ASSERT_EQUAL_INT(i, LatencyHistogram::bucket(LatencyHistogram::bucket_upper(i)));
+  }
+  TEST_ASSERT_EQUAL_INT(LATENCY_HISTOGRAM_BUCKETS - 1, LatencyHistogram::bucket(UINT32_MAX));
+}
+
+void test_percentiles_within_bucket_width(){
+  LatencyHistogram histogram;
+
+  for (uint32_t i = 1; i <= 1000; i++){
+    histogram.record(i);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.count());
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.min());
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.max());
+  TEST_ASSERT_UINT32_WITHIN(500 / 8, 500, histogram.percentile(50));
+  TEST_ASSERT_UINT32_WITHIN(990 / 8, 990, histogram.percentile(99));
+  TEST_ASSERT_EQUAL_UINT32(1000, histogram.percentile(100));
+}
+
+void test_link_counts_lost_samples_and_gaps(){
+  LinkLatencyTracker link;
+
+  link.on_receive(0, 5000, 100000);
+  link.on_receive(1, 15000, 110000);
+  link.on_receive(3, 35000, 130500);
+
+  TEST_ASSERT_EQUAL_UINT32(3, link.received());
+  TEST_ASSERT_EQUAL_UINT32(1, link.lost());
+  TEST_ASSERT_EQUAL_UINT32(0, link.out_of_order());
+  TEST_ASSERT_EQUAL_UINT32(10000, link.gaps().min());
+  TEST_ASSERT_EQUAL_UINT32(20500, link.gaps().max());
+}
+
+void test_link_transit_is_relative_to_fastest_sample(){
+  LinkLatencyTracker link;
+
+  //the controller clock is far ahead of ours and wraps around in between
+  TEST_ASSERT_EQUAL_UINT32(0, link.on_receive(0, 0xFFFFFF00, 1000));
+  TEST_ASSERT_EQUAL_UINT32(300, link.on_receive(1, 0x00000100, 1812));
+  TEST_ASSERT_EQUAL_UINT32(0, link.on_receive(2, 0x00000200, 1612));
+}
+
+int main(int argc, char **argv){
+  UNITY_BEGIN();
+  RUN_TEST(test_bucket_edges_round_trip);
+  RUN_TEST(test_percentiles_within_bucket_width);
+  RUN_TEST(test_link_counts_lost_samples_and_gaps);
+  RUN_TEST(test_link_transit_is_relative_to_fastest_sample);
+  return UNITY_END();
+}
@@ -0,0 +1,99 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <MotionProfile.h>
+
+const uint32_t TICK_RATE = 1000;
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+//runs the ramp until it settles, returns the ticks it took
+int runToTarget(RampGenerator &ramp, int target, int &largestStep){
+  ramp.setTarget(target);
+
+  int ticks = 0;
+  int previous = ramp.output();
+  largestStep = 0;
+
+  while (!ramp.settled() && ticks < 100000){
+    int output = ramp.update();
+    if (abs(output - previous) > largestStep){
+      largestStep = abs(output - previous);
+    }
+    previous = output;
+    ticks++;
+  }
+  return ticks;
+}
+
+void test_slew_rate_limit(){
+  RampGenerator ramp(1000, 0, TICK_RATE);
+  int largestStep;
+
+  TEST_ASSERT_EQUAL_INT(255, runToTarget(ramp, 255, largestStep));
+  TEST_ASSERT_EQUAL_INT(255, ramp.output());
+  TEST_ASSERT_EQUAL_INT(1, largestStep);
+}
+
+void test_trapezoid_reaches_target_without_overshoot(){
+  RampGenerator ramp(1000, 4000, TICK_RATE);
+  ramp.setTarget(200);
+
+  int highest = 0;
+  for (int i = 0; i < 2000; i++){
+    int output = ramp.update();
+    if (output > highest){
+      highest = output;
+    }
+  }
+
+  TEST_ASSERT_TRUE(ramp.settled());
+  TEST_ASSERT_EQUAL_INT(200, ramp.output());
+  TEST_ASSERT_EQUAL_INT(200, highest);
+}
+
+void test_acceleration_makes_the_ramp_slower(){
+  RampGenerator slewOnly(1000, 0, TICK_RATE);
+  RampGenerator trapezoid(1000, 4000, TICK_RATE);
+  int largestStep;
+
+  TEST_ASSERT_TRUE(runToTarget(trapezoid, 255, largestStep) > runToTarget(slewOnly, 255, largestStep));
+}
+
+void test_skip_band_is_jumped_across(){
+  RampGenerator ramp(1000, 0, TICK_RATE);
+  ramp.setSkipBand(70);
+  ramp.setTarget(-100);
+
+  TEST_ASSERT_EQUAL_INT(-70, ramp.update());
+
+  int largestStep;
+  runToTarget(ramp, 0, largestStep);
+  TEST_ASSERT_EQUAL_INT(0, ramp.output());
+  TEST_ASSERT_EQUAL_INT(70, largestStep);
+}
+
+void test_reset_stops_at_once(){
+  RampGenerator ramp(1000, 4000, TICK_RATE);
+  ramp.setTarget(255);
+  for (int i = 0; i < 100; i++){
+    ramp.update();
+  }
+
+  ramp.reset(0);
+  TEST_ASSERT_TRUE(ramp.settled());
+  TEST_ASSERT_EQUAL_INT(0, ramp.update());
+}
+
+int main(int argc, char **argv){
+  UNITY_BEGIN();
+  RUN_TEST(test_slew_rate_limit);
+  RUN_TEST(test_trapezoid_reaches_target_without_overshoot);
+  RUN_TEST(test_acceleration_makes_the_ramp_slower);
+  RUN_TEST(test_skip_band_is_jumped_across);
+  RUN_TEST(test_reset_stops_at_once);
+  return UNITY_END();
+}
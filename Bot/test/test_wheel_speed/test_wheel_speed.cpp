@@ -0,0 +1,223 @@
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include <QuadratureEncoder.h>
+#include <WheelSpeed.h>
+
+const uint32_t TICK_RATE = 1000;
+const int DUTY_MAX = 255;
+const int32_t SPEED_MAX = 2400;
+
+// kp 0.04, ki 0.8, as on the M4
+const WheelSpeedGains GAINS = { 2621, 52429 };
+
+/*
+ * First order motor with a dead band, the same model as the simulator's wheels.
+ */
+struct Motor {
+  int deadBand;
+  double fullSpeed;
+  double supply;
+  double speed;
+  double position;
+
+  Motor(int deadBand) : deadBand(deadBand), fullSpeed(3000.0), supply(1.0), speed(0.0), position(0.0) {}
+
+  int32_t tick(int duty){
+    const double dt = 1.0 / TICK_RATE;
+    const double tau = 0.05;
+
+    double drive = abs(duty) * supply - deadBand;
+    double target = drive > 0 ? fullSpeed * drive / (DUTY_MAX - deadBand) : 0.0;
+    if (duty < 0){
+      target = -target;
+    }
+    speed += (target - speed) * (1.0 - exp(-dt / tau));
+    position += speed * dt;
+    return (int32_t)floor(position);
+  }
+};
+
+// runs the controller on the motor for the given ticks, returns the last count
+int32_t run(WheelSpeedController &controller, Motor &motor, int ticks, int32_t count){
+  for (int i = 0; i < ticks; i++){
+    count = motor.tick(controller.update(count));
+  }
+  return count;
+}
+
+WheelSpeedController makeController(int deadBand){
+  WheelSpeedController controller(SPEED_MAX, DUTY_MAX, TICK_RATE);
+  controller.setGains(GAINS);
+  controller.setDeadBand(deadBand);
+  return controller;
+}
+
+/*
+ * Fake encoder timer, a plain 16 bit counter
+ */
+uint16_t COUNTER = 0;
+
+bool quadratureCounterBegin(uint8_t encoder){
+  return encoder < QUADRATURE_ENCODERS;
+}
+
+uint16_t quadratureCounterRead(uint8_t encoder){
+  (void)encoder;
+  return COUNTER;
+}
+
+void setUp(){
+  COUNTER = 0;
+}
+
+void tearDown(){
+}
+
+void test_speed_is_measured_over_the_window(){
+  WheelSpeedController controller = makeController(0);
+  int32_t count = 0;
+
+  for (int i = 0; i < WHEEL_SPEED_WINDOW; i++){
+    count += 3;
+    controller.update(count);
+  }
+  TEST_ASSERT_EQUAL_INT32(3 * TICK_RATE, controller.speed());
+}
+
+void test_setpoint_scales_to_speed_max(){
+  WheelSpeedController controller = makeController(0);
+
+  controller.setSetpoint(DUTY_MAX);
+  TEST_ASSERT_EQUAL_INT32(SPEED_MAX, controller.setpointSpeed());
+  controller.setSetpoint(-2 * DUTY_MAX);
+  TEST_ASSERT_EQUAL_INT32(-SPEED_MAX, controller.setpointSpeed());
+}
+
+void test_holds_speed_on_a_low_battery(){
+  Motor motor(64);
+  WheelSpeedController controller = makeController(64);
+  controller.setSetpoint(DUTY_MAX / 2);
+  int32_t setpoint = controller.setpointSpeed();
+
+  run(controller, motor, 1000, 0);
+  TEST_ASSERT_INT32_WITHIN(setpoint / 50, setpoint, (int32_t)motor.speed);
+
+  //the feedforward alone would lose a fifth of the speed here
+  motor.supply = 0.8;
+  run(controller, motor, 1000, (int32_t)floor(motor.position));
+  TEST_ASSERT_INT32_WITHIN(setpoint / 50, setpoint, (int32_t)motor.speed);
+}
+
+void test_reverse_speed(){
+  Motor motor(64);
+  WheelSpeedController controller = makeController(64);
+  controller.setSetpoint(-DUTY_MAX / 3);
+
+  run(controller, motor, 1000, 0);
+  TEST_ASSERT_INT32_WITHIN(-controller.setpointSpeed() / 50, controller.setpointSpeed(), (int32_t)motor.speed);
+}
+
+void test_integral_does_not_wind_up_in_saturation(){
+  Motor motor(64);
+  motor.supply = 0.7;
+  WheelSpeedController controller = makeController(64);
+
+  //full speed is out of reach on a low battery, the duty saturates
+  controller.setSetpoint(DUTY_MAX);
+  int32_t count = run(controller, motor, 2000, 0);
+  TEST_ASSERT_EQUAL_INT(DUTY_MAX, controller.duty());
+
+  //a reachable setpoint takes over as soon as the speed is there
+  controller.setSetpoint(DUTY_MAX / 2);
+  run(controller, motor, 300, count);
+  TEST_ASSERT_INT32_WITHIN(controller.setpointSpeed() / 10, controller.setpointSpeed(), (int32_t)motor.speed);
+}
+
+void test_zero_setpoint_stops_at_once(){
+  Motor motor(64);
+  WheelSpeedController controller = makeController(64);
+  controller.setSetpoint(DUTY_MAX);
+  int32_t count = run(controller, motor, 500, 0);
+
+  controller.setSetpoint(0);
+  TEST_ASSERT_EQUAL_INT(0, controller.update(count));
+}
+
+// runs the search on the motor until it ends, returns the ticks it took
+int findDeadBand(DeadBandFinder &finder, Motor &motor){
+  int32_t count = 0;
+  int ticks = 0;
+
+  finder.start(count);
+  while (finder.running() && ticks < 100000){
+    count = motor.tick(finder.update(count));
+    ticks++;
+  }
+  return ticks;
+}
+
+void test_dead_band_is_found(){
+  Motor motor(64);
+  DeadBandFinder finder(DUTY_MAX, 20, 2, 300);
+
+  int ticks = findDeadBand(finder, motor);
+  TEST_ASSERT_TRUE(finder.found());
+  TEST_ASSERT_INT_WITHIN(8, 68, finder.deadBand());
+  TEST_ASSERT_TRUE(ticks < 5000);
+}
+
+void test_dead_band_rises_on_a_low_battery(){
+  Motor charged(64);
+  Motor low(64);
+  low.supply = 0.8;
+  DeadBandFinder chargedFinder(DUTY_MAX, 20, 2, 300);
+  DeadBandFinder lowFinder(DUTY_MAX, 20, 2, 300);
+
+  findDeadBand(chargedFinder, charged);
+  findDeadBand(lowFinder, low);
+  TEST_ASSERT_TRUE(lowFinder.deadBand() > chargedFinder.deadBand());
+}
+
+void test_dead_band_search_gives_up_without_encoder(){
+  DeadBandFinder finder(DUTY_MAX, 20, 2, 300);
+  int highest = 0;
+
+  finder.start(0);
+  for (int i = 0; i < 100000 && finder.running(); i++){
+    int duty = abs(finder.update(0));
+    if (duty > highest){
+      highest = duty;
+    }
+  }
+
+  TEST_ASSERT_FALSE(finder.running());
+  TEST_ASSERT_FALSE(finder.found());
+  TEST_ASSERT_EQUAL_INT(DUTY_MAX, highest);
+}
+
+void test_encoder_count_survives_counter_wrap(){
+  QuadratureEncoder encoder(0);
+  COUNTER = 0xfff0;
+  TEST_ASSERT_TRUE(encoder.begin());
+
+  COUNTER = 0x0010;
+  TEST_ASSERT_EQUAL_INT32(0x20, encoder.count());
+  COUNTER = 0xffe0;
+  TEST_ASSERT_EQUAL_INT32(-0x10, encoder.count());
+}
+
+int main(int argc, char **argv){
+  UNITY_BEGIN();
+  RUN_TEST(test_speed_is_measured_over_the_window);
+  RUN_TEST(test_setpoint_scales_to_speed_max);
+  RUN_TEST(test_holds_speed_on_a_low_battery);
+  RUN_TEST(test_reverse_speed);
+  RUN_TEST(test_integral_does_not_wind_up_in_saturation);
+  RUN_TEST(test_zero_setpoint_stops_at_once);
+  RUN_TEST(test_dead_band_is_found);
+  RUN_TEST(test_dead_band_rises_on_a_low_battery);
+  RUN_TEST(test_dead_band_search_gives_up_without_encoder);
+  RUN_TEST(test_encoder_count_survives_counter_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,91 @@
+#include <unity.h>
+#include <stdio.h>
+#include <WheelSpeed.h>
+
+/*
+ * Times one control loop tick of the wheel speed control, both wheels.
+ * Runs on the host (pio test -e native) and on the board (pio test -e giga_r1_m4),
+ * where it has to stay well under 10 us so it fits next to everything else in a tick.
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t nowMicros(){
+  return micros();
+}
+#else
+#include <chrono>
+static uint32_t nowMicros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+const uint32_t BENCHMARK_TICKS = 100000;
+
+// budget for one tick of both wheels
+const uint32_t TICK_BUDGET_NS = 2000;
+
+const WheelSpeedGains GAINS = { 2621, 52429 };
+
+volatile int32_t sink = 0;
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+void test_wheel_speed_benchmark(){
+  WheelSpeedController left(2400, 255, 1000);
+  WheelSpeedController right(2400, 255, 1000);
+  left.setGains(GAINS);
+  right.setGains(GAINS);
+  left.setDeadBand(68);
+  right.setDeadBand(70);
+
+  int32_t leftCount = 0;
+  int32_t rightCount = 0;
+  int32_t sum = 0;
+
+  uint32_t start = nowMicros();
+  for (uint32_t i = 0; i < BENCHMARK_TICKS; i++){
+    //a setpoint that keeps changing and encoders that keep moving, no shortcut is taken
+    left.setSetpoint((int)((i >> 4) & 0xff) - 128);
+    right.setSetpoint(128 - (int)((i >> 5) & 0xff));
+    leftCount += (i * 7) & 3;
+    rightCount -= (i * 13) & 3;
+    sum += left.update(leftCount) - right.update(rightCount);
+  }
+  uint32_t elapsed = nowMicros() - start;
+  sink = sum;
+
+  uint32_t nsPerTick = (uint32_t)((uint64_t)elapsed * 1000 / BENCHMARK_TICKS);
+
+  char message[64];
+  snprintf(message, sizeof(message), "%lu ticks in %lu us, %lu ns per tick",
+           (unsigned long)BENCHMARK_TICKS, (unsigned long)elapsed, (unsigned long)nsPerTick);
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_LESS_THAN_UINT32(TICK_BUDGET_NS, nsPerTick);
+}
+
+int runBenchmarks(){
+  UNITY_BEGIN();
+  RUN_TEST(test_wheel_speed_benchmark);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup(){
+  delay(2000);
+  runBenchmarks();
+}
+
+void loop(){
+}
+#else
+int main(int argc, char **argv){
+  return runBenchmarks();
+}
+#endif
@@ -0,0 +1,29 @@
+#include "ButtonDebouncer.h"
+
+ButtonDebouncer::ButtonDebouncer(uint8_t threshold)
+    : _threshold(threshold > 0 ? threshold : 1), _integrator(0), _pressed(false)
+{
+}
+
+bool ButtonDebouncer::update(bool raw_pressed)
+{
+    if (raw_pressed) {
+        if (_integrator < _threshold) {
+            _integrator++;
+        }
+    } else if (_integrator > 0) {
+        _integrator--;
+    }
+
+    if (_integrator == 0) {
+        _pressed = false;
+    } else if (_integrator >= _threshold) {
+        _pressed = true;
+    }
+    return _pressed;
+}
+
+bool ButtonDebouncer::pressed() const
+{
+    return _pressed;
+}
@@ -0,0 +1,28 @@
+#ifndef BUTTON_DEBOUNCER_H
+#define BUTTON_DEBOUNCER_H
+
+#include <stdint.h>
+
+/*
+Integrator debounce for a single button.
+
+Every sample moves the integrator one step towards the raw reading, the
+debounced state only flips once it reaches either end. A bouncing contact
+therefore has to read the same level for `threshold` samples in a row
+(on average) before the button changes state.
+  */
+class ButtonDebouncer {
+public:
+    ButtonDebouncer(uint8_t threshold = 5);
+
+    // feeds one raw reading, returns the debounced state
+    bool update(bool raw_pressed);
+    bool pressed() const;
+
+private:
+    uint8_t _threshold;
+    uint8_t _integrator;
+    bool _pressed;
+};
+
+#endif
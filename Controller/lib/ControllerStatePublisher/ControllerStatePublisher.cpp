@@ -0,0 +1,93 @@
+#include "ControllerStatePublisher.h"
+
+ControllerStatePublisher::ControllerStatePublisher(const PublisherConfig &config)
+    : _config(config)
+{
+    reset();
+}
+
+void ControllerStatePublisher::set_config(const PublisherConfig &config)
+{
+    _config = config;
+}
+
+const PublisherConfig &ControllerStatePublisher::config() const
+{
+    return _config;
+}
+
+void ControllerStatePublisher::reset()
+{
+    _has_published = false;
+    _last_published = {};
+    _last_publish_ms = 0;
+    _last_change_ms = 0;
+    _published = 0;
+    _suppressed = 0;
+}
+
+bool ControllerStatePublisher::axis_moved(uint16_t axis, uint16_t last_axis) const
+{
+    uint16_t distance = (axis > last_axis) ? axis - last_axis : last_axis - axis;
+    return distance > _config.axis_deadband;
+}
+
+bool ControllerStatePublisher::active(const ControllerState &sample, uint32_t now_ms) const
+{
+    if (axis_moved(sample.thumb_stick_x_axis, JOYSTICK_MIDDLE) || axis_moved(sample.thumb_stick_y_axis, JOYSTICK_MIDDLE)) {
+        return true;
+    }
+    return (uint32_t)(now_ms - _last_change_ms) < _config.idle_after_ms;
+}
+
+bool ControllerStatePublisher::should_publish(const ControllerState &sample, uint32_t now_ms)
+{
+    bool publish = false;
+
+    if (!_has_published) {
+        publish = true;
+    } else {
+        uint32_t since_publish = now_ms - _last_publish_ms;
+
+        bool buttons_changed = sample.buttons != _last_published.buttons;
+        bool axes_moved = axis_moved(sample.thumb_stick_x_axis, _last_published.thumb_stick_x_axis)
+                       || axis_moved(sample.thumb_stick_y_axis, _last_published.thumb_stick_y_axis);
+
+        if (buttons_changed) {
+            publish = true;
+        } else if (axes_moved) {
+            publish = since_publish >= _config.min_interval_ms;
+        } else {
+            uint16_t keepalive_ms = active(sample, now_ms) ? _config.active_keepalive_ms : _config.idle_keepalive_ms;
+            publish = since_publish >= keepalive_ms;
+        }
+
+        if (buttons_changed || axes_moved) {
+            _last_change_ms = now_ms;
+        }
+    }
+
+    if (!publish) {
+        _suppressed++;
+        return false;
+    }
+
+    if (!_has_published) {
+        _last_change_ms = now_ms;
+    }
+    _has_published = true;
+    _last_published = sample;
+    _last_publish_ms = now_ms;
+    _published++;
+    return true;
+}
+
+uint32_t ControllerStatePublisher::published_count() const
+{
+    return _published;
+}
+
+uint32_t ControllerStatePublisher::suppressed_count() const
+{
+    return _suppressed;
+}
@@ -0,0 +1,61 @@
+#ifndef CONTROLLER_STATE_PUBLISHER_H
+#define CONTROLLER_STATE_PUBLISHER_H
+
+#include <stdint.h>
+#include <ControllerState.h>
+
+/*
+Decides which input samples are worth sending to the central.
+
+A sample is sent when:
+- a button changed, straight away
+- an axis moved more than axis_deadband away from the last sent value,
+  but no more often than every min_interval_ms
+- nothing changed for a keep-alive interval, so the central knows we are still here
+
+While the stick is deflected or was moved within the last idle_after_ms the
+keep-alive is active_keepalive_ms, after that it drops to idle_keepalive_ms.
+Times are millis() values compared with wrap-around safe arithmetic.
+  */
+static const constexpr PublisherConfig DEFAULT_PUBLISHER_CONFIG = {
+    8,      // axis_deadband
+    10,     // min_interval_ms
+    50,     // active_keepalive_ms
+    100,    // idle_keepalive_ms, keep below the Bot's COMMAND_TIMEOUT_US
+    1000,   // idle_after_ms
+};
+
+class ControllerStatePublisher {
+public:
+    ControllerStatePublisher(const PublisherConfig &config = DEFAULT_PUBLISHER_CONFIG);
+
+    void set_config(const PublisherConfig &config);
+    const PublisherConfig &config() const;
+
+    // forget the last sent sample, the next one is always sent
+    void reset();
+
+    // true if the sample should be sent now, it is then remembered as the last sent sample
+    bool should_publish(const ControllerState &sample, uint32_t now_ms);
+
+    // true while the controller is in use and the fast keep-alive applies
+    bool active(const ControllerState &sample, uint32_t now_ms) const;
+
+    uint32_t published_count() const;
+    uint32_t suppressed_count() const;
+
+private:
+    bool axis_moved(uint16_t axis, uint16_t last_axis) const;
+
+    PublisherConfig _config;
+
+    bool _has_published;
+    ControllerState _last_published;
+    uint32_t _last_publish_ms;
+    uint32_t _last_change_ms;
+
+    uint32_t _published;
+    uint32_t _suppressed;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "InputSampler.h"
+
+// The sampling task must preempt loop() and the BLE host, it sleeps between ticks
+static const constexpr UBaseType_t SAMPLING_TASK_PRIORITY = configMAX_PRIORITIES - 2;
+static const constexpr uint32_t SAMPLING_TASK_STACK = 2048;
+static const constexpr uint32_t TIMER_TICK_HZ = 1000000;
+
+InputSampler *InputSampler::_running = nullptr;
+
+InputSampler::InputSampler(int x_axis_pin, int y_axis_pin, const ButtonInput (&buttons)[INPUT_SAMPLER_BUTTONS], int button_pressed_level)
+    : _x_axis_pin(x_axis_pin), _y_axis_pin(y_axis_pin), _button_pressed_level(button_pressed_level),
+      _rate_hz(0), _oversample_shift(0), _timer(nullptr), _task(nullptr), _listener(nullptr), _samples(0), _missed(0), _requested(0)
+{
+    for (int i = 0; i < INPUT_SAMPLER_BUTTONS; i++) {
+        _buttons[i] = buttons[i];
+    }
+}
+
+bool InputSampler::begin(uint32_t rate_hz, uint8_t oversample_shift, uint8_t debounce_samples)
+{
+    if (_running != nullptr || rate_hz == 0 || rate_hz > TIMER_TICK_HZ) {
+        return false;
+    }
+
+    _rate_hz = rate_hz;
+    _oversample_shift = oversample_shift;
+    _samples = 0;
+    _missed = 0;
+    _requested = 0;
+    for (int i = 0; i < INPUT_SAMPLER_BUTTONS; i++) {
+        _debouncers[i] = ButtonDebouncer(debounce_samples);
+    }
+
+    if (xTaskCreatePinnedToCore(sampling_task, "input_sampler", SAMPLING_TASK_STACK, this,
+                                SAMPLING_TASK_PRIORITY, &_task, ARDUINO_RUNNING_CORE) != pdPASS) {
+        _task = nullptr;
+        return false;
+    }
+    _running = this;
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    _timer = timerBegin(TIMER_TICK_HZ);
+    if (_timer != nullptr) {
+        timerAttachInterrupt(_timer, on_timer);
+    }
+#else
+    // 80 MHz APB clock divided down to 1 MHz timer ticks
+    _timer = timerBegin(0, 80, true);
+    if (_timer != nullptr) {
+        timerAttachInterrupt(_timer, on_timer, true);
+    }
+#endif
+
+    if (_timer == nullptr) {
+        end();
+        return false;
+    }
+    start_timer();
+    return true;
+}
+
+void InputSampler::start_timer()
+{
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    timerAlarm(_timer, TIMER_TICK_HZ / _rate_hz, true, 0);
+#else
+    timerAlarmWrite(_timer, TIMER_TICK_HZ / _rate_hz, true);
+    timerAlarmEnable(_timer);
+#endif
+}
+
+void InputSampler::end()
+{
+    if (_timer != nullptr) {
+        timerEnd(_timer);
+        _timer = nullptr;
+    }
+    if (_task != nullptr) {
+        vTaskDelete(_task);
+        _task = nullptr;
+    }
+    _running = nullptr;
+}
+
+void InputSampler::set_listener(TaskHandle_t listener)
+{
+    _listener = listener;
+}
+
+bool InputSampler::set_rate(uint32_t rate_hz)
+{
+    if (rate_hz == 0 || rate_hz > TIMER_TICK_HZ) {
+        return false;
+    }
+    if (rate_hz == _rate_hz) {
+        return true;
+    }
+    _rate_hz = rate_hz;
+    if (_timer != nullptr) {
+        start_timer();
+    }
+    return true;
+}
+
+void IRAM_ATTR InputSampler::sample_now()
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    if (_task != nullptr) {
+        // sample_now() may run on the other core, the task clears the count concurrently
+        __atomic_add_fetch(&_requested, 1, __ATOMIC_RELAXED);
+        vTaskNotifyGiveFromISR(_task, &higher_priority_task_woken);
+    }
+    if (higher_priority_task_woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+bool InputSampler::latest(ControllerState &state)
+{
+    return _slot.read(state);
+}
+
+uint32_t InputSampler::rate() const
+{
+    return _rate_hz;
+}
+
+uint32_t InputSampler::sample_count() const
+{
+    return _samples;
+}
+
+uint32_t InputSampler::missed_count() const
+{
+    return _missed;
+}
+
+void IRAM_ATTR InputSampler::on_timer()
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    if (_running != nullptr && _running->_task != nullptr) {
+        vTaskNotifyGiveFromISR(_running->_task, &higher_priority_task_woken);
+    }
+    if (higher_priority_task_woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void InputSampler::sampling_task(void *parameter)
+{
+    InputSampler *sampler = static_cast<InputSampler *>(parameter);
+    uint32_t requested = 0;
+    while (true) {
+        // the count is above one when ticks arrived while we were still sampling,
+        // extra samples asked for by sample_now() are not missed ticks
+        uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // read and clear in one step, so no sample_now() in between is lost
+        requested += __atomic_exchange_n(&sampler->_requested, 0, __ATOMIC_ACQ_REL);
+        // a request counted after ulTaskNotifyTake() has its notification in the next batch
+        uint32_t in_batch = requested < ticks ? requested : ticks;
+        requested -= in_batch;
+        if (ticks > in_batch + 1) {
+            sampler->_missed += ticks - in_batch - 1;
+        }
+        sampler->sample();
+    }
+}
+
+uint16_t InputSampler::read_axis(int pin) const
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < (1 << _oversample_shift); i++) {
+        sum += analogRead(pin);
+    }
+    return sum >> _oversample_shift;
+}
+
+void InputSampler::sample()
+{
+    ControllerState state = {};
+    state.timestamp_us = micros();
+    state.thumb_stick_x_axis = read_axis(_x_axis_pin);
+    state.thumb_stick_y_axis = read_axis(_y_axis_pin);
+    for (int i = 0; i < INPUT_SAMPLER_BUTTONS; i++) {
+        if (_debouncers[i].update(digitalRead(_buttons[i].pin) == _button_pressed_level)) {
+            state.buttons |= _buttons[i].bit;
+        }
+    }
+
+    _slot.write(state);
+    _samples++;
+
+    if (_listener != nullptr) {
+        xTaskNotifyGive(_listener);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef INPUT_SAMPLER_H
+#define INPUT_SAMPLER_H
+
+#include <Arduino.h>
+#include <ControllerState.h>
+#include <ButtonDebouncer.h>
+#include "LatestValueSlot.h"
+
+struct ButtonInput {
+    int pin;
+    uint8_t bit;
+};
+
+static const constexpr int INPUT_SAMPLER_BUTTONS = 5;
+
+/*
+Samples the thumb stick and buttons from a hardware timer at a fixed rate,
+independent of how often the BLE side sends them.
+
+The timer interrupt only wakes a high priority sampling task, analogRead is not
+safe to call from an interrupt on the ESP32. Each tick the task:
+- reads every axis (1 << oversample_shift) times and averages the readings
+- runs every button through a ButtonDebouncer
+- hands the result to the consumer through a LatestValueSlot
+- gives the listener task a notification, so the consumer can sleep until then
+
+Only one InputSampler can be running at a time.
+  */
+class InputSampler {
+public:
+    InputSampler(int x_axis_pin, int y_axis_pin, const ButtonInput (&buttons)[INPUT_SAMPLER_BUTTONS], int button_pressed_level);
+
+    // starts the timer and the sampling task, returns false if either could not be created
+    bool begin(uint32_t rate_hz = 1000, uint8_t oversample_shift = 2, uint8_t debounce_samples = 5);
+    void end();
+
+    // task notified after every sample, e.g. loop() blocked in BLE.poll(timeout)
+    void set_listener(TaskHandle_t listener);
+    // retimes a running sampler, e.g. down to an idle rate while nobody listens
+    bool set_rate(uint32_t rate_hz);
+    // takes a sample right away instead of on the next tick, safe to call from an interrupt
+    void IRAM_ATTR sample_now();
+
+    // newest sample, returns false if there was none since the last call
+    bool latest(ControllerState &state);
+
+    uint32_t rate() const;
+    uint32_t sample_count() const;
+    // timer ticks the task was too late to sample
+    uint32_t missed_count() const;
+
+private:
+    void sample();
+    void start_timer();
+    uint16_t read_axis(int pin) const;
+
+    static void sampling_task(void *parameter);
+    static void IRAM_ATTR on_timer();
+
+    int _x_axis_pin;
+    int _y_axis_pin;
+    ButtonInput _buttons[INPUT_SAMPLER_BUTTONS];
+    ButtonDebouncer _debouncers[INPUT_SAMPLER_BUTTONS];
+    int _button_pressed_level;
+
+    uint32_t _rate_hz;
+    uint8_t _oversample_shift;
+
+    LatestValueSlot<ControllerState> _slot;
+
+    hw_timer_t *_timer;
+    TaskHandle_t _task;
+    TaskHandle_t _listener;
+
+    volatile uint32_t _samples;
+    volatile uint32_t _missed;
+    // notifications from sample_now() rather than the timer
+    volatile uint32_t _requested;
+
+    static InputSampler *_running;
+};
+
+#endif
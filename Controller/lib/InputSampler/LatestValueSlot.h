@@ -0,0 +1,54 @@
+#ifndef LATEST_VALUE_SLOT_H
+#define LATEST_VALUE_SLOT_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+Lock-free hand-off of the newest value from one producer to one consumer.
+
+A triple buffer: the producer and the consumer each own one buffer and the third
+sits in the middle. Publishing swaps the producer's buffer into the middle and
+marks it fresh, reading swaps a fresh middle buffer out to the consumer.
+Neither side ever waits or retries, older unread values are simply replaced,
+which is what we want for inputs where only the newest sample matters.
+  */
+template <typename T>
+class LatestValueSlot {
+public:
+    LatestValueSlot()
+        : _middle(1), _write_index(0), _read_index(2)
+    {
+    }
+
+    // Producer side, never blocks
+    void write(const T &value)
+    {
+        _buffers[_write_index] = value;
+        uint8_t previous = _middle.exchange(_write_index | FRESH_BIT, std::memory_order_acq_rel);
+        _write_index = previous & INDEX_MASK;
+    }
+
+    // Consumer side, returns false and leaves value untouched if nothing new was written
+    bool read(T &value)
+    {
+        if ((_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        uint8_t previous = _middle.exchange(_read_index, std::memory_order_acq_rel);
+        _read_index = previous & INDEX_MASK;
+        value = _buffers[_read_index];
+        return true;
+    }
+
+private:
+    static const constexpr uint8_t INDEX_MASK = 0x03;
+    static const constexpr uint8_t FRESH_BIT = 0x04;
+
+    T _buffers[3];
+    std::atomic<uint8_t> _middle;
+    uint8_t _write_index;   // only touched by the producer
+    uint8_t _read_index;    // only touched by the consumer
+};
+
+#endif
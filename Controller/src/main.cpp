@@ -1,42 +1,65 @@
 #include <Arduino.h>
 #include <ArduinoBLE.h>
+#include <BotStatus.h>
+#include <ControllerState.h>
+#include <ControllerStatePublisher.h>
+#include <InputSampler.h>
+#include <LatencyStats.h>
+#include <LinkProfile.h>
+#include <Telemetry.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
 
 // Setup this device to act as a Bluetooth Low Energy Peripheral
 // see Arduino's BLE documentation to better understand the library:
 // https://docs.arduino.cc/libraries/arduinoble/#Usage/Examples
 
 /*
-We will need to stream a service with characteristics for each
-type of user input which should include:
-- X-axs from the thumbstick
-- Y-axis from the thumstick
+We stream a service with a single ControllerState characteristic that
+packs every user input:
+- X-axis from the thumbstick
+- Y-axis from the thumbstick
 - Button press from the thumbstick
 - Button press (Yellow)
 - Button press (Red)
 - Button press (Green)
 - Button press (Blue)
+
+The inputs are sampled from a hardware timer by the InputSampler, which
+averages the axes and debounces the buttons. A sample is only sent when something changed
+beyond the deadband or a keep-alive is due, see ControllerStatePublisher.
+The central can change that cadence by writing the PublisherConfig characteristic.
+
+The Bot sends its own status back on a telemetry service it serves, we subscribe
+to it once connected and log every status it notifies, see BotStatus.h.
+
+Nothing busy-waits: loop() sleeps in BLE.poll() until the bluetooth controller
+has news, the InputSampler took a sample or a button changed. With every task
+blocked the FreeRTOS idle task halts the CPU (WAITI) until the next interrupt.
   */
 static const constexpr char *CENTRAL_NAME = "DUCKS_Central";
 static const constexpr char *CENTRAL_ADDRESS = "f4:12:fa:6d:71:2d";
 
-static const constexpr char *CONTROLLER_UUID = "547b5676-0377-480f-b6f8-2a94873c07ec";
-static const constexpr char *THUMB_STICK_X_AXIS_UUID = "5b03b0ef-c8db-4ef0-adf6-09e23d41a68d";
-static const constexpr char *THUMB_STICK_Y_AXIS_UUID = "b1169c28-5e12-4213-a4ff-0aa316f233cc";
-static const constexpr char *THUMB_STICK_BUTTON_UUID = "c2dd566c-65bb-4d28-8708-227c923433cf";
-static const constexpr char *YELLOW_BUTTON_UUID = "b273ac1b-e05f-4e47-a508-6c87d89e46eb";
-static const constexpr char *RED_BUTTON_UUID = "6db0dbd7-8830-4e3d-b885-baf0e4c75d93";
-static const constexpr char *GREEN_BUTTON_UUID = "ec339d10-06c3-4ad0-80dc-0066f0fea2b9";
-static const constexpr char *BLUE_BUTTON_UUID = "473abf6f-2591-427d-9ae9-9546d01e2287";
-
 BLEService controller_service(CONTROLLER_UUID);
 
-BLEIntCharacteristic thumb_stick_x_axis_characteristic(THUMB_STICK_X_AXIS_UUID, BLERead | BLENotify);
-BLEIntCharacteristic thumb_stick_y_axis_characteristic(THUMB_STICK_Y_AXIS_UUID, BLERead | BLENotify);
-BLEByteCharacteristic thumb_stick_button_characteristic(THUMB_STICK_BUTTON_UUID, BLERead | BLENotify);
-BLEByteCharacteristic yellow_button_characteristic(YELLOW_BUTTON_UUID, BLERead | BLENotify);
-BLEByteCharacteristic red_button_characteristic(RED_BUTTON_UUID, BLERead | BLENotify);
-BLEByteCharacteristic green_button_characteristic(GREEN_BUTTON_UUID, BLERead | BLENotify);
-BLEByteCharacteristic blue_button_characteristic(BLUE_BUTTON_UUID, BLERead | BLENotify);
+BLECharacteristic controller_state_characteristic(CONTROLLER_STATE_UUID, BLERead | BLENotify, CONTROLLER_STATE_SIZE, true);
+BLECharacteristic publisher_config_characteristic(PUBLISHER_CONFIG_UUID, BLERead | BLEWrite, PUBLISHER_CONFIG_SIZE, true);
+
+// Incremented for every sample sent, lets the central spot lost or reordered samples
+uint16_t controller_state_sequence = 0;
+
+ControllerStatePublisher controller_state_publisher;
+
+// Time from an input sample to its notification being handed to the BLE stack
+LatencyHistogram sample_to_notify_latency;
+
+// Published states and idle input readings go out as binary records, decode with tools/telemetry_decode.py
+TelemetryLog telemetry;
+
+// Newest status notified by the Bot, valid once has_bot_status is set
+BotStatus bot_status = {};
+bool has_bot_status = false;
 
 
 // Define all of the pin outs for this sketch:
@@ -71,13 +94,40 @@ static const constexpr int POWER_STATUS_LED = DIGITAL_PIN_8;
 static const constexpr int BUTTON_PRESSED = LOW;
 static const constexpr int BUTTON_BOT_PRESSED = HIGH;
 
-static const constexpr int JOYSTICK_MIN = 0;
-static const constexpr int JOYSTICK_MAX = 0xFFF;
-static const constexpr int JOYSTICK_MIDDLE = JOYSTICK_MAX / 2;
-
 static const constexpr int BUTTON_DEFAULT = BUTTON_BOT_PRESSED;
 static const constexpr int JOYSTICK_DEFAULT = JOYSTICK_MIDDLE;
 
+// How often the inputs are sampled, the publisher decides which samples are sent
+static const constexpr uint32_t SAMPLE_RATE_HZ = 1000;
+// Every axis reading is the average of 1 << ADC_OVERSAMPLE_SHIFT conversions
+static const constexpr uint8_t ADC_OVERSAMPLE_SHIFT = 2;
+// A button has to read the same for this many samples before it changes state
+static const constexpr uint8_t DEBOUNCE_SAMPLES = 5;
+// Sample rate while no central is connected, the button interrupts still sample every edge
+static const constexpr uint32_t IDLE_SAMPLE_RATE_HZ = 20;
+// Raw input readings are logged this often while no central is connected
+static const constexpr unsigned long DEBUG_INPUTS_INTERVAL_MS = 100;
+// Longest loop() sleeps without any event, bounds how late serial commands are seen
+static const constexpr unsigned long LOOP_SLEEP_MS = DEBUG_INPUTS_INTERVAL_MS;
+// The radio needs the 80 MHz APB clock, so the CPU is not clocked below it
+static const constexpr int MIN_CPU_FREQUENCY_MHZ = 80;
+
+static const constexpr ButtonInput BUTTON_INPUTS[INPUT_SAMPLER_BUTTONS] = {
+    {THUMB_STICK_BUTTON, THUMB_STICK_BUTTON_BIT},
+    {YELLOW_BUTTON, YELLOW_BUTTON_BIT},
+    {RED_BUTTON, RED_BUTTON_BIT},
+    {GREEN_BUTTON, GREEN_BUTTON_BIT},
+    {BLUE_BUTTON, BLUE_BUTTON_BIT},
+};
+
+InputSampler input_sampler(THUMB_STICK_X_AXIS, THUMB_STICK_Y_AXIS, BUTTON_INPUTS, BUTTON_PRESSED);
+
+// True while any central is connected, also one about to be dropped for its address
+bool central_link_up = false;
+// True while the expected central is connected and gets our samples
+bool central_accepted = false;
+BLEDevice connected_central;
+
 
 inline void setup_pin_configurations()
 {
@@ -90,24 +140,62 @@ inline void setup_pin_configurations()
     pinMode(BLUE_BUTTON, INPUT_PULLUP);
 }
 
+// A button edge is sampled right away instead of on the next tick, which also wakes loop()
+void IRAM_ATTR button_changed()
+{
+    input_sampler.sample_now();
+}
+
+inline void setup_button_interrupts()
+{
+    for (const ButtonInput &button : BUTTON_INPUTS) {
+        attachInterrupt(digitalPinToInterrupt(button.pin), button_changed, CHANGE);
+    }
+}
+
+// Lets the CPU clock drop while every task is blocked, when the core was built with power management
+void setup_power_management()
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config = {};
+    config.max_freq_mhz = getCpuFrequencyMhz();
+    config.min_freq_mhz = MIN_CPU_FREQUENCY_MHZ;
+    config.light_sleep_enable = false;
+    if (esp_pm_configure(&config) != ESP_OK) {
+        Serial.println("Power management is not available, the CPU stays at full clock.");
+    }
+#endif
+}
+
+// Logs the unfiltered pin readings, a set bit is a pressed button
 void serial_debug_inputs()
 {
-    int x_axis = analogRead(THUMB_STICK_X_AXIS);
-    int y_axis = analogRead(THUMB_STICK_Y_AXIS);
-    int thumb_stick_button = digitalRead(THUMB_STICK_BUTTON);
-    int yellow_button = digitalRead(YELLOW_BUTTON);
-    int red_button = digitalRead(RED_BUTTON);
-    int green_button = digitalRead(GREEN_BUTTON);
-    int blue_button = digitalRead(BLUE_BUTTON);
-
-    Serial.println("The x_axis is: " + String(x_axis));
-    Serial.println("The y_axis is: " + String(y_axis));
-    Serial.println("The thumb_stick_button is: " + String(thumb_stick_button));
-    Serial.println("The yellow_button is: " + String(yellow_button));
-    Serial.println("The red_button is: " + String(red_button));
-    Serial.println("The green_button is: " + String(green_button));
-    Serial.println("The blue_button is: " + String(blue_button));
-    Serial.println();
+    uint16_t x_axis = analogRead(THUMB_STICK_X_AXIS);
+    uint16_t y_axis = analogRead(THUMB_STICK_Y_AXIS);
+
+    uint8_t buttons = 0;
+    for (const ButtonInput &button : BUTTON_INPUTS) {
+        if (digitalRead(button.pin) == BUTTON_PRESSED) {
+            buttons |= button.bit;
+        }
+    }
+
+    telemetry.log_raw_inputs(x_axis, y_axis, buttons, micros());
+}
+
+void serial_debug_inputs_when_due()
+{
+    static unsigned long previous_debug_ms = 0;
+    if (millis() - previous_debug_ms >= DEBUG_INPUTS_INTERVAL_MS) {
+        previous_debug_ms = millis();
+        serial_debug_inputs();
+    }
+}
+
+// Sends as much telemetry as the USB serial takes right now, never waits on it
+void drain_telemetry()
+{
+    telemetry.drain(Serial, Serial.availableForWrite());
 }
 
 // Called when a core component fails to initialize
@@ -136,60 +224,183 @@ void indicate_bluetooth_disconnection(BLEDevice central_device){
     Serial.println("Disconnected from central_device: " + central_device.address());
 }
 
+// Keeps and logs every status the Bot notifies
+void bot_status_updated(BLEDevice central_device, BLECharacteristic characteristic){
+    BotStatus status;
+    if (!decode_bot_status(characteristic.value(), characteristic.valueLength(), status)) {
+        return;
+    }
+    bot_status = status;
+    has_bot_status = true;
+    telemetry.log(TELEMETRY_BOT_STATUS, characteristic.value(), BOT_STATUS_SIZE, micros());
+}
+
+// Subscribes to the Bot's status, a central without the telemetry service (the Receiver) is left alone
+void subscribe_bot_status(BLEDevice central_device){
+    has_bot_status = false;
+    if (!central_device.discoverService(BOT_TELEMETRY_UUID)) {
+        return;
+    }
+
+    // a local copy retains the remote attribute only while it is used
+    BLECharacteristic bot_status_characteristic = central_device.characteristic(BOT_STATUS_UUID);
+    if (!bot_status_characteristic) {
+        return;
+    }
+    bot_status_characteristic.setEventHandler(BLEUpdated, bot_status_updated);
+    if (!bot_status_characteristic.subscribe()) {
+        Serial.println("Was unable to subscribe to the Bot status");
+    }
+}
+
+// Accepts the expected central and drops any other one
+void central_connected(BLEDevice central_device){
+    if (central_device.address() == CENTRAL_ADDRESS){
+        Serial.println("Found the correct central device!");
+        indicate_bluetooth_connection(central_device);
+        controller_state_publisher.reset();
+        input_sampler.set_rate(SAMPLE_RATE_HZ);
+        central_accepted = true;
+        subscribe_bot_status(central_device);
+    } else {
+        Serial.println("The address was: " + central_device.address());
+        central_device.disconnect();
+    }
+}
+
+void central_disconnected(BLEDevice central_device){
+    if (central_accepted) {
+        central_accepted = false;
+        input_sampler.set_rate(IDLE_SAMPLE_RATE_HZ);
+    }
+    indicate_bluetooth_disconnection(central_device);
+    BLE.advertise();
+}
+
+void publish_controller_state(const ControllerState &state){
+    uint8_t value[CONTROLLER_STATE_SIZE];
+    encode_controller_state(state, value);
+    controller_state_characteristic.writeValue(value, sizeof(value));
+}
+
+// Applies a cadence written by the central, short or out-of-range values are ignored
+void publisher_config_written(BLEDevice central_device, BLECharacteristic characteristic){
+    PublisherConfig config;
+    if (!decode_publisher_config(characteristic.value(), characteristic.valueLength(), config)) {
+        Serial.println("Ignoring invalid publisher config");
+        return;
+    }
+    controller_state_publisher.set_config(config);
+}
+
+void publish_publisher_config(const PublisherConfig &config){
+    uint8_t value[PUBLISHER_CONFIG_SIZE];
+    encode_publisher_config(config, value);
+    publisher_config_characteristic.writeValue(value, sizeof(value));
+}
+
 void update_controller_state(){
 
-    int x_axis = analogRead(THUMB_STICK_X_AXIS);
-    int y_axis = analogRead(THUMB_STICK_Y_AXIS);
-    int thumb_stick_button = digitalRead(THUMB_STICK_BUTTON);
-    int yellow_button = digitalRead(YELLOW_BUTTON);
-    int red_button = digitalRead(RED_BUTTON);
-    int green_button = digitalRead(GREEN_BUTTON);
-    int blue_button = digitalRead(BLUE_BUTTON);
+    ControllerState state;
+    if (!input_sampler.latest(state)) {
+        return;
+    }
+
+    if (!controller_state_publisher.should_publish(state, millis())) {
+        return;
+    }
+
+    state.sequence = controller_state_sequence++;
+    publish_controller_state(state);
+    sample_to_notify_latency.record(micros() - state.timestamp_us);
+    telemetry.log_controller_state(state, state.timestamp_us);
+}
+
+
+// Dumps or clears the latency statistics when asked to over Serial
+void handle_serial_command()
+{
+    if (!Serial.available()) {
+        return;
+    }
 
-    thumb_stick_x_axis_characteristic.writeValue(x_axis);
-    thumb_stick_y_axis_characteristic.writeValue(y_axis);
-    thumb_stick_button_characteristic.writeValue(thumb_stick_button);
-    yellow_button_characteristic.writeValue(yellow_button);
-    red_button_characteristic.writeValue(red_button);
-    green_button_characteristic.writeValue(green_button);
-    blue_button_characteristic.writeValue(blue_button);
+    char command = Serial.read();
+    if (command == LATENCY_DUMP_COMMAND) {
+        Serial.println("Latency:");
+        sample_to_notify_latency.print(Serial, "Sample to notify", true);
+        Serial.print("Published ");
+        Serial.print(controller_state_publisher.published_count());
+        Serial.print(", suppressed ");
+        Serial.print(controller_state_publisher.suppressed_count());
+        Serial.print(", missed samples ");
+        Serial.println(input_sampler.missed_count());
+        Serial.print("Telemetry: logged ");
+        Serial.print(telemetry.logged());
+        Serial.print(", dropped ");
+        Serial.println(telemetry.dropped());
+        if (has_bot_status) {
+            Serial.print("Bot: duty ");
+            Serial.print(bot_status.motor1_duty);
+            Serial.print("/");
+            Serial.print(bot_status.motor2_duty);
+            Serial.print(bot_status.flags & BOT_STATUS_ARMED ? ", armed" : ", disarmed");
+            Serial.print(", command age ");
+            Serial.print(bot_status.command_age_us);
+            Serial.print(" us, RSSI ");
+            Serial.print(bot_status.rssi);
+            Serial.print(" dBm, overruns ");
+            Serial.print(bot_status.overruns);
+            Serial.print(", timeouts ");
+            Serial.println(bot_status.command_timeouts);
+        }
+    } else if (command == LATENCY_RESET_COMMAND) {
+        sample_to_notify_latency.reset();
+        Serial.println("Latency statistics cleared");
+    }
 }
 
 
 void setup()
 {
     Serial.begin(9600);
-    while (!Serial);
 
     setup_pin_configurations();
+    setup_power_management();
+
+    // full rate once the central connects
+    input_sampler.set_listener(xTaskGetCurrentTaskHandle());
+    if (!input_sampler.begin(IDLE_SAMPLE_RATE_HZ, ADC_OVERSAMPLE_SHIFT, DEBOUNCE_SAMPLES)) {
+        Serial.println("ERROR: Failed to start the input sampler.");
+        initialization_error_loop();
+    }
+    setup_button_interrupts();
 
     if (!BLE.begin()) {
         Serial.println("ERROR: Failed to initialize bluetooth low energy.");
         initialization_error_loop();
     }
 
-    BLE.setLocalName("DUCKS_Controller");
+    BLE.setLocalName(CONTROLLER_NAME);
     BLE.setAdvertisedService(controller_service);
-    BLE.setDeviceName("DUCKS_Controller");
+    BLE.setDeviceName(CONTROLLER_NAME);
 
-    controller_service.addCharacteristic(thumb_stick_x_axis_characteristic);
-    controller_service.addCharacteristic(thumb_stick_y_axis_characteristic);
-    controller_service.addCharacteristic(thumb_stick_button_characteristic);
-    controller_service.addCharacteristic(yellow_button_characteristic);
-    controller_service.addCharacteristic(red_button_characteristic);
-    controller_service.addCharacteristic(green_button_characteristic);
-    controller_service.addCharacteristic(blue_button_characteristic);
+    // once connected, ask the central for the realtime link profile (7.5 ms interval, latency 0)
+    BLE.setConnectionInterval(REALTIME_CONNECTION_INTERVAL, REALTIME_CONNECTION_INTERVAL);
+    BLE.setSupervisionTimeout(REALTIME_SUPERVISION_TIMEOUT);
+
+    controller_service.addCharacteristic(controller_state_characteristic);
+    controller_service.addCharacteristic(publisher_config_characteristic);
+    publisher_config_characteristic.setEventHandler(BLEWritten, publisher_config_written);
 
     BLE.addService(controller_service);
 
-    // write defaults values to the characteristics to start
-    thumb_stick_x_axis_characteristic.writeValue(JOYSTICK_DEFAULT);
-    thumb_stick_y_axis_characteristic.writeValue(JOYSTICK_DEFAULT);
-    thumb_stick_button_characteristic.writeValue(BUTTON_DEFAULT);
-    yellow_button_characteristic.writeValue(BUTTON_DEFAULT);
-    red_button_characteristic.writeValue(BUTTON_DEFAULT);
-    green_button_characteristic.writeValue(BUTTON_DEFAULT);
-    blue_button_characteristic.writeValue(BUTTON_DEFAULT);
+    // write the default state to the characteristic to start
+    ControllerState default_state = {};
+    default_state.sequence = controller_state_sequence++;
+    default_state.thumb_stick_x_axis = JOYSTICK_DEFAULT;
+    default_state.thumb_stick_y_axis = JOYSTICK_DEFAULT;
+    publish_controller_state(default_state);
+    publish_publisher_config(controller_state_publisher.config());
 
     BLE.advertise();
     Serial.println("Controller is now advertising...");
@@ -200,36 +411,26 @@ void loop()
     // reference: BatteryMonitor.ino sketch from ArduinoBLE/examples/Peripheral/BatteryMonitor/BatteryMonitor.ino
     // accessed 11/15/2025
 
-    long previous_time = 0;
-
-    BLEDevice central_device = BLE.central(); // hang out here and wait for something to connect
-    
-    if (central_device){
-
-        if (central_device.address() == CENTRAL_ADDRESS){
-            Serial.println("Found the correct central device!");
-            indicate_bluetooth_connection(central_device);
-        } else {
-            Serial.println("The address was: " + central_device.address());
-            central_device.disconnect();
-        }
-        
-    
-        while (central_device.connected()) {
-            long current_time = millis();
-            if (current_time - previous_time >= 200) {
-                previous_time = current_time;
-                update_controller_state();
-            }
-
-
-        }
-
-        indicate_bluetooth_disconnection(central_device);
-        BLE.advertise();
+    // sleeps until the bluetooth controller, a new sample or a button wakes us
+    BLE.poll(LOOP_SLEEP_MS);
+
+    BLEDevice central_device = BLE.central();
+    if (central_device && !central_link_up) {
+        central_link_up = true;
+        connected_central = central_device;
+        central_connected(central_device);
+    } else if (!central_device && central_link_up) {
+        central_link_up = false;
+        central_disconnected(connected_central);
+    }
 
+    if (central_accepted) {
+        // a new sample is ready every 1 / SAMPLE_RATE_HZ
+        update_controller_state();
+    } else {
+        serial_debug_inputs_when_due();
     }
 
-    
+    handle_serial_command();
+    drain_telemetry();
 }
-
@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <BotStatus.h>
+
+static BotStatus example()
+{
+    BotStatus status = {};
+    status.sequence = 0x1234;
+    status.flags = BOT_STATUS_ARMED | BOT_STATUS_CLOSED_LOOP;
+    status.motor1_duty = 200;
+    status.motor2_duty = -255;
+    status.command_age_us = 0x00012345;
+    status.overruns = 7;
+    status.command_timeouts = 0x0102;
+    status.rssi = -60;
+    return status;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_encode_is_version_1_little_endian()
+{
+    const uint8_t expected[BOT_STATUS_SIZE] = {
+        0x01,
+        0x03,
+        0x34, 0x12,
+        0xC8, 0x00,
+        0x01, 0xFF,
+        0x45, 0x23, 0x01, 0x00,
+        0x07, 0x00, 0x00, 0x00,
+        0x02, 0x01,
+        0xC4,
+    };
+    uint8_t buffer[BOT_STATUS_SIZE];
+
+    encode_bot_status(example(), buffer);
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buffer, BOT_STATUS_SIZE);
+}
+
+void test_round_trip_keeps_negative_duties()
+{
+    uint8_t buffer[BOT_STATUS_SIZE];
+    BotStatus decoded = {};
+
+    encode_bot_status(example(), buffer);
+
+    TEST_ASSERT_TRUE(decode_bot_status(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL_UINT16(0x1234, decoded.sequence);
+    TEST_ASSERT_EQUAL_UINT8(BOT_STATUS_ARMED | BOT_STATUS_CLOSED_LOOP, decoded.flags);
+    TEST_ASSERT_EQUAL_INT16(200, decoded.motor1_duty);
+    TEST_ASSERT_EQUAL_INT16(-255, decoded.motor2_duty);
+    TEST_ASSERT_EQUAL_UINT32(0x00012345, decoded.command_age_us);
+    TEST_ASSERT_EQUAL_UINT32(7, decoded.overruns);
+    TEST_ASSERT_EQUAL_UINT16(0x0102, decoded.command_timeouts);
+    TEST_ASSERT_EQUAL_INT(-60, decoded.rssi);
+}
+
+void test_unknown_rssi_round_trips()
+{
+    BotStatus status = example();
+    uint8_t buffer[BOT_STATUS_SIZE];
+    BotStatus decoded = {};
+
+    status.rssi = BOT_STATUS_NO_RSSI;
+    encode_bot_status(status, buffer);
+
+    TEST_ASSERT_EQUAL_HEX8(0x7F, buffer[18]);
+    TEST_ASSERT_TRUE(decode_bot_status(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL_INT(BOT_STATUS_NO_RSSI, decoded.rssi);
+}
+
+void test_bad_version_and_size_leave_status_untouched()
+{
+    uint8_t buffer[BOT_STATUS_SIZE];
+    BotStatus decoded = {};
+
+    encode_bot_status(example(), buffer);
+
+    TEST_ASSERT_FALSE(decode_bot_status(buffer, BOT_STATUS_SIZE - 1, decoded));
+    TEST_ASSERT_FALSE(decode_bot_status(nullptr, BOT_STATUS_SIZE, decoded));
+    buffer[0] = BOT_STATUS_VERSION + 1;
+    TEST_ASSERT_FALSE(decode_bot_status(buffer, sizeof(buffer), decoded));
+
+    TEST_ASSERT_EQUAL_UINT16(0, decoded.sequence);
+    TEST_ASSERT_EQUAL_INT16(0, decoded.motor2_duty);
+}
+
+void test_due_once_per_interval()
+{
+    BotStatusPublisher publisher;
+    BotStatus status = {};
+
+    // the first status goes out straight away
+    TEST_ASSERT_TRUE(publisher.due(5000));
+    publisher.publish(status, 5000);
+    TEST_ASSERT_EQUAL_UINT16(0, status.sequence);
+
+    TEST_ASSERT_FALSE(publisher.due(5000 + BOT_STATUS_INTERVAL_MS - 1));
+    TEST_ASSERT_TRUE(publisher.due(5000 + BOT_STATUS_INTERVAL_MS));
+
+    // a late status starts the next interval from when it was sent
+    publisher.publish(status, 5000 + BOT_STATUS_INTERVAL_MS + 30);
+    TEST_ASSERT_EQUAL_UINT16(1, status.sequence);
+    TEST_ASSERT_FALSE(publisher.due(5000 + 2 * BOT_STATUS_INTERVAL_MS + 29));
+    TEST_ASSERT_TRUE(publisher.due(5000 + 2 * BOT_STATUS_INTERVAL_MS + 30));
+    TEST_ASSERT_EQUAL_UINT32(2, publisher.published_count());
+}
+
+void test_due_across_millis_wrap()
+{
+    BotStatusPublisher publisher;
+    BotStatus status = {};
+    uint32_t sent_ms = UINT32_MAX - 50;
+
+    publisher.publish(status, sent_ms);
+
+    TEST_ASSERT_FALSE(publisher.due(sent_ms + BOT_STATUS_INTERVAL_MS - 1));
+    TEST_ASSERT_TRUE(publisher.due(sent_ms + BOT_STATUS_INTERVAL_MS));
+    TEST_ASSERT_TRUE(sent_ms + BOT_STATUS_INTERVAL_MS < sent_ms);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_encode_is_version_1_little_endian);
+    RUN_TEST(test_round_trip_keeps_negative_duties);
+    RUN_TEST(test_unknown_rssi_round_trips);
+    RUN_TEST(test_bad_version_and_size_leave_status_untouched);
+    RUN_TEST(test_due_once_per_interval);
+    RUN_TEST(test_due_across_millis_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,70 @@
+#include <unity.h>
+#include <ButtonDebouncer.h>
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_press_needs_threshold_samples()
+{
+    ButtonDebouncer debouncer(5);
+
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_FALSE(debouncer.update(true));
+    }
+    TEST_ASSERT_TRUE(debouncer.update(true));
+    TEST_ASSERT_TRUE(debouncer.pressed());
+}
+
+void test_release_waits_for_integrator_to_reach_zero()
+{
+    ButtonDebouncer debouncer(5);
+
+    // saturates at the threshold, extra samples do not delay the release
+    for (int i = 0; i < 20; i++) {
+        debouncer.update(true);
+    }
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(debouncer.update(false));
+    }
+    TEST_ASSERT_FALSE(debouncer.update(false));
+    TEST_ASSERT_FALSE(debouncer.pressed());
+}
+
+void test_bouncing_contact_keeps_state()
+{
+    ButtonDebouncer debouncer(5);
+
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_FALSE(debouncer.update(i % 2 == 0));
+    }
+
+    for (int i = 0; i < 5; i++) {
+        debouncer.update(true);
+    }
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_TRUE(debouncer.update(i % 2 == 0));
+    }
+}
+
+void test_zero_threshold_follows_raw_reading()
+{
+    ButtonDebouncer debouncer(0);
+
+    TEST_ASSERT_TRUE(debouncer.update(true));
+    TEST_ASSERT_FALSE(debouncer.update(false));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_press_needs_threshold_samples);
+    RUN_TEST(test_release_waits_for_integrator_to_reach_zero);
+    RUN_TEST(test_bouncing_contact_keeps_state);
+    RUN_TEST(test_zero_threshold_follows_raw_reading);
+    return UNITY_END();
+}
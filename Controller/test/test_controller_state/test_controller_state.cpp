@@ -0,0 +1,188 @@
+#include <unity.h>
+#include <ControllerState.h>
+
+static ControllerState example()
+{
+    ControllerState state = {};
+    state.sequence = 0xBEEF;
+    state.timestamp_us = 0x12345678;
+    state.thumb_stick_x_axis = 0x0ABC;
+    state.thumb_stick_y_axis = 0x0123;
+    state.buttons = RED_BUTTON_BIT | BLUE_BUTTON_BIT;
+    return state;
+}
+
+static PublisherConfig example_config()
+{
+    PublisherConfig config = { 8, 10, 50, 100, 1000 };
+    return config;
+}
+
+static bool config_round_trip(const PublisherConfig &config, PublisherConfig &decoded)
+{
+    uint8_t buffer[PUBLISHER_CONFIG_SIZE];
+    encode_publisher_config(config, buffer);
+    return decode_publisher_config(buffer, sizeof(buffer), decoded);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_encode_is_version_1_little_endian()
+{
+    const uint8_t expected[CONTROLLER_STATE_SIZE] = {
+        0x01,
+        0x14,
+        0xEF, 0xBE,
+        0x78, 0x56, 0x34, 0x12,
+        0xBC, 0x0A,
+        0x23, 0x01,
+    };
+    uint8_t buffer[CONTROLLER_STATE_SIZE];
+
+    encode_controller_state(example(), buffer);
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buffer, CONTROLLER_STATE_SIZE);
+}
+
+void test_round_trip()
+{
+    uint8_t buffer[CONTROLLER_STATE_SIZE];
+    ControllerState decoded = {};
+
+    encode_controller_state(example(), buffer);
+
+    TEST_ASSERT_TRUE(decode_controller_state(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, decoded.sequence);
+    TEST_ASSERT_EQUAL_UINT32(0x12345678, decoded.timestamp_us);
+    TEST_ASSERT_EQUAL_UINT16(0x0ABC, decoded.thumb_stick_x_axis);
+    TEST_ASSERT_EQUAL_UINT16(0x0123, decoded.thumb_stick_y_axis);
+    TEST_ASSERT_EQUAL_UINT8(RED_BUTTON_BIT | BLUE_BUTTON_BIT, decoded.buttons);
+}
+
+void test_bad_version_leaves_state_untouched()
+{
+    uint8_t buffer[CONTROLLER_STATE_SIZE];
+    ControllerState decoded = {};
+
+    encode_controller_state(example(), buffer);
+    buffer[0] = CONTROLLER_STATE_VERSION + 1;
+
+    TEST_ASSERT_FALSE(decode_controller_state(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL_UINT16(0, decoded.sequence);
+    TEST_ASSERT_EQUAL_UINT8(0, decoded.buttons);
+}
+
+void test_bad_size_leaves_state_untouched()
+{
+    uint8_t buffer[CONTROLLER_STATE_SIZE + 1] = {};
+    ControllerState decoded = {};
+
+    encode_controller_state(example(), buffer);
+
+    TEST_ASSERT_FALSE(decode_controller_state(buffer, CONTROLLER_STATE_SIZE - 1, decoded));
+    TEST_ASSERT_FALSE(decode_controller_state(nullptr, CONTROLLER_STATE_SIZE, decoded));
+    TEST_ASSERT_EQUAL_UINT16(0, decoded.sequence);
+
+    // a longer value is fine, later versions may only append
+    TEST_ASSERT_TRUE(decode_controller_state(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, decoded.sequence);
+}
+
+void test_publisher_config_round_trip()
+{
+    PublisherConfig config = example_config();
+    PublisherConfig decoded = {};
+
+    TEST_ASSERT_TRUE(config_round_trip(config, decoded));
+    TEST_ASSERT_EQUAL_UINT16(8, decoded.axis_deadband);
+    TEST_ASSERT_EQUAL_UINT16(10, decoded.min_interval_ms);
+    TEST_ASSERT_EQUAL_UINT16(50, decoded.active_keepalive_ms);
+    TEST_ASSERT_EQUAL_UINT16(100, decoded.idle_keepalive_ms);
+    TEST_ASSERT_EQUAL_UINT16(1000, decoded.idle_after_ms);
+
+    // the limits themselves are accepted
+    config.axis_deadband = PUBLISHER_AXIS_DEADBAND_MAX;
+    config.min_interval_ms = 1;
+    config.active_keepalive_ms = 1;
+    config.idle_keepalive_ms = PUBLISHER_KEEPALIVE_MAX_MS;
+    TEST_ASSERT_TRUE(config_round_trip(config, decoded));
+}
+
+void test_publisher_config_keepalives_out_of_range_are_rejected()
+{
+    PublisherConfig config = example_config();
+    PublisherConfig decoded = {};
+
+    config.active_keepalive_ms = 0;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    config = example_config();
+    config.idle_keepalive_ms = 0;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    // at or above the Bot's command timeout the Bot would stop a controller that is still there
+    config = example_config();
+    config.idle_keepalive_ms = 250;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    config = example_config();
+    config.active_keepalive_ms = 65535;
+    config.min_interval_ms = 10;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    config = example_config();
+    config.idle_keepalive_ms = PUBLISHER_KEEPALIVE_MAX_MS + 1;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    TEST_ASSERT_EQUAL_UINT16(0, decoded.idle_keepalive_ms);
+}
+
+void test_publisher_config_min_interval_and_deadband_are_checked()
+{
+    PublisherConfig config = example_config();
+    PublisherConfig decoded = {};
+
+    config.min_interval_ms = config.active_keepalive_ms + 1;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    config = example_config();
+    config.axis_deadband = PUBLISHER_AXIS_DEADBAND_MAX + 1;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    config = example_config();
+    config.axis_deadband = 65535;
+    TEST_ASSERT_FALSE(config_round_trip(config, decoded));
+
+    TEST_ASSERT_EQUAL_UINT16(0, decoded.axis_deadband);
+}
+
+void test_publisher_config_bad_size_is_rejected()
+{
+    uint8_t buffer[PUBLISHER_CONFIG_SIZE];
+    PublisherConfig decoded = {};
+
+    encode_publisher_config(example_config(), buffer);
+
+    TEST_ASSERT_FALSE(decode_publisher_config(buffer, PUBLISHER_CONFIG_SIZE - 1, decoded));
+    TEST_ASSERT_FALSE(decode_publisher_config(nullptr, PUBLISHER_CONFIG_SIZE, decoded));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_encode_is_version_1_little_endian);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_bad_version_leaves_state_untouched);
+    RUN_TEST(test_bad_size_leaves_state_untouched);
+    RUN_TEST(test_publisher_config_round_trip);
+    RUN_TEST(test_publisher_config_keepalives_out_of_range_are_rejected);
+    RUN_TEST(test_publisher_config_min_interval_and_deadband_are_checked);
+    RUN_TEST(test_publisher_config_bad_size_is_rejected);
+    return UNITY_END();
+}
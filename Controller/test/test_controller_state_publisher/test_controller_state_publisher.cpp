@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <ControllerStatePublisher.h>
+
+static ControllerState sample(uint16_t x_axis, uint16_t y_axis, uint8_t buttons = 0)
+{
+    ControllerState state = {};
+    state.thumb_stick_x_axis = x_axis;
+    state.thumb_stick_y_axis = y_axis;
+    state.buttons = buttons;
+    return state;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_first_sample_is_always_sent()
+{
+    ControllerStatePublisher publisher;
+
+    TEST_ASSERT_TRUE(publisher.should_publish(sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE), 12345));
+    TEST_ASSERT_EQUAL_UINT32(1, publisher.published_count());
+}
+
+void test_axis_within_deadband_is_not_sent()
+{
+    ControllerStatePublisher publisher;
+    uint16_t deadband = DEFAULT_PUBLISHER_CONFIG.axis_deadband;
+
+    publisher.should_publish(sample(1000, 1000), 0);
+
+    TEST_ASSERT_FALSE(publisher.should_publish(sample(1000 + deadband, 1000 - deadband), 20));
+    TEST_ASSERT_TRUE(publisher.should_publish(sample(1000 + deadband + 1, 1000), 21));
+    TEST_ASSERT_EQUAL_UINT32(2, publisher.published_count());
+    TEST_ASSERT_EQUAL_UINT32(1, publisher.suppressed_count());
+}
+
+void test_axis_changes_wait_for_min_interval()
+{
+    ControllerStatePublisher publisher;
+    uint16_t min_interval_ms = DEFAULT_PUBLISHER_CONFIG.min_interval_ms;
+
+    publisher.should_publish(sample(1000, 1000), 0);
+
+    TEST_ASSERT_FALSE(publisher.should_publish(sample(2000, 1000), min_interval_ms - 1));
+    TEST_ASSERT_TRUE(publisher.should_publish(sample(2000, 1000), min_interval_ms));
+    TEST_ASSERT_FALSE(publisher.should_publish(sample(3000, 1000), 2 * min_interval_ms - 1));
+}
+
+void test_button_change_is_sent_straight_away()
+{
+    ControllerStatePublisher publisher;
+
+    publisher.should_publish(sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE), 0);
+
+    TEST_ASSERT_TRUE(publisher.should_publish(sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE, RED_BUTTON_BIT), 1));
+    TEST_ASSERT_TRUE(publisher.should_publish(sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE), 2));
+}
+
+void test_deflected_stick_keeps_active_keepalive()
+{
+    ControllerStatePublisher publisher;
+    uint16_t keepalive_ms = DEFAULT_PUBLISHER_CONFIG.active_keepalive_ms;
+    ControllerState held = sample(JOYSTICK_MAX, JOYSTICK_MIDDLE);
+
+    publisher.should_publish(held, 0);
+    TEST_ASSERT_FALSE(publisher.should_publish(held, keepalive_ms - 1));
+    TEST_ASSERT_TRUE(publisher.should_publish(held, keepalive_ms));
+
+    // long after the last change, the stick is still in use
+    TEST_ASSERT_TRUE(publisher.active(held, 10000));
+    TEST_ASSERT_TRUE(publisher.should_publish(held, 10000));
+    TEST_ASSERT_FALSE(publisher.should_publish(held, 10000 + keepalive_ms - 1));
+    TEST_ASSERT_TRUE(publisher.should_publish(held, 10000 + keepalive_ms));
+}
+
+void test_centered_stick_goes_idle()
+{
+    ControllerStatePublisher publisher;
+    PublisherConfig config = DEFAULT_PUBLISHER_CONFIG;
+    ControllerState centered = sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE);
+
+    publisher.should_publish(centered, 0);
+    TEST_ASSERT_TRUE(publisher.active(centered, config.idle_after_ms - 1));
+    TEST_ASSERT_FALSE(publisher.active(centered, config.idle_after_ms));
+
+    // active keep-alive until idle_after_ms, then the idle one
+    uint32_t last_sent = config.idle_after_ms - config.active_keepalive_ms;
+    TEST_ASSERT_TRUE(publisher.should_publish(centered, last_sent));
+    TEST_ASSERT_FALSE(publisher.should_publish(centered, last_sent + config.active_keepalive_ms));
+    TEST_ASSERT_FALSE(publisher.should_publish(centered, last_sent + config.idle_keepalive_ms - 1));
+    TEST_ASSERT_TRUE(publisher.should_publish(centered, last_sent + config.idle_keepalive_ms));
+}
+
+void test_change_makes_idle_controller_active_again()
+{
+    ControllerStatePublisher publisher;
+    PublisherConfig config = DEFAULT_PUBLISHER_CONFIG;
+    ControllerState centered = sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE);
+    uint32_t now_ms = 5000;
+
+    publisher.should_publish(centered, 0);
+    TEST_ASSERT_FALSE(publisher.active(centered, now_ms));
+
+    TEST_ASSERT_TRUE(publisher.should_publish(sample(JOYSTICK_MIDDLE, JOYSTICK_MIDDLE, BLUE_BUTTON_BIT), now_ms));
+    TEST_ASSERT_TRUE(publisher.should_publish(centered, now_ms + 1));
+    TEST_ASSERT_TRUE(publisher.active(centered, now_ms + config.idle_after_ms));
+    TEST_ASSERT_TRUE(publisher.should_publish(centered, now_ms + 1 + config.active_keepalive_ms));
+}
+
+void test_times_wrap_around()
+{
+    ControllerStatePublisher publisher;
+    uint16_t keepalive_ms = DEFAULT_PUBLISHER_CONFIG.active_keepalive_ms;
+    ControllerState held = sample(JOYSTICK_MIN, JOYSTICK_MIDDLE);
+
+    publisher.should_publish(held, UINT32_MAX - 10);
+    TEST_ASSERT_FALSE(publisher.should_publish(held, keepalive_ms - 12));
+    TEST_ASSERT_TRUE(publisher.should_publish(held, keepalive_ms - 11));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_is_always_sent);
+    RUN_TEST(test_axis_within_deadband_is_not_sent);
+    RUN_TEST(test_axis_changes_wait_for_min_interval);
+    RUN_TEST(test_button_change_is_sent_straight_away);
+    RUN_TEST(test_deflected_stick_keeps_active_keepalive);
+    RUN_TEST(test_centered_stick_goes_idle);
+    RUN_TEST(test_change_makes_idle_controller_active_again);
+    RUN_TEST(test_times_wrap_around);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+#include <unity.h>
+#include <string.h>
+#include <Telemetry.h>
+
+static const constexpr int RAW_INPUTS_FRAME_SIZE = TELEMETRY_HEADER_SIZE + 5 + 1;
+
+// tools/telemetry_decode.py prints this as "inputs x=291 y=2748 buttons=red,blue"
+static const uint8_t RAW_INPUTS_FRAME[RAW_INPUTS_FRAME_SIZE] = {
+    0xA5, 0x02, 0x05,
+    0x78, 0x56, 0x34, 0x12,
+    0x23, 0x01, 0xBC, 0x0A, 0x14,
+    0xC2,
+};
+
+// and this as "DROPPED 3 records"
+static const uint8_t DROPPED_FRAME[] = {
+    0xA5, 0x7F, 0x04,
+    0x78, 0x56, 0x34, 0x12,
+    0x03, 0x00, 0x00, 0x00,
+    0xC8,
+};
+
+struct CaptureOutput {
+    uint8_t data[2 * TELEMETRY_BUFFER_SIZE];
+    size_t length;
+
+    void write(const uint8_t buffer[], size_t size)
+    {
+        memcpy(&data[length], buffer, size);
+        length += size;
+    }
+};
+
+static CaptureOutput output;
+
+static bool log_known_inputs(TelemetryLog &log)
+{
+    return log.log_raw_inputs(0x0123, 0x0ABC, RED_BUTTON_BIT | BLUE_BUTTON_BIT, 0x12345678);
+}
+
+void setUp()
+{
+    output.length = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_crc8_check_value()
+{
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+    TEST_ASSERT_EQUAL_HEX8(0xF4, telemetry_crc8(check, sizeof(check)));
+    // a running CRC over two parts is the CRC over the whole
+    TEST_ASSERT_EQUAL_HEX8(0xF4, telemetry_crc8(&check[4], 5, telemetry_crc8(check, 4)));
+}
+
+void test_known_frame_matches_decoder()
+{
+    TelemetryLog log;
+
+    TEST_ASSERT_TRUE(log_known_inputs(log));
+    TEST_ASSERT_EQUAL_UINT32(RAW_INPUTS_FRAME_SIZE, log.drain(output, 1000));
+
+    TEST_ASSERT_EQUAL_UINT32(RAW_INPUTS_FRAME_SIZE, output.length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(RAW_INPUTS_FRAME, output.data, RAW_INPUTS_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_HEX8(RAW_INPUTS_FRAME[RAW_INPUTS_FRAME_SIZE - 1], telemetry_crc8(&RAW_INPUTS_FRAME[1], RAW_INPUTS_FRAME_SIZE - 2));
+}
+
+void test_frames_survive_ring_wrap()
+{
+    TelemetryLog log;
+    uint32_t next_timestamp = 0;
+    uint32_t checked = 0;
+
+    // 150 frames of 13 bytes go round the 1024 byte ring almost twice
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 50; i++) {
+            TEST_ASSERT_TRUE(log.log_raw_inputs(0, 0, 0, next_timestamp++));
+        }
+
+        // odd budgets split frames and the copy at the end of the ring
+        output.length = 0;
+        while (log.pending() > 0) {
+            log.drain(output, 100);
+        }
+        TEST_ASSERT_EQUAL_UINT32(50 * RAW_INPUTS_FRAME_SIZE, output.length);
+
+        for (size_t offset = 0; offset < output.length; offset += RAW_INPUTS_FRAME_SIZE) {
+            const uint8_t *frame = &output.data[offset];
+            uint32_t timestamp = frame[3] | (frame[4] << 8) | (frame[5] << 16) | ((uint32_t)frame[6] << 24);
+
+            TEST_ASSERT_EQUAL_HEX8(TELEMETRY_SYNC, frame[0]);
+            TEST_ASSERT_EQUAL_HEX8(telemetry_crc8(&frame[1], RAW_INPUTS_FRAME_SIZE - 2), frame[RAW_INPUTS_FRAME_SIZE - 1]);
+            TEST_ASSERT_EQUAL_UINT32(checked++, timestamp);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(150, log.logged());
+    TEST_ASSERT_EQUAL_UINT32(0, log.dropped());
+}
+
+void test_full_ring_drops_and_reports()
+{
+    TelemetryLog log;
+    uint32_t fitting = TELEMETRY_BUFFER_SIZE / RAW_INPUTS_FRAME_SIZE;
+
+    for (uint32_t i = 0; i < fitting; i++) {
+        TEST_ASSERT_TRUE(log_known_inputs(log));
+    }
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_FALSE(log_known_inputs(log));
+    }
+    TEST_ASSERT_EQUAL_UINT32(fitting * RAW_INPUTS_FRAME_SIZE, log.pending());
+    TEST_ASSERT_EQUAL_UINT32(3, log.dropped());
+
+    log.drain(output, TELEMETRY_BUFFER_SIZE);
+    output.length = 0;
+
+    // the drop count goes out first, ahead of the record that found room
+    TEST_ASSERT_TRUE(log_known_inputs(log));
+    log.drain(output, TELEMETRY_BUFFER_SIZE);
+
+    TEST_ASSERT_EQUAL_UINT32(sizeof(DROPPED_FRAME) + RAW_INPUTS_FRAME_SIZE, output.length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(DROPPED_FRAME, output.data, sizeof(DROPPED_FRAME));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(RAW_INPUTS_FRAME, &output.data[sizeof(DROPPED_FRAME)], RAW_INPUTS_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(fitting + 1, log.logged());
+    TEST_ASSERT_EQUAL_UINT32(3, log.dropped());
+}
+
+void test_oversized_payload_is_dropped()
+{
+    TelemetryLog log;
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD + 1] = {};
+
+    TEST_ASSERT_FALSE(log.log(TELEMETRY_RAW_INPUTS, payload, sizeof(payload), 0));
+    TEST_ASSERT_EQUAL_UINT32(0, log.pending());
+    TEST_ASSERT_EQUAL_UINT32(1, log.dropped());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc8_check_value);
+    RUN_TEST(test_known_frame_matches_decoder);
+    RUN_TEST(test_frames_survive_ring_wrap);
+    RUN_TEST(test_full_ring_drops_and_reports);
+    RUN_TEST(test_oversized_payload_is_dropped);
+    return UNITY_END();
+}
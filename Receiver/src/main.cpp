@@ -1,160 +1,124 @@
 #include <Arduino.h>
 #include <ArduinoBLE.h>
-#include <array>
+#include <ControllerFleet.h>
+#include <ControllerState.h>
+#include <LinkProfile.h>
+#include <LatencyStats.h>
+#include <Telemetry.h>
 
 static const constexpr char *CENTRAL_NAME = "DUCKS_Central";
 
-static const constexpr char *CONTROLLER_UUID = "547b5676-0377-480f-b6f8-2a94873c07ec";
-static const constexpr char *THUMB_STICK_X_AXIS_UUID = "5b03b0ef-c8db-4ef0-adf6-09e23d41a68d";
-static const constexpr char *THUMB_STICK_Y_AXIS_UUID = "b1169c28-5e12-4213-a4ff-0aa316f233cc";
-static const constexpr char *THUMB_STICK_BUTTON_UUID = "c2dd566c-65bb-4d28-8708-227c923433cf";
-static const constexpr char *YELLOW_BUTTON_UUID = "b273ac1b-e05f-4e47-a508-6c87d89e46eb";
-static const constexpr char *RED_BUTTON_UUID = "6db0dbd7-8830-4e3d-b885-baf0e4c75d93";
-static const constexpr char *GREEN_BUTTON_UUID = "ec339d10-06c3-4ad0-80dc-0066f0fea2b9";
-static const constexpr char *BLUE_BUTTON_UUID = "473abf6f-2591-427d-9ae9-9546d01e2287";
-
-static const constexpr int NUMBER_OF_CHARACTERISTICS = 7;
-
-typedef enum Result {
-    SUCCESS,
-    ERROR
-};
-
-struct ControllerState {
-    int thumb_stick_x_axis;
-    int thumb_stick_y_axis;
-    byte thumb_stick_button;
-    byte yellow_button;
-    byte red_button;
-    byte green_button;
-    byte blue_button;
-};
-
-
-Result subscribe_to_characteristics(std::array<BLECharacteristic, NUMBER_OF_CHARACTERISTICS> characteristics){
-    for (int i = 0; i < characteristics.size(); ++i){
-        BLECharacteristic characteristic = characteristics[i];
-        String id_string = "index: " + String(i) + " and UUID:  " + String(characteristic.uuid());
-        Serial.println("Attempting to subscribe to a characteristic at " + id_string + ".");
-        if (!characteristic){
-            Serial.println("The characteristic at " + id_string + " does not exist.");
-            return ERROR;
-        }
-        if (!characteristic.canSubscribe()){
-            Serial.println("The characteristic at " + id_string + " is not subscribable.");
-            return ERROR;
-        }
-        if (!characteristic.subscribe()){
-            Serial.println("Failed to subscribe to characteristic at " + id_string + ".");
-            return ERROR;
-        }
-        Serial.println("Subscribed to characteristic at " + id_string + ".");
-    }
-    return SUCCESS;
+// Every controller in range stays connected, each one feeds its own output channel (its fleet slot)
+ControllerFleet fleet;
+
+// Transit, packet gaps and lost samples of every controller link, indexed by channel
+LinkLatencyTracker link_latency[FLEET_MAX_CONTROLLERS];
+
+// Every received controller state is logged as a binary record, decode with tools/telemetry_decode.py
+TelemetryLog telemetry;
+
+// Sends as much telemetry as the UART takes right now, never waits on it
+void drain_telemetry()
+{
+    telemetry.drain(Serial, Serial.availableForWrite());
+}
+
+// Longest BLE.poll() waits for the next bluetooth event before serial is serviced again
+static const constexpr unsigned long BLE_POLL_TIMEOUT_MS = 10;
+
+// Consumes each fresh state of a channel, receive_us is when its notification was dispatched
+typedef void (*OutputStage)(uint8_t channel, const ControllerState &state, uint32_t receive_us);
+
+// Binary telemetry record per state, decode with tools/telemetry_decode.py
+void telemetry_output(uint8_t channel, const ControllerState &state, uint32_t receive_us)
+{
+    telemetry.log_channel_state(channel, state, receive_us);
+}
+
+// One human readable line per state, only for a quick look, it blocks once the UART is full
+void text_output(uint8_t channel, const ControllerState &state, uint32_t receive_us)
+{
+    Serial.print("ch ");
+    Serial.print(channel);
+    Serial.print(" seq ");
+    Serial.print(state.sequence);
+    Serial.print(" x ");
+    Serial.print(state.thumb_stick_x_axis);
+    Serial.print(" y ");
+    Serial.print(state.thumb_stick_y_axis);
+    Serial.print(" buttons 0x");
+    Serial.println(state.buttons, HEX);
 }
 
-void monitor_controller_state(BLEDevice controller)
+// Swap for text_output to read the states in a serial monitor
+OutputStage output_stage = telemetry_output;
+
+// Dumps or clears the latency statistics when asked to over Serial
+void handle_serial_command()
 {
-    // reference: SensorTagButton.ino sketch from ArduinoBLE/examples/Central/SensorTagButton/SensorTagButton.ino
-    // accessed 11/16/2025
-
-    Serial.println("Connecting to the controller device...");
-    if (controller.connect()) {
-        Serial.println("Connected to the controller device. ");
-    } else {
-        Serial.println("Failed to connect to the controller device.");
+    if (!Serial.available()) {
         return;
     }
 
-    bool res = controller.discoverService(CONTROLLER_UUID);
-    Serial.println("Result of discover service: " + String(res));
-    res = controller.discoverAttributes();
-    Serial.println("Result of discoverAttributes: " + String(res));
+    char command = Serial.read();
+    if (command == LATENCY_DUMP_COMMAND) {
+        Serial.println("Latency:");
+        for (int channel = 0; channel < FLEET_MAX_CONTROLLERS; channel++) {
+            if (link_latency[channel].received() == 0) {
+                continue;
+            }
+            char name[24];
+            snprintf(name, sizeof(name), "Controller link %d", channel);
+            link_latency[channel].print(Serial, name);
+        }
+        Serial.print("Telemetry: logged ");
+        Serial.print(telemetry.logged());
+        Serial.print(", dropped ");
+        Serial.println(telemetry.dropped());
+        Serial.print("Coalesced snapshots: ");
+        Serial.println(fleet.coalesced());
+    } else if (command == LATENCY_RESET_COMMAND) {
+        for (int channel = 0; channel < FLEET_MAX_CONTROLLERS; channel++) {
+            link_latency[channel].reset();
+        }
+        fleet.reset_coalesced();
+        Serial.println("Latency statistics cleared");
+    }
+}
 
+// Called from BLE.poll() for every controller state notification, the fleet keeps only the newest state per channel
+void controller_state_updated(int channel, const ControllerState &state, uint32_t receive_us)
+{
+    link_latency[channel].on_receive(state.sequence, state.timestamp_us, receive_us);
+}
 
+void controller_connected(int channel, BLEDevice controller)
+{
+    Serial.print("Controller ");
+    Serial.print(channel);
+    Serial.print(" connected: ");
+    Serial.println(controller.address());
+    link_latency[channel].restart();
+}
 
-    if (!controller.hasService(CONTROLLER_UUID)){
-        Serial.println("The controller does not have the controller service as expected!");
-    }
-    BLEService controller_service = controller.service(CONTROLLER_UUID);
-
-    BLECharacteristic thumb_stick_x_axis_characteristic = controller.characteristic(THUMB_STICK_X_AXIS_UUID);
-    BLECharacteristic thumb_stick_y_axis_characteristic = controller.characteristic(THUMB_STICK_Y_AXIS_UUID);
-    BLECharacteristic thumb_stick_button_characteristic = controller.characteristic(THUMB_STICK_BUTTON_UUID);
-    BLECharacteristic yellow_button_characteristic = controller.characteristic(YELLOW_BUTTON_UUID);
-    BLECharacteristic red_button_characteristic = controller.characteristic(RED_BUTTON_UUID);
-    BLECharacteristic green_button_characteristic = controller.characteristic(GREEN_BUTTON_UUID);
-    BLECharacteristic blue_button_characteristic = controller.characteristic(BLUE_BUTTON_UUID);
-
-    // BLECharacteristic thumb_stick_x_axis_characteristic = controller.characteristic(0);
-    // BLECharacteristic thumb_stick_y_axis_characteristic = controller.characteristic(1);
-    // BLECharacteristic thumb_stick_button_characteristic = controller.characteristic(2);
-    // BLECharacteristic yellow_button_characteristic = controller.characteristic(3);
-    // BLECharacteristic red_button_characteristic = controller.characteristic(4);
-    // BLECharacteristic green_button_characteristic = controller.characteristic(5);
-    // BLECharacteristic blue_button_characteristic = controller.characteristic(6);
-
-
-    std::array<BLECharacteristic, NUMBER_OF_CHARACTERISTICS> characteristics = {
-        thumb_stick_x_axis_characteristic,
-        thumb_stick_y_axis_characteristic,
-        thumb_stick_button_characteristic,
-        yellow_button_characteristic,
-        red_button_characteristic,
-        green_button_characteristic,
-        blue_button_characteristic
-    };
-
-    Result rs = subscribe_to_characteristics(characteristics);
-    if (rs == ERROR){
-        return;
-    }
+void controller_disconnected(int channel, BLEDevice controller)
+{
+    Serial.print("Controller ");
+    Serial.print(channel);
+    Serial.println(" disconnected");
+}
 
-    ControllerState controller_state = {};
-    const int wait_interval_ms = 500;
-    int previous_time_ms = 0;
-    while (controller.connected()){
+// Hands every fresh state to the output stage, at most once per state
+void consume_controller_snapshots()
+{
+    ControllerState state;
+    uint32_t receive_us;
 
-        int current_time_ms = millis();
-        if (current_time_ms > (previous_time_ms + wait_interval_ms)){
-            previous_time_ms = current_time_ms;
-        } else {
-            continue;
+    for (int channel = 0; channel < FLEET_MAX_CONTROLLERS; channel++) {
+        if (fleet.take(channel, state, receive_us) && output_stage) {
+            output_stage(channel, state, receive_us);
         }
-        
-        if (thumb_stick_x_axis_characteristic.valueUpdated()){
-            thumb_stick_x_axis_characteristic.readValue(&controller_state.thumb_stick_x_axis, sizeof(int));
-        } 
-        if (thumb_stick_y_axis_characteristic.valueUpdated()){
-            thumb_stick_y_axis_characteristic.readValue(&controller_state.thumb_stick_y_axis, sizeof(int));
-        } 
-        if (thumb_stick_button_characteristic.valueUpdated()){
-            thumb_stick_button_characteristic.readValue(&controller_state.thumb_stick_button, sizeof(byte));
-        } 
-        if (yellow_button_characteristic.valueUpdated()){
-            yellow_button_characteristic.readValue(&controller_state.yellow_button, sizeof(byte));
-        } 
-        if (red_button_characteristic.valueUpdated()){
-            red_button_characteristic.readValue(&controller_state.red_button, sizeof(byte));
-        } 
-        if (green_button_characteristic.valueUpdated()){
-            green_button_characteristic.readValue(&controller_state.green_button, sizeof(byte));
-        } 
-        if (blue_button_characteristic.valueUpdated()){
-            blue_button_characteristic.readValue(&controller_state.blue_button, sizeof(byte));
-        } 
-
-        Serial.println("The x_axis is: " + String(controller_state.thumb_stick_x_axis));
-        Serial.println("The y_axis is: " + String(controller_state.thumb_stick_y_axis));
-        Serial.println("The thumb_stick_button is: " + String(controller_state.thumb_stick_button));
-        Serial.println("The yellow_button is: " + String(controller_state.yellow_button));
-        Serial.println("The red_button is: " + String(controller_state.red_button));
-        Serial.println("The green_button is: " + String(controller_state.green_button));
-        Serial.println("The blue_button is: " + String(controller_state.blue_button));
-        Serial.println();
     }
- 
-    return;
 }
 
 
@@ -172,35 +136,25 @@ void setup()
     BLE.setDeviceName(CENTRAL_NAME);
     BLE.setLocalName(CENTRAL_NAME);
 
-    Serial.println("Scanning for controller.");
-    BLE.scanForUuid(CONTROLLER_UUID);
+    // only accept the realtime link profile the controller asks for
+    BLE.setConnectionInterval(REALTIME_CONNECTION_INTERVAL, REALTIME_CONNECTION_INTERVAL);
+    BLE.setSupervisionTimeout(REALTIME_SUPERVISION_TIMEOUT);
+
+    fleet.set_policy(FLEET_CHANNEL_PER_CONTROLLER);
+    fleet.set_state_handler(controller_state_updated);
+    fleet.set_connect_handler(controller_connected);
+    fleet.set_disconnect_handler(controller_disconnected);
+
+    Serial.println("Scanning for controllers.");
+    fleet.begin();
 }
 
 void loop()
 {
-    // reference: SensorTagButton.ino sketch from ArduinoBLE/examples/Central/SensorTagButton/SensorTagButton.ino
-    // accessed 11/16/2025
-
-    BLEDevice peripheral = BLE.available();
-
-    if (peripheral){
-        BLEDevice& p = peripheral;
-        String msg = "Found a peripheral with address: " + p.address() + ", localName: " + p.localName()  + ", serviceUUID: " + p.advertisedServiceUuid(); + ".";
-        Serial.println(msg);
-        if (!p.hasService(CONTROLLER_UUID)){
-                Serial.println("The controller does not have the controller service in loop to start!");
-        }
-
-        if (p.advertisedServiceUuid() == CONTROLLER_UUID) {
-            BLE.stopScan();
+    // returns as soon as the next bluetooth event was handled, or after the timeout
+    fleet.poll(BLE_POLL_TIMEOUT_MS);
 
-            if (!p.hasService(CONTROLLER_UUID)){
-                Serial.println("The controller does not have the controller service in loop after stop scan!");
-            }
-
-            monitor_controller_state(p);
-
-            BLE.scan();
-        }
-    }
+    consume_controller_snapshots();
+    handle_serial_command();
+    drain_telemetry();
 }
@@ -0,0 +1,88 @@
+#include "BotStatus.h"
+
+static void put_uint16(uint8_t buffer[], uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static void put_uint32(uint8_t buffer[], uint32_t value)
+{
+    put_uint16(&buffer[0], value & 0xFFFF);
+    put_uint16(&buffer[2], value >> 16);
+}
+
+static uint16_t get_uint16(const uint8_t buffer[])
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+static uint32_t get_uint32(const uint8_t buffer[])
+{
+    return get_uint16(&buffer[0]) | ((uint32_t)get_uint16(&buffer[2]) << 16);
+}
+
+void encode_bot_status(const BotStatus &status, uint8_t buffer[])
+{
+    buffer[0] = BOT_STATUS_VERSION;
+    buffer[1] = status.flags;
+    put_uint16(&buffer[2], status.sequence);
+    put_uint16(&buffer[4], (uint16_t)status.motor1_duty);
+    put_uint16(&buffer[6], (uint16_t)status.motor2_duty);
+    put_uint32(&buffer[8], status.command_age_us);
+    put_uint32(&buffer[12], status.overruns);
+    put_uint16(&buffer[16], status.command_timeouts);
+    buffer[18] = (uint8_t)status.rssi;
+}
+
+bool decode_bot_status(const uint8_t buffer[], int length, BotStatus &status)
+{
+    if (buffer == nullptr || length < BOT_STATUS_SIZE) {
+        return false;
+    }
+    if (buffer[0] != BOT_STATUS_VERSION) {
+        return false;
+    }
+
+    status.flags = buffer[1];
+    status.sequence = get_uint16(&buffer[2]);
+    status.motor1_duty = (int16_t)get_uint16(&buffer[4]);
+    status.motor2_duty = (int16_t)get_uint16(&buffer[6]);
+    status.command_age_us = get_uint32(&buffer[8]);
+    status.overruns = get_uint32(&buffer[12]);
+    status.command_timeouts = get_uint16(&buffer[16]);
+    status.rssi = (int8_t)buffer[18];
+    return true;
+}
+
+BotStatusPublisher::BotStatusPublisher(uint16_t interval_ms)
+    : _interval_ms(interval_ms), _last_ms(0), _sequence(0), _published(0)
+{
+}
+
+void BotStatusPublisher::set_interval(uint16_t interval_ms)
+{
+    _interval_ms = interval_ms;
+}
+
+uint16_t BotStatusPublisher::interval() const
+{
+    return _interval_ms;
+}
+
+bool BotStatusPublisher::due(uint32_t now_ms) const
+{
+    return _published == 0 || now_ms - _last_ms >= _interval_ms;
+}
+
+void BotStatusPublisher::publish(BotStatus &status, uint32_t now_ms)
+{
+    status.sequence = _sequence++;
+    _last_ms = now_ms;
+    _published++;
+}
+
+uint32_t BotStatusPublisher::published_count() const
+{
+    return _published;
+}
@@ -0,0 +1,85 @@
+#ifndef BOT_STATUS_H
+#define BOT_STATUS_H
+
+#include <stdint.h>
+
+// The Bot serves its status on a telemetry service of its own and notifies every
+// Controller that subscribed to it, the back-channel to the controller states.
+// This header is shared by the Bot and the Controller.
+
+static const constexpr char *BOT_TELEMETRY_UUID = "e3c5ecbb-5fbe-4706-b97e-38b94acf7dbf";
+static const constexpr char *BOT_STATUS_UUID = "41aba442-b429-418c-9009-ac9e77ce41d4";
+
+/*
+Wire format, version 1, all fields little-endian, fits one notification at the default MTU:
+  byte  0      version
+  byte  1      flag bits, see BOT_STATUS_ARMED and BOT_STATUS_CLOSED_LOOP
+  bytes 2-3    sequence number, incremented for every status sent
+  bytes 4-5    duty applied to motor 1 (left), int16, negative is reverse
+  bytes 6-7    duty applied to motor 2 (right), int16, negative is reverse
+  bytes 8-11   age of the newest drive command on the M4 in microseconds
+  bytes 12-15  control loop overruns since the last statistics reset
+  bytes 16-17  command watchdog timeouts since the last statistics reset
+  byte  18     RSSI of the driving Controller's link in dBm, int8, BOT_STATUS_NO_RSSI if unknown
+  */
+static const constexpr uint8_t BOT_STATUS_VERSION = 1;
+static const constexpr int BOT_STATUS_SIZE = 19;
+
+// the motors may move, a Controller is connected
+static const constexpr uint8_t BOT_STATUS_ARMED = 1 << 0;
+// the wheel speed is controlled from the encoders
+static const constexpr uint8_t BOT_STATUS_CLOSED_LOOP = 1 << 1;
+
+static const constexpr int8_t BOT_STATUS_NO_RSSI = 127;
+
+// 5 statuses a second, a small share of the link next to the controller states
+static const constexpr uint16_t BOT_STATUS_INTERVAL_MS = 200;
+
+struct BotStatus {
+    uint16_t sequence;
+    uint8_t flags;
+    int16_t motor1_duty;
+    int16_t motor2_duty;
+    uint32_t command_age_us;
+    uint32_t overruns;
+    uint16_t command_timeouts;
+    int8_t rssi;
+};
+
+// Packs status into buffer, which must hold BOT_STATUS_SIZE bytes
+void encode_bot_status(const BotStatus &status, uint8_t buffer[]);
+
+// Unpacks a received value into status.
+// Returns false, leaving status untouched, if the value is too short or has another version.
+bool decode_bot_status(const uint8_t buffer[], int length, BotStatus &status);
+
+/*
+Paces the status notifications of the Bot.
+
+Statuses are never queued. Whenever one is due the sketch builds it from the newest
+values it has, so every change in between is coalesced into that one record and
+the latest value wins. At most one status goes out every interval, so the
+back-channel only ever takes a bounded share of the link's airtime.
+  */
+class BotStatusPublisher {
+public:
+    BotStatusPublisher(uint16_t interval_ms = BOT_STATUS_INTERVAL_MS);
+
+    void set_interval(uint16_t interval_ms);
+    uint16_t interval() const;
+
+    // whether the next status may be sent at now_ms
+    bool due(uint32_t now_ms) const;
+    // stamps status with the next sequence number and starts the next interval, call right before sending it
+    void publish(BotStatus &status, uint32_t now_ms);
+
+    uint32_t published_count() const;
+
+private:
+    uint16_t _interval_ms;
+    uint32_t _last_ms;
+    uint16_t _sequence;
+    uint32_t _published;
+};
+
+#endif
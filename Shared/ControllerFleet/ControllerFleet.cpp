@@ -0,0 +1,350 @@
+#include "ControllerFleet.h"
+
+#include <string.h>
+
+ControllerFleet *ControllerFleet::_active = nullptr;
+
+ControllerFleet::ControllerFleet()
+    : _priority_count(0),
+      _policy(FLEET_HIGHEST_PRIORITY),
+      _state_handler(nullptr),
+      _connect_handler(nullptr),
+      _disconnect_handler(nullptr),
+      _scanning(false),
+      _connections(0),
+      _reconnect_count(0)
+{
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        _slots[i].connected = false;
+        _slots[i].priority = FLEET_DEFAULT_PRIORITY;
+        _slots[i].connection_order = 0;
+        _slots[i].received_us = 0;
+        _slots[i].has_state = false;
+        _slots[i].fresh = false;
+        _slots[i].coalesced = 0;
+    }
+}
+
+bool ControllerFleet::begin()
+{
+    _active = this;
+    return start_scan();
+}
+
+void ControllerFleet::poll(unsigned long timeout_ms)
+{
+    BLE.poll(timeout_ms);
+    check_links();
+
+    if (free_slot() < 0) {
+        stop_scan();
+        return;
+    }
+    if (reconnect()) {
+        return;
+    }
+    if (!_scanning) {
+        start_scan();
+        return;
+    }
+
+    BLEDevice found = BLE.available();
+    if (!found || find_slot(found) >= 0) {
+        return;
+    }
+
+    // the radio cannot scan and initiate at the same time
+    stop_scan();
+    connect(found);
+}
+
+void ControllerFleet::set_policy(FleetPolicy policy)
+{
+    _policy = policy;
+}
+
+FleetPolicy ControllerFleet::policy() const
+{
+    return _policy;
+}
+
+bool ControllerFleet::set_priority(const char *address, uint8_t priority)
+{
+    if (strlen(address) >= sizeof(_priorities[0].address)) {
+        return false;
+    }
+
+    for (int i = 0; i < _priority_count; i++) {
+        if (String(_priorities[i].address).equalsIgnoreCase(address)) {
+            _priorities[i].priority = priority;
+            return true;
+        }
+    }
+
+    if (_priority_count == FLEET_MAX_PRIORITIES) {
+        return false;
+    }
+    strcpy(_priorities[_priority_count].address, address);
+    _priorities[_priority_count].priority = priority;
+    _priority_count++;
+    return true;
+}
+
+void ControllerFleet::set_state_handler(StateHandler handler)
+{
+    _state_handler = handler;
+}
+
+void ControllerFleet::set_connect_handler(LinkHandler handler)
+{
+    _connect_handler = handler;
+}
+
+void ControllerFleet::set_disconnect_handler(LinkHandler handler)
+{
+    _disconnect_handler = handler;
+}
+
+int ControllerFleet::connected() const
+{
+    int count = 0;
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        if (_slots[i].connected) {
+            count++;
+        }
+    }
+    return count;
+}
+
+const ControllerSlot &ControllerFleet::slot(int index) const
+{
+    return _slots[index];
+}
+
+int ControllerFleet::driver() const
+{
+    if (_policy != FLEET_HIGHEST_PRIORITY) {
+        return -1;
+    }
+
+    int best = -1;
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        const ControllerSlot &candidate = _slots[i];
+        if (!candidate.connected) {
+            continue;
+        }
+        if (best < 0 || candidate.priority > _slots[best].priority ||
+            (candidate.priority == _slots[best].priority && candidate.connection_order < _slots[best].connection_order)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool ControllerFleet::drives(int index) const
+{
+    if (index < 0 || index >= FLEET_MAX_CONTROLLERS || !_slots[index].connected) {
+        return false;
+    }
+    if (_policy == FLEET_CHANNEL_PER_CONTROLLER) {
+        return true;
+    }
+    return driver() == index;
+}
+
+bool ControllerFleet::take(int index, ControllerState &state, uint32_t &received_us)
+{
+    ControllerSlot &slot = _slots[index];
+    if (!slot.fresh) {
+        return false;
+    }
+    state = slot.state;
+    received_us = slot.received_us;
+    slot.fresh = false;
+    return true;
+}
+
+uint32_t ControllerFleet::coalesced() const
+{
+    uint32_t total = 0;
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        total += _slots[i].coalesced;
+    }
+    return total;
+}
+
+void ControllerFleet::reset_coalesced()
+{
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        _slots[i].coalesced = 0;
+    }
+}
+
+bool ControllerFleet::start_scan()
+{
+    _scanning = BLE.scanForUuid(CONTROLLER_UUID);
+    return _scanning;
+}
+
+void ControllerFleet::stop_scan()
+{
+    if (_scanning) {
+        BLE.stopScan();
+        _scanning = false;
+    }
+}
+
+int ControllerFleet::free_slot() const
+{
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        if (!_slots[i].connected) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ControllerFleet::find_slot(const BLEDevice &device) const
+{
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        if (_slots[i].connected && _slots[i].device == device) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t ControllerFleet::priority_of(const String &address) const
+{
+    for (int i = 0; i < _priority_count; i++) {
+        if (address.equalsIgnoreCase(_priorities[i].address)) {
+            return _priorities[i].priority;
+        }
+    }
+    return FLEET_DEFAULT_PRIORITY;
+}
+
+void ControllerFleet::check_links()
+{
+    for (int i = 0; i < FLEET_MAX_CONTROLLERS; i++) {
+        if (_slots[i].connected && !_slots[i].device.connected()) {
+            release(i);
+        }
+    }
+}
+
+bool ControllerFleet::connect(BLEDevice device)
+{
+    int index = free_slot();
+    if (index < 0 || !device.connect()) {
+        return false;
+    }
+    return set_up(index, device);
+}
+
+// takes the next dropped Controller off the list and connects to it directly, false if there was none
+bool ControllerFleet::reconnect()
+{
+#ifdef ARDUINO_BLE_CONNECT_KNOWN
+    if (_reconnect_count == 0) {
+        return false;
+    }
+
+    char address[sizeof(_reconnects[0])];
+    strcpy(address, _reconnects[0]);
+    _reconnect_count--;
+    memmove(_reconnects[0], _reconnects[1], _reconnect_count * sizeof(_reconnects[0]));
+
+    stop_scan();
+    BLEDevice device = BLE.connectKnown(address);
+    if (device && find_slot(device) < 0) {
+        set_up(free_slot(), device);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ControllerFleet::set_up(int index, BLEDevice device)
+{
+    if (!device.discoverAttributes()) {
+        device.disconnect();
+        return false;
+    }
+
+    // the Controller packs all of its inputs into one characteristic
+    BLECharacteristic characteristic = device.characteristic(CONTROLLER_STATE_UUID);
+    if (!characteristic || !characteristic.canSubscribe()) {
+        device.disconnect();
+        return false;
+    }
+
+    ControllerSlot &slot = _slots[index];
+    slot.device = device;
+    slot.priority = priority_of(device.address());
+    slot.connection_order = ++_connections;
+    slot.has_state = false;
+    slot.fresh = false;
+    slot.connected = true;
+
+    if (_connect_handler) {
+        _connect_handler(index, device);
+    }
+
+    characteristic.setEventHandler(BLEUpdated, state_updated);
+    if (!characteristic.subscribe()) {
+        device.disconnect();
+        release(index);
+        return false;
+    }
+    return true;
+}
+
+void ControllerFleet::release(int index)
+{
+    ControllerSlot &slot = _slots[index];
+    slot.connected = false;
+    slot.fresh = false;
+
+    String address = slot.device.address();
+    bool listed = false;
+    for (int i = 0; i < _reconnect_count; i++) {
+        listed = listed || address.equalsIgnoreCase(_reconnects[i]);
+    }
+    if (!listed && _reconnect_count < FLEET_MAX_CONTROLLERS && address.length() < sizeof(_reconnects[0])) {
+        strcpy(_reconnects[_reconnect_count++], address.c_str());
+    }
+
+    if (_disconnect_handler) {
+        _disconnect_handler(index, slot.device);
+    }
+}
+
+void ControllerFleet::state_updated(BLEDevice device, BLECharacteristic characteristic)
+{
+    uint32_t received_us = micros();
+    ControllerFleet *fleet = _active;
+    if (!fleet) {
+        return;
+    }
+
+    int index = fleet->find_slot(device);
+    ControllerState state;
+    if (index < 0 || !decode_controller_state(characteristic.value(), characteristic.valueLength(), state)) {
+        return;
+    }
+
+    ControllerSlot &slot = fleet->_slots[index];
+    if (slot.fresh) {
+        slot.coalesced++;
+    }
+    slot.state = state;
+    slot.received_us = received_us;
+    slot.has_state = true;
+    slot.fresh = true;
+
+    if (fleet->_state_handler) {
+        fleet->_state_handler(index, state, received_us);
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef CONTROLLER_FLEET_H
+#define CONTROLLER_FLEET_H
+
+#include <stdint.h>
+#include <ArduinoBLE.h>
+#include <ControllerState.h>
+
+/*
+Keeps several Controllers connected to one central at the same time.
+
+The fleet scans for CONTROLLER_UUID while it has a free slot, connects every
+Controller it finds and subscribes to its state characteristic. Notifications of
+all links are decoded into the slot of the Controller that sent them, so the
+sketch only has to call poll() from its loop and never blocks on one link.
+
+Only the link setup (connect and attribute discovery) waits for the peer, the
+ArduinoBLE API has no asynchronous form of it. The notifications of the links
+already up keep being dispatched while it waits.
+
+A Controller whose link dropped is reconnected without scanning when the
+library has BLE.connectKnown(): its address goes into the radio's filter accept
+list and the radio connects on its first advert. If it does not come back within
+the connect timeout it is found by scanning again like any other Controller.
+
+Which Controller gets to drive is a policy:
+- FLEET_HIGHEST_PRIORITY: one slot drives, the one with the highest priority,
+  ties go to the Controller that connected first
+- FLEET_CHANNEL_PER_CONTROLLER: every slot drives its own output channel,
+  the channel is the slot index
+  */
+static const constexpr int FLEET_MAX_CONTROLLERS = 3;
+
+enum FleetPolicy {
+    FLEET_HIGHEST_PRIORITY,
+    FLEET_CHANNEL_PER_CONTROLLER
+};
+
+// addresses without an entry in the priority table get this priority
+static const constexpr uint8_t FLEET_DEFAULT_PRIORITY = 0;
+static const constexpr int FLEET_MAX_PRIORITIES = 8;
+
+struct ControllerSlot {
+    bool connected;
+    BLEDevice device;
+    uint8_t priority;
+    // increases with every connection, orders Controllers of equal priority
+    uint32_t connection_order;
+
+    // newest state, not yet taken if fresh is set
+    ControllerState state;
+    uint32_t received_us;
+    bool has_state;
+    bool fresh;
+    // states replaced by a newer one before they were taken
+    uint32_t coalesced;
+};
+
+class ControllerFleet {
+public:
+    // called for every decoded state from inside BLE polling, before take() sees it
+    typedef void (*StateHandler)(int slot, const ControllerState &state, uint32_t received_us);
+    // called once a slot is set up and before its first state can arrive, and when its link is gone
+    typedef void (*LinkHandler)(int slot, BLEDevice device);
+
+    ControllerFleet();
+
+    // starts scanning, false if the radio refused
+    bool begin();
+
+    /*
+    Dispatches bluetooth events for up to timeout_ms, frees the slots of dropped
+    links and connects at most one newly found Controller.
+    */
+    void poll(unsigned long timeout_ms);
+
+    void set_policy(FleetPolicy policy);
+    FleetPolicy policy() const;
+
+    // address as printed by BLEDevice::address(), applies from the next connection of that Controller
+    bool set_priority(const char *address, uint8_t priority);
+
+    void set_state_handler(StateHandler handler);
+    void set_connect_handler(LinkHandler handler);
+    void set_disconnect_handler(LinkHandler handler);
+
+    int connected() const;
+    const ControllerSlot &slot(int index) const;
+
+    // the slot whose states drive, -1 if none is connected or every slot has its own channel
+    int driver() const;
+    // whether the states of the slot are to be applied under the current policy
+    bool drives(int index) const;
+
+    // copies the newest state of the slot if it arrived since the last take, latest value wins
+    bool take(int index, ControllerState &state, uint32_t &received_us);
+    uint32_t coalesced() const;
+    void reset_coalesced();
+
+private:
+    struct PriorityEntry {
+        char address[18];
+        uint8_t priority;
+    };
+
+    bool start_scan();
+    void stop_scan();
+    int free_slot() const;
+    int find_slot(const BLEDevice &device) const;
+    uint8_t priority_of(const String &address) const;
+    void check_links();
+    bool connect(BLEDevice device);
+    bool set_up(int index, BLEDevice device);
+    void release(int index);
+    bool reconnect();
+
+    static void state_updated(BLEDevice device, BLECharacteristic characteristic);
+
+    ControllerSlot _slots[FLEET_MAX_CONTROLLERS];
+    PriorityEntry _priorities[FLEET_MAX_PRIORITIES];
+    int _priority_count;
+
+    FleetPolicy _policy;
+    StateHandler _state_handler;
+    LinkHandler _connect_handler;
+    LinkHandler _disconnect_handler;
+    bool _scanning;
+    uint32_t _connections;
+
+    // addresses of Controllers whose link dropped, tried once with BLE.connectKnown()
+    char _reconnects[FLEET_MAX_CONTROLLERS][18];
+    int _reconnect_count;
+
+    // the notification handler has no context argument, there is one fleet per sketch
+    static ControllerFleet *_active;
+};
+
+#endif
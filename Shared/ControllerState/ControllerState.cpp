@@ -0,0 +1,84 @@
+#include "ControllerState.h"
+
+static void put_uint16(uint8_t buffer[], uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static void put_uint32(uint8_t buffer[], uint32_t value)
+{
+    put_uint16(&buffer[0], value & 0xFFFF);
+    put_uint16(&buffer[2], value >> 16);
+}
+
+static uint16_t get_uint16(const uint8_t buffer[])
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+static uint32_t get_uint32(const uint8_t buffer[])
+{
+    return get_uint16(&buffer[0]) | ((uint32_t)get_uint16(&buffer[2]) << 16);
+}
+
+void encode_controller_state(const ControllerState &state, uint8_t buffer[])
+{
+    buffer[0] = CONTROLLER_STATE_VERSION;
+    buffer[1] = state.buttons;
+    put_uint16(&buffer[2], state.sequence);
+    put_uint32(&buffer[4], state.timestamp_us);
+    put_uint16(&buffer[8], state.thumb_stick_x_axis);
+    put_uint16(&buffer[10], state.thumb_stick_y_axis);
+}
+
+bool decode_controller_state(const uint8_t buffer[], int length, ControllerState &state)
+{
+    if (buffer == nullptr || length < CONTROLLER_STATE_SIZE) {
+        return false;
+    }
+    if (buffer[0] != CONTROLLER_STATE_VERSION) {
+        return false;
+    }
+
+    state.buttons = buffer[1];
+    state.sequence = get_uint16(&buffer[2]);
+    state.timestamp_us = get_uint32(&buffer[4]);
+    state.thumb_stick_x_axis = get_uint16(&buffer[8]);
+    state.thumb_stick_y_axis = get_uint16(&buffer[10]);
+    return true;
+}
+
+void encode_publisher_config(const PublisherConfig &config, uint8_t buffer[])
+{
+    put_uint16(&buffer[0], config.axis_deadband);
+    put_uint16(&buffer[2], config.min_interval_ms);
+    put_uint16(&buffer[4], config.active_keepalive_ms);
+    put_uint16(&buffer[6], config.idle_keepalive_ms);
+    put_uint16(&buffer[8], config.idle_after_ms);
+}
+
+bool decode_publisher_config(const uint8_t buffer[], int length, PublisherConfig &config)
+{
+    if (buffer == nullptr || length < PUBLISHER_CONFIG_SIZE) {
+        return false;
+    }
+
+    PublisherConfig decoded;
+    decoded.axis_deadband = get_uint16(&buffer[0]);
+    decoded.min_interval_ms = get_uint16(&buffer[2]);
+    decoded.active_keepalive_ms = get_uint16(&buffer[4]);
+    decoded.idle_keepalive_ms = get_uint16(&buffer[6]);
+    decoded.idle_after_ms = get_uint16(&buffer[8]);
+
+    if (decoded.active_keepalive_ms == 0 || decoded.active_keepalive_ms > PUBLISHER_KEEPALIVE_MAX_MS
+        || decoded.idle_keepalive_ms == 0 || decoded.idle_keepalive_ms > PUBLISHER_KEEPALIVE_MAX_MS) {
+        return false;
+    }
+    if (decoded.min_interval_ms > decoded.active_keepalive_ms || decoded.axis_deadband > PUBLISHER_AXIS_DEADBAND_MAX) {
+        return false;
+    }
+
+    config = decoded;
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef CONTROLLER_STATE_H
+#define CONTROLLER_STATE_H
+
+#include <stdint.h>
+
+// The controller publishes every input sample as one packed ControllerState value
+// on a single characteristic, so each sample costs one notification on the link.
+// This header is shared by the Controller, the Receiver and the Bot.
+
+static const constexpr char *CONTROLLER_NAME = "DUCKS_Controller";
+static const constexpr char *CONTROLLER_UUID = "547b5676-0377-480f-b6f8-2a94873c07ec";
+static const constexpr char *CONTROLLER_STATE_UUID = "8552bd29-15d5-4fbb-bbbc-bc27a3bdda88";
+static const constexpr char *PUBLISHER_CONFIG_UUID = "9df32bfe-3a82-44a5-ae6a-df57184946df";
+
+/*
+Wire format, version 1, all fields little-endian:
+  byte  0      version
+  byte  1      button bits, a set bit means the button is pressed
+  bytes 2-3    sequence number, incremented for every sample
+  bytes 4-7    sender timestamp in microseconds (micros() on the controller)
+  bytes 8-9    thumb stick x axis, 12-bit ADC value
+  bytes 10-11  thumb stick y axis, 12-bit ADC value
+  */
+static const constexpr uint8_t CONTROLLER_STATE_VERSION = 1;
+static const constexpr int CONTROLLER_STATE_SIZE = 12;
+
+static const constexpr uint8_t THUMB_STICK_BUTTON_BIT = 1 << 0;
+static const constexpr uint8_t YELLOW_BUTTON_BIT = 1 << 1;
+static const constexpr uint8_t RED_BUTTON_BIT = 1 << 2;
+static const constexpr uint8_t GREEN_BUTTON_BIT = 1 << 3;
+static const constexpr uint8_t BLUE_BUTTON_BIT = 1 << 4;
+
+static const constexpr uint16_t JOYSTICK_MIN = 0;
+static const constexpr uint16_t JOYSTICK_MAX = 0xFFF;
+static const constexpr uint16_t JOYSTICK_MIDDLE = JOYSTICK_MAX / 2;
+
+struct ControllerState {
+    uint16_t sequence;
+    uint32_t timestamp_us;
+    uint16_t thumb_stick_x_axis;
+    uint16_t thumb_stick_y_axis;
+    uint8_t buttons;
+};
+
+// Packs state into buffer, which must hold CONTROLLER_STATE_SIZE bytes
+void encode_controller_state(const ControllerState &state, uint8_t buffer[]);
+
+// Unpacks a received value into state.
+// Returns false, leaving state untouched, if the value is too short or has another version.
+bool decode_controller_state(const uint8_t buffer[], int length, ControllerState &state);
+
+/*
+Publishing cadence of the controller, writable by the central at runtime.
+Wire format, all fields uint16_t little-endian:
+  bytes 0-1  axis_deadband       ADC counts an axis must move before it is sent again
+  bytes 2-3  min_interval_ms     shortest gap between samples sent for axis changes
+  bytes 4-5  active_keepalive_ms resend interval while the stick is in use
+  bytes 6-7  idle_keepalive_ms   resend interval once the stick has been left alone
+  bytes 8-9  idle_after_ms       time without a change before the controller counts as idle
+
+Both keep-alives must be 1 up to PUBLISHER_KEEPALIVE_MAX_MS, below the Bot's
+250 ms command timeout with room for a late connection event, so the Bot never
+stops a controller that is still there.
+min_interval_ms may not exceed active_keepalive_ms, and axis_deadband is at most
+PUBLISHER_AXIS_DEADBAND_MAX, an eighth of the stick travel.
+  */
+static const constexpr int PUBLISHER_CONFIG_SIZE = 10;
+static const constexpr uint16_t PUBLISHER_KEEPALIVE_MAX_MS = 200;
+static const constexpr uint16_t PUBLISHER_AXIS_DEADBAND_MAX = (JOYSTICK_MAX + 1) / 8;
+
+struct PublisherConfig {
+    uint16_t axis_deadband;
+    uint16_t min_interval_ms;
+    uint16_t active_keepalive_ms;
+    uint16_t idle_keepalive_ms;
+    uint16_t idle_after_ms;
+};
+
+void encode_publisher_config(const PublisherConfig &config, uint8_t buffer[]);
+
+// Returns false, leaving config untouched, if the value is too short or a field is out of range
+bool decode_publisher_config(const uint8_t buffer[], int length, PublisherConfig &config);
+
+inline bool button_pressed(const ControllerState &state, uint8_t button_bit)
+{
+    return (state.buttons & button_bit) != 0;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include "LatencyStats.h"
+
+static int highest_bit(uint32_t value)
+{
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        _counts[i] = 0;
+    }
+    _count = 0;
+    _min = UINT32_MAX;
+    _max = 0;
+}
+
+int LatencyHistogram::bucket(uint32_t value_us)
+{
+    if (value_us < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return value_us;
+    }
+
+    int msb = highest_bit(value_us);
+    int sub = (value_us >> (msb - LATENCY_HISTOGRAM_SUB_BITS)) & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+    return (msb - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+uint32_t LatencyHistogram::bucket_lower(int bucket)
+{
+    if (bucket < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    int msb = bucket / LATENCY_HISTOGRAM_SUB_BUCKETS + LATENCY_HISTOGRAM_SUB_BITS - 1;
+    uint32_t sub = bucket % LATENCY_HISTOGRAM_SUB_BUCKETS;
+    return (LATENCY_HISTOGRAM_SUB_BUCKETS + sub) << (msb - LATENCY_HISTOGRAM_SUB_BITS);
+}
+
+uint32_t LatencyHistogram::bucket_upper(int bucket)
+{
+    if (bucket >= LATENCY_HISTOGRAM_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    return bucket_lower(bucket + 1) - 1;
+}
+
+uint32_t LatencyHistogram::bucket_count(int bucket) const
+{
+    return _counts[bucket];
+}
+
+void LatencyHistogram::record(uint32_t value_us)
+{
+    _counts[bucket(value_us)]++;
+    _count++;
+    if (value_us < _min) {
+        _min = value_us;
+    }
+    if (value_us > _max) {
+        _max = value_us;
+    }
+}
+
+uint32_t LatencyHistogram::count() const
+{
+    return _count;
+}
+
+uint32_t LatencyHistogram::min() const
+{
+    return _count == 0 ? 0 : _min;
+}
+
+uint32_t LatencyHistogram::max() const
+{
+    return _max;
+}
+
+uint32_t LatencyHistogram::percentile(uint8_t percent) const
+{
+    uint32_t count = _count;
+    if (count == 0) {
+        return 0;
+    }
+
+    // rank of the wanted value, rounded up, at least the first one
+    uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += _counts[i];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper(i);
+            return upper < _max ? upper : _max;
+        }
+    }
+    return _max;
+}
+
+LinkLatencyTracker::LinkLatencyTracker()
+{
+    reset();
+}
+
+void LinkLatencyTracker::reset()
+{
+    _transit.reset();
+    _gaps.reset();
+    restart();
+
+    _received = 0;
+    _lost = 0;
+    _out_of_order = 0;
+}
+
+void LinkLatencyTracker::restart()
+{
+    _has_previous = false;
+    _previous_sequence = 0;
+    _previous_receive_us = 0;
+
+    _window_samples = 0;
+    _window_min_offset = 0;
+    _previous_window_min_offset = 0;
+}
+
+uint32_t LinkLatencyTracker::on_receive(uint16_t sequence, uint32_t sender_timestamp_us, uint32_t receive_us)
+{
+    // clock offset plus transit time, offsets are compared modulo 2^32
+    uint32_t offset = receive_us - sender_timestamp_us;
+
+    if (!_has_previous) {
+        _window_min_offset = offset;
+        _previous_window_min_offset = offset;
+    } else {
+        uint16_t expected = _previous_sequence + 1;
+        uint16_t skipped = sequence - expected;
+        if (skipped < 0x8000) {
+            _lost += skipped;
+        } else {
+            _out_of_order++;
+        }
+        _gaps.record(receive_us - _previous_receive_us);
+    }
+
+    if (_window_samples == LINK_LATENCY_WINDOW) {
+        _previous_window_min_offset = _window_min_offset;
+        _window_min_offset = offset;
+        _window_samples = 0;
+    }
+    if ((int32_t)(offset - _window_min_offset) < 0) {
+        _window_min_offset = offset;
+    }
+    _window_samples++;
+
+    uint32_t baseline = _window_min_offset;
+    if ((int32_t)(_previous_window_min_offset - baseline) < 0) {
+        baseline = _previous_window_min_offset;
+    }
+    uint32_t transit = offset - baseline;
+    _transit.record(transit);
+
+    _has_previous = true;
+    _previous_sequence = sequence;
+    _previous_receive_us = receive_us;
+    _received++;
+    return transit;
+}
+
+const LatencyHistogram &LinkLatencyTracker::transit() const
+{
+    return _transit;
+}
+
+const LatencyHistogram &LinkLatencyTracker::gaps() const
+{
+    return _gaps;
+}
+
+uint32_t LinkLatencyTracker::received() const
+{
+    return _received;
+}
+
+uint32_t LinkLatencyTracker::lost() const
+{
+    return _lost;
+}
+
+uint32_t LinkLatencyTracker::out_of_order() const
+{
+    return _out_of_order;
+}
@@ -0,0 +1,144 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+// Characters sent over Serial to dump or clear the latency statistics of a sketch
+static const constexpr char LATENCY_DUMP_COMMAND = 'l';
+static const constexpr char LATENCY_RESET_COMMAND = 'r';
+
+/*
+Fixed size histogram of microsecond durations, safe to fill from a time critical path.
+
+Values below 8 us get a bucket each. Above that every power of two is split into
+8 buckets, so a bucket is at most 12.5% wide and the whole uint32_t range fits
+into LATENCY_HISTOGRAM_BUCKETS buckets. Percentiles are reported as the upper
+edge of the bucket they fall into, never above the largest recorded value.
+  */
+static const constexpr int LATENCY_HISTOGRAM_SUB_BITS = 3;
+static const constexpr int LATENCY_HISTOGRAM_SUB_BUCKETS = 1 << LATENCY_HISTOGRAM_SUB_BITS;
+static const constexpr int LATENCY_HISTOGRAM_BUCKETS = (32 - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint32_t value_us);
+    void reset();
+
+    uint32_t count() const;
+    uint32_t min() const;
+    uint32_t max() const;
+    // percent from 0 to 100, 0 when nothing was recorded
+    uint32_t percentile(uint8_t percent) const;
+
+    static int bucket(uint32_t value_us);
+    static uint32_t bucket_lower(int bucket);
+    static uint32_t bucket_upper(int bucket);
+    uint32_t bucket_count(int bucket) const;
+
+    // prints "name: n=.. min=.. p50=.. p99=.. max=.. us", and every non-empty bucket if distribution is set
+    template <typename Output>
+    void print(Output &output, const char *name, bool distribution = false) const
+    {
+        output.print(name);
+        output.print(": n=");
+        output.print(count());
+        output.print(" min=");
+        output.print(min());
+        output.print(" p50=");
+        output.print(percentile(50));
+        output.print(" p99=");
+        output.print(percentile(99));
+        output.print(" max=");
+        output.print(max());
+        output.println(" us");
+
+        if (!distribution) {
+            return;
+        }
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+            if (_counts[i] == 0) {
+                continue;
+            }
+            output.print("  ");
+            output.print(bucket_lower(i));
+            output.print("-");
+            output.print(bucket_upper(i));
+            output.print(" us: ");
+            output.println(_counts[i]);
+        }
+    }
+
+private:
+    volatile uint32_t _counts[LATENCY_HISTOGRAM_BUCKETS];
+    volatile uint32_t _count;
+    volatile uint32_t _min;
+    volatile uint32_t _max;
+};
+
+/*
+Follows the ControllerState samples arriving over one link.
+
+Controller and receiver clocks are not synchronised, so the one-way transit time
+cannot be measured directly. Instead receive time minus sender timestamp is
+compared with the smallest such difference seen recently, which gives the transit
+time above the fastest delivery (the "relative" transit). The baseline is a
+minimum over the last two windows of LINK_LATENCY_WINDOW samples so that drift
+between the two clocks does not pile up.
+
+Also keeps the distribution of gaps between arriving samples and counts samples
+that were lost or arrived out of order, based on the sequence number.
+  */
+static const constexpr uint32_t LINK_LATENCY_WINDOW = 512;
+
+class LinkLatencyTracker {
+public:
+    LinkLatencyTracker();
+
+    void reset();
+    // forgets the previous sample and the clock baseline but keeps the statistics, for a new connection
+    void restart();
+
+    // returns the relative transit time of this sample
+    uint32_t on_receive(uint16_t sequence, uint32_t sender_timestamp_us, uint32_t receive_us);
+
+    const LatencyHistogram &transit() const;
+    const LatencyHistogram &gaps() const;
+
+    uint32_t received() const;
+    uint32_t lost() const;
+    uint32_t out_of_order() const;
+
+    template <typename Output>
+    void print(Output &output, const char *name) const
+    {
+        output.print(name);
+        output.print(": received ");
+        output.print(received());
+        output.print(", lost ");
+        output.print(lost());
+        output.print(", out of order ");
+        output.println(out_of_order());
+        _transit.print(output, "  transit above fastest");
+        _gaps.print(output, "  packet gap", true);
+    }
+
+private:
+    LatencyHistogram _transit;
+    LatencyHistogram _gaps;
+
+    bool _has_previous;
+    uint16_t _previous_sequence;
+    uint32_t _previous_receive_us;
+
+    uint32_t _window_samples;
+    uint32_t _window_min_offset;
+    uint32_t _previous_window_min_offset;
+
+    uint32_t _received;
+    uint32_t _lost;
+    uint32_t _out_of_order;
+};
+
+#endif
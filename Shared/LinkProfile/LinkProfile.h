@@ -0,0 +1,37 @@
+#ifndef LINK_PROFILE_H
+#define LINK_PROFILE_H
+
+#include <stdint.h>
+
+/*
+Connection parameters for the "realtime" link between the controller and whoever drives from it.
+Units are the ones used by the Bluetooth spec and ArduinoBLE:
+- connection interval in 1.25 ms steps
+- peripheral (slave) latency in connection events the peripheral may skip
+- supervision timeout in 10 ms steps
+
+7.5 ms is the shortest interval the spec allows. With a latency of 0 the peripheral
+listens on every connection event, so a notification waits at most one interval.
+The supervision timeout is kept short so a dead link is noticed quickly.
+  */
+static const constexpr uint16_t REALTIME_CONNECTION_INTERVAL = 0x0006;  // 7.5 ms
+static const constexpr uint16_t REALTIME_PERIPHERAL_LATENCY = 0;
+static const constexpr uint16_t REALTIME_SUPERVISION_TIMEOUT = 0x0032;  // 500 ms
+
+inline uint32_t connection_interval_us(uint16_t interval)
+{
+    return (uint32_t)interval * 1250;
+}
+
+inline uint32_t supervision_timeout_ms(uint16_t supervision_timeout)
+{
+    return (uint32_t)supervision_timeout * 10;
+}
+
+// true when the granted parameters are at least as fast as the realtime profile
+inline bool is_realtime_link(uint16_t interval, uint16_t latency)
+{
+    return interval != 0 && interval <= REALTIME_CONNECTION_INTERVAL && latency <= REALTIME_PERIPHERAL_LATENCY;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "Telemetry.h"
+
+static void put_uint16(uint8_t buffer[], uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static void put_uint32(uint8_t buffer[], uint32_t value)
+{
+    put_uint16(&buffer[0], value & 0xFFFF);
+    put_uint16(&buffer[2], value >> 16);
+}
+
+uint8_t telemetry_crc8(const uint8_t data[], size_t length, uint8_t crc)
+{
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+TelemetryLog::TelemetryLog()
+    : _head(0), _tail(0), _unreported_drops(0), _logged(0), _dropped(0)
+{
+}
+
+bool TelemetryLog::write_frame(uint8_t type, const uint8_t payload[], uint8_t length, uint32_t timestamp_us)
+{
+    if (length > TELEMETRY_MAX_PAYLOAD) {
+        return false;
+    }
+
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    uint32_t frame_size = TELEMETRY_HEADER_SIZE + length + 1;
+
+    if (TELEMETRY_BUFFER_SIZE - (head - tail) < frame_size) {
+        return false;
+    }
+
+    uint8_t frame[TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + 1];
+    frame[0] = TELEMETRY_SYNC;
+    frame[1] = type;
+    frame[2] = length;
+    put_uint32(&frame[3], timestamp_us);
+    for (uint8_t i = 0; i < length; i++) {
+        frame[TELEMETRY_HEADER_SIZE + i] = payload[i];
+    }
+    frame[frame_size - 1] = telemetry_crc8(&frame[1], frame_size - 2);
+
+    for (uint32_t i = 0; i < frame_size; i++) {
+        _buffer[(head + i) & (TELEMETRY_BUFFER_SIZE - 1)] = frame[i];
+    }
+
+    _head.store(head + frame_size, std::memory_order_release);
+    return true;
+}
+
+bool TelemetryLog::log(uint8_t type, const uint8_t payload[], uint8_t length, uint32_t timestamp_us)
+{
+    if (_unreported_drops > 0) {
+        uint8_t drops[4];
+        put_uint32(drops, _unreported_drops);
+        if (write_frame(TELEMETRY_DROPPED, drops, sizeof(drops), timestamp_us)) {
+            _unreported_drops = 0;
+        }
+    }
+
+    if (_unreported_drops > 0 || !write_frame(type, payload, length, timestamp_us)) {
+        _unreported_drops++;
+        _dropped++;
+        return false;
+    }
+
+    _logged++;
+    return true;
+}
+
+bool TelemetryLog::log_controller_state(const ControllerState &state, uint32_t timestamp_us)
+{
+    uint8_t payload[CONTROLLER_STATE_SIZE];
+    encode_controller_state(state, payload);
+    return log(TELEMETRY_CONTROLLER_STATE, payload, sizeof(payload), timestamp_us);
+}
+
+bool TelemetryLog::log_channel_state(uint8_t channel, const ControllerState &state, uint32_t timestamp_us)
+{
+    uint8_t payload[1 + CONTROLLER_STATE_SIZE];
+    payload[0] = channel;
+    encode_controller_state(state, &payload[1]);
+    return log(TELEMETRY_CHANNEL_STATE, payload, sizeof(payload), timestamp_us);
+}
+
+bool TelemetryLog::log_raw_inputs(uint16_t x_axis, uint16_t y_axis, uint8_t buttons, uint32_t timestamp_us)
+{
+    uint8_t payload[5];
+    put_uint16(&payload[0], x_axis);
+    put_uint16(&payload[2], y_axis);
+    payload[4] = buttons;
+    return log(TELEMETRY_RAW_INPUTS, payload, sizeof(payload), timestamp_us);
+}
+
+size_t TelemetryLog::pending() const
+{
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+uint32_t TelemetryLog::logged() const
+{
+    return _logged;
+}
+
+uint32_t TelemetryLog::dropped() const
+{
+    return _dropped;
+}
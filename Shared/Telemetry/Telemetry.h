@@ -0,0 +1,107 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <ControllerState.h>
+
+/*
+Binary telemetry records, decoded on the host by tools/telemetry_decode.py.
+
+Frame layout, multi-byte fields little-endian:
+  byte  0      TELEMETRY_SYNC
+  byte  1      record type, see below
+  byte  2      payload length
+  bytes 3-6    timestamp in microseconds (micros() of the sender)
+  bytes 7-..   payload
+  last byte    CRC-8 (polynomial 0x07) over bytes 1 up to the end of the payload
+
+The sync byte is not printable, so records and ordinary Serial.println text can
+share one port and the decoder can resynchronise after garbage.
+  */
+static const constexpr uint8_t TELEMETRY_SYNC = 0xA5;
+static const constexpr int TELEMETRY_HEADER_SIZE = 7;
+static const constexpr int TELEMETRY_MAX_PAYLOAD = 32;
+
+// payload: encode_controller_state()
+static const constexpr uint8_t TELEMETRY_CONTROLLER_STATE = 0x01;
+// payload: x axis uint16_t, y axis uint16_t, buttons uint8_t (raw pin reads, a set bit is a pressed button)
+static const constexpr uint8_t TELEMETRY_RAW_INPUTS = 0x02;
+// payload: channel uint8_t (the fleet slot of the sending controller), then encode_controller_state()
+static const constexpr uint8_t TELEMETRY_CHANNEL_STATE = 0x03;
+// payload: encode_bot_status(), as notified by the Bot
+static const constexpr uint8_t TELEMETRY_BOT_STATUS = 0x04;
+// payload: uint32_t records dropped since the last TELEMETRY_DROPPED record
+static const constexpr uint8_t TELEMETRY_DROPPED = 0x7F;
+
+// must be a power of two
+static const constexpr uint32_t TELEMETRY_BUFFER_SIZE = 1024;
+
+uint8_t telemetry_crc8(const uint8_t data[], size_t length, uint8_t crc = 0);
+
+/*
+Lock-free single-producer / single-consumer ring of telemetry frames.
+
+The producer side (log calls) never blocks: a frame that does not fit is dropped
+and counted, and a TELEMETRY_DROPPED record is written once there is room again.
+The consumer side hands out at most the number of bytes the output can take right
+now, so draining never waits on the UART either.
+  */
+class TelemetryLog {
+public:
+    TelemetryLog();
+
+    // producer side, false if the record was dropped
+    bool log(uint8_t type, const uint8_t payload[], uint8_t length, uint32_t timestamp_us);
+    bool log_controller_state(const ControllerState &state, uint32_t timestamp_us);
+    bool log_channel_state(uint8_t channel, const ControllerState &state, uint32_t timestamp_us);
+    bool log_raw_inputs(uint16_t x_axis, uint16_t y_axis, uint8_t buttons, uint32_t timestamp_us);
+
+    // consumer side, writes at most budget bytes to output and returns how many were written
+    template <typename Output>
+    size_t drain(Output &output, size_t budget)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+
+        size_t length = head - tail;
+        if (length > budget) {
+            length = budget;
+        }
+
+        size_t written = 0;
+        while (written < length) {
+            uint32_t index = (tail + written) & (TELEMETRY_BUFFER_SIZE - 1);
+            size_t chunk = TELEMETRY_BUFFER_SIZE - index;
+            if (chunk > length - written) {
+                chunk = length - written;
+            }
+            output.write(&_buffer[index], chunk);
+            written += chunk;
+        }
+
+        _tail.store(tail + written, std::memory_order_release);
+        return written;
+    }
+
+    // bytes waiting to be drained
+    size_t pending() const;
+
+    uint32_t logged() const;
+    uint32_t dropped() const;
+
+private:
+    bool write_frame(uint8_t type, const uint8_t payload[], uint8_t length, uint32_t timestamp_us);
+
+    uint8_t _buffer[TELEMETRY_BUFFER_SIZE];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+
+    // only touched by the producer
+    uint32_t _unreported_drops;
+    volatile uint32_t _logged;
+    volatile uint32_t _dropped;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <SimSystem.h>
+#include <ControllerState.h>
+
+/*
+ * Deterministic controller -> bot benchmark on the simulated system.
+ *
+ * For every link configuration of the sweep:
+ * - latency: the stick is pushed at a random moment and the time until the M4 first
+ *   writes a motor PWM is taken, then the stick is released and the motors come to
+ *   a stop before the next push
+ * - throughput: the stick is moved every millisecond for a while and the ACL packets
+ *   the radio delivers are counted
+ *
+ * The same seed always gives the same numbers.
+ *
+ * usage: benchmark [trials] [seed]
+ */
+
+struct SweepPoint {
+  uint64_t intervalNs;
+  double eventLoss;
+  uint64_t jitterNs;
+};
+
+static const uint64_t SETTLE_NS = 6000 * SIM_NS_PER_MS;
+static const uint64_t PUSH_TIMEOUT_NS = 1000 * SIM_NS_PER_MS;
+static const uint64_t STOP_TIMEOUT_NS = 2000 * SIM_NS_PER_MS;
+static const uint64_t THROUGHPUT_WINDOW_NS = 2000 * SIM_NS_PER_MS;
+
+static const int MOTOR_PINS[] = { 4, 5, 6, 7 };
+
+static double percentile(std::vector<uint64_t> sorted, double share){
+  if (sorted.empty()){
+    return 0.0;
+  }
+  size_t index = (size_t)(share * (sorted.size() - 1) + 0.5);
+  return sorted[index] / 1e6;
+}
+
+static void runPoint(const SweepPoint &point, int trials, uint64_t seed){
+  SimSystemConfig config;
+  config.seed = seed;
+  config.link.intervalNs = point.intervalNs;
+  config.link.eventLoss = point.eventLoss;
+  config.link.jitterNs = point.jitterNs;
+  SimSystem system(config);
+  Simulator &simulator = system.simulator();
+
+  uint64_t firstPwmNs = 0;
+  simulator.onOutput([&](int board, int pin, int value, uint64_t ns) {
+    if (board != system.botM4() || value == 0 || firstPwmNs){
+      return;
+    }
+    for (int motorPin : MOTOR_PINS){
+      if (pin == motorPin){
+        firstPwmNs = ns;
+      }
+    }
+  });
+
+  simulator.runUntil(SETTLE_NS);
+
+  std::vector<uint64_t> latencies;
+  int timeouts = 0;
+  std::uniform_int_distribution<uint64_t> phase(0, 20 * SIM_NS_PER_MS);
+
+  for (int trial = 0; trial < trials && system.centralConnected(); trial++){
+    //push at a random point of the connection and sampling cycles
+    simulator.runFor(phase(simulator.random()));
+
+    firstPwmNs = 0;
+    uint64_t pushNs = simulator.now();
+    system.setStick(JOYSTICK_MIDDLE, trial % 2 ? JOYSTICK_MIN : JOYSTICK_MAX);
+    if (system.runUntil([&]() { return firstPwmNs != 0; }, PUSH_TIMEOUT_NS, 50 * SIM_NS_PER_US)){
+      latencies.push_back(firstPwmNs - pushNs);
+    } else {
+      timeouts++;
+    }
+
+    system.centerStick();
+    system.runUntil([&]() { return system.motor1() == 0 && system.motor2() == 0; }, STOP_TIMEOUT_NS);
+    simulator.runFor(50 * SIM_NS_PER_MS);
+  }
+
+  //throughput with the stick never at rest
+  system.radio().resetStats();
+  uint64_t start = simulator.now();
+  for (uint64_t t = 0; t < THROUGHPUT_WINDOW_NS; t += SIM_NS_PER_MS){
+    uint16_t x = JOYSTICK_MIDDLE + (uint16_t)((t / SIM_NS_PER_MS) % 512);
+    simulator.at(start + t, [&system, x]() { system.setStick(x, JOYSTICK_MAX); });
+  }
+  simulator.runUntil(start + THROUGHPUT_WINDOW_NS);
+  const SimRadio::Stats &stats = system.radio().stats();
+  double packetsPerSecond = stats.packetsDelivered * 1e9 / THROUGHPUT_WINDOW_NS;
+  double lostShare = stats.connectionEvents ? (double)stats.lostEvents / stats.connectionEvents : 0.0;
+  system.centerStick();
+
+  std::sort(latencies.begin(), latencies.end());
+  printf("%9.2f %6.0f%% %7.2f | %4zu %4d | %7.2f %7.2f %7.2f %7.2f | %8.1f %6.1f%%\n",
+         point.intervalNs / 1e6, point.eventLoss * 100, point.jitterNs / 1e6,
+         latencies.size(), timeouts,
+         percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99),
+         latencies.empty() ? 0.0 : latencies.back() / 1e6,
+         packetsPerSecond, lostShare * 100);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv){
+  int trials = argc > 1 ? atoi(argv[1]) : 20;
+  uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1;
+
+  //interval 0 keeps what the boards negotiated, the 7.5 ms realtime profile
+  const uint64_t intervals[] = { 0, 15 * SIM_NS_PER_MS, 30 * SIM_NS_PER_MS };
+  const double losses[] = { 0.0, 0.1, 0.3 };
+  const uint64_t jitters[] = { 0, 1 * SIM_NS_PER_MS };
+
+  printf("stick push -> first motor PWM, %d trials per point, seed %llu\n", trials, (unsigned long long)seed);
+  printf("interval   loss  jitter |   ok  lost |     p50     p90     p99     max | packets/s events lost\n");
+  printf("    (ms)           (ms) |           |    (ms)    (ms)    (ms)    (ms) |\n");
+
+  for (uint64_t interval : intervals){
+    for (double loss : losses){
+      for (uint64_t jitter : jitters){
+        SweepPoint point = { interval, loss, jitter };
+        runPoint(point, trials, seed);
+      }
+    }
+  }
+  Simulator::exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,81 @@
+#ifndef SIM_NODE_H
+#define SIM_NODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Interface between the simulator and one simulated board.
+ *
+ * Every sketch is built as its own shared module together with ArduinoBLE and the
+ * Arduino shim, so each board gets its own copy of BLE, HCI, ATT and the sketch
+ * globals. The module only exports the two entry points below, everything else it
+ * needs from the outside world (time, pins, serial, the HCI link to its radio)
+ * goes through this table of host functions.
+ *
+ * All times are simulated nanoseconds since the start of the simulation.
+ */
+struct SimHostApi {
+  void *host;
+
+  // time as seen by the calling task, and the board's micros() origin
+  uint64_t (*now)(void *host);
+  uint64_t (*bootTime)(void *host, int node);
+
+  // spends time on the calling task, other tasks may run in between
+  void (*advance)(void *host, uint64_t ns);
+  // blocks the calling task until the given time
+  void (*sleepUntil)(void *host, uint64_t ns);
+
+  // starts another task of the same board, entry runs forever, returns its id
+  int (*spawn)(void *host, int node, void (*entry)(void *), void *arg);
+  // task notification, the FreeRTOS ulTaskNotifyTake / vTaskNotifyGiveFromISR pair
+  uint32_t (*notifyTake)(void *host, uint64_t timeoutNs);
+  void (*notifyGive)(void *host, int task);
+  int (*currentTask)(void *host);
+
+  // calls isr every periodNs, outside of any task
+  void (*startTimer)(void *host, int node, uint64_t periodNs, void (*isr)(void *), void *arg);
+  void (*stopTimers)(void *host, int node);
+  // calls isr outside of any task when the digital input changes as mode asks for,
+  // one of the SIM_PIN_ edges below, a null isr detaches it
+  void (*attachInterrupt)(void *host, int node, int pin, int mode, void (*isr)(void *), void *arg);
+
+  // HCI transport between the board and its simulated bluetooth controller
+  void (*hciWrite)(void *host, int node, const uint8_t *data, size_t length);
+  size_t (*hciAvailable)(void *host, int node);
+  size_t (*hciRead)(void *host, int node, uint8_t *data, size_t length);
+  // blocks until HCI data is available, the task gets a notification or the timeout
+  // passed, takes the task's notifications like ulTaskNotifyTake
+  void (*hciWait)(void *host, int node, uint64_t timeoutNs);
+
+  int (*analogRead)(void *host, int node, int pin);
+  int (*digitalRead)(void *host, int node, int pin);
+  void (*analogWrite)(void *host, int node, int pin, int value);
+  void (*digitalWrite)(void *host, int node, int pin, int value);
+  // counter of a quadrature encoder timer, -1 if the board has no such encoder
+  int (*encoderRead)(void *host, int node, int encoder);
+
+  void (*serialWrite)(void *host, int node, const uint8_t *data, size_t length);
+  int (*serialRead)(void *host, int node);
+  int (*serialAvailable)(void *host, int node);
+};
+
+// pin interrupt edges, the values of Arduino's PinStatus
+enum SimPinEdge {
+  SIM_PIN_CHANGE = 2,
+  SIM_PIN_FALLING = 3,
+  SIM_PIN_RISING = 4,
+};
+
+extern "C" {
+  // hands the module its host table and board id, called once after loading
+  typedef void (*SimNodeAttachFn)(const SimHostApi *api, int node);
+  // runs setup() and then loop() forever, called on the board's first task
+  typedef void (*SimNodeMainFn)(void);
+}
+
+#define SIM_NODE_ATTACH_SYMBOL "simNodeAttach"
+#define SIM_NODE_MAIN_SYMBOL "simNodeMain"
+
+#endif
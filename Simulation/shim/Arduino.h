@@ -0,0 +1,120 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+/*
+ * Arduino core for the simulated boards.
+ *
+ * Built on the ArduinoBLE test shim (extras/test/include/util): String, itoa and the
+ * ArduinoCore-API prototypes in Common.h come from there unchanged. This header adds
+ * what the sketches use on top of it: Serial, the pin aliases, the int overloads of
+ * the core API and, for the Nano ESP32 build (SIM_ESP32), the timer and FreeRTOS
+ * calls the InputSampler relies on. Everything is implemented by SimRuntime.cpp
+ * against the simulator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "String.h"
+#include "Stream.h"
+#include "itoa.h"
+#include "Common.h"
+
+typedef arduino::String String;
+typedef bool boolean;
+
+#undef F
+template <typename T>
+auto F(T &&text) -> const arduino::__FlashStringHelper * {
+  return (const arduino::__FlashStringHelper *)text;
+}
+
+#ifndef PSTR
+#define PSTR(string_literal) (string_literal)
+#endif
+
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+static const uint8_t A6 = 20;
+static const uint8_t A7 = 21;
+
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 13
+#endif
+
+// the int flavours of the ArduinoCore-API calls, as in its Compat.h
+inline void pinMode(pin_size_t pin, int mode){ pinMode(pin, (PinMode)mode); }
+inline void digitalWrite(pin_size_t pin, int value){ digitalWrite(pin, (PinStatus)value); }
+
+// every digital pin can interrupt, attachInterrupt() takes the pin number itself
+#define digitalPinToInterrupt(pin) (pin)
+
+extern "C" void noInterrupts(void);
+extern "C" void interrupts(void);
+
+/*
+ * Serial port of the board, output goes to the simulator.
+ */
+class SimSerial : public Stream {
+public:
+  void begin(unsigned long baud){ (void)baud; }
+  void end() {}
+  operator bool() const { return true; }
+
+  using Print::write;
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int availableForWrite() override;
+
+  int available() override;
+  int read() override;
+  int peek() override;
+};
+
+extern SimSerial Serial;
+
+#if defined(SIM_ESP32)
+/*
+ * Subset of the ESP32 Arduino core 3.x and FreeRTOS used by the controller sketch.
+ * Tasks are simulator tasks, timers fire from the simulator's event queue.
+ */
+#define ESP_ARDUINO_VERSION_MAJOR 3
+#define IRAM_ATTR
+#define ARDUINO_RUNNING_CORE 1
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct SimTask *TaskHandle_t;
+typedef struct SimHardwareTimer hw_timer_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define configMAX_PRIORITIES 25
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffUL
+#define portYIELD_FROM_ISR()
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+hw_timer_t *timerBegin(uint32_t frequency);
+void timerAttachInterrupt(hw_timer_t *timer, void (*isr)(void));
+void timerAlarm(hw_timer_t *timer, uint64_t alarmValue, bool autoreload, uint64_t reloadCount);
+void timerEnd(hw_timer_t *timer);
+#endif
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SIM_SCHEDULER_H
+#define SIM_SCHEDULER_H
+
+#include <Arduino.h>
+
+/*
+ * Scheduler library of the Arduino mbed core, every loop is a simulator task.
+ */
+typedef void (*SchedulerTask)(void);
+
+class SchedulerClass {
+public:
+  void startLoop(SchedulerTask task);
+};
+
+extern SchedulerClass Scheduler;
+
+#endif
@@ -0,0 +1,354 @@
+#include <Arduino.h>
+#include <Scheduler.h>
+#include <RPC.h>
+#include <utility/HCITransport.h>
+#include <SimNode.h>
+#if defined(SIM_GIGA_M4)
+#include <QuadratureEncoder.h>
+#endif
+
+/*
+ * Board side of the simulator: the Arduino core calls, Serial, the Scheduler and
+ * the HCI transport of one simulated board, all forwarded to the host table. The
+ * GIGA M4 build (SIM_GIGA_M4) also gets its encoder timers from there.
+ *
+ * Busy code only moves simulated time forward when it looks at the clock or polls
+ * for data, so every such call is charged a small cost. Without it a loop like
+ * "while (micros() < deadline) {}" would never end.
+ */
+static const uint64_t SIM_CLOCK_READ_NS = 100;
+// a Scheduler switch on the mbed core, also the polling granularity of yield() loops
+static const uint64_t SIM_YIELD_NS = 5000;
+static const uint64_t SIM_HCI_POLL_NS = 2000;
+
+static const SimHostApi *api = nullptr;
+static int node = -1;
+
+extern "C" __attribute__((visibility("default"))) void simNodeAttach(const SimHostApi *hostApi, int nodeId){
+  api = hostApi;
+  node = nodeId;
+}
+
+extern "C" __attribute__((visibility("default"))) void simNodeMain(void){
+  setup();
+  for (;;){
+    loop();
+  }
+}
+
+/*
+ * Time
+ */
+static uint64_t boardNanos(){
+  api->advance(api->host, SIM_CLOCK_READ_NS);
+  return api->now(api->host) - api->bootTime(api->host, node);
+}
+
+unsigned long micros(void){
+  return (unsigned long)(uint32_t)(boardNanos() / 1000);
+}
+
+unsigned long millis(void){
+  return (unsigned long)(uint32_t)(boardNanos() / 1000000);
+}
+
+void delay(unsigned long ms){
+  api->sleepUntil(api->host, api->now(api->host) + (uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us){
+  api->advance(api->host, (uint64_t)us * 1000);
+}
+
+void yield(void){
+  api->advance(api->host, SIM_YIELD_NS);
+}
+
+void noInterrupts(void){
+}
+
+void interrupts(void){
+}
+
+/*
+ * Pins
+ */
+void pinMode(pin_size_t pin, PinMode mode){
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(pin_size_t pin, PinStatus status){
+  api->digitalWrite(api->host, node, pin, status);
+}
+
+PinStatus digitalRead(pin_size_t pin){
+  return api->digitalRead(api->host, node, pin) ? HIGH : LOW;
+}
+
+int analogRead(pin_size_t pin){
+  return api->analogRead(api->host, node, pin);
+}
+
+void analogReference(uint8_t mode){
+  (void)mode;
+}
+
+void analogWrite(pin_size_t pin, int value){
+  api->analogWrite(api->host, node, pin, value);
+}
+
+static void pinInterrupt(void *arg){
+  ((voidFuncPtr)arg)();
+}
+
+void attachInterrupt(pin_size_t interruptNumber, voidFuncPtr callback, PinStatus mode){
+  api->attachInterrupt(api->host, node, interruptNumber, mode, callback ? pinInterrupt : nullptr, (void *)callback);
+}
+
+void detachInterrupt(pin_size_t interruptNumber){
+  api->attachInterrupt(api->host, node, interruptNumber, CHANGE, nullptr, nullptr);
+}
+
+#if defined(SIM_GIGA_M4)
+/*
+ * Encoder timers of the M4, counted by the simulator's motor models
+ */
+bool quadratureCounterBegin(uint8_t encoder){
+  return api->encoderRead(api->host, node, encoder) >= 0;
+}
+
+uint16_t quadratureCounterRead(uint8_t encoder){
+  return (uint16_t)api->encoderRead(api->host, node, encoder);
+}
+#endif
+
+/*
+ * WMath and friends, random() is seeded per board so runs stay deterministic
+ */
+static uint32_t randomState = 1;
+
+void randomSeed(unsigned long seed){
+  randomState = seed ? (uint32_t)seed : 1;
+}
+
+long random(long howBig){
+  if (howBig <= 0){
+    return 0;
+  }
+  randomState = randomState * 1664525 + 1013904223;
+  return (long)(randomState % (uint32_t)howBig);
+}
+
+long random(long howSmall, long howBig){
+  if (howSmall >= howBig){
+    return howSmall;
+  }
+  return random(howBig - howSmall) + howSmall;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax){
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+uint16_t makeWord(uint16_t w){ return w; }
+uint16_t makeWord(uint8_t h, uint8_t l){ return (h << 8) | l; }
+
+/*
+ * Serial
+ */
+SimSerial Serial;
+
+size_t SimSerial::write(uint8_t value){
+  api->serialWrite(api->host, node, &value, 1);
+  return 1;
+}
+
+size_t SimSerial::write(const uint8_t *buffer, size_t size){
+  api->serialWrite(api->host, node, buffer, size);
+  return size;
+}
+
+int SimSerial::availableForWrite(){
+  return 256;
+}
+
+int SimSerial::available(){
+  return api->serialAvailable(api->host, node);
+}
+
+int SimSerial::read(){
+  return api->serialRead(api->host, node);
+}
+
+int SimSerial::peek(){
+  return -1;
+}
+
+/*
+ * Scheduler and RPC of the mbed core
+ */
+SchedulerClass Scheduler;
+RPCClass RPC;
+
+static void schedulerLoop(void *arg){
+  SchedulerTask task = (SchedulerTask)arg;
+  for (;;){
+    task();
+    yield();
+  }
+}
+
+void SchedulerClass::startLoop(SchedulerTask task){
+  api->spawn(api->host, node, schedulerLoop, (void *)task);
+}
+
+/*
+ * HCI transport to the simulated bluetooth controller
+ */
+class SimHCITransportClass : public HCITransportInterface {
+public:
+  int begin(){
+    _peeked = -1;
+    return 1;
+  }
+
+  void end() {}
+
+  void wait(unsigned long timeout){
+    if (_peeked < 0){
+      api->hciWait(api->host, node, (uint64_t)timeout * 1000000);
+    }
+  }
+
+  int available(){
+    size_t count = api->hciAvailable(api->host, node) + (_peeked >= 0 ? 1 : 0);
+    if (count == 0){
+      api->advance(api->host, SIM_HCI_POLL_NS);
+    }
+    return (int)count;
+  }
+
+  int peek(){
+    if (_peeked < 0){
+      uint8_t value;
+      if (api->hciRead(api->host, node, &value, 1) == 1){
+        _peeked = value;
+      }
+    }
+    return _peeked;
+  }
+
+  int read(){
+    int value = peek();
+    _peeked = -1;
+    return value;
+  }
+
+  size_t read(uint8_t *data, size_t length){
+    size_t count = 0;
+    if (_peeked >= 0 && length > 0){
+      data[count++] = (uint8_t)_peeked;
+      _peeked = -1;
+    }
+    count += api->hciRead(api->host, node, data + count, length - count);
+    if (count == 0){
+      api->advance(api->host, SIM_HCI_POLL_NS);
+    }
+    return count;
+  }
+
+  size_t write(const uint8_t *data, size_t length){
+    api->hciWrite(api->host, node, data, length);
+    return length;
+  }
+
+private:
+  int _peeked = -1;
+};
+
+SimHCITransportClass SimHCITransport;
+HCITransportInterface &HCITransport = SimHCITransport;
+
+#if defined(SIM_ESP32)
+/*
+ * FreeRTOS tasks and hardware timers of the ESP32 core
+ */
+struct SimHardwareTimer {
+  uint32_t frequency;
+  void (*isr)(void);
+};
+
+static SimHardwareTimer hardwareTimer;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core){
+  (void)name;
+  (void)stackDepth;
+  (void)priority;
+  (void)core;
+
+  int id = api->spawn(api->host, node, task, parameter);
+  if (handle){
+    *handle = (TaskHandle_t)(intptr_t)(id + 1);
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task){
+  //simulator tasks run until the simulation ends
+  (void)task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait){
+  (void)clearOnExit;
+  uint64_t timeout = ticksToWait == portMAX_DELAY ? UINT64_MAX : (uint64_t)ticksToWait * 1000000;
+  return api->notifyTake(api->host, timeout);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken){
+  api->notifyGive(api->host, (int)(intptr_t)task - 1);
+  if (higherPriorityTaskWoken){
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task){
+  api->notifyGive(api->host, (int)(intptr_t)task - 1);
+  return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void){
+  return (TaskHandle_t)(intptr_t)(api->currentTask(api->host) + 1);
+}
+
+static void hardwareTimerInterrupt(void *arg){
+  SimHardwareTimer *timer = (SimHardwareTimer *)arg;
+  if (timer->isr){
+    timer->isr();
+  }
+}
+
+hw_timer_t *timerBegin(uint32_t frequency){
+  hardwareTimer.frequency = frequency;
+  hardwareTimer.isr = nullptr;
+  return &hardwareTimer;
+}
+
+void timerAttachInterrupt(hw_timer_t *timer, void (*isr)(void)){
+  timer->isr = isr;
+}
+
+void timerAlarm(hw_timer_t *timer, uint64_t alarmValue, bool autoreload, uint64_t reloadCount){
+  (void)autoreload;
+  (void)reloadCount;
+  //a new alarm replaces the running one, as on the hardware timer
+  api->stopTimers(api->host, node);
+  api->startTimer(api->host, node, alarmValue * 1000000000ULL / timer->frequency, hardwareTimerInterrupt, timer);
+}
+
+void timerEnd(hw_timer_t *timer){
+  (void)timer;
+  api->stopTimers(api->host, node);
+}
+#endif
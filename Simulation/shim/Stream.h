@@ -0,0 +1,96 @@
+#ifndef SIM_STREAM_H
+#define SIM_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "String.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/*
+ * Print and Stream of the simulated Arduino core.
+ *
+ * Shadows the no-op Stream of the ArduinoBLE test shim, the sketches print real
+ * reports and the simulator wants to see them. Formatting follows the Arduino core.
+ */
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t value) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size){
+    size_t written = 0;
+    while (size--){
+      written += write(*buffer++);
+    }
+    return written;
+  }
+  size_t write(const char *text){ return text ? write((const uint8_t *)text, strlen(text)) : 0; }
+  size_t write(const char *buffer, size_t size){ return write((const uint8_t *)buffer, size); }
+
+  virtual int availableForWrite(){ return 0; }
+  virtual void flush() {}
+
+  size_t print(const arduino::__FlashStringHelper *text){ return write((const char *)text); }
+  size_t print(const arduino::String &text){ return write(text.c_str()); }
+  size_t print(const char text[]){ return write(text); }
+  size_t print(char value){ return write((uint8_t)value); }
+  size_t print(unsigned char value, int base = DEC){ return printNumber(value, base); }
+  size_t print(int value, int base = DEC){ return printSigned(value, base); }
+  size_t print(unsigned int value, int base = DEC){ return printNumber(value, base); }
+  size_t print(long value, int base = DEC){ return printSigned(value, base); }
+  size_t print(unsigned long value, int base = DEC){ return printNumber(value, base); }
+  size_t print(long long value, int base = DEC){ return printSigned(value, base); }
+  size_t print(unsigned long long value, int base = DEC){ return printNumber(value, base); }
+  size_t print(double value, int digits = 2){
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return write(text);
+  }
+
+  template <typename T>
+  size_t println(const T &value){ return print(value) + println(); }
+  template <typename T>
+  size_t println(const T &value, int format){ return print(value, format) + println(); }
+  size_t println(const char text[]){ return print(text) + println(); }
+  size_t println(void){ return write("\r\n"); }
+
+private:
+  size_t printSigned(long long value, int base){
+    if (base == DEC && value < 0){
+      return write('-') + printNumber(0ULL - (unsigned long long)value, base);
+    }
+    return printNumber((unsigned long long)value, base);
+  }
+
+  size_t printNumber(unsigned long long value, int base){
+    char text[8 * sizeof(value) + 1];
+    char *digit = &text[sizeof(text) - 1];
+    *digit = '\0';
+
+    if (base < 2){
+      base = DEC;
+    }
+    do {
+      int remainder = value % base;
+      *--digit = remainder < 10 ? '0' + remainder : 'A' + remainder - 10;
+      value /= base;
+    } while (value);
+
+    return write(digit);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available(){ return 0; }
+  virtual int read(){ return -1; }
+  virtual int peek(){ return -1; }
+};
+
+#endif
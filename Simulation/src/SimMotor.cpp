@@ -0,0 +1,60 @@
+#include "SimMotor.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static const int DUTY_MAX = 255;
+
+SimMotor::SimMotor(const Config &config)
+  : _config(config),
+    _duty(0),
+    _supply(1.0),
+    _ns(0),
+    _speed(0.0),
+    _position(0.0){
+}
+
+void SimMotor::setDuty(int duty, uint64_t ns){
+  advance(ns);
+  _duty = duty;
+}
+
+void SimMotor::setSupply(double share, uint64_t ns){
+  advance(ns);
+  _supply = share;
+}
+
+int32_t SimMotor::count(uint64_t ns){
+  advance(ns);
+  return (int32_t)floor(_position);
+}
+
+double SimMotor::speed(uint64_t ns){
+  advance(ns);
+  return _speed;
+}
+
+double SimMotor::steadySpeed() const {
+  double drive = abs(_duty) * _supply - _config.deadBand;
+  if (drive <= 0.0){
+    return 0.0;
+  }
+  double speed = _config.fullSpeed * drive / (DUTY_MAX - _config.deadBand);
+  return _duty < 0 ? -speed : speed;
+}
+
+void SimMotor::advance(uint64_t ns){
+  if (ns <= _ns){
+    return;
+  }
+
+  double dt = (ns - _ns) / 1e9;
+  double tau = _config.timeConstantNs / 1e9;
+  double target = steadySpeed();
+  double decay = exp(-dt / tau);
+
+  //exact solution of the first order response over dt
+  _position += target * dt + (_speed - target) * tau * (1.0 - decay);
+  _speed = target + (_speed - target) * decay;
+  _ns = ns;
+}
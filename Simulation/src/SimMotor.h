@@ -0,0 +1,51 @@
+#ifndef SIM_MOTOR_H
+#define SIM_MOTOR_H
+
+#include <stdint.h>
+
+/*
+ * One wheel of the Bot: a DC motor behind the PWM duty and the quadrature encoder
+ * on its shaft.
+ *
+ * The motor is a first order system. The supply share scales the duty like a
+ * battery losing voltage does, and the motor only turns once the scaled duty is
+ * beyond the dead band:
+ *
+ *   speed -> fullSpeed * (|duty| * supply - deadBand) / (255 - deadBand)
+ *
+ * with the given time constant. The encoder position is the exact integral of the
+ * speed, so the count does not depend on how often it is read.
+ */
+class SimMotor {
+public:
+  struct Config {
+    int deadBand = 64;
+    // encoder counts per second at full duty on a charged battery
+    double fullSpeed = 3000.0;
+    uint64_t timeConstantNs = 50 * 1000 * 1000;
+  };
+
+  explicit SimMotor(const Config &config);
+
+  // signed duty, forward positive
+  void setDuty(int duty, uint64_t ns);
+  // battery voltage as a share of a charged one
+  void setSupply(double share, uint64_t ns);
+
+  int32_t count(uint64_t ns);
+  // counts per second
+  double speed(uint64_t ns);
+
+private:
+  void advance(uint64_t ns);
+  double steadySpeed() const;
+
+  Config _config;
+  int _duty;
+  double _supply;
+  uint64_t _ns;
+  double _speed;
+  double _position;
+};
+
+#endif
@@ -0,0 +1,714 @@
+#include "SimRadio.h"
+#include "Simulator.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+static const uint8_t HCI_COMMAND_PKT = 0x01;
+static const uint8_t HCI_ACLDATA_PKT = 0x02;
+static const uint8_t HCI_EVENT_PKT = 0x04;
+
+static const uint8_t EVT_DISCONN_COMPLETE = 0x05;
+static const uint8_t EVT_CMD_COMPLETE = 0x0e;
+static const uint8_t EVT_CMD_STATUS = 0x0f;
+static const uint8_t EVT_NUM_COMP_PKTS = 0x13;
+static const uint8_t EVT_LE_META_EVENT = 0x3e;
+
+static const uint8_t EVT_LE_CONN_COMPLETE = 0x01;
+static const uint8_t EVT_LE_ADVERTISING_REPORT = 0x02;
+static const uint8_t EVT_LE_CONN_UPDATE_COMPLETE = 0x03;
+
+static const uint8_t STATUS_SUCCESS = 0x00;
+static const uint8_t STATUS_UNKNOWN_CONNECTION = 0x02;
+static const uint8_t STATUS_COMMAND_DISALLOWED = 0x0c;
+static const uint8_t REASON_SUPERVISION_TIMEOUT = 0x08;
+static const uint8_t REASON_LOCAL_HOST = 0x16;
+
+static const uint8_t ADV_IND = 0x00;
+static const uint8_t ADV_SCAN_IND = 0x02;
+static const uint8_t SCAN_RSP = 0x04;
+// what the controller reports for LE Read Buffer Size, ArduinoBLE fragments longer L2CAP PDUs to it
+// what the controller reports for LE Read Buffer Size, ArduinoBLE derives its MTU from it
+static const uint16_t ACL_PACKET_LENGTH = 251;
+static const uint8_t ACL_PACKETS = 8;
+
+// entries of the filter accept list
+static const uint8_t FILTER_ACCEPT_LIST_SIZE = 8;
+static const uint8_t STATUS_MEMORY_CAPACITY_EXCEEDED = 0x07;
+static const uint8_t STATUS_INVALID_PARAMETERS = 0x12;
+
+// every simulated controller advertises with its public address
+static const uint8_t PUBLIC_ADDRESS = 0x00;
+
+// connection events between an update request and its instant
+static const uint64_t UPDATE_INSTANT_EVENTS = 6;
+
+static const uint64_t NS_PER_SLOT = 625 * 1000;
+static const uint64_t NS_PER_INTERVAL_UNIT = 1250 * 1000;
+static const uint64_t NS_PER_TIMEOUT_UNIT = 10 * 1000 * 1000;
+
+struct SimRadio::Controller {
+  int board;
+  uint8_t address[6];
+  uint64_t hciLatencyNs;
+  std::vector<uint8_t> fromHost;
+  uint64_t lastToHostNs = 0;
+
+  bool advertising = false;
+  uint64_t advertisingGeneration = 0;
+  uint64_t advertisingIntervalNs = 100 * 1000 * 1000;
+  uint8_t advertisingType = ADV_IND;
+  std::vector<uint8_t> advertisingData;
+  std::vector<uint8_t> scanResponseData;
+
+  bool scanning = false;
+  bool activeScan = false;
+  bool filterDuplicates = false;
+  std::set<std::vector<uint8_t>> reported;
+
+  bool initiating = false;
+  // initiator filter policy 1: connect to whichever device of the accept list advertises first
+  bool initiatingAcceptList = false;
+  uint8_t initiatingPeer[6];
+  uint16_t initiatingInterval = 0;
+  uint16_t initiatingTimeout = 0;
+
+  // address type followed by the address
+  std::set<std::vector<uint8_t>> acceptList;
+};
+
+struct SimRadio::Connection {
+  uint16_t handle;
+  Controller *central;
+  Controller *peripheral;
+
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t supervisionTimeout;
+  uint64_t events = 0;
+  uint64_t lastEventNs = 0;
+  uint64_t lastSuccessNs = 0;
+
+  bool updatePending = false;
+  uint64_t updateInstant = 0;
+  uint16_t updateInterval = 0;
+  uint16_t updateLatency = 0;
+  uint16_t updateTimeout = 0;
+
+  std::deque<std::vector<uint8_t>> toPeripheral;
+  std::deque<std::vector<uint8_t>> toCentral;
+  uint64_t lastToPeripheralNs = 0;
+  uint64_t lastToCentralNs = 0;
+};
+
+static void put16(std::vector<uint8_t> &buffer, uint16_t value){
+  buffer.push_back(value & 0xff);
+  buffer.push_back(value >> 8);
+}
+
+static uint16_t get16(const uint8_t *data){
+  return data[0] | (data[1] << 8);
+}
+
+SimRadio::SimRadio(Simulator &simulator)
+  : _simulator(simulator),
+    _nextHandle(0x0040){
+}
+
+SimRadio::~SimRadio(){
+}
+
+void SimRadio::addController(int board, const std::string &address, uint64_t hciLatencyNs){
+  std::unique_ptr<Controller> controller(new Controller());
+  controller->board = board;
+  controller->hciLatencyNs = hciLatencyNs;
+
+  unsigned int bytes[6];
+  if (sscanf(address.c_str(), "%x:%x:%x:%x:%x:%x",
+             &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6){
+    throw std::invalid_argument("bad bluetooth address " + address);
+  }
+  // HCI carries addresses least significant byte first
+  for (int i = 0; i < 6; i++){
+    controller->address[i] = (uint8_t)bytes[5 - i];
+  }
+
+  _controllers[board] = std::move(controller);
+}
+
+SimRadio::LinkConfig &SimRadio::link(){
+  return _link;
+}
+
+const SimRadio::Stats &SimRadio::stats() const {
+  return _stats;
+}
+
+void SimRadio::resetStats(){
+  _stats = Stats();
+}
+
+SimRadio::Controller *SimRadio::controller(int board) const {
+  auto it = _controllers.find(board);
+  return it == _controllers.end() ? nullptr : it->second.get();
+}
+
+SimRadio::Controller *SimRadio::advertiser(const uint8_t address[6]) const {
+  for (auto &entry : _controllers){
+    if (memcmp(entry.second->address, address, 6) == 0){
+      return entry.second.get();
+    }
+  }
+  return nullptr;
+}
+
+bool SimRadio::connected(int board) const {
+  for (auto &entry : _connections){
+    if (entry.second->central->board == board || entry.second->peripheral->board == board){
+      return true;
+    }
+  }
+  return false;
+}
+
+void SimRadio::dropConnections(int board){
+  std::vector<uint16_t> handles;
+  for (auto &entry : _connections){
+    if (entry.second->central->board == board || entry.second->peripheral->board == board){
+      handles.push_back(entry.first);
+    }
+  }
+  for (uint16_t handle : handles){
+    _stats.supervisionTimeouts++;
+    disconnect(*_connections[handle], REASON_SUPERVISION_TIMEOUT, nullptr, REASON_SUPERVISION_TIMEOUT);
+  }
+}
+
+/*
+ * Host to controller
+ */
+void SimRadio::fromHost(int board, const uint8_t *data, size_t length){
+  Controller *target = controller(board);
+  if (!target){
+    return;
+  }
+  std::vector<uint8_t> &buffer = target->fromHost;
+  buffer.insert(buffer.end(), data, data + length);
+
+  for (;;){
+    size_t packetLength;
+    if (buffer.empty()){
+      return;
+    } else if (buffer[0] == HCI_COMMAND_PKT){
+      if (buffer.size() < 4){
+        return;
+      }
+      packetLength = 4 + buffer[3];
+    } else if (buffer[0] == HCI_ACLDATA_PKT){
+      if (buffer.size() < 5){
+        return;
+      }
+      packetLength = 5 + get16(&buffer[3]);
+    } else {
+      buffer.erase(buffer.begin());
+      continue;
+    }
+    if (buffer.size() < packetLength){
+      return;
+    }
+
+    std::vector<uint8_t> packet(buffer.begin(), buffer.begin() + packetLength);
+    buffer.erase(buffer.begin(), buffer.begin() + packetLength);
+    handlePacket(*target, packet);
+  }
+}
+
+void SimRadio::handlePacket(Controller &controller, const std::vector<uint8_t> &packet){
+  if (packet[0] == HCI_COMMAND_PKT){
+    handleCommand(controller, get16(&packet[1]), &packet[4], packet.size() - 4);
+  } else {
+    handleAcl(controller, &packet[1], packet.size() - 1);
+  }
+}
+
+void SimRadio::handleCommand(Controller &controller, uint16_t opcode, const uint8_t *params, size_t length){
+  std::vector<uint8_t> result;
+  std::vector<uint8_t> padded(params, params + length);
+  padded.resize(64, 0);
+  const uint8_t *p = padded.data();
+
+  switch (opcode){
+    case 0x0c03:{ // reset
+      controller.advertising = false;
+      controller.advertisingGeneration++;
+      controller.scanning = false;
+      controller.initiating = false;
+      for (auto it = _connections.begin(); it != _connections.end();){
+        if (it->second->central == &controller || it->second->peripheral == &controller){
+          it = _connections.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      break;
+    }
+    case 0x1001:{ // read local version information
+      const uint8_t version[] = { 0x09, 0x00, 0x00, 0x09, 0xff, 0xff, 0x00, 0x00 };
+      result.assign(version, version + sizeof(version));
+      break;
+    }
+    case 0x1009:{ // read BD_ADDR
+      result.assign(controller.address, controller.address + 6);
+      break;
+    }
+    case 0x1405:{ // read RSSI
+      result.push_back(p[0]);
+      result.push_back(p[1]);
+      result.push_back((uint8_t)SIMULATED_RSSI);
+      break;
+    }
+    case 0x2002:{ // LE read buffer size
+      put16(result, ACL_PACKET_LENGTH);
+      result.push_back(ACL_PACKETS);
+      break;
+    }
+    case 0x2006:{ // LE set advertising parameters
+      controller.advertisingIntervalNs = get16(&p[0]) * NS_PER_SLOT;
+      controller.advertisingType = p[4];
+      break;
+    }
+    case 0x2008:{ // LE set advertising data
+      controller.advertisingData.assign(&p[1], &p[1] + std::min<uint8_t>(p[0], 31));
+      break;
+    }
+    case 0x2009:{ // LE set scan response data
+      controller.scanResponseData.assign(&p[1], &p[1] + std::min<uint8_t>(p[0], 31));
+      break;
+    }
+    case 0x200a:{ // LE set advertise enable
+      bool enable = p[0] != 0;
+      if (enable && !controller.advertising){
+        controller.advertising = true;
+        scheduleAdvertising(controller);
+      } else if (!enable){
+        controller.advertising = false;
+        controller.advertisingGeneration++;
+      }
+      break;
+    }
+    case 0x200b:{ // LE set scan parameters
+      controller.activeScan = p[0] == 0x01;
+      break;
+    }
+    case 0x200c:{ // LE set scan enable
+      controller.scanning = p[0] != 0;
+      controller.filterDuplicates = p[1] != 0;
+      controller.reported.clear();
+      break;
+    }
+    case 0x200d:{ // LE create connection
+      if (controller.initiating){
+        commandStatus(controller, opcode, STATUS_COMMAND_DISALLOWED);
+        return;
+      }
+      controller.initiating = true;
+      controller.initiatingAcceptList = p[4] == 0x01;
+      memcpy(controller.initiatingPeer, &p[6], 6);
+      controller.initiatingInterval = get16(&p[13]);
+      controller.initiatingTimeout = get16(&p[19]);
+      commandStatus(controller, opcode, STATUS_SUCCESS);
+      return;
+    }
+    case 0x200e:{ // LE create connection cancel
+      if (!controller.initiating){
+        commandComplete(controller, opcode, STATUS_COMMAND_DISALLOWED);
+        return;
+      }
+      controller.initiating = false;
+      commandComplete(controller, opcode, STATUS_SUCCESS);
+
+      std::vector<uint8_t> event(19, 0);
+      event[0] = EVT_LE_CONN_COMPLETE;
+      event[1] = STATUS_UNKNOWN_CONNECTION;
+      sendEvent(controller, EVT_LE_META_EVENT, event);
+      return;
+    }
+    case 0x200f:{ // LE read filter accept list size
+      result.push_back(FILTER_ACCEPT_LIST_SIZE);
+      break;
+    }
+    case 0x2010:   // LE clear filter accept list
+    case 0x2011:   // LE add device to filter accept list
+    case 0x2012:{  // LE remove device from filter accept list
+      // the list is in use while initiating with it
+      if (controller.initiating && controller.initiatingAcceptList){
+        commandComplete(controller, opcode, STATUS_COMMAND_DISALLOWED);
+        return;
+      }
+      std::vector<uint8_t> entry(p, p + 7);
+      if (opcode == 0x2010){
+        controller.acceptList.clear();
+      } else if (opcode == 0x2011){
+        if (entry[0] > 0x01){
+          commandComplete(controller, opcode, STATUS_INVALID_PARAMETERS);
+          return;
+        }
+        if (!controller.acceptList.count(entry) && controller.acceptList.size() >= FILTER_ACCEPT_LIST_SIZE){
+          commandComplete(controller, opcode, STATUS_MEMORY_CAPACITY_EXCEEDED);
+          return;
+        }
+        controller.acceptList.insert(entry);
+      } else {
+        controller.acceptList.erase(entry);
+      }
+      break;
+    }
+    case 0x2013:{ // LE connection update
+      auto it = _connections.find(get16(&p[0]) & 0x0fff);
+      if (it == _connections.end()){
+        commandStatus(controller, opcode, STATUS_UNKNOWN_CONNECTION);
+        return;
+      }
+      Connection &connection = *it->second;
+      connection.updatePending = true;
+      connection.updateInstant = connection.events + UPDATE_INSTANT_EVENTS;
+      // the controller is free to pick any interval of the range, this one takes the fastest
+      connection.updateInterval = get16(&p[2]);
+      connection.updateLatency = get16(&p[6]);
+      connection.updateTimeout = get16(&p[8]);
+      commandStatus(controller, opcode, STATUS_SUCCESS);
+      return;
+    }
+    case 0x2020:{ // LE remote connection parameter request reply
+      result.push_back(p[0]);
+      result.push_back(p[1]);
+      break;
+    }
+    case 0x0406:{ // disconnect
+      uint16_t handle = get16(&p[0]) & 0x0fff;
+      uint8_t reason = p[2];
+      auto it = _connections.find(handle);
+      if (it == _connections.end()){
+        commandStatus(controller, opcode, STATUS_UNKNOWN_CONNECTION);
+        return;
+      }
+      commandStatus(controller, opcode, STATUS_SUCCESS);
+
+      // the peer acknowledges the LL_TERMINATE_IND on the next connection event
+      Controller *local = &controller;
+      uint64_t delay = it->second->interval * NS_PER_INTERVAL_UNIT;
+      _simulator.at(_simulator.now() + delay, [this, handle, local, reason]() {
+        auto connection = _connections.find(handle);
+        if (connection != _connections.end()){
+          disconnect(*connection->second, REASON_LOCAL_HOST, local, reason);
+        }
+      });
+      return;
+    }
+    default:
+      // event masks, random address, resolving list and the like: accepted and ignored
+      break;
+  }
+
+  commandComplete(controller, opcode, STATUS_SUCCESS, result);
+}
+
+void SimRadio::handleAcl(Controller &controller, const uint8_t *packet, size_t length){
+  uint16_t handle = get16(&packet[0]) & 0x0fff;
+  auto it = _connections.find(handle);
+  if (it == _connections.end()){
+    // the buffer is freed straight away so the host does not run out of credits
+    std::vector<uint8_t> params;
+    params.push_back(1);
+    put16(params, handle);
+    put16(params, 1);
+    sendEvent(controller, EVT_NUM_COMP_PKTS, params);
+    return;
+  }
+
+  Connection &connection = *it->second;
+  std::vector<uint8_t> data(packet, packet + length);
+  if (connection.central == &controller){
+    connection.toPeripheral.push_back(data);
+  } else {
+    connection.toCentral.push_back(data);
+  }
+}
+
+/*
+ * Controller to host
+ */
+void SimRadio::commandComplete(Controller &controller, uint16_t opcode, uint8_t status, const std::vector<uint8_t> &result){
+  std::vector<uint8_t> params;
+  params.push_back(1);
+  put16(params, opcode);
+  params.push_back(status);
+  params.insert(params.end(), result.begin(), result.end());
+  sendEvent(controller, EVT_CMD_COMPLETE, params);
+}
+
+void SimRadio::commandStatus(Controller &controller, uint16_t opcode, uint8_t status){
+  std::vector<uint8_t> params;
+  params.push_back(status);
+  params.push_back(1);
+  put16(params, opcode);
+  sendEvent(controller, EVT_CMD_STATUS, params);
+}
+
+void SimRadio::sendEvent(Controller &controller, uint8_t event, const std::vector<uint8_t> &params, uint64_t delayNs){
+  std::vector<uint8_t> packet;
+  packet.push_back(HCI_EVENT_PKT);
+  packet.push_back(event);
+  packet.push_back((uint8_t)params.size());
+  packet.insert(packet.end(), params.begin(), params.end());
+  toHost(controller, packet, delayNs);
+}
+
+/*
+ * Everything the controller sends reaches the host after the HCI latency and in
+ * the order it was sent, whatever the delay it was sent with.
+ */
+void SimRadio::toHost(Controller &controller, const std::vector<uint8_t> &packet, uint64_t delayNs){
+  uint64_t at = std::max(_simulator.now() + delayNs + controller.hciLatencyNs, controller.lastToHostNs);
+  controller.lastToHostNs = at;
+
+  int board = controller.board;
+  _simulator.at(at, [this, board, packet]() {
+    _simulator.deliverHci(board, packet.data(), packet.size());
+  });
+}
+
+/*
+ * Advertising
+ */
+void SimRadio::scheduleAdvertising(Controller &controller){
+  uint64_t generation = ++controller.advertisingGeneration;
+  std::uniform_int_distribution<uint64_t> advDelay(0, _link.advertisingDelayNs);
+  uint64_t at = _simulator.now() + advDelay(_simulator.random());
+
+  Controller *advertiser = &controller;
+  _simulator.at(at, [this, advertiser, generation]() {
+    advertisingEvent(*advertiser, generation);
+  });
+}
+
+void SimRadio::advertisingEvent(Controller &controller, uint64_t generation){
+  if (!controller.advertising || controller.advertisingGeneration != generation){
+    return;
+  }
+
+  bool scannable = controller.advertisingType == ADV_IND || controller.advertisingType == ADV_SCAN_IND;
+  bool connectable = controller.advertisingType == ADV_IND || controller.advertisingType == 0x01;
+
+  for (auto &entry : _controllers){
+    Controller &scanner = *entry.second;
+    if (&scanner == &controller || !scanner.scanning){
+      continue;
+    }
+
+    uint8_t types[2] = { controller.advertisingType, SCAN_RSP };
+    int reports = scanner.activeScan && scannable ? 2 : 1;
+    for (int i = 0; i < reports; i++){
+      const std::vector<uint8_t> &data = i == 0 ? controller.advertisingData : controller.scanResponseData;
+
+      std::vector<uint8_t> key(controller.address, controller.address + 6);
+      key.push_back(types[i]);
+      if (scanner.filterDuplicates && !scanner.reported.insert(key).second){
+        continue;
+      }
+
+      std::vector<uint8_t> event;
+      event.push_back(EVT_LE_ADVERTISING_REPORT);
+      event.push_back(1);
+      event.push_back(types[i]);
+      event.push_back(0x00);
+      event.insert(event.end(), controller.address, controller.address + 6);
+      event.push_back((uint8_t)data.size());
+      event.insert(event.end(), data.begin(), data.end());
+      event.push_back((uint8_t)SIMULATED_RSSI);
+      sendEvent(scanner, EVT_LE_META_EVENT, event, _link.airtimeNs * (i + 1));
+    }
+  }
+
+  if (connectable){
+    for (auto &entry : _controllers){
+      Controller &initiator = *entry.second;
+      if (&initiator == &controller || !initiator.initiating){
+        continue;
+      }
+      bool targeted;
+      if (initiator.initiatingAcceptList){
+        std::vector<uint8_t> entry(1, PUBLIC_ADDRESS);
+        entry.insert(entry.end(), controller.address, controller.address + 6);
+        targeted = initiator.acceptList.count(entry) != 0;
+      } else {
+        targeted = memcmp(initiator.initiatingPeer, controller.address, 6) == 0;
+      }
+      if (targeted){
+        connect(initiator, controller);
+        return;
+      }
+    }
+  }
+
+  std::uniform_int_distribution<uint64_t> advDelay(0, _link.advertisingDelayNs);
+  uint64_t at = _simulator.now() + controller.advertisingIntervalNs + advDelay(_simulator.random());
+  Controller *advertiser = &controller;
+  _simulator.at(at, [this, advertiser, generation]() {
+    advertisingEvent(*advertiser, generation);
+  });
+}
+
+/*
+ * Connections
+ */
+void SimRadio::connect(Controller &central, Controller &peripheral){
+  if (central.initiatingAcceptList){
+    _stats.acceptListConnections++;
+  }
+  central.initiating = false;
+  central.initiatingAcceptList = false;
+  peripheral.advertising = false;
+  peripheral.advertisingGeneration++;
+
+  std::unique_ptr<Connection> connection(new Connection());
+  connection->handle = _nextHandle++;
+  connection->central = &central;
+  connection->peripheral = &peripheral;
+  connection->interval = central.initiatingInterval ? central.initiatingInterval : 0x0018;
+  connection->latency = 0;
+  connection->supervisionTimeout = central.initiatingTimeout ? central.initiatingTimeout : 0x00c8;
+  connection->lastEventNs = _simulator.now();
+  connection->lastSuccessNs = _simulator.now();
+
+  uint16_t handle = connection->handle;
+  _connections[handle] = std::move(connection);
+  _stats.connections++;
+
+  connectionComplete(central, *_connections[handle], true);
+  connectionComplete(peripheral, *_connections[handle], false);
+
+  uint64_t interval = _link.intervalNs ? _link.intervalNs : _connections[handle]->interval * NS_PER_INTERVAL_UNIT;
+  _simulator.at(_simulator.now() + interval, [this, handle]() {
+    connectionEvent(handle);
+  });
+}
+
+void SimRadio::connectionComplete(Controller &controller, Connection &connection, bool central){
+  Controller &peer = central ? *connection.peripheral : *connection.central;
+
+  std::vector<uint8_t> event;
+  event.push_back(EVT_LE_CONN_COMPLETE);
+  event.push_back(STATUS_SUCCESS);
+  put16(event, connection.handle);
+  event.push_back(central ? 0x00 : 0x01);
+  event.push_back(0x00);
+  event.insert(event.end(), peer.address, peer.address + 6);
+  put16(event, connection.interval);
+  put16(event, connection.latency);
+  put16(event, connection.supervisionTimeout);
+  event.push_back(0x00);
+  sendEvent(controller, EVT_LE_META_EVENT, event);
+}
+
+void SimRadio::connectionEvent(uint16_t handle){
+  auto it = _connections.find(handle);
+  if (it == _connections.end()){
+    return;
+  }
+  Connection &connection = *it->second;
+  uint64_t now = _simulator.now();
+
+  connection.events++;
+  connection.lastEventNs = now;
+  _stats.connectionEvents++;
+
+  if (connection.updatePending && connection.events >= connection.updateInstant){
+    connection.updatePending = false;
+    connection.interval = connection.updateInterval;
+    connection.latency = connection.updateLatency;
+    connection.supervisionTimeout = connection.updateTimeout;
+
+    std::vector<uint8_t> event;
+    event.push_back(EVT_LE_CONN_UPDATE_COMPLETE);
+    event.push_back(STATUS_SUCCESS);
+    put16(event, connection.handle);
+    put16(event, connection.interval);
+    put16(event, connection.latency);
+    put16(event, connection.supervisionTimeout);
+    sendEvent(*connection.central, EVT_LE_META_EVENT, event);
+    sendEvent(*connection.peripheral, EVT_LE_META_EVENT, event);
+  }
+
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  if (_link.eventLoss > 0.0 && chance(_simulator.random()) < _link.eventLoss){
+    _stats.lostEvents++;
+    if (now - connection.lastSuccessNs >= connection.supervisionTimeout * NS_PER_TIMEOUT_UNIT){
+      _stats.supervisionTimeouts++;
+      disconnect(connection, REASON_SUPERVISION_TIMEOUT, nullptr, REASON_SUPERVISION_TIMEOUT);
+      return;
+    }
+  } else {
+    connection.lastSuccessNs = now;
+    transfer(connection, *connection.central, *connection.peripheral, connection.toPeripheral, connection.lastToPeripheralNs);
+    transfer(connection, *connection.peripheral, *connection.central, connection.toCentral, connection.lastToCentralNs);
+  }
+
+  uint64_t interval = _link.intervalNs ? _link.intervalNs : connection.interval * NS_PER_INTERVAL_UNIT;
+  _simulator.at(now + interval, [this, handle]() {
+    connectionEvent(handle);
+  });
+}
+
+void SimRadio::transfer(Connection &connection, Controller &from, Controller &to,
+                        std::deque<std::vector<uint8_t>> &queue, uint64_t &lastDelivery){
+  uint64_t now = _simulator.now();
+  std::uniform_int_distribution<uint64_t> jitter(0, _link.jitterNs);
+
+  uint16_t sent = 0;
+  while (!queue.empty() && sent < _link.packetsPerEvent){
+    std::vector<uint8_t> packet;
+    packet.push_back(HCI_ACLDATA_PKT);
+    packet.insert(packet.end(), queue.front().begin(), queue.front().end());
+    queue.pop_front();
+    sent++;
+
+    // the receiving controller starts every L2CAP PDU that arrives in one piece as a flushable start
+    uint16_t flags = get16(&packet[1]) & 0x3000;
+    uint16_t pb = flags == 0x1000 ? 0x1000 : 0x2000;
+    packet[1] = connection.handle & 0xff;
+    packet[2] = ((connection.handle >> 8) & 0x0f) | (pb >> 8);
+
+    uint64_t delay = _link.airtimeNs * sent + (_link.jitterNs ? jitter(_simulator.random()) : 0);
+    lastDelivery = std::max(now + delay, lastDelivery);
+    toHost(to, packet, lastDelivery - now);
+    _stats.packetsDelivered++;
+  }
+
+  if (sent){
+    std::vector<uint8_t> params;
+    params.push_back(1);
+    put16(params, connection.handle);
+    put16(params, sent);
+    sendEvent(from, EVT_NUM_COMP_PKTS, params, _link.airtimeNs * sent);
+  }
+}
+
+void SimRadio::disconnect(Connection &connection, uint8_t localReason, Controller *local, uint8_t peerReason){
+  Controller *controllers[2] = { connection.central, connection.peripheral };
+  uint16_t handle = connection.handle;
+
+  for (Controller *controller : controllers){
+    std::vector<uint8_t> params;
+    params.push_back(STATUS_SUCCESS);
+    put16(params, handle);
+    params.push_back(controller == local || !local ? localReason : peerReason);
+    sendEvent(*controller, EVT_DISCONN_COMPLETE, params);
+  }
+
+  _stats.disconnects++;
+  _connections.erase(handle);
+}
@@ -0,0 +1,105 @@
+#ifndef SIM_RADIO_H
+#define SIM_RADIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class Simulator;
+
+// what every controller reports for Read RSSI, on any link
+static const int8_t SIMULATED_RSSI = -50;
+
+/*
+ * The bluetooth controllers of all simulated boards and the air between them.
+ *
+ * Each board talks HCI to its own controller. The controllers implement the part
+ * of the LE command set ArduinoBLE uses: advertising, scanning, initiating (also
+ * from the filter accept list), the connection parameter update and disconnects. Connected controllers exchange ACL
+ * data once per connection event, so the interval, lost events, retransmissions
+ * and the supervision timeout shape the latency just like on the real link.
+ */
+class SimRadio {
+public:
+  struct LinkConfig {
+    // connection event spacing, 0 uses what the central negotiated
+    uint64_t intervalNs = 0;
+    // probability that a connection event fails, its packets are retried on the next one
+    double eventLoss = 0.0;
+    // uniform extra delay of every delivered packet, sleep clock drift and radio scheduling
+    uint64_t jitterNs = 0;
+    // packets per direction and connection event
+    int packetsPerEvent = 4;
+    // time on air of one packet
+    uint64_t airtimeNs = 400 * 1000;
+    // upper bound of the random advDelay added to every advertising event
+    uint64_t advertisingDelayNs = 10 * 1000 * 1000;
+  };
+
+  struct Stats {
+    uint64_t connections = 0;
+    // connections an initiator made from its filter accept list
+    uint64_t acceptListConnections = 0;
+    uint64_t disconnects = 0;
+    uint64_t supervisionTimeouts = 0;
+    uint64_t connectionEvents = 0;
+    uint64_t lostEvents = 0;
+    uint64_t packetsDelivered = 0;
+  };
+
+  explicit SimRadio(Simulator &simulator);
+  ~SimRadio();
+
+  void addController(int board, const std::string &address, uint64_t hciLatencyNs);
+
+  LinkConfig &link();
+  const Stats &stats() const;
+  void resetStats();
+
+  // ends every connection of the board as if its peer went out of range
+  void dropConnections(int board);
+  bool connected(int board) const;
+
+  // HCI packets written by the board's host
+  void fromHost(int board, const uint8_t *data, size_t length);
+
+private:
+  struct Controller;
+  struct Connection;
+
+  Controller *controller(int board) const;
+  Controller *advertiser(const uint8_t address[6]) const;
+
+  void handlePacket(Controller &controller, const std::vector<uint8_t> &packet);
+  void handleCommand(Controller &controller, uint16_t opcode, const uint8_t *params, size_t length);
+  void handleAcl(Controller &controller, const uint8_t *packet, size_t length);
+
+  void commandComplete(Controller &controller, uint16_t opcode, uint8_t status,
+                       const std::vector<uint8_t> &result = std::vector<uint8_t>());
+  void commandStatus(Controller &controller, uint16_t opcode, uint8_t status);
+  void sendEvent(Controller &controller, uint8_t event, const std::vector<uint8_t> &params, uint64_t delayNs = 0);
+  void toHost(Controller &controller, const std::vector<uint8_t> &packet, uint64_t delayNs);
+
+  void scheduleAdvertising(Controller &controller);
+  void advertisingEvent(Controller &controller, uint64_t generation);
+  void connect(Controller &central, Controller &peripheral);
+  void connectionComplete(Controller &controller, Connection &connection, bool central);
+  void connectionEvent(uint16_t handle);
+  void transfer(Connection &connection, Controller &from, Controller &to,
+                std::deque<std::vector<uint8_t>> &queue, uint64_t &lastDelivery);
+  void disconnect(Connection &connection, uint8_t localReason, Controller *local, uint8_t peerReason);
+
+  Simulator &_simulator;
+  LinkConfig _link;
+  Stats _stats;
+  std::map<int, std::unique_ptr<Controller>> _controllers;
+  std::map<uint16_t, std::unique_ptr<Connection>> _connections;
+  uint16_t _nextHandle;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "SimSystem.h"
+
+#include <stdio.h>
+#include <stdexcept>
+#include <BotCores.h>
+#include <ControllerState.h>
+
+// the Controller only accepts this central
+static const char *CENTRAL_ADDRESS = "f4:12:fa:6d:71:2d";
+// further Controllers count up the last byte
+static const char *CONTROLLER_ADDRESS_PREFIX = "34:85:18:7a:1c:";
+static const int CONTROLLER_ADDRESS_FIRST = 0xe1;
+
+// SRAM4 of the GIGA, home of the M7/M4 mailboxes
+static const uintptr_t GIGA_SRAM4_ADDRESS = 0x38000000;
+static const size_t GIGA_SRAM4_SIZE = 64 * 1024;
+
+// ADC channels of the thumb stick on the Controller
+static const int THUMB_STICK_X_PIN = 14;
+static const int THUMB_STICK_Y_PIN = 15;
+
+// motor pins of the M4
+static const int MOTOR_1_FWD_PIN = 7;
+static const int MOTOR_1_RV_PIN = 6;
+static const int MOTOR_2_FWD_PIN = 4;
+static const int MOTOR_2_RV_PIN = 5;
+
+// the boards do not come up at the same moment, neither do the real ones
+static const uint64_t CONTROLLER_BOOT_NS = 0;
+static const uint64_t CONTROLLER_BOOT_SPACING_NS = 23 * SIM_NS_PER_MS;
+static const uint64_t CENTRAL_BOOT_NS = 37 * SIM_NS_PER_MS;
+
+SimSystem::SimSystem(const SimSystemConfig &config)
+  : _simulator(config.seed),
+    _central(-1),
+    _botM4(-1){
+  _simulator.echoSerial(config.echoSerial);
+  _simulator.radio().link() = config.link;
+
+  for (int i = 0; i < config.controllers; i++){
+    std::string name = i == 0 ? "controller" : "controller-" + std::to_string(i);
+    int board = _simulator.addBoard(name, config.nodeDirectory + "/controller_node.so",
+                                    CONTROLLER_BOOT_NS + i * CONTROLLER_BOOT_SPACING_NS);
+    char address[18];
+    snprintf(address, sizeof(address), "%s%02x", CONTROLLER_ADDRESS_PREFIX, CONTROLLER_ADDRESS_FIRST + i);
+    _simulator.addRadio(board, address);
+    _controllers.push_back(board);
+    centerStick(i);
+  }
+
+  if (config.central == SimSystemConfig::BOT){
+    if (!_simulator.mapSharedMemory(GIGA_SRAM4_ADDRESS, GIGA_SRAM4_SIZE)){
+      throw std::runtime_error("cannot map the GIGA SRAM4 window");
+    }
+    _central = _simulator.addBoard("bot-m7", config.nodeDirectory + "/bot_m7_node.so", CENTRAL_BOOT_NS);
+    _botM4 = _simulator.addBoard("bot-m4", config.nodeDirectory + "/bot_m4_node.so", CENTRAL_BOOT_NS);
+    addWheels(config);
+  } else {
+    _central = _simulator.addBoard("receiver", config.nodeDirectory + "/receiver_node.so", CENTRAL_BOOT_NS);
+  }
+  _simulator.addRadio(_central, CENTRAL_ADDRESS);
+}
+
+SimSystem::~SimSystem(){
+}
+
+void SimSystem::addWheels(const SimSystemConfig &config){
+  _wheels.assign(2, SimMotor(config.wheel));
+
+  //the PWM pins of each motor set its duty
+  _simulator.onOutput([this](int board, int pin, int value, uint64_t ns) {
+    (void)value;
+    if (board != _botM4){
+      return;
+    }
+    if (pin == MOTOR_1_FWD_PIN || pin == MOTOR_1_RV_PIN){
+      _wheels[0].setDuty(motor1(), ns);
+    } else if (pin == MOTOR_2_FWD_PIN || pin == MOTOR_2_RV_PIN){
+      _wheels[1].setDuty(motor2(), ns);
+    }
+  });
+
+  if (!config.encoders){
+    return;
+  }
+  for (int i = 0; i < (int)_wheels.size(); i++){
+    _simulator.setEncoder(_botM4, i, [this, i]() {
+      return (uint16_t)_wheels[i].count(_simulator.now());
+    });
+  }
+}
+
+Simulator &SimSystem::simulator(){
+  return _simulator;
+}
+
+SimRadio &SimSystem::radio(){
+  return _simulator.radio();
+}
+
+void SimSystem::setStick(uint16_t x, uint16_t y){
+  setStick(0, x, y);
+}
+
+void SimSystem::centerStick(){
+  centerStick(0);
+}
+
+void SimSystem::setStick(int controller, uint16_t x, uint16_t y){
+  _simulator.setAnalogInput(_controllers[controller], THUMB_STICK_X_PIN, x);
+  _simulator.setAnalogInput(_controllers[controller], THUMB_STICK_Y_PIN, y);
+}
+
+void SimSystem::centerStick(int controller){
+  setStick(controller, JOYSTICK_MIDDLE, JOYSTICK_MIDDLE);
+}
+
+int SimSystem::motor1() const {
+  if (_botM4 < 0){
+    return 0;
+  }
+  return _simulator.output(_botM4, MOTOR_1_FWD_PIN) - _simulator.output(_botM4, MOTOR_1_RV_PIN);
+}
+
+int SimSystem::motor2() const {
+  if (_botM4 < 0){
+    return 0;
+  }
+  return _simulator.output(_botM4, MOTOR_2_FWD_PIN) - _simulator.output(_botM4, MOTOR_2_RV_PIN);
+}
+
+double SimSystem::wheelSpeed(int wheel){
+  return _wheels.empty() ? 0.0 : _wheels[wheel].speed(_simulator.now());
+}
+
+void SimSystem::setSupply(double share){
+  for (SimMotor &wheel : _wheels){
+    wheel.setSupply(share, _simulator.now());
+  }
+}
+
+bool SimSystem::centralConnected() const {
+  return _simulator.radio().connected(_central);
+}
+
+bool SimSystem::controllerConnected(int controller) const {
+  return _simulator.radio().connected(_controllers[controller]);
+}
+
+bool SimSystem::runUntil(std::function<bool()> condition, uint64_t timeoutNs, uint64_t stepNs){
+  uint64_t deadline = _simulator.now() + timeoutNs;
+  while (!condition()){
+    if (_simulator.now() >= deadline){
+      return false;
+    }
+    _simulator.runUntil(std::min(deadline, _simulator.now() + stepNs));
+  }
+  return true;
+}
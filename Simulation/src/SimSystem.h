@@ -0,0 +1,80 @@
+#ifndef SIM_SYSTEM_H
+#define SIM_SYSTEM_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Simulator.h"
+#include "SimRadio.h"
+#include "SimMotor.h"
+
+/*
+ * The whole project wired up in a simulator: one or more Controllers as peripherals
+ * and either the Bot (both GIGA cores) or the Receiver as the central that connects
+ * to them. The central gets the address the Controllers accept.
+ */
+struct SimSystemConfig {
+  enum Central { BOT, RECEIVER };
+
+  uint64_t seed = 1;
+  Central central = BOT;
+  // Controllers in range of the central, each with its own address
+  int controllers = 1;
+  SimRadio::LinkConfig link;
+  // wheels of the Bot, without encoders the M4 drives them open loop
+  SimMotor::Config wheel;
+  bool encoders = true;
+  // prints every line the boards write to Serial
+  bool echoSerial = false;
+  // directory of the *_node modules
+  std::string nodeDirectory = SIM_NODE_DIR;
+};
+
+class SimSystem {
+public:
+  explicit SimSystem(const SimSystemConfig &config = SimSystemConfig());
+  ~SimSystem();
+
+  Simulator &simulator();
+  SimRadio &radio();
+
+  // thumb stick of the first Controller, raw 12 bit ADC readings
+  void setStick(uint16_t x, uint16_t y);
+  void centerStick();
+  // thumb stick of any Controller
+  void setStick(int controller, uint16_t x, uint16_t y);
+  void centerStick(int controller);
+
+  // signed duty the M4 drives the motors with, forward positive
+  int motor1() const;
+  int motor2() const;
+
+  // speed of wheel 0 (motor 1) or 1 (motor 2), encoder counts per second
+  double wheelSpeed(int wheel);
+  // battery voltage of the Bot as a share of a charged one
+  void setSupply(double share);
+
+  // whether the central has at least one link, or a link to the given Controller
+  bool centralConnected() const;
+  bool controllerConnected(int controller) const;
+
+  // runs the simulation until condition holds, checked every stepNs, false on timeout
+  bool runUntil(std::function<bool()> condition, uint64_t timeoutNs, uint64_t stepNs = 100 * SIM_NS_PER_US);
+
+  int controller() const { return _controllers.front(); }
+  int controller(int index) const { return _controllers[index]; }
+  int central() const { return _central; }
+  int botM4() const { return _botM4; }
+
+private:
+  void addWheels(const SimSystemConfig &config);
+
+  Simulator _simulator;
+  std::vector<int> _controllers;
+  int _central;
+  int _botM4;
+  std::vector<SimMotor> _wheels;
+};
+
+#endif
@@ -0,0 +1,602 @@
+#include "Simulator.h"
+#include "SimRadio.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdexcept>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0
+#endif
+
+// the sketches and ArduinoBLE only need a few KB, the headroom is for printf and friends
+static const size_t SIM_TASK_STACK = 256 * 1024;
+
+Simulator *Simulator::active = nullptr;
+
+SimHostApi Simulator::hostApi = {
+  nullptr,
+  Simulator::apiNow,
+  Simulator::apiBootTime,
+  Simulator::apiAdvance,
+  Simulator::apiSleepUntil,
+  Simulator::apiSpawn,
+  Simulator::apiNotifyTake,
+  Simulator::apiNotifyGive,
+  Simulator::apiCurrentTask,
+  Simulator::apiStartTimer,
+  Simulator::apiStopTimers,
+  Simulator::apiAttachInterrupt,
+  Simulator::apiHciWrite,
+  Simulator::apiHciAvailable,
+  Simulator::apiHciRead,
+  Simulator::apiHciWait,
+  Simulator::apiAnalogRead,
+  Simulator::apiDigitalRead,
+  Simulator::apiAnalogWrite,
+  Simulator::apiDigitalWrite,
+  Simulator::apiEncoderRead,
+  Simulator::apiSerialWrite,
+  Simulator::apiSerialRead,
+  Simulator::apiSerialAvailable,
+};
+
+/*
+ * dlopen() hands out the same copy of a library for the same path, so every board
+ * loads a private copy of its module file and gets its own globals.
+ * Boards never destroy their globals and ArduinoBLE's destructors do not expect to
+ * run, so modules stay mapped after dlclose().
+ */
+static void *loadModuleCopy(const std::string &path){
+  char copyPath[] = "/tmp/simnode-XXXXXX";
+  int copy = mkstemp(copyPath);
+  if (copy < 0){
+    return nullptr;
+  }
+
+  FILE *source = fopen(path.c_str(), "rb");
+  bool copied = source != nullptr;
+  if (source){
+    char buffer[64 * 1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), source)) > 0){
+      if (write(copy, buffer, length) != (ssize_t)length){
+        copied = false;
+        break;
+      }
+    }
+    fclose(source);
+  }
+  close(copy);
+
+  void *module = copied ? dlopen(copyPath, RTLD_NOW | RTLD_LOCAL | RTLD_NODELETE) : nullptr;
+  if (!module && copied){
+    fprintf(stderr, "simulator: %s\n", dlerror());
+  }
+  unlink(copyPath);
+  return module;
+}
+
+static void runNodeMain(void *main){
+  ((SimNodeMainFn)main)();
+}
+
+Simulator::Simulator(uint64_t seed)
+  : _random(seed),
+    _eventOrder(0),
+    _now(0),
+    _until(0),
+    _horizon(0),
+    _current(nullptr),
+    _echo(false){
+  _radio.reset(new SimRadio(*this));
+}
+
+Simulator::~Simulator(){
+  _tasks.clear();
+  for (auto &board : _boards){
+    if (board->module){
+      dlclose(board->module);
+    }
+  }
+  for (auto &region : _sharedMemory){
+    munmap(region.first, region.second);
+  }
+}
+
+int Simulator::addBoard(const std::string &name, const std::string &modulePath, uint64_t bootNs){
+  void *module = loadModuleCopy(modulePath);
+  if (!module){
+    throw std::runtime_error("cannot load " + modulePath);
+  }
+
+  SimNodeAttachFn attach = (SimNodeAttachFn)dlsym(module, SIM_NODE_ATTACH_SYMBOL);
+  SimNodeMainFn main = (SimNodeMainFn)dlsym(module, SIM_NODE_MAIN_SYMBOL);
+  if (!attach || !main){
+    dlclose(module);
+    throw std::runtime_error(modulePath + " is not a simulator node");
+  }
+
+  std::unique_ptr<Board> board(new Board());
+  board->name = name;
+  board->modulePath = modulePath;
+  board->module = module;
+  board->bootNs = bootNs;
+  board->echoed = 0;
+  board->timerGeneration = 0;
+  board->busyNs = 0;
+  _boards.push_back(std::move(board));
+
+  int id = (int)_boards.size() - 1;
+  attach(&hostApi, id);
+
+  // the board powers up at bootNs, its setup() runs from there
+  int task = spawnTask(id, runNodeMain, (void *)main);
+  _tasks[task]->state = TASK_SLEEPING;
+  _tasks[task]->wakeNs = bootNs;
+  return id;
+}
+
+void Simulator::addRadio(int board, const std::string &address, uint64_t hciLatencyNs){
+  _radio->addController(board, address, hciLatencyNs);
+}
+
+bool Simulator::mapSharedMemory(uintptr_t address, size_t size){
+  void *memory = mmap((void *)address, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if (memory == MAP_FAILED){
+    return false;
+  }
+  if (memory != (void *)address){
+    munmap(memory, size);
+    return false;
+  }
+  _sharedMemory.push_back(std::make_pair(memory, size));
+  return true;
+}
+
+/*
+ * Scheduler
+ */
+void Simulator::runUntil(uint64_t ns){
+  Simulator *previous = active;
+  active = this;
+  _until = ns;
+
+  for (;;){
+    Task *task = nextTask();
+    uint64_t taskNs = task ? std::max(task->wakeNs, _now) : SIM_FOREVER;
+    uint64_t eventNs = _events.empty() ? SIM_FOREVER : _events.top().ns;
+
+    if (eventNs <= taskNs){
+      if (eventNs > _until){
+        break;
+      }
+      Event event = _events.top();
+      _events.pop();
+      _now = std::max(_now, event.ns);
+      event.fn();
+      continue;
+    }
+    if (taskNs > _until){
+      break;
+    }
+
+    _now = taskNs;
+    task->state = TASK_READY;
+    _current = task;
+    recomputeHorizon();
+    swapcontext(&_schedulerContext, &task->context);
+    _current = nullptr;
+
+    echoLines(*_boards[task->board]);
+  }
+
+  _now = std::max(_now, _until);
+  active = previous;
+}
+
+void Simulator::runFor(uint64_t ns){
+  runUntil(_now + ns);
+}
+
+uint64_t Simulator::now() const {
+  return _now;
+}
+
+Simulator::Task *Simulator::nextTask(){
+  Task *next = nullptr;
+  for (auto &task : _tasks){
+    if (task->state == TASK_DONE){
+      continue;
+    }
+    if (task->state != TASK_READY && task->wakeNs == SIM_FOREVER){
+      continue;
+    }
+    if (!next || task->wakeNs < next->wakeNs){
+      next = task.get();
+    }
+  }
+  return next;
+}
+
+/*
+ * The running task may go on until something else is due: an event, another task
+ * or the end of the run.
+ */
+void Simulator::recomputeHorizon(){
+  _horizon = _until;
+  if (!_events.empty()){
+    _horizon = std::min(_horizon, _events.top().ns);
+  }
+  for (auto &task : _tasks){
+    if (task.get() == _current || task->state == TASK_DONE){
+      continue;
+    }
+    if (task->state == TASK_READY || task->wakeNs != SIM_FOREVER){
+      _horizon = std::min(_horizon, task->wakeNs);
+    }
+  }
+}
+
+int Simulator::spawnTask(int board, void (*entry)(void *), void *arg){
+  std::unique_ptr<Task> task(new Task());
+  task->id = (int)_tasks.size();
+  task->board = board;
+  task->stack.resize(SIM_TASK_STACK);
+  task->entry = entry;
+  task->arg = arg;
+  task->state = TASK_READY;
+  task->wakeNs = _now;
+  task->notifications = 0;
+
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack.data();
+  task->context.uc_stack.ss_size = task->stack.size();
+  task->context.uc_link = nullptr;
+  makecontext(&task->context, taskEntry, 0);
+
+  _tasks.push_back(std::move(task));
+  if (_current){
+    recomputeHorizon();
+  }
+  return (int)_tasks.size() - 1;
+}
+
+void Simulator::taskEntry(){
+  Simulator *simulator = active;
+  Task *task = simulator->_current;
+  task->entry(task->arg);
+
+  task->state = TASK_DONE;
+  simulator->switchToScheduler();
+}
+
+void Simulator::switchToScheduler(){
+  Task *task = _current;
+  swapcontext(&task->context, &_schedulerContext);
+}
+
+void Simulator::block(TaskState state, uint64_t wakeNs){
+  if (!_current){
+    return;
+  }
+  _current->state = state;
+  _current->wakeNs = wakeNs;
+  switchToScheduler();
+}
+
+void Simulator::wakeBoard(int board, TaskState waitingFor){
+  for (auto &task : _tasks){
+    if (task->board == board && task->state == waitingFor){
+      task->state = TASK_READY;
+      task->wakeNs = _now;
+    }
+  }
+  if (_current){
+    recomputeHorizon();
+  }
+}
+
+/*
+ * Events
+ */
+void Simulator::at(uint64_t ns, std::function<void()> fn){
+  Event event;
+  event.ns = std::max(ns, _now);
+  event.order = _eventOrder++;
+  event.fn = fn;
+  _events.push(event);
+  if (_current){
+    recomputeHorizon();
+  }
+}
+
+void Simulator::scheduleTimer(int board, uint64_t generation, uint64_t periodNs, void (*isr)(void *), void *arg){
+  at(_now + periodNs, [this, board, generation, periodNs, isr, arg]() {
+    if (_boards[board]->timerGeneration != generation){
+      return;
+    }
+    isr(arg);
+    scheduleTimer(board, generation, periodNs, isr, arg);
+  });
+}
+
+/*
+ * Board I/O
+ */
+void Simulator::setAnalogInput(int board, int pin, int value){
+  _boards[board]->inputs[pin] = value;
+}
+
+void Simulator::setDigitalInput(int board, int pin, int value){
+  Board &target = *_boards[board];
+  auto input = target.inputs.find(pin);
+  // inputs idle high, as apiDigitalRead reads them
+  int previous = input == target.inputs.end() ? 1 : input->second;
+  target.inputs[pin] = value;
+
+  auto it = target.interrupts.find(pin);
+  if (it == target.interrupts.end() || (previous != 0) == (value != 0)){
+    return;
+  }
+  PinInterrupt interrupt = it->second;
+  bool rising = value != 0;
+  if (interrupt.mode == SIM_PIN_CHANGE || (interrupt.mode == SIM_PIN_RISING) == rising){
+    at(_now, [interrupt]() { interrupt.isr(interrupt.arg); });
+  }
+}
+
+int Simulator::output(int board, int pin) const {
+  auto it = _boards[board]->outputs.find(pin);
+  return it == _boards[board]->outputs.end() ? 0 : it->second;
+}
+
+void Simulator::onOutput(std::function<void(int, int, int, uint64_t)> callback){
+  _onOutput.push_back(callback);
+}
+
+void Simulator::setEncoder(int board, int encoder, std::function<uint16_t()> read){
+  _boards[board]->encoders[encoder] = read;
+}
+
+void Simulator::writeOutput(int board, int pin, int value){
+  auto it = _boards[board]->outputs.find(pin);
+  if (it != _boards[board]->outputs.end() && it->second == value){
+    return;
+  }
+  _boards[board]->outputs[pin] = value;
+  for (auto &callback : _onOutput){
+    callback(board, pin, value, _now);
+  }
+}
+
+const std::string &Simulator::serialOutput(int board) const {
+  return _boards[board]->serialTx;
+}
+
+void Simulator::sendSerial(int board, const std::string &text){
+  _boards[board]->serialRx.insert(_boards[board]->serialRx.end(), text.begin(), text.end());
+}
+
+void Simulator::echoSerial(bool echo){
+  _echo = echo;
+}
+
+void Simulator::echoLines(Board &board){
+  if (!_echo){
+    board.echoed = board.serialTx.size();
+    return;
+  }
+  size_t end;
+  while ((end = board.serialTx.find('\n', board.echoed)) != std::string::npos){
+    std::string line = board.serialTx.substr(board.echoed, end - board.echoed);
+    if (!line.empty() && line[line.size() - 1] == '\r'){
+      line.resize(line.size() - 1);
+    }
+    printf("%10.3f ms [%s] %s\n", _now / 1e6, board.name.c_str(), line.c_str());
+    board.echoed = end + 1;
+  }
+}
+
+uint64_t Simulator::busyTime(int board) const {
+  return _boards[board]->busyNs;
+}
+
+const std::string &Simulator::boardName(int board) const {
+  return _boards[board]->name;
+}
+
+int Simulator::boardCount() const {
+  return (int)_boards.size();
+}
+
+void Simulator::exit(int status){
+  fflush(nullptr);
+  _exit(status);
+}
+
+SimRadio &Simulator::radio(){
+  return *_radio;
+}
+
+const SimRadio &Simulator::radio() const {
+  return *_radio;
+}
+
+std::mt19937_64 &Simulator::random(){
+  return _random;
+}
+
+void Simulator::deliverHci(int board, const uint8_t *data, size_t length){
+  _boards[board]->hciRx.insert(_boards[board]->hciRx.end(), data, data + length);
+  wakeBoard(board, TASK_WAIT_HCI);
+}
+
+void Simulator::hciFromBoard(int board, const uint8_t *data, size_t length){
+  _radio->fromHost(board, data, length);
+}
+
+/*
+ * Host table, the host pointer is unused: the table is shared by all boards and
+ * calls always come from the simulator that is currently running.
+ */
+uint64_t Simulator::apiNow(void *){
+  return active->_now;
+}
+
+uint64_t Simulator::apiBootTime(void *, int node){
+  return active->_boards[node]->bootNs;
+}
+
+void Simulator::apiAdvance(void *, uint64_t ns){
+  Simulator *simulator = active;
+  if (!simulator->_current){
+    // interrupt handlers take no time
+    return;
+  }
+  simulator->_now += ns;
+  simulator->_boards[simulator->_current->board]->busyNs += ns;
+  if (simulator->_now >= simulator->_horizon){
+    simulator->block(TASK_READY, simulator->_now);
+  }
+}
+
+void Simulator::apiSleepUntil(void *, uint64_t ns){
+  Simulator *simulator = active;
+  simulator->block(TASK_SLEEPING, std::max(ns, simulator->_now));
+}
+
+int Simulator::apiSpawn(void *, int node, void (*entry)(void *), void *arg){
+  return active->spawnTask(node, entry, arg);
+}
+
+uint32_t Simulator::apiNotifyTake(void *, uint64_t timeoutNs){
+  Simulator *simulator = active;
+  Task *task = simulator->_current;
+  if (!task){
+    return 0;
+  }
+  if (!task->notifications){
+    uint64_t wake = timeoutNs == SIM_FOREVER ? SIM_FOREVER : simulator->_now + timeoutNs;
+    simulator->block(TASK_WAIT_NOTIFY, wake);
+  }
+  uint32_t notifications = task->notifications;
+  task->notifications = 0;
+  return notifications;
+}
+
+void Simulator::apiNotifyGive(void *, int id){
+  Simulator *simulator = active;
+  if (id < 0 || id >= (int)simulator->_tasks.size()){
+    return;
+  }
+  Task *task = simulator->_tasks[id].get();
+  task->notifications++;
+  if (task->state == TASK_WAIT_NOTIFY || task->state == TASK_WAIT_HCI){
+    task->state = TASK_READY;
+    task->wakeNs = simulator->_now;
+    if (simulator->_current){
+      simulator->recomputeHorizon();
+    }
+  }
+}
+
+int Simulator::apiCurrentTask(void *){
+  return active->_current ? active->_current->id : -1;
+}
+
+void Simulator::apiStartTimer(void *, int node, uint64_t periodNs, void (*isr)(void *), void *arg){
+  Simulator *simulator = active;
+  simulator->scheduleTimer(node, simulator->_boards[node]->timerGeneration, std::max<uint64_t>(periodNs, 1), isr, arg);
+}
+
+void Simulator::apiStopTimers(void *, int node){
+  active->_boards[node]->timerGeneration++;
+}
+
+void Simulator::apiAttachInterrupt(void *, int node, int pin, int mode, void (*isr)(void *), void *arg){
+  auto &interrupts = active->_boards[node]->interrupts;
+  if (!isr){
+    interrupts.erase(pin);
+    return;
+  }
+  interrupts[pin] = PinInterrupt{ mode, isr, arg };
+}
+
+void Simulator::apiHciWrite(void *, int node, const uint8_t *data, size_t length){
+  active->hciFromBoard(node, data, length);
+}
+
+size_t Simulator::apiHciAvailable(void *, int node){
+  return active->_boards[node]->hciRx.size();
+}
+
+size_t Simulator::apiHciRead(void *, int node, uint8_t *data, size_t length){
+  std::deque<uint8_t> &rx = active->_boards[node]->hciRx;
+  size_t count = std::min(length, rx.size());
+  std::copy(rx.begin(), rx.begin() + count, data);
+  rx.erase(rx.begin(), rx.begin() + count);
+  return count;
+}
+
+void Simulator::apiHciWait(void *, int node, uint64_t timeoutNs){
+  Simulator *simulator = active;
+  Task *task = simulator->_current;
+  if (simulator->_boards[node]->hciRx.empty() && task && !task->notifications){
+    simulator->block(TASK_WAIT_HCI, simulator->_now + timeoutNs);
+  }
+  if (task){
+    task->notifications = 0;
+  }
+}
+
+int Simulator::apiAnalogRead(void *, int node, int pin){
+  auto &inputs = active->_boards[node]->inputs;
+  auto it = inputs.find(pin);
+  return it == inputs.end() ? 0 : it->second;
+}
+
+int Simulator::apiDigitalRead(void *, int node, int pin){
+  auto &inputs = active->_boards[node]->inputs;
+  auto it = inputs.find(pin);
+  // inputs idle high, the sketches use pull-ups
+  return it == inputs.end() ? 1 : it->second;
+}
+
+void Simulator::apiAnalogWrite(void *, int node, int pin, int value){
+  active->writeOutput(node, pin, value);
+}
+
+void Simulator::apiDigitalWrite(void *, int node, int pin, int value){
+  active->writeOutput(node, pin, value);
+}
+
+int Simulator::apiEncoderRead(void *, int node, int encoder){
+  auto &encoders = active->_boards[node]->encoders;
+  auto it = encoders.find(encoder);
+  return it == encoders.end() ? -1 : it->second();
+}
+
+void Simulator::apiSerialWrite(void *, int node, const uint8_t *data, size_t length){
+  active->_boards[node]->serialTx.append((const char *)data, length);
+}
+
+int Simulator::apiSerialRead(void *, int node){
+  std::deque<uint8_t> &rx = active->_boards[node]->serialRx;
+  if (rx.empty()){
+    return -1;
+  }
+  int value = rx.front();
+  rx.pop_front();
+  return value;
+}
+
+int Simulator::apiSerialAvailable(void *, int node){
+  return (int)active->_boards[node]->serialRx.size();
+}
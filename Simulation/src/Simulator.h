@@ -0,0 +1,195 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include <ucontext.h>
+#include <SimNode.h>
+
+class SimRadio;
+
+const uint64_t SIM_NS_PER_US = 1000;
+const uint64_t SIM_NS_PER_MS = 1000000;
+const uint64_t SIM_FOREVER = UINT64_MAX;
+
+/*
+ * Deterministic discrete-event simulator for the boards of the project.
+ *
+ * Every board is a sketch module (see SimNode.h) whose loops run as cooperative
+ * tasks on their own stacks. There is one simulated clock. The task with the
+ * earliest wake-up time runs until it sleeps, waits for data or has spent enough
+ * time to reach the next pending event, so boards interleave at the granularity of
+ * what they actually do. Host events (radio traffic, timers, scripted inputs) are
+ * ordered by time and insertion, so a run only depends on its seed.
+ */
+class Simulator {
+public:
+  explicit Simulator(uint64_t seed = 1);
+  ~Simulator();
+
+  Simulator(const Simulator &) = delete;
+  Simulator &operator=(const Simulator &) = delete;
+
+  // loads a sketch module as a new board, its micros() starts at bootNs
+  int addBoard(const std::string &name, const std::string &modulePath, uint64_t bootNs = 0);
+  // gives the board a bluetooth controller on the simulated radio, address as "aa:bb:cc:dd:ee:ff"
+  void addRadio(int board, const std::string &address, uint64_t hciLatencyNs = 50 * SIM_NS_PER_US);
+
+  // backs a fixed address range with zeroed memory shared by all boards, like the GIGA's SRAM4
+  bool mapSharedMemory(uintptr_t address, size_t size);
+
+  // runs every board and event up to the given time
+  void runUntil(uint64_t ns);
+  void runFor(uint64_t ns);
+  uint64_t now() const;
+
+  // runs fn at the given time, outside of any board
+  void at(uint64_t ns, std::function<void()> fn);
+
+  void setAnalogInput(int board, int pin, int value);
+  // also runs the pin interrupt the board attached to an input that changes
+  void setDigitalInput(int board, int pin, int value);
+  int output(int board, int pin) const;
+  // adds a callback for every analogWrite and digitalWrite that changes a pin
+  void onOutput(std::function<void(int board, int pin, int value, uint64_t ns)> callback);
+  // gives the board a quadrature encoder timer, read returns its 16 bit counter
+  void setEncoder(int board, int encoder, std::function<uint16_t()> read);
+
+  // everything the board printed so far
+  const std::string &serialOutput(int board) const;
+  void sendSerial(int board, const std::string &text);
+  // prints every line a board writes to stdout, prefixed with its name
+  void echoSerial(bool echo);
+
+  // simulated time the board's tasks spent running, not sleeping or waiting
+  uint64_t busyTime(int board) const;
+
+  const std::string &boardName(int board) const;
+  int boardCount() const;
+
+  // ends the process without destroying the globals of the boards: real boards never
+  // do and ArduinoBLE's destructors do not expect it
+  static void exit(int status);
+
+  SimRadio &radio();
+  const SimRadio &radio() const;
+  std::mt19937_64 &random();
+
+  // used by the radio
+  void deliverHci(int board, const uint8_t *data, size_t length);
+  void hciFromBoard(int board, const uint8_t *data, size_t length);
+
+private:
+  enum TaskState { TASK_READY, TASK_SLEEPING, TASK_WAIT_HCI, TASK_WAIT_NOTIFY, TASK_DONE };
+
+  struct Task {
+    int id;
+    int board;
+    ucontext_t context;
+    std::vector<char> stack;
+    void (*entry)(void *);
+    void *arg;
+    TaskState state;
+    uint64_t wakeNs;
+    uint32_t notifications;
+  };
+
+  struct PinInterrupt {
+    int mode;
+    void (*isr)(void *);
+    void *arg;
+  };
+
+  struct Board {
+    std::string name;
+    std::string modulePath;
+    void *module;
+    uint64_t bootNs;
+    std::map<int, int> inputs;
+    std::map<int, int> outputs;
+    std::map<int, std::function<uint16_t()>> encoders;
+    std::map<int, PinInterrupt> interrupts;
+    std::deque<uint8_t> hciRx;
+    std::deque<uint8_t> serialRx;
+    std::string serialTx;
+    size_t echoed;
+    uint64_t timerGeneration;
+    uint64_t busyNs;
+  };
+
+  struct Event {
+    uint64_t ns;
+    uint64_t order;
+    std::function<void()> fn;
+    bool operator>(const Event &other) const {
+      return ns != other.ns ? ns > other.ns : order > other.order;
+    }
+  };
+
+  static void taskEntry();
+  static Simulator *active;
+  static SimHostApi hostApi;
+
+  int spawnTask(int board, void (*entry)(void *), void *arg);
+  Task *nextTask();
+  void switchToScheduler();
+  void block(TaskState state, uint64_t wakeNs);
+  void wakeBoard(int board, TaskState waitingFor);
+  void recomputeHorizon();
+  void scheduleTimer(int board, uint64_t generation, uint64_t periodNs, void (*isr)(void *), void *arg);
+  void echoLines(Board &board);
+
+  static uint64_t apiNow(void *host);
+  static uint64_t apiBootTime(void *host, int node);
+  static void apiAdvance(void *host, uint64_t ns);
+  static void apiSleepUntil(void *host, uint64_t ns);
+  static int apiSpawn(void *host, int node, void (*entry)(void *), void *arg);
+  static uint32_t apiNotifyTake(void *host, uint64_t timeoutNs);
+  static void apiNotifyGive(void *host, int task);
+  static int apiCurrentTask(void *host);
+  static void apiStartTimer(void *host, int node, uint64_t periodNs, void (*isr)(void *), void *arg);
+  static void apiStopTimers(void *host, int node);
+  static void apiAttachInterrupt(void *host, int node, int pin, int mode, void (*isr)(void *), void *arg);
+  static void apiHciWrite(void *host, int node, const uint8_t *data, size_t length);
+  static size_t apiHciAvailable(void *host, int node);
+  static size_t apiHciRead(void *host, int node, uint8_t *data, size_t length);
+  static void apiHciWait(void *host, int node, uint64_t timeoutNs);
+  static int apiAnalogRead(void *host, int node, int pin);
+  static int apiDigitalRead(void *host, int node, int pin);
+  static void apiAnalogWrite(void *host, int node, int pin, int value);
+  static void apiDigitalWrite(void *host, int node, int pin, int value);
+  static int apiEncoderRead(void *host, int node, int encoder);
+  static void apiSerialWrite(void *host, int node, const uint8_t *data, size_t length);
+  static int apiSerialRead(void *host, int node);
+  static int apiSerialAvailable(void *host, int node);
+
+  void writeOutput(int board, int pin, int value);
+
+  std::mt19937_64 _random;
+  std::unique_ptr<SimRadio> _radio;
+
+  std::vector<std::unique_ptr<Board>> _boards;
+  std::vector<std::unique_ptr<Task>> _tasks;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+  uint64_t _eventOrder;
+
+  uint64_t _now;
+  uint64_t _until;
+  uint64_t _horizon;
+  Task *_current;
+  ucontext_t _schedulerContext;
+
+  std::vector<std::pair<void *, size_t>> _sharedMemory;
+  std::vector<std::function<void(int, int, int, uint64_t)>> _onOutput;
+  bool _echo;
+};
+
+#endif
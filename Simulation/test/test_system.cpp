@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <SimSystem.h>
+#include <ControllerState.h>
+
+/*
+ * End-to-end tests of the simulated system: the real Controller, Bot and Receiver
+ * sketches talking over the simulated radio.
+ */
+
+static int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)){ \
+      fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #condition); \
+      failures++; \
+      return; \
+    } \
+  } while (0)
+
+#define RUN_TEST(test) \
+  do { \
+    int before = failures; \
+    test(); \
+    printf("%s %s\n", failures == before ? "PASS" : "FAIL", #test); \
+  } while (0)
+
+// long enough for both boards to boot, find each other and the M4 to finish its dead band search
+static const uint64_t SETTLE_NS = 6000 * SIM_NS_PER_MS;
+
+static bool motorsStopped(SimSystem &system){
+  return system.motor1() == 0 && system.motor2() == 0;
+}
+
+static void settle(SimSystem &system){
+  system.simulator().runUntil(SETTLE_NS);
+}
+
+void test_bot_connects_to_controller(){
+  SimSystem system;
+
+  CHECK(system.runUntil([&]() { return system.centralConnected(); }, 3000 * SIM_NS_PER_MS));
+  settle(system);
+  CHECK(system.centralConnected());
+  CHECK(motorsStopped(system));
+}
+
+void test_stick_drives_motors(){
+  SimSystem system;
+  settle(system);
+  CHECK(system.centralConnected());
+
+  system.setStick(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  CHECK(system.runUntil([&]() { return system.motor1() != 0 && system.motor2() != 0; }, 100 * SIM_NS_PER_MS));
+
+  //both wheels turn the same way for a straight push, and keep doing so
+  system.simulator().runFor(500 * SIM_NS_PER_MS);
+  CHECK(system.motor1() != 0);
+  CHECK((system.motor1() > 0) == (system.motor2() > 0));
+}
+
+void test_motors_stop_when_stick_released(){
+  SimSystem system;
+  settle(system);
+
+  system.setStick(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  CHECK(system.runUntil([&]() { return !motorsStopped(system); }, 100 * SIM_NS_PER_MS));
+  system.simulator().runFor(500 * SIM_NS_PER_MS);
+
+  system.centerStick();
+  CHECK(system.runUntil([&]() { return motorsStopped(system); }, 500 * SIM_NS_PER_MS));
+  CHECK(system.centralConnected());
+}
+
+void test_motors_stop_when_link_drops(){
+  SimSystem system;
+  settle(system);
+
+  system.setStick(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  CHECK(system.runUntil([&]() { return !motorsStopped(system); }, 100 * SIM_NS_PER_MS));
+  system.simulator().runFor(500 * SIM_NS_PER_MS);
+
+  //every connection event lost from here on, the link times out and the bot stops on its own
+  system.radio().link().eventLoss = 1.0;
+  CHECK(system.runUntil([&]() { return !system.centralConnected(); }, 1000 * SIM_NS_PER_MS));
+  CHECK(system.runUntil([&]() { return motorsStopped(system); }, 500 * SIM_NS_PER_MS));
+}
+
+void test_lossy_link_still_drives_motors(){
+  SimSystemConfig config;
+  config.seed = 7;
+  config.link.eventLoss = 0.2;
+  config.link.jitterNs = 500 * SIM_NS_PER_US;
+  SimSystem system(config);
+  settle(system);
+  CHECK(system.centralConnected());
+
+  system.setStick(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  CHECK(system.runUntil([&]() { return !motorsStopped(system); }, 200 * SIM_NS_PER_MS));
+}
+
+void test_receiver_connects_to_controller(){
+  SimSystemConfig config;
+  config.central = SimSystemConfig::RECEIVER;
+  SimSystem system(config);
+
+  CHECK(system.runUntil([&]() { return system.centralConnected(); }, 3000 * SIM_NS_PER_MS));
+  system.simulator().runFor(1000 * SIM_NS_PER_MS);
+  CHECK(system.centralConnected());
+  CHECK(system.simulator().serialOutput(system.central()).find("Controller 0 connected") != std::string::npos);
+}
+
+// pushes the stick of one controller and tells whether the motors follow
+static bool stickDrivesMotors(SimSystem &system, int controller){
+  system.setStick(controller, JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  bool moved = system.runUntil([&]() { return !motorsStopped(system); }, 300 * SIM_NS_PER_MS);
+  system.centerStick(controller);
+  system.runUntil([&]() { return motorsStopped(system); }, 500 * SIM_NS_PER_MS);
+  return moved;
+}
+
+void test_bot_keeps_every_controller_connected(){
+  SimSystemConfig config;
+  config.controllers = 2;
+  SimSystem system(config);
+  settle(system);
+  CHECK(system.controllerConnected(0));
+  CHECK(system.controllerConnected(1));
+
+  //one controller drives, the other one is connected but ignored
+  bool first = stickDrivesMotors(system, 0);
+  bool second = stickDrivesMotors(system, 1);
+  CHECK(first != second);
+
+  //the other controller takes over once the driver's link drops
+  int driver = first ? 0 : 1;
+  system.radio().dropConnections(system.controller(driver));
+  CHECK(system.controllerConnected(1 - driver));
+  system.simulator().runFor(100 * SIM_NS_PER_MS);
+  CHECK(stickDrivesMotors(system, 1 - driver));
+}
+
+static size_t occurrences(const std::string &text, const char *needle){
+  size_t count = 0;
+  for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)){
+    count++;
+  }
+  return count;
+}
+
+// time from the radio link coming up until the Bot has found the controller state characteristic
+static bool measureLinkSetup(SimSystem &system, size_t setups, uint64_t &setupNs){
+  const std::string &output = system.simulator().serialOutput(system.central());
+  if (!system.runUntil([&]() { return system.controllerConnected(0); }, 3000 * SIM_NS_PER_MS, SIM_NS_PER_MS)){
+    return false;
+  }
+  uint64_t linkUp = system.simulator().now();
+  if (!system.runUntil([&]() { return occurrences(output, "Controller 0 connected") >= setups; }, 2000 * SIM_NS_PER_MS, SIM_NS_PER_MS)){
+    return false;
+  }
+  setupNs = system.simulator().now() - linkUp;
+  return true;
+}
+
+void test_reconnect_restores_attributes_from_cache(){
+  SimSystem system;
+  uint64_t discoveryNs, cachedNs;
+
+  CHECK(measureLinkSetup(system, 1, discoveryNs));
+  settle(system);
+
+  //the controller comes back after a dropout, its handles are taken from the cache
+  system.radio().dropConnections(system.controller());
+  CHECK(measureLinkSetup(system, 2, cachedNs));
+  CHECK(cachedNs < 100 * SIM_NS_PER_MS);
+  CHECK(cachedNs < discoveryNs / 2);
+
+  //the notifications were enabled again by the cache, the stick still drives
+  system.simulator().runFor(100 * SIM_NS_PER_MS);
+  CHECK(stickDrivesMotors(system, 0));
+}
+
+void test_dropped_controller_reconnects_from_accept_list(){
+  SimSystem system;
+  settle(system);
+  CHECK(system.radio().stats().acceptListConnections == 0);
+
+  //the Bot initiates to the known address right away instead of scanning for it
+  const std::string &output = system.simulator().serialOutput(system.central());
+  system.radio().dropConnections(system.controller());
+  CHECK(system.runUntil([&]() { return occurrences(output, "Controller 0 connected") >= 2; }, 2000 * SIM_NS_PER_MS));
+  CHECK(system.radio().stats().acceptListConnections == 1);
+
+  system.simulator().runFor(100 * SIM_NS_PER_MS);
+  CHECK(stickDrivesMotors(system, 0));
+}
+
+// wheel speed after the stick was held for a while
+static double heldWheelSpeed(SimSystem &system, uint16_t y){
+  system.setStick(JOYSTICK_MIDDLE, y);
+  system.simulator().runFor(1500 * SIM_NS_PER_MS);
+  return system.wheelSpeed(0);
+}
+
+void test_wheel_speed_holds_on_low_battery(){
+  SimSystem system;
+  settle(system);
+
+  //the dead band of the motor model is 64, the search stops just above it
+  const std::string &output = system.simulator().serialOutput(system.central());
+  CHECK(system.runUntil([&]() { return output.find("Wheels: dead band") != std::string::npos; }, 6000 * SIM_NS_PER_MS));
+  int deadBand1, deadBand2;
+  CHECK(sscanf(output.c_str() + output.find("Wheels: dead band"), "Wheels: dead band %d/%d", &deadBand1, &deadBand2) == 2);
+  CHECK(deadBand1 >= 64 && deadBand1 <= 76);
+  CHECK(deadBand2 >= 64 && deadBand2 <= 76);
+
+  uint16_t halfThrottle = JOYSTICK_MIDDLE + (JOYSTICK_MAX - JOYSTICK_MIDDLE) / 2;
+  double charged = heldWheelSpeed(system, halfThrottle);
+  CHECK(charged > 100.0);
+
+  //open loop the same duty would lose a good part of its speed
+  system.setSupply(0.8);
+  double low = heldWheelSpeed(system, halfThrottle);
+  CHECK(low > charged * 0.95 && low < charged * 1.05);
+}
+
+void test_controller_sleeps_between_events(){
+  SimSystem system;
+  settle(system);
+  CHECK(system.centralConnected());
+
+  //connected with nothing to send the Controller only wakes for samples and the radio,
+  //the old busy loop spent over a quarter of the time polling
+  uint64_t busy = system.simulator().busyTime(system.controller());
+  system.simulator().runFor(1000 * SIM_NS_PER_MS);
+  CHECK(system.simulator().busyTime(system.controller()) - busy < 20 * SIM_NS_PER_MS);
+
+  //and still reacts as fast as before
+  system.setStick(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  CHECK(system.runUntil([&]() { return system.motor1() != 0; }, 50 * SIM_NS_PER_MS));
+}
+
+void test_bot_reports_its_status_to_the_controller(){
+  SimSystem system;
+  settle(system);
+  system.setStick(JOYSTICK_MIDDLE, JOYSTICK_MAX);
+  CHECK(system.runUntil([&]() { return system.motor1() != 0; }, 100 * SIM_NS_PER_MS));
+
+  //the Controller logs every status as a telemetry record: sync, TELEMETRY_BOT_STATUS, 19 bytes
+  const std::string &output = system.simulator().serialOutput(system.controller());
+  const char *record = "\xa5\x04\x13";
+  size_t before = occurrences(output, record);
+  system.simulator().runFor(2000 * SIM_NS_PER_MS);
+  size_t statuses = occurrences(output, record) - before;
+  //one every 200 ms while the stick streams states as fast as the link goes
+  CHECK(statuses >= 8 && statuses <= 11);
+
+  size_t dump = output.size();
+  system.simulator().sendSerial(system.controller(), "l");
+  CHECK(system.runUntil([&]() { return output.find("Bot: duty", dump) != std::string::npos; }, 200 * SIM_NS_PER_MS));
+  int duty1, duty2;
+  CHECK(sscanf(output.c_str() + output.find("Bot: duty", dump), "Bot: duty %d/%d, armed", &duty1, &duty2) == 2);
+  CHECK(duty1 > 0 && duty2 > 0);
+  //read in the background, the status carries the one asked for by the status before
+  int rssi;
+  CHECK(sscanf(output.c_str() + output.find("RSSI ", dump), "RSSI %d dBm", &rssi) == 1);
+  CHECK(rssi == SIMULATED_RSSI);
+}
+
+void test_receiver_gives_every_controller_a_channel(){
+  SimSystemConfig config;
+  config.central = SimSystemConfig::RECEIVER;
+  config.controllers = 2;
+  SimSystem system(config);
+
+  //a channel is reported once its controller is set up
+  const std::string &output = system.simulator().serialOutput(system.central());
+  CHECK(system.runUntil([&]() { return output.find("Controller 1 connected") != std::string::npos; }, 5000 * SIM_NS_PER_MS));
+  CHECK(output.find("Controller 0 connected") != std::string::npos);
+  CHECK(system.controllerConnected(0) && system.controllerConnected(1));
+}
+
+int main(){
+  RUN_TEST(test_bot_connects_to_controller);
+  RUN_TEST(test_stick_drives_motors);
+  RUN_TEST(test_motors_stop_when_stick_released);
+  RUN_TEST(test_motors_stop_when_link_drops);
+  RUN_TEST(test_lossy_link_still_drives_motors);
+  RUN_TEST(test_receiver_connects_to_controller);
+  RUN_TEST(test_bot_keeps_every_controller_connected);
+  RUN_TEST(test_receiver_gives_every_controller_a_channel);
+  RUN_TEST(test_reconnect_restores_attributes_from_cache);
+  RUN_TEST(test_dropped_controller_reconnects_from_accept_list);
+  RUN_TEST(test_wheel_speed_holds_on_low_battery);
+  RUN_TEST(test_controller_sleeps_between_events);
+  RUN_TEST(test_bot_reports_its_status_to_the_controller);
+  Simulator::exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,66 @@
+//#include "Common.h"
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "HCITransport.h"
+
+class HCIFakeTransportClass : public HCITransportInterface
+{
+public:
+    HCIFakeTransportClass() : _rxIndex(0), _bulkRead(true), _txWrites(0) {};
+    ~HCIFakeTransportClass() {};
+
+    int begin() {return 0;}
+    void end() {return;}
+    void wait(unsigned long timeout) {return;}
+    int available() {return _rx.size() - _rxIndex;}
+    int peek() {return available() ? _rx[_rxIndex] : -1;}
+    int read() {return available() ? _rx[_rxIndex++] : -1;}
+    size_t write(const uint8_t* data, size_t length) {
+        _tx.assign(data, data + length);
+        _txPkts.push_back(_tx);
+        _txWrites++;
+        return length;
+    }
+
+    size_t read(uint8_t* data, size_t length) {
+        if (!_bulkRead) {
+            return HCITransportInterface::read(data, length);
+        }
+        size_t count = length < (size_t)available() ? length : available();
+        std::copy(_rx.begin() + _rxIndex, _rx.begin() + _rxIndex + count, data);
+        _rxIndex += count;
+        return count;
+    }
+
+    /* Bytes the controller sends to the host, read by the next HCI.poll() */
+    void receive(const uint8_t* data, size_t length) {
+        if (_rxIndex == _rx.size()) {
+            _rx.clear();
+            _rxIndex = 0;
+        }
+        _rx.insert(_rx.end(), data, data + length);
+    }
+
+    /* false reads byte by byte through the default of HCITransportInterface */
+    void setBulkRead(bool bulkRead) {_bulkRead = bulkRead;}
+
+    /* The last packet the host wrote and how many it wrote so far */
+    const std::vector<uint8_t>& sent() const {return _tx;}
+    int sentCount() const {return _txWrites;}
+    /* Every packet written since the last clearSent() */
+    const std::vector<std::vector<uint8_t>>& sentPkts() const {return _txPkts;}
+    void clearSent() {_txPkts.clear();}
+
+private:
+    std::vector<uint8_t> _rx;
+    size_t _rxIndex;
+    bool _bulkRead;
+    std::vector<uint8_t> _tx;
+    std::vector<std::vector<uint8_t>> _txPkts;
+    int _txWrites;
+};
+
+extern HCIFakeTransportClass HCIFakeTransport;
@@ -0,0 +1,107 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#define private public
+#define protected public
+
+#include "HCIFakeTransport.h"
+#include "HCI.h"
+#include "ATT.h"
+#include "GATTCache.h"
+#include "BLEProperty.h"
+
+static const uint16_t HANDLE = 0x0040;
+static const uint8_t ADDRESS[6] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+
+static const uint8_t SERVICE_UUID[] = { 0x00, 0x18 };
+static const uint8_t CHARACTERISTIC_UUID[] = { 0x2a, 0x2a };
+
+/* one service with one notifying characteristic, declared at 0x0002, value at 0x0003 */
+static BLERemoteDevice* peer(uint16_t valueHandle)
+{
+  BLERemoteDevice* device = new BLERemoteDevice();
+  BLERemoteService* service = new BLERemoteService(SERVICE_UUID, sizeof(SERVICE_UUID), 0x0001, 0x0004);
+  service->addCharacteristic(new BLERemoteCharacteristic(CHARACTERISTIC_UUID, sizeof(CHARACTERISTIC_UUID), HANDLE, 0x0002, BLENotify, valueHandle));
+  device->addService(service);
+  return device;
+}
+
+/* Read Response with the characteristic declaration the peer has now */
+static void declaration(uint16_t valueHandle)
+{
+  uint8_t pkt[] = {
+    0x02, (uint8_t)HANDLE, (uint8_t)((0x2000 | HANDLE) >> 8), 0x0a, 0x00,
+    0x06, 0x00, 0x04, 0x00,
+    0x0b, BLENotify, (uint8_t)valueHandle, (uint8_t)(valueHandle >> 8), CHARACTERISTIC_UUID[0], CHARACTERISTIC_UUID[1]
+  };
+  HCIFakeTransport.receive(pkt, sizeof(pkt));
+}
+
+TEST_CASE("GATT cache checks peers without a Database Hash", "[ArduinoBLE::GATTCache]")
+{
+  GATTCache.setEnabled(true);
+  GATTCache.clear();
+  HCI.resetAclLinks();
+  HCI.addAclLink(HANDLE);
+  HCI._maxPkt = 4;
+  ATT._peers[0].connectionHandle = HANDLE;
+  ATT._peers[0].mtu = 23;
+
+  BLERemoteDevice* cached = peer(0x0003);
+  REQUIRE( GATTCache.store(0x00, ADDRESS, NULL, HANDLE, cached) );
+  delete cached;
+
+  BLERemoteDevice* device = new BLERemoteDevice();
+
+  WHEN("The peer still has the cached table")
+  {
+    int writes = HCIFakeTransport.sentCount();
+    declaration(0x0003);
+
+    REQUIRE( GATTCache.restore(0x00, ADDRESS, NULL, false, HANDLE, device) );
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 1 );
+    REQUIRE( device->serviceCount() == 1 );
+  }
+
+  WHEN("The peer was reflashed with another table")
+  {
+    declaration(0x0005);
+
+    /* the entry is dropped and the peer discovered again */
+    REQUIRE( !GATTCache.restore(0x00, ADDRESS, NULL, false, HANDLE, device) );
+    REQUIRE( device->serviceCount() == 0 );
+    REQUIRE( GATTCache.find(0x00, ADDRESS) == NULL );
+  }
+
+  WHEN("The peer is bonded")
+  {
+    int writes = HCIFakeTransport.sentCount();
+
+    /* nothing is read */
+    REQUIRE( GATTCache.restore(0x00, ADDRESS, NULL, true, HANDLE, device) );
+    REQUIRE( HCIFakeTransport.sentCount() == writes );
+  }
+
+  delete device;
+  GATTCache.clear();
+  ATT._peers[0].connectionHandle = 0xffff;
+  HCI.resetAclLinks();
+}
@@ -0,0 +1,233 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "HCIFakeTransport.h"
+#include "HCI.h"
+#include "ATT.h"
+
+static const uint16_t SLOW = 0x0040;
+static const uint16_t FAST = 0x0041;
+
+/* Number of Completed Packets for one handle */
+static void numCompPkts(uint16_t handle, uint8_t count)
+{
+  uint8_t pkt[] = { 0x04, 0x13, 0x05, 0x01, (uint8_t)handle, (uint8_t)(handle >> 8), count, 0x00 };
+  HCIFakeTransport.receive(pkt, sizeof(pkt));
+  HCI.poll();
+}
+
+static int send(uint16_t handle)
+{
+  uint8_t payload[] = { 0x52, 0x2a, 0x00, 0x01 };
+  HCITransportIov iov = { payload, sizeof(payload) };
+
+  return HCI.trySendAclPkt(handle, ATT_CID, &iov, 1);
+}
+
+static uint16_t sentHandle()
+{
+  return HCIFakeTransport.sent()[1] | (HCIFakeTransport.sent()[2] << 8);
+}
+
+TEST_CASE("HCI shares the controller's ACL buffers between connections", "[ArduinoBLE::HCI]")
+{
+  HCI.resetAclLinks();
+  HCI.addAclLink(SLOW);
+  HCI.addAclLink(FAST);
+  HCI._maxPkt = 4;
+
+  WHEN("The controller completes packets")
+  {
+    send(SLOW);
+    send(SLOW);
+    send(FAST);
+
+    /* they are counted per connection */
+    numCompPkts(SLOW, 1);
+    REQUIRE( HCI.aclPending(SLOW) == 1 );
+    REQUIRE( HCI.aclPending(FAST) == 1 );
+
+    /* more than it had, or of a connection that is gone, changes nothing else */
+    numCompPkts(SLOW, 5);
+    numCompPkts(0x0042, 1);
+    REQUIRE( HCI.aclPending(SLOW) == 0 );
+    REQUIRE( HCI._pendingPkt == 1 );
+  }
+
+  WHEN("The controller buffers are full")
+  {
+    for (int i = 0; i < 4; i++) {
+      REQUIRE( send(SLOW) == 0 );
+    }
+
+    /* the packets wait here, until the connection's queue is full */
+    int writes = HCIFakeTransport.sentCount();
+    for (int i = 0; i < HCI_ACL_LINK_QUEUE; i++) {
+      REQUIRE( send(SLOW) == 0 );
+    }
+    REQUIRE( send(SLOW) == -1 );
+    REQUIRE( HCIFakeTransport.sentCount() == writes );
+    REQUIRE( HCI.aclQueued(SLOW) == HCI_ACL_LINK_QUEUE );
+
+    /* the other connection still has its own queue */
+    REQUIRE( send(FAST) == 0 );
+    REQUIRE( HCI.aclQueued(FAST) == 1 );
+
+    /* a free buffer goes to the next connection in turn */
+    numCompPkts(SLOW, 1);
+    REQUIRE( sentHandle() == SLOW );
+    numCompPkts(SLOW, 1);
+    REQUIRE( sentHandle() == FAST );
+    numCompPkts(SLOW, 1);
+    REQUIRE( sentHandle() == SLOW );
+    REQUIRE( HCI.aclQueued(FAST) == 0 );
+    REQUIRE( HCI.aclQueued(SLOW) == HCI_ACL_LINK_QUEUE - 2 );
+  }
+
+  WHEN("A connection closes with packets in the controller and queued")
+  {
+    for (int i = 0; i < 6; i++) {
+      send(SLOW);
+    }
+    send(FAST);
+
+    /* its buffers are free again, and the other connection gets one of them */
+    int writes = HCIFakeTransport.sentCount();
+    HCI.removeAclLink(SLOW);
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 1 );
+    REQUIRE( sentHandle() == FAST );
+    REQUIRE( HCI._pendingPkt == 1 );
+    REQUIRE( HCI._aclQueued == 0 );
+    REQUIRE( send(SLOW) == -1 );
+  }
+
+  HCI.resetAclLinks();
+}
+
+TEST_CASE("HCI fragments PDUs longer than an ACL packet", "[ArduinoBLE::HCI]")
+{
+  std::vector<uint8_t> payload(HCI_ACL_PAYLOAD_MAX);
+  for (size_t i = 0; i < payload.size(); i++) {
+    payload[i] = i;
+  }
+
+  HCI.resetAclLinks();
+  HCI.addAclLink(SLOW);
+  HCI.addAclLink(FAST);
+  HCI._maxPkt = 8;
+  HCI._aclPktLen = 251;
+  HCIFakeTransport.clearSent();
+
+  WHEN("One is sent")
+  {
+    REQUIRE( HCI.sendAclPkt(SLOW, ATT_CID, payload.size(), payload.data()) == 0 );
+
+    /* 4 + 517 bytes of L2CAP PDU in 251 byte pieces */
+    const std::vector<std::vector<uint8_t>>& pkts = HCIFakeTransport.sentPkts();
+    REQUIRE( pkts.size() == 3 );
+    REQUIRE( pkts[0][2] == 0x00 );
+    REQUIRE( pkts[1][2] == 0x10 );
+    REQUIRE( pkts[2][2] == 0x10 );
+    REQUIRE( (pkts[2][3] | (pkts[2][4] << 8)) == 4 + HCI_ACL_PAYLOAD_MAX - 2 * 251 );
+
+    std::vector<uint8_t> pdu;
+    for (const std::vector<uint8_t>& pkt : pkts) {
+      pdu.insert(pdu.end(), pkt.begin() + 5, pkt.end());
+    }
+    REQUIRE( (pdu[0] | (pdu[1] << 8)) == HCI_ACL_PAYLOAD_MAX );
+    REQUIRE( std::vector<uint8_t>(pdu.begin() + 4, pdu.end()) == payload );
+    REQUIRE( HCI.aclPending(SLOW) == 3 );
+  }
+
+  WHEN("Two connections send one at once")
+  {
+    HCI._maxPkt = 0;
+    HCI.sendAclPkt(SLOW, ATT_CID, payload.size(), payload.data());
+    HCI.sendAclPkt(FAST, ATT_CID, payload.size(), payload.data());
+    HCI._maxPkt = 8;
+    HCI.scheduleAcl();
+
+    /* the fragments take turns */
+    const std::vector<std::vector<uint8_t>>& pkts = HCIFakeTransport.sentPkts();
+    REQUIRE( pkts.size() == 6 );
+    for (size_t i = 0; i < pkts.size(); i++) {
+      REQUIRE( pkts[i][1] == (i % 2 ? (uint8_t)FAST : (uint8_t)SLOW) );
+    }
+    REQUIRE( HCI._aclQueued == 0 );
+  }
+
+  HCIFakeTransport.clearSent();
+  HCI.resetAclLinks();
+}
+
+TEST_CASE("ATT notifies the peers that keep up", "[ArduinoBLE::HCI]")
+{
+  uint8_t value[] = { 0x01, 0x02, 0x03 };
+
+  HCI.resetAclLinks();
+  HCI.addAclLink(SLOW);
+  HCI.addAclLink(FAST);
+  HCI._maxPkt = 1;
+  ATT._peers[0].connectionHandle = SLOW;
+  ATT._peers[0].mtu = 23;
+  ATT._peers[1].connectionHandle = FAST;
+  ATT._peers[1].mtu = 23;
+
+  /* the slow peer never completes a packet */
+  for (int i = 0; i < HCI_ACL_LINK_QUEUE + 1; i++) {
+    send(SLOW);
+  }
+
+  WHEN("A value is notified")
+  {
+    int writes = HCIFakeTransport.sentCount();
+
+    /* it is queued for the fast peer only, without waiting for the slow one */
+    REQUIRE( ATT.handleNotify(0x002a, value, sizeof(value)) == sizeof(value) );
+    REQUIRE( HCI.aclQueued(FAST) == 1 );
+    REQUIRE( HCI.aclQueued(SLOW) == HCI_ACL_LINK_QUEUE );
+
+    /* and it takes its turn with the slow one's backlog */
+    numCompPkts(SLOW, 1);
+    numCompPkts(SLOW, 1);
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 2 );
+    REQUIRE( sentHandle() == FAST );
+  }
+
+  WHEN("Every peer is behind")
+  {
+    REQUIRE( ATT.handleNotify(0x002a, value, sizeof(value)) == sizeof(value) );
+    for (int i = 0; i < HCI_ACL_LINK_QUEUE; i++) {
+      ATT.handleNotify(0x002a, value, sizeof(value));
+    }
+
+    REQUIRE( ATT.handleNotify(0x002a, value, sizeof(value)) == 0 );
+  }
+
+  ATT._peers[0].connectionHandle = 0xffff;
+  ATT._peers[1].connectionHandle = 0xffff;
+  HCI.resetAclLinks();
+}
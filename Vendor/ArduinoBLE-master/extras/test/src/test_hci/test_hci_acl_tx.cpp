@@ -0,0 +1,131 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string.h>
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "HCIFakeTransport.h"
+#include "HCI.h"
+#include "ATT.h"
+
+/* ACL packet on handle 0x040 as the controller has to see it */
+static std::vector<uint8_t> aclPkt(uint16_t cid, const std::vector<uint8_t> & payload)
+{
+  uint8_t plen = payload.size();
+  std::vector<uint8_t> pkt = {
+    0x02, 0x40, 0x00,
+    (uint8_t)(plen + 4), 0x00,
+    plen, 0x00,
+    (uint8_t)cid, (uint8_t)(cid >> 8)
+  };
+  pkt.insert(pkt.end(), payload.begin(), payload.end());
+  return pkt;
+}
+
+/* handle 0x040 is connected and the controller has room for one packet */
+static void freeAclBuffer()
+{
+  HCI.resetAclLinks();
+  HCI.addAclLink(0x0040);
+  HCI._maxPkt = 1;
+}
+
+TEST_CASE("HCI sends ACL packets", "[ArduinoBLE::HCI]")
+{
+  std::vector<uint8_t> payload = { 0x12, 0x2a, 0x00, 0x01, 0x02, 0x03 };
+
+  WHEN("The payload is in one piece")
+  {
+    freeAclBuffer();
+    int writes = HCIFakeTransport.sentCount();
+    HCI.sendAclPkt(0x0040, ATT_CID, payload.size(), payload.data());
+
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 1 );
+    REQUIRE( HCIFakeTransport.sent() == aclPkt(ATT_CID, payload) );
+    REQUIRE( HCI._pendingPkt == 1 );
+  }
+
+  WHEN("The payload is in pieces")
+  {
+    HCITransportIov pieces[] = {
+      { &payload[0], 3 },
+      { &payload[3], 3 }
+    };
+
+    freeAclBuffer();
+    int writes = HCIFakeTransport.sentCount();
+    HCI.sendAclPkt(0x0040, ATT_CID, pieces, 2);
+
+    /* one packet, one write */
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 1 );
+    REQUIRE( HCIFakeTransport.sent() == aclPkt(ATT_CID, payload) );
+  }
+
+  WHEN("The payload is built in place")
+  {
+    freeAclBuffer();
+    uint8_t* pkt = HCI.reserveAclPkt(0x0040);
+    memcpy(pkt, payload.data(), payload.size());
+    HCI.sendReservedAclPkt(0x0040, ATT_CID, payload.size());
+
+    REQUIRE( HCIFakeTransport.sent() == aclPkt(ATT_CID, payload) );
+    REQUIRE( HCI._pendingPkt == 1 );
+  }
+
+  HCI.resetAclLinks();
+}
+
+TEST_CASE("ATT sends without copying the value together", "[ArduinoBLE::HCI]")
+{
+  uint8_t value[] = { 0x01, 0x02, 0x03 };
+
+  ATT._peers[0].connectionHandle = 0x0040;
+  ATT._peers[0].mtu = 23;
+
+  WHEN("A notification is sent")
+  {
+    freeAclBuffer();
+    REQUIRE( ATT.handleNotify(0x002a, value, sizeof(value)) == sizeof(value) );
+    REQUIRE( HCIFakeTransport.sent() == aclPkt(ATT_CID, { 0x1b, 0x2a, 0x00, 0x01, 0x02, 0x03 }) );
+  }
+
+  WHEN("A notification is longer than the MTU")
+  {
+    uint8_t longValue[40] = { 0 };
+
+    freeAclBuffer();
+    REQUIRE( ATT.handleNotify(0x002a, longValue, sizeof(longValue)) == 20 );
+    REQUIRE( HCIFakeTransport.sent().size() == 9 + 23 );
+  }
+
+  WHEN("A value is written without response")
+  {
+    freeAclBuffer();
+    ATT.writeCmd(0x0040, 0x002a, value, sizeof(value));
+    REQUIRE( HCIFakeTransport.sent() == aclPkt(ATT_CID, { 0x52, 0x2a, 0x00, 0x01, 0x02, 0x03 }) );
+  }
+
+  ATT._peers[0].connectionHandle = 0xffff;
+  HCI.resetAclLinks();
+}
@@ -0,0 +1,158 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "HCIFakeTransport.h"
+#include "HCI.h"
+
+void set_millis(unsigned long const millis);
+
+static const uint16_t READ_RSSI = 0x1405;
+static const uint16_t SET_SCAN_ENABLE = 0x200c;
+static const uint16_t CREATE_CONN = 0x200d;
+
+struct Finished {
+  int count;
+  uint16_t opcode;
+  int status;
+  std::vector<uint8_t> response;
+};
+
+static void finished(uint16_t opcode, int status, uint8_t responseLength, uint8_t response[], void* context)
+{
+  Finished* result = (Finished*)context;
+
+  result->count++;
+  result->opcode = opcode;
+  result->status = status;
+  result->response.assign(response, response + responseLength);
+}
+
+static void commandComplete(uint8_t ncmd, uint16_t opcode, std::vector<uint8_t> parameters)
+{
+  std::vector<uint8_t> pkt = { 0x04, 0x0e, (uint8_t)(4 + parameters.size()), ncmd, (uint8_t)opcode, (uint8_t)(opcode >> 8), 0x00 };
+  pkt.insert(pkt.end(), parameters.begin(), parameters.end());
+  HCIFakeTransport.receive(pkt.data(), pkt.size());
+}
+
+static void commandStatus(uint8_t ncmd, uint16_t opcode, uint8_t status)
+{
+  uint8_t pkt[] = { 0x04, 0x0f, 0x04, status, ncmd, (uint8_t)opcode, (uint8_t)(opcode >> 8) };
+  HCIFakeTransport.receive(pkt, sizeof(pkt));
+}
+
+static uint16_t sentOpcode()
+{
+  return HCIFakeTransport.sent()[1] | (HCIFakeTransport.sent()[2] << 8);
+}
+
+TEST_CASE("HCI command queue", "[ArduinoBLE::HCI]")
+{
+  set_millis(0);
+  HCI._cmdQueueHead = 0;
+  HCI._cmdQueueCount = 0;
+  HCI._cmdCredits = 1;
+
+  Finished first = {};
+  Finished second = {};
+  uint16_t handle = 0x0040;
+  uint8_t enable[] = { 0x01, 0x00 };
+
+  WHEN("There is one credit")
+  {
+    int writes = HCIFakeTransport.sentCount();
+    REQUIRE( HCI.sendCommandAsync(READ_RSSI, sizeof(handle), &handle, finished, &first) == 0 );
+    REQUIRE( HCI.sendCommandAsync(SET_SCAN_ENABLE, sizeof(enable), enable, finished, &second) == 0 );
+
+    /* the second one waits for the credit of the first */
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 1 );
+    REQUIRE( sentOpcode() == READ_RSSI );
+    HCI.poll();
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 1 );
+
+    commandComplete(1, READ_RSSI, { 0x40, 0x00, 0xce });
+    HCI.poll();
+    REQUIRE( first.count == 1 );
+    REQUIRE( first.status == 0 );
+    REQUIRE( first.response == std::vector<uint8_t>({ 0x40, 0x00, 0xce }) );
+
+    /* it was copied, it went out after the caller's parameters were gone */
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 2 );
+    REQUIRE( HCIFakeTransport.sent() == std::vector<uint8_t>({ 0x01, 0x0c, 0x20, 0x02, 0x01, 0x00 }) );
+    REQUIRE( second.count == 0 );
+
+    commandComplete(1, SET_SCAN_ENABLE, {});
+    HCI.poll();
+    REQUIRE( second.count == 1 );
+    REQUIRE( !HCI.commandsPending() );
+  }
+
+  WHEN("The controller takes several at once")
+  {
+    HCI._cmdCredits = 2;
+    int writes = HCIFakeTransport.sentCount();
+    HCI.sendCommandAsync(CREATE_CONN, 0, NULL, finished, &first);
+    HCI.sendCommandAsync(READ_RSSI, sizeof(handle), &handle, finished, &second);
+    REQUIRE( HCIFakeTransport.sentCount() == writes + 2 );
+
+    /* results are matched by opcode, not by order */
+    commandComplete(1, READ_RSSI, { 0x40, 0x00, 0xce });
+    commandStatus(1, CREATE_CONN, 0x0c);
+    HCI.poll();
+    REQUIRE( second.opcode == READ_RSSI );
+    REQUIRE( second.status == 0 );
+    REQUIRE( first.opcode == CREATE_CONN );
+    REQUIRE( first.status == 0x0c );
+    REQUIRE( first.response.empty() );
+  }
+
+  WHEN("The controller never answers")
+  {
+    HCI.sendCommandAsync(READ_RSSI, sizeof(handle), &handle, finished, &first);
+    HCI.sendCommandAsync(SET_SCAN_ENABLE, sizeof(enable), enable, finished, &second);
+
+    set_millis(HCI_COMMAND_TIMEOUT - 1);
+    HCI.poll();
+    REQUIRE( first.count == 0 );
+
+    /* the credit comes back with the timeout and the next one goes */
+    set_millis(HCI_COMMAND_TIMEOUT);
+    HCI.poll();
+    REQUIRE( first.count == 1 );
+    REQUIRE( first.status == -1 );
+    REQUIRE( sentOpcode() == SET_SCAN_ENABLE );
+  }
+
+  WHEN("The queue is full")
+  {
+    for (int i = 0; i < HCI_COMMAND_QUEUE_SIZE; i++) {
+      REQUIRE( HCI.sendCommandAsync(READ_RSSI, sizeof(handle), &handle) == 0 );
+    }
+    REQUIRE( HCI.sendCommandAsync(READ_RSSI, sizeof(handle), &handle) == -1 );
+  }
+
+  HCI._cmdQueueCount = 0;
+  set_millis(0);
+}
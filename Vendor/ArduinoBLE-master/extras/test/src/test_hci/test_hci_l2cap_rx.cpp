@@ -0,0 +1,137 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "HCIFakeTransport.h"
+#include "HCI.h"
+#include "ATT.h"
+
+/* ACL packet from the controller, start or continuing fragment of an L2CAP PDU */
+static void receiveFragment(uint16_t handle, bool start, const uint8_t* data, uint16_t length)
+{
+  uint16_t handleWithFlags = handle | (start ? 0x2000 : 0x1000);
+  std::vector<uint8_t> pkt = {
+    0x02,
+    (uint8_t)handleWithFlags, (uint8_t)(handleWithFlags >> 8),
+    (uint8_t)length, (uint8_t)(length >> 8)
+  };
+  pkt.insert(pkt.end(), data, data + length);
+  HCIFakeTransport.receive(pkt.data(), pkt.size());
+  HCI.poll();
+}
+
+/* The rest of a PDU from offset on, in fragments as long as the controller's */
+static void receiveRest(uint16_t handle, const std::vector<uint8_t> & pdu, size_t offset)
+{
+  for (; offset < pdu.size(); offset += 251) {
+    size_t length = (pdu.size() - offset) < 251 ? (pdu.size() - offset) : 251;
+    receiveFragment(handle, false, &pdu[offset], length);
+  }
+}
+
+/* L2CAP PDU of an ATT read response with length bytes of value */
+static std::vector<uint8_t> readRespPdu(uint16_t length)
+{
+  std::vector<uint8_t> pdu = { (uint8_t)(length + 1), (uint8_t)((length + 1) >> 8), 0x04, 0x00, 0x0b };
+  for (uint16_t i = 0; i < length; i++) {
+    pdu.push_back(i);
+  }
+  return pdu;
+}
+
+TEST_CASE("HCI reassembles L2CAP PDUs per connection", "[ArduinoBLE::HCI]")
+{
+  uint8_t response[ATT_MAX_MTU];
+
+  HCI.resetAclLinks();
+  ATT._pendingResp.connectionHandle = 0x0040;
+  ATT._pendingResp.op = 0x0b; // Read Response
+  ATT._pendingResp.buffer = response;
+  ATT._pendingResp.length = 0;
+
+  /* the longest read response the largest MTU allows */
+  std::vector<uint8_t> pdu = readRespPdu(ATT_MAX_MTU - 1);
+
+  WHEN("The fragments of two connections interleave")
+  {
+    std::vector<uint8_t> other = readRespPdu(100);
+
+    receiveFragment(0x0040, true, &pdu[0], 251);
+    receiveFragment(0x0041, true, &other[0], 50);
+    receiveFragment(0x0040, false, &pdu[251], 251);
+    receiveFragment(0x0041, false, &other[50], other.size() - 50);
+    REQUIRE( ATT._pendingResp.length == 0 );
+    receiveFragment(0x0040, false, &pdu[502], pdu.size() - 502);
+
+    /* each went to its own buffer and both are free again */
+    REQUIRE( ATT._pendingResp.length == ATT_MAX_MTU );
+    REQUIRE( std::vector<uint8_t>(response, response + ATT_MAX_MTU) == std::vector<uint8_t>(pdu.begin() + 4, pdu.end()) );
+    REQUIRE( HCI.l2CapRx(0x0040) == NULL );
+    REQUIRE( HCI.l2CapRx(0x0041) == NULL );
+  }
+
+  WHEN("The L2CAP header is split")
+  {
+    receiveFragment(0x0040, true, &pdu[0], 2);
+    receiveRest(0x0040, pdu, 2);
+
+    REQUIRE( ATT._pendingResp.length == ATT_MAX_MTU );
+  }
+
+  WHEN("A fragment comes without its start")
+  {
+    receiveFragment(0x0040, false, &pdu[251], 251);
+
+    REQUIRE( HCI.l2CapRx(0x0040) == NULL );
+  }
+
+  WHEN("A PDU grows past its L2CAP length")
+  {
+    receiveFragment(0x0040, true, &pdu[0], 251);
+    receiveFragment(0x0040, false, &pdu[251], 251);
+    receiveFragment(0x0040, false, &pdu[251], 251);
+
+    /* it is dropped, not handed on */
+    REQUIRE( ATT._pendingResp.length == 0 );
+    REQUIRE( HCI.l2CapRx(0x0040) == NULL );
+  }
+
+  WHEN("More connections are in the middle of a PDU than there are buffers")
+  {
+    for (uint16_t handle = 0x0041; handle < 0x0041 + HCI_L2CAP_RX_BUFFERS; handle++) {
+      receiveFragment(handle, true, &pdu[0], 251);
+    }
+
+    /* the start that finds none is dropped, the others still complete */
+    receiveFragment(0x0040, true, &pdu[0], 251);
+    REQUIRE( HCI.l2CapRx(0x0040) == NULL );
+    receiveRest(0x0041, pdu, 251);
+    REQUIRE( HCI.l2CapRx(0x0041) == NULL );
+    REQUIRE( HCI.l2CapRx(0x0042) != NULL );
+  }
+
+  HCI.resetAclLinks();
+  ATT._pendingResp.connectionHandle = 0xffff;
+}
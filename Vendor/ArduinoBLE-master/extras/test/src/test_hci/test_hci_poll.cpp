@@ -0,0 +1,176 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "HCIFakeTransport.h"
+#include "HCI.h"
+
+/* ATT notification of a 20 byte value on a connection nobody knows, dropped by ATT */
+static std::vector<uint8_t> notificationPkt()
+{
+  std::vector<uint8_t> pkt = {
+    0x02,                   // ACL data
+    0x40, 0x20,             // handle 0x040, first automatically flushable
+    0x1b, 0x00,             // ACL length
+    0x17, 0x00, 0x04, 0x00, // L2CAP length, ATT cid
+    0x1b, 0x2a, 0x00        // notify, attribute handle
+  };
+  for (uint8_t i = 0; i < 20; i++) {
+    pkt.push_back(i);
+  }
+  return pkt;
+}
+
+/* Number of Completed Packets, one packet on handle 0x040 */
+static std::vector<uint8_t> numCompPktsPkt()
+{
+  return { 0x04, 0x13, 0x05, 0x01, 0x40, 0x00, 0x01, 0x00 };
+}
+
+/* packets the controller still has of handle 0x040 */
+static void pendingPkts(uint8_t count)
+{
+  HCI.resetAclLinks();
+  HCI.addAclLink(0x0040);
+  HCI._aclLinks[0].pending = count;
+  HCI._pendingPkt = count;
+}
+
+static void receive(const std::vector<uint8_t> & pkt)
+{
+  HCIFakeTransport.receive(pkt.data(), pkt.size());
+}
+
+/* Feeds the packets, polling after every chunk bytes, until all of them are handled */
+static void receiveInChunks(const std::vector<uint8_t> & bytes, size_t chunk)
+{
+  for (size_t i = 0; i < bytes.size(); i += chunk) {
+    size_t length = (bytes.size() - i) < chunk ? (bytes.size() - i) : chunk;
+    HCIFakeTransport.receive(&bytes[i], length);
+    HCI.poll();
+  }
+}
+
+TEST_CASE("HCI poll frames packets", "[ArduinoBLE::HCI]")
+{
+  std::vector<uint8_t> bytes;
+  for (int i = 0; i < 10; i++) {
+    std::vector<uint8_t> notification = notificationPkt();
+    std::vector<uint8_t> numCompPkts = numCompPktsPkt();
+    bytes.insert(bytes.end(), notification.begin(), notification.end());
+    bytes.insert(bytes.end(), numCompPkts.begin(), numCompPkts.end());
+  }
+
+  WHEN("Packets arrive whole or split at any byte")
+  {
+    for (size_t chunk : { (size_t)1, (size_t)2, (size_t)3, (size_t)7, bytes.size() }) {
+      pendingPkts(100);
+      receiveInChunks(bytes, chunk);
+
+      /* every event was seen, nothing is left half read */
+      REQUIRE( HCI.aclPending(0x0040) == 90 );
+      REQUIRE( HCI._recvIndex == 0 );
+      REQUIRE( HCI._recvLength == 0 );
+    }
+  }
+
+  WHEN("The transport reads byte by byte")
+  {
+    HCIFakeTransport.setBulkRead(false);
+    pendingPkts(100);
+    receiveInChunks(bytes, 5);
+    HCIFakeTransport.setBulkRead(true);
+
+    REQUIRE( HCI.aclPending(0x0040) == 90 );
+    REQUIRE( HCI._recvIndex == 0 );
+  }
+
+  WHEN("A packet does not fit the receive buffer")
+  {
+    std::vector<uint8_t> oversized = { 0x02, 0x40, 0x20, 0x00, 0x02 };
+    oversized.resize(5 + 0x200, 0xaa);
+
+    pendingPkts(10);
+    receiveInChunks(oversized, 100);
+    receive(numCompPktsPkt());
+    HCI.poll();
+
+    /* it is dropped and the next packet is still found */
+    REQUIRE( HCI._recvSkip == 0 );
+    REQUIRE( HCI.aclPending(0x0040) == 9 );
+  }
+
+  WHEN("A byte is not a packet type")
+  {
+    pendingPkts(10);
+    receive({ 0xff });
+    receive(numCompPktsPkt());
+    HCI.poll();
+
+    REQUIRE( HCI.aclPending(0x0040) == 9 );
+  }
+
+  HCI.resetAclLinks();
+}
+
+/*
+ * Times HCI.poll() on a burst of notifications, with the bulk read of the transport
+ * and with the byte by byte default every transport had before.
+ */
+static unsigned long nsPerNotification(bool bulkRead)
+{
+  const int BURST = 32;
+  const int BURSTS = 5000;
+
+  std::vector<uint8_t> burst;
+  for (int i = 0; i < BURST; i++) {
+    std::vector<uint8_t> notification = notificationPkt();
+    burst.insert(burst.end(), notification.begin(), notification.end());
+  }
+
+  HCIFakeTransport.setBulkRead(bulkRead);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BURSTS; i++) {
+    HCIFakeTransport.receive(burst.data(), burst.size());
+    HCI.poll();
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  HCIFakeTransport.setBulkRead(true);
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (BURST * BURSTS);
+}
+
+TEST_CASE("HCI poll benchmark", "[ArduinoBLE::HCI][benchmark]")
+{
+  unsigned long byteByByte = nsPerNotification(false);
+  unsigned long bulk = nsPerNotification(true);
+
+  printf("HCI poll: %lu ns per notification byte by byte, %lu ns in bulk\n", byteByByte, bulk);
+
+  REQUIRE( HCI._recvIndex == 0 );
+  REQUIRE( bulk < byteByByte );
+}
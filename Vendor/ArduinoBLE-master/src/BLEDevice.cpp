@@ -261,6 +261,83 @@ int BLEDevice::rssi()
   return _rssi;
 }
 
+static BLEDevice rssiDevice;
+static BLERssiHandler rssiHandler = NULL;
+
+static void rssiRead(uint16_t /*opcode*/, int status, uint8_t responseLength, uint8_t response[], void* /*context*/)
+{
+  BLERssiHandler handler = rssiHandler;
+  rssiHandler = NULL;
+
+  struct __attribute__ ((packed)) HCIReadRssi {
+    uint16_t handle;
+    int8_t rssi;
+  } *readRssi = (HCIReadRssi*)response;
+
+  if (status == 0 && responseLength >= sizeof(HCIReadRssi) && handler) {
+    handler(rssiDevice, readRssi->rssi);
+  }
+}
+
+bool BLEDevice::requestRssi(BLERssiHandler handler)
+{
+  uint16_t handle = ATT.connectionHandle(_addressType, _address);
+
+  if (handle == 0xffff || rssiHandler) {
+    return false;
+  }
+
+  if (HCI.readRssiAsync(handle, rssiRead) != 0) {
+    return false;
+  }
+
+  rssiDevice = *this;
+  rssiHandler = handler;
+
+  return true;
+}
+
+bool BLEDevice::connectionParameters(uint16_t& interval, uint16_t& latency, uint16_t& supervisionTimeout) const
+{
+  uint16_t handle = ATT.connectionHandle(_addressType, _address);
+
+  if (handle == 0xffff) {
+    return false;
+  }
+
+  return ATT.connectionParameters(handle, interval, latency, supervisionTimeout);
+}
+
+int BLEDevice::connectionInterval() const
+{
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t supervisionTimeout;
+
+  if (!connectionParameters(interval, latency, supervisionTimeout)) {
+    return 0;
+  }
+
+  return interval;
+}
+
+bool BLEDevice::updateConnectionParameters(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t supervisionTimeout)
+{
+  uint16_t handle = ATT.connectionHandle(_addressType, _address);
+
+  if (handle == 0xffff) {
+    return false;
+  }
+
+  if (ATT.role(handle) == 0x00) {
+    // we are the central, the controller can apply it directly
+    return HCI.leConnUpdate(handle, minInterval, maxInterval, latency, supervisionTimeout) == 0;
+  }
+
+  L2CAPSignaling.requestConnectionParameters(handle, minInterval, maxInterval, latency, supervisionTimeout);
+  return true;
+}
+
 bool BLEDevice::connect()
 {
   return ATT.connect(_addressType, _address);
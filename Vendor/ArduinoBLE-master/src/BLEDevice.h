@@ -35,6 +35,7 @@ enum BLEDeviceEvent {
 class BLEDevice;
 
 typedef void (*BLEDeviceEventHandler)(BLEDevice device);
+typedef void (*BLERssiHandler)(BLEDevice device, int rssi);
 
 class BLEDevice {
 public:
@@ -68,6 +69,15 @@ public:
   int manufacturerData(uint8_t value[], int length) const;
 
   virtual int rssi();
+  // reads the RSSI without waiting for it, the handler gets it from BLE.poll();
+  // one read at a time, false if one is still going or the device is not connected
+  bool requestRssi(BLERssiHandler handler);
+
+  // parameters currently in use on the connection, in 1.25 ms / connection events / 10 ms units
+  bool connectionParameters(uint16_t& interval, uint16_t& latency, uint16_t& supervisionTimeout) const;
+  int connectionInterval() const;
+  // asks for new parameters, check connectionParameters() once the update completed
+  bool updateConnectionParameters(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t supervisionTimeout);
 
   bool connect();
   bool discoverAttributes();
@@ -96,6 +106,7 @@ public:
 protected:
   friend class ATTClass;
   friend class GAPClass;
+  friend class BLELocalDevice;
 
   BLEDevice(uint8_t addressType, uint8_t address[6]);
 
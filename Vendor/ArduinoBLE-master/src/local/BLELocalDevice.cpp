@@ -21,6 +21,7 @@
 #include "utility/HCI.h"
 #include "utility/GAP.h"
 #include "utility/GATT.h"
+#include "utility/GATTCache.h"
 #include "utility/L2CAPSignaling.h"
 
 #include "BLELocalDevice.h"
@@ -408,6 +409,38 @@ BLEDevice BLELocalDevice::available()
   return GAP.available();
 }
 
+BLEDevice BLELocalDevice::connectKnown(const char* address)
+{
+  uint8_t peerBdaddr[6];
+  uint8_t peerBdaddrType;
+
+  // "aa:bb:cc:dd:ee:ff", most significant byte first
+  if (strlen(address) != 17) {
+    return BLEDevice();
+  }
+
+  for (int i = 0; i < 6; i++) {
+    const char* byte = &address[i * 3];
+    char* end;
+
+    if (!isxdigit(byte[0]) || !isxdigit(byte[1])) {
+      return BLEDevice();
+    }
+
+    peerBdaddr[5 - i] = strtoul(byte, &end, 16);
+
+    if (end != byte + 2 || (i < 5 && *end != ':')) {
+      return BLEDevice();
+    }
+  }
+
+  if (!ATT.connectKnown(peerBdaddr, peerBdaddrType)) {
+    return BLEDevice();
+  }
+
+  return BLEDevice(peerBdaddrType, peerBdaddr);
+}
+
 void BLELocalDevice::setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler eventHandler)
 {
   if (event == BLEDiscovered) {
@@ -471,6 +504,18 @@ void BLELocalDevice::setStoreLTK(int (*storeLTK)(uint8_t*, uint8_t*)){
 void BLELocalDevice::setStoreIRK(int (*storeIRK)(uint8_t*, uint8_t*)){
   HCI._storeIRK = storeIRK;
 }
+void BLELocalDevice::setGattCache(bool enabled){
+  GATTCache.setEnabled(enabled);
+}
+void BLELocalDevice::clearGattCache(){
+  GATTCache.clear();
+}
+void BLELocalDevice::setStoreGattCache(int (*storeGattCache)(const uint8_t*, uint16_t)){
+  GATTCache.setStore(storeGattCache);
+}
+void BLELocalDevice::setLoadGattCache(int (*loadGattCache)(uint8_t*, uint16_t)){
+  GATTCache.setLoad(loadGattCache);
+}
 void BLELocalDevice::setDisplayCode(void (*displayCode)(uint32_t confirmationCode)){
   HCI._displayCode = displayCode;
 }
@@ -75,6 +75,12 @@ public:
   virtual BLEDevice central();
   virtual BLEDevice available();
 
+  // Connects to a peer whose address is already known, as printed by BLEDevice::address(),
+  // without scanning: the controller connects on the first advert it receives from that
+  // address. Waits as long as BLEDevice::connect() does, the returned device is false on timeout.
+  virtual BLEDevice connectKnown(const char* address);
+#define ARDUINO_BLE_CONNECT_KNOWN
+
   virtual void setAdvertisingInterval(uint16_t advertisingInterval);
   virtual void setConnectionInterval(uint16_t minimumConnectionInterval, uint16_t maximumConnectionInterval);
   virtual void setSupervisionTimeout(uint16_t supervisionTimeout);
@@ -105,6 +111,15 @@ public:
   // LTK - 16 octet LTK for the mac address
   virtual void setGetLTK(int (*getLTK)(uint8_t* address, uint8_t* LTK));
 
+  // Keeps the attribute handles of peers this device connected to, so that
+  // discoverAttributes() skips discovery on reconnect, see utility/GATTCache.h
+  virtual void setGattCache(bool enabled);
+  virtual void clearGattCache();
+  // data - the whole GATT cache, GATT_CACHE_STORAGE_SIZE bytes, to keep it in flash
+  virtual void setStoreGattCache(int (*storeGattCache)(const uint8_t* data, uint16_t length));
+  // data - buffer for the GATT cache, return the number of bytes read
+  virtual void setLoadGattCache(int (*loadGattCache)(uint8_t* data, uint16_t length));
+
   virtual void setDisplayCode(void (*displayCode)(uint32_t confirmationCode));
   virtual void setBinaryConfirmPairing(bool (*binaryConfirmPairing)());
   uint8_t BDaddress[6];
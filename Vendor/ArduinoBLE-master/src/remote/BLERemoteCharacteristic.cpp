@@ -20,6 +20,7 @@
 #include "BLEProperty.h"
 
 #include "utility/ATT.h"
+#include "utility/GATTCache.h"
 
 #include "BLERemoteCharacteristic.h"
 
@@ -35,6 +36,8 @@ BLERemoteCharacteristic::BLERemoteCharacteristic(const uint8_t uuid[], uint8_t u
   _valueLength(0),
   _valueUpdated(false),
   _updatedValueRead(true),
+  _cccdValue(0x0000),
+  _cccdWritten(false),
   _valueUpdatedEventHandler(NULL)
 {
 }
@@ -165,7 +168,7 @@ bool BLERemoteCharacteristic::read()
     return false;
   }
   
-  uint8_t resp[256];
+  uint8_t resp[ATT_MAX_MTU];
 
   int respLength = ATT.readReq(_connectionHandle, _valueHandle, resp);
 
@@ -195,24 +198,39 @@ bool BLERemoteCharacteristic::read()
 
 bool BLERemoteCharacteristic::writeCccd(uint16_t value)
 {
+  if (_cccdWritten && _cccdValue == value) {
+    // already set on this connection, e.g. when restored from the GATT cache
+    return true;
+  }
+
+  bool written = false;
+  bool found = false;
   int numDescriptors = descriptorCount();
 
   for (int i = 0; i < numDescriptors; i++) {
     BLERemoteDescriptor* d = descriptor(i);
 
     if (strcmp(d->uuid(), "2902") == 0) {
-      return d->writeValue((uint8_t*)&value, sizeof(value));
+      written = d->writeValue((uint8_t*)&value, sizeof(value));
+      found = true;
+      break;
     }
   }
 
-  if (_properties & (BLENotify | BLEIndicate)) {
+  if (!found && (_properties & (BLENotify | BLEIndicate))) {
     // no CCCD descriptor found, fallback to _valueHandle + 1
     BLERemoteDescriptor cccd(NULL, 0, _connectionHandle, _valueHandle + 1);
 
-    return cccd.writeValue((uint8_t*)&value, sizeof(value));
+    written = cccd.writeValue((uint8_t*)&value, sizeof(value));
+  }
+
+  if (written) {
+    _cccdValue = value;
+    _cccdWritten = true;
+    GATTCache.cccdWritten(_connectionHandle, _valueHandle, value);
   }
 
-  return false;
+  return written;
 }
 
 uint16_t BLERemoteCharacteristic::valueHandle() const
@@ -55,6 +55,7 @@ public:
 
 protected:
   friend class ATTClass;
+  friend class GATTCacheClass;
 
   uint16_t startHandle() const;
   uint16_t valueHandle() const;
@@ -76,6 +77,10 @@ private:
   bool _valueUpdated;
   bool _updatedValueRead;
 
+  // last value written to the peer's CCCD on this connection
+  uint16_t _cccdValue;
+  bool _cccdWritten;
+
   BLELinkedList<BLERemoteDescriptor*> _descriptors;
 
   BLECharacteristicEventHandler _valueUpdatedEventHandler;
@@ -100,7 +100,7 @@ bool BLERemoteDescriptor::read()
     return false;
   }
 
-  uint8_t resp[256];
+  uint8_t resp[ATT_MAX_MTU];
 
   int respLength = ATT.readReq(_connectionHandle, _handle, resp);
 
@@ -37,6 +37,7 @@ public:
 
 protected:
   friend class ATTClass;
+  friend class GATTCacheClass;
   uint16_t handle() const;
 
 private:
@@ -21,6 +21,7 @@
 
 #include "HCI.h"
 #include "GATT.h"
+#include "GATTCache.h"
 
 #include "local/BLELocalAttribute.h"
 #include "local/BLELocalCharacteristic.h"
@@ -98,6 +99,9 @@ ATTClass::ATTClass() :
     _peers[i].addressType = 0x00;
     memset(_peers[i].address, 0x00, sizeof(_peers[i].address));
     _peers[i].mtu = 23;
+    _peers[i].interval = 0;
+    _peers[i].latency = 0;
+    _peers[i].supervisionTimeout = 0;
     _peers[i].device = NULL;
     _peers[i].encryption = 0x0;
   }
@@ -114,8 +118,7 @@ ATTClass::~ATTClass()
 
 bool ATTClass::connect(uint8_t peerBdaddrType, uint8_t peerBdaddr[6])
 {
-  if (HCI.leCreateConn(0x0060, 0x0030, 0x00, peerBdaddrType, peerBdaddr, 0x00,
-                        0x0006, 0x000c, 0x0000, 0x00c8, 0x0004, 0x0006) != 0) {
+  if (createConnection(0x00, peerBdaddrType, peerBdaddr) != 0) {
     return false;
   }
 
@@ -138,6 +141,58 @@ bool ATTClass::connect(uint8_t peerBdaddrType, uint8_t peerBdaddr[6])
   return isConnected;
 }
 
+bool ATTClass::connectKnown(const uint8_t peerBdaddr[6], uint8_t& peerBdaddrType)
+{
+  // whether the peer uses its public or a static random address is not known up front, accept either
+  if (HCI.leClearFilterAcceptList() != 0 ||
+      HCI.leAddDeviceToFilterAcceptList(0x00, peerBdaddr) != 0 ||
+      HCI.leAddDeviceToFilterAcceptList(0x01, peerBdaddr) != 0) {
+    return false;
+  }
+
+  // with the filter accept list as initiator filter policy the controller connects on the
+  // first advert of the peer, the host sees no advertising reports at all
+  uint8_t unused[6] = { 0 };
+
+  if (createConnection(0x01, 0x00, unused) != 0) {
+    return false;
+  }
+
+  for (unsigned long start = millis(); (millis() - start) < _timeout;) {
+    HCI.poll();
+
+    for (uint8_t addressType = 0x00; addressType <= 0x01; addressType++) {
+      if (connected(addressType, peerBdaddr)) {
+        peerBdaddrType = addressType;
+        return true;
+      }
+    }
+  }
+
+  HCI.leCancelConn();
+
+  return false;
+}
+
+int ATTClass::createConnection(uint8_t initiatorFilter, uint8_t peerBdaddrType, uint8_t peerBdaddr[6])
+{
+  uint16_t minInterval = 0x0006;
+  uint16_t maxInterval = 0x000c;
+  uint16_t supervisionTimeout = 0x00c8;
+
+  // ask for the parameters set with BLE.setConnectionInterval / setSupervisionTimeout straight away
+  if (L2CAPSignaling.minInterval() && L2CAPSignaling.maxInterval()) {
+    minInterval = L2CAPSignaling.minInterval();
+    maxInterval = L2CAPSignaling.maxInterval();
+  }
+  if (L2CAPSignaling.supervisionTimeout()) {
+    supervisionTimeout = L2CAPSignaling.supervisionTimeout();
+  }
+
+  return HCI.leCreateConn(0x0060, 0x0030, initiatorFilter, peerBdaddrType, peerBdaddr, 0x00,
+                          minInterval, maxInterval, 0x0000, supervisionTimeout, 0x0004, 0x0006);
+}
+
 bool ATTClass::disconnect(uint8_t peerBdaddrType, uint8_t peerBdaddr[6])
 {
   uint16_t connHandle = connectionHandle(peerBdaddrType, peerBdaddr);
@@ -172,6 +227,7 @@ bool ATTClass::discoverAttributes(uint8_t peerBdaddrType, uint8_t peerBdaddr[6],
 
   // find the device entry for the peeer
   BLERemoteDevice* device = NULL;
+  int peerIndex = -1;
 
   for (int i = 0; i < ATT_MAX_PEERS; i++) {
     if (_peers[i].connectionHandle == connHandle) {
@@ -180,6 +236,7 @@ bool ATTClass::discoverAttributes(uint8_t peerBdaddrType, uint8_t peerBdaddr[6],
       }
 
       device = _peers[i].device;
+      peerIndex = i;
 
       break;
     }
@@ -189,9 +246,31 @@ bool ATTClass::discoverAttributes(uint8_t peerBdaddrType, uint8_t peerBdaddr[6],
     return false;
   }
 
+  // the GATT cache only holds complete attribute tables
+  bool cached = (serviceUuidFilter == NULL && GATTCache.enabled());
+  uint8_t identityType = 0x00;
+  uint8_t identity[6] = { 0 };
+  uint8_t hash[GATT_CACHE_HASH_SIZE];
+  bool hasHash = false;
+
   if (serviceUuidFilter == NULL) {
     // clear existing services
     device->clearServices();
+
+    if (cached) {
+      identityAddress(peerIndex, identityType, identity);
+      hasHash = readDatabaseHash(connHandle, hash);
+
+      if (!connected(connHandle)) {
+        return false;
+      }
+
+      bool bonded = (getPeerEncryption(connHandle) & PEER_ENCRYPTION::ENCRYPTED_AES) != 0;
+
+      if (GATTCache.restore(identityType, identity, hasHash ? hash : NULL, bonded, connHandle, device)) {
+        return true;
+      }
+    }
   } else {
     int serviceCount = device->serviceCount();
   
@@ -220,11 +299,19 @@ bool ATTClass::discoverAttributes(uint8_t peerBdaddrType, uint8_t peerBdaddr[6],
     return false;
   }
 
+  if (cached) {
+    GATTCache.store(identityType, identity, hasHash ? hash : NULL, connHandle, device);
+  }
+
   return true;
 }
 
 void ATTClass::setMaxMtu(uint16_t maxMtu)
 {
+  if (maxMtu > ATT_MAX_MTU) {
+    maxMtu = ATT_MAX_MTU;
+  }
+
   _maxMtu = maxMtu;
 }
 
@@ -234,8 +321,8 @@ void ATTClass::setTimeout(unsigned long timeout)
 }
 
 void ATTClass::addConnection(uint16_t handle, uint8_t role, uint8_t peerBdaddrType,
-                              uint8_t peerBdaddr[6], uint16_t /*interval*/,
-                              uint16_t /*latency*/, uint16_t /*supervisionTimeout*/,
+                              uint8_t peerBdaddr[6], uint16_t interval,
+                              uint16_t latency, uint16_t supervisionTimeout,
                               uint8_t /*masterClockAccuracy*/)
 {
   int peerIndex = -1;
@@ -255,6 +342,9 @@ void ATTClass::addConnection(uint16_t handle, uint8_t role, uint8_t peerBdaddrTy
   _peers[peerIndex].connectionHandle = handle;
   _peers[peerIndex].role = role;
   _peers[peerIndex].mtu = 23;
+  _peers[peerIndex].interval = interval;
+  _peers[peerIndex].latency = latency;
+  _peers[peerIndex].supervisionTimeout = supervisionTimeout;
   _peers[peerIndex].addressType = peerBdaddrType;
   memcpy(_peers[peerIndex].address, peerBdaddr, sizeof(_peers[peerIndex].address));
   uint8_t BDADDr[6];
@@ -275,7 +365,7 @@ void ATTClass::addConnection(uint16_t handle, uint8_t role, uint8_t peerBdaddrTy
   }
 }
 
-void ATTClass::handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::handleData(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   uint8_t opcode = data[0];
 
@@ -302,7 +392,8 @@ void ATTClass::handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[
 #ifdef _BLE_TRACE_
       Serial.println("MTU");
 #endif
-      mtuReq(connectionHandle, dlen, data);
+      // fixed size request, anything past 8 bit lengths fails its length check
+      mtuReq(connectionHandle, (uint8_t)min(dlen, (uint16_t)0xff), data);
       break;
 
     case ATT_OP_MTU_RESP:
@@ -313,7 +404,7 @@ void ATTClass::handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[
 #ifdef _BLE_TRACE_
       Serial.println("Find info");
 #endif
-      findInfoReq(connectionHandle, mtu, dlen, data);
+      findInfoReq(connectionHandle, mtu, (uint8_t)min(dlen, (uint16_t)0xff), data);
       break;
 
     case ATT_OP_FIND_INFO_RESP:
@@ -434,11 +525,16 @@ void ATTClass::removeConnection(uint16_t handle, uint8_t /*reason*/)
     _eventHandlers[BLEDisconnected](bleDevice);
   }
 
+  GATTCache.disconnected(handle);
+
   _peers[peerIndex].connectionHandle = 0xffff;
   _peers[peerIndex].role = 0x00;
   _peers[peerIndex].addressType = 0x00;
   memset(_peers[peerIndex].address, 0x00, sizeof(_peers[peerIndex].address));
   _peers[peerIndex].mtu = 23;
+  _peers[peerIndex].interval = 0;
+  _peers[peerIndex].latency = 0;
+  _peers[peerIndex].supervisionTimeout = 0;
   _peers[peerIndex].encryption = PEER_ENCRYPTION::NO_ENCRYPTION;
   _peers[peerIndex].IOCap[0] = 0;
   _peers[peerIndex].IOCap[1] = 0;
@@ -538,6 +634,43 @@ uint16_t ATTClass::mtu(uint16_t handle) const
   return 23;
 }
 
+bool ATTClass::connectionParameters(uint16_t handle, uint16_t& interval, uint16_t& latency, uint16_t& supervisionTimeout) const
+{
+  for (int i = 0; i < ATT_MAX_PEERS; i++) {
+    if (_peers[i].connectionHandle == handle) {
+      interval = _peers[i].interval;
+      latency = _peers[i].latency;
+      supervisionTimeout = _peers[i].supervisionTimeout;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint8_t ATTClass::role(uint16_t handle) const
+{
+  for (int i = 0; i < ATT_MAX_PEERS; i++) {
+    if (_peers[i].connectionHandle == handle) {
+      return _peers[i].role;
+    }
+  }
+
+  return 0x00;
+}
+
+void ATTClass::updateConnectionParameters(uint16_t handle, uint16_t interval, uint16_t latency, uint16_t supervisionTimeout)
+{
+  for (int i = 0; i < ATT_MAX_PEERS; i++) {
+    if (_peers[i].connectionHandle == handle) {
+      _peers[i].interval = interval;
+      _peers[i].latency = latency;
+      _peers[i].supervisionTimeout = supervisionTimeout;
+      return;
+    }
+  }
+}
+
 bool ATTClass::disconnect()
 {
   int numDisconnects = 0;
@@ -607,21 +740,27 @@ int ATTClass::handleNotify(uint16_t handle, const uint8_t* value, int length)
       continue;
     }
 
-    uint8_t notification[_peers[i].mtu];
+    // built in the outgoing packet, the value is copied once
+    uint8_t* notification = HCI.reserveAclPkt(_peers[i].connectionHandle);
     uint16_t notificationLength = 0;
 
+    if (!notification) {
+      // this peer is behind, the next value goes out when it caught up
+      continue;
+    }
+
     notification[0] = ATT_OP_HANDLE_NOTIFY;
     notificationLength++;
 
     memcpy(&notification[1], &handle, sizeof(handle));
     notificationLength += sizeof(handle);
 
-    length = min((uint16_t)(_peers[i].mtu - notificationLength), (uint16_t)length);
+    length = min((uint16_t)(min(_peers[i].mtu, (uint16_t)HCI_ACL_PAYLOAD_MAX) - notificationLength), (uint16_t)length);
     memcpy(&notification[notificationLength], value, length);
     notificationLength += length;
 
     /// TODO: Set encryption requirement on notify.
-    HCI.sendAclPkt(_peers[i].connectionHandle, ATT_CID, notificationLength, notification);
+    HCI.sendReservedAclPkt(_peers[i].connectionHandle, ATT_CID, notificationLength);
 
     numNotifications++;
   }
@@ -638,22 +777,22 @@ int ATTClass::handleInd(uint16_t handle, const uint8_t* value, int length)
       continue;
     }
 
-    uint8_t indication[_peers[i].mtu];
-    uint16_t indicationLength = 0;
-
-    indication[0] = ATT_OP_HANDLE_IND;
-    indicationLength++;
+    struct __attribute__ ((packed)) {
+      uint8_t op;
+      uint16_t handle;
+    } indication = { ATT_OP_HANDLE_IND, handle };
 
-    memcpy(&indication[1], &handle, sizeof(handle));
-    indicationLength += sizeof(handle);
+    length = min((uint16_t)(min(_peers[i].mtu, (uint16_t)HCI_ACL_PAYLOAD_MAX) - sizeof(indication)), (uint16_t)length);
 
-    length = min((uint16_t)(_peers[i].mtu - indicationLength), (uint16_t)length);
-    memcpy(&indication[indicationLength], value, length);
-    indicationLength += length;
+    // the value goes out from where it is
+    HCITransportIov payload[] = {
+      { &indication, sizeof(indication) },
+      { value, (size_t)length }
+    };
 
     _cnf = false;
 
-    HCI.sendAclPkt(_peers[i].connectionHandle, ATT_CID, indicationLength, indication);
+    HCI.sendAclPkt(_peers[i].connectionHandle, ATT_CID, payload, 2);
 
     while (!_cnf) {
       HCI.poll();
@@ -669,7 +808,7 @@ int ATTClass::handleInd(uint16_t handle, const uint8_t* value, int length)
   return (numIndications > 0) ? length : 0;
 }
 
-void ATTClass::error(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::error(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   if (dlen != 4) {
     // drop
@@ -727,7 +866,7 @@ int ATTClass::mtuReq(uint16_t connectionHandle, uint16_t mtu, uint8_t responseBu
   return sendReq(connectionHandle, &mtuReq, sizeof(mtuReq), responseBuffer);
 }
 
-void ATTClass::mtuResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::mtuResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   uint16_t mtu = *(uint16_t*)data;
 
@@ -735,6 +874,11 @@ void ATTClass::mtuResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
     return;
   }
 
+  // the connection's MTU is the smaller of the two, what we asked for is ours
+  if (mtu > _maxMtu) {
+    mtu = _maxMtu;
+  }
+
   for (int i = 0; i < ATT_MAX_PEERS; i++) {
     if (_peers[i].connectionHandle == connectionHandle) {
       _peers[i].mtu = mtu;
@@ -824,7 +968,7 @@ int ATTClass::findInfoReq(uint16_t connectionHandle, uint16_t startHandle, uint1
   return sendReq(connectionHandle, &findInfoReq, sizeof(findInfoReq), responseBuffer);
 }
 
-void ATTClass::findInfoResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::findInfoResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   if (dlen < 2) {
     return; // invalid, drop
@@ -837,7 +981,7 @@ void ATTClass::findInfoResp(uint16_t connectionHandle, uint8_t dlen, uint8_t dat
   }
 }
 
-void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
+void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) FindByTypeReq {
     uint16_t startHandle;
@@ -890,7 +1034,7 @@ void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
   }
 }
 
-void ATTClass::readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
+void ATTClass::readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) ReadByGroupReq {
     uint16_t startHandle;
@@ -981,7 +1125,7 @@ int ATTClass::readByGroupReq(uint16_t connectionHandle, uint16_t startHandle, ui
   return sendReq(connectionHandle, &readByGroupReq, sizeof(readByGroupReq), responseBuffer);
 }
 
-void ATTClass::readByGroupResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::readByGroupResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   if (dlen < 2) {
     return; // invalid, drop
@@ -994,7 +1138,7 @@ void ATTClass::readByGroupResp(uint16_t connectionHandle, uint8_t dlen, uint8_t
   }
 }
 
-void ATTClass::readOrReadBlobReq(uint16_t connectionHandle, uint16_t mtu, uint8_t opcode, uint8_t dlen, uint8_t data[])
+void ATTClass::readOrReadBlobReq(uint16_t connectionHandle, uint16_t mtu, uint8_t opcode, uint16_t dlen, uint8_t data[])
 {
   if (opcode == ATT_OP_READ_REQ) {
     if (dlen != sizeof(uint16_t)) {
@@ -1111,7 +1255,7 @@ void ATTClass::readOrReadBlobReq(uint16_t connectionHandle, uint16_t mtu, uint8_
   }
 }
 
-void ATTClass::readResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::readResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   if (connectionHandle == _pendingResp.connectionHandle && _pendingResp.op == ATT_OP_READ_RESP) {
     _pendingResp.buffer[0] = ATT_OP_READ_RESP;
@@ -1120,7 +1264,7 @@ void ATTClass::readResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
   }
 }
 
-void ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
+void ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) ReadByTypeReq {
     uint16_t startHandle;
@@ -1240,7 +1384,7 @@ int ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t startHandle, uin
   return sendReq(connectionHandle, &readByTypeReq, sizeof(readByTypeReq), responseBuffer);
 }
 
-void ATTClass::readByTypeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::readByTypeResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   if (dlen < 1) {
     return; // invalid, drop
@@ -1253,7 +1397,7 @@ void ATTClass::readByTypeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t d
   }
 }
 
-void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op, uint8_t dlen, uint8_t data[])
+void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op, uint16_t dlen, uint8_t data[])
 {
   bool withResponse = (op == ATT_OP_WRITE_REQ);
 
@@ -1274,7 +1418,7 @@ void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op
     return;
   }
 
-  uint8_t valueLength = dlen - sizeof(handle);
+  uint16_t valueLength = dlen - sizeof(handle);
   uint8_t* value = &data[sizeof(handle)];
 
   BLELocalAttribute* attribute = GATT.attribute(handle - 1);
@@ -1301,7 +1445,11 @@ void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op
     for (int i = 0; i < ATT_MAX_PEERS; i++) {
       if (_peers[i].connectionHandle == connectionHandle) {
         if(holdResponse){
-          
+          // the held value is written once encrypted, a longer one than the buffer takes is dropped
+          if (valueLength > sizeof(writeBuffer) - 10) {
+            break;
+          }
+
           writeBufferSize = 0;
           memcpy(writeBuffer, &handle, 2);
           writeBufferSize+=2;
@@ -1312,7 +1460,7 @@ void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op
           writeBufferSize += sizeof(_peers[i].address);
           
           writeBuffer[writeBufferSize] = valueLength;
-          writeBufferSize += sizeof(valueLength);
+          writeBufferSize += sizeof(uint8_t);
 
           memcpy(&writeBuffer[writeBufferSize], value, valueLength);
           writeBufferSize += valueLength;
@@ -1397,7 +1545,7 @@ int ATTClass::processWriteBuffer(){
   return 1;
 }
 
-void ATTClass::writeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void ATTClass::writeResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   if (dlen != 0) {
     return; // drop
@@ -1410,7 +1558,7 @@ void ATTClass::writeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]
   }
 }
 
-void ATTClass::prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
+void ATTClass::prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) PrepWriteReq {
     uint16_t handle;
@@ -1462,7 +1610,7 @@ void ATTClass::prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dle
     return;
   }
 
-  uint8_t valueLength = dlen - sizeof(PrepWriteReq);
+  uint16_t valueLength = dlen - sizeof(PrepWriteReq);
   uint8_t* value = &data[sizeof(PrepWriteReq)];
 
   if ((offset != _longWriteValueLength) || ((offset + valueLength) > (uint16_t)characteristic->valueSize())) {
@@ -1483,7 +1631,7 @@ void ATTClass::prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dle
   HCI.sendAclPkt(connectionHandle, ATT_CID, responseLength, response);
 }
 
-void ATTClass::execWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
+void ATTClass::execWriteReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[])
 {
   if (dlen != sizeof(uint8_t)) {
     sendError(connectionHandle, ATT_OP_EXEC_WRITE_REQ, 0x0000, ATT_ECODE_INVALID_PDU);
@@ -1515,7 +1663,7 @@ void ATTClass::execWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dle
   HCI.sendAclPkt(connectionHandle, ATT_CID, responseLength, response);
 }
 
-void ATTClass::handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint8_t dlen, uint8_t data[])
+void ATTClass::handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint16_t dlen, uint8_t data[])
 {
   if (dlen < 2) {
     return; // drop
@@ -1568,7 +1716,7 @@ void ATTClass::handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint
   }
 }
 
-void ATTClass::handleCnf(uint16_t /*connectionHandle*/, uint8_t /*dlen*/, uint8_t /*data*/[])
+void ATTClass::handleCnf(uint16_t /*connectionHandle*/, uint16_t /*dlen*/, uint8_t /*data*/[])
 {
   _cnf = true;
 }
@@ -1597,6 +1745,37 @@ bool ATTClass::exchangeMtu(uint16_t connectionHandle)
   return true;
 }
 
+bool ATTClass::readDatabaseHash(uint16_t connectionHandle, uint8_t hash[])
+{
+  uint8_t responseBuffer[_maxMtu];
+
+  int respLength = readByTypeReq(connectionHandle, 0x0001, 0xffff, GATT_DATABASE_HASH_UUID, responseBuffer);
+
+  // opcode, length per attribute, handle and the 16 byte hash
+  if (respLength < (4 + GATT_CACHE_HASH_SIZE) || responseBuffer[0] != ATT_OP_READ_BY_TYPE_RESP ||
+      responseBuffer[1] != (2 + GATT_CACHE_HASH_SIZE)) {
+    return false;
+  }
+
+  memcpy(hash, &responseBuffer[4], GATT_CACHE_HASH_SIZE);
+
+  return true;
+}
+
+void ATTClass::identityAddress(int peerIndex, uint8_t& addressType, uint8_t address[6]) const
+{
+  static const uint8_t unresolved[6] = { 0 };
+
+  if (memcmp(_peers[peerIndex].resolvedAddress, unresolved, 6) != 0) {
+    // a resolvable private address, the peer is known by the address its IRK belongs to
+    addressType = 0x02;
+    memcpy(address, _peers[peerIndex].resolvedAddress, 6);
+  } else {
+    addressType = _peers[peerIndex].addressType;
+    memcpy(address, _peers[peerIndex].address, 6);
+  }
+}
+
 bool ATTClass::discoverServices(uint16_t connectionHandle, BLERemoteDevice* device, const char* serviceUuidFilter)
 {
   uint16_t reqStartHandle = 0x0001;
@@ -1777,13 +1956,23 @@ bool ATTClass::discoverDescriptors(uint16_t connectionHandle, BLERemoteDevice* d
 }
 
 int ATTClass::sendReq(uint16_t connectionHandle, void* requestBuffer, int requestLength, uint8_t responseBuffer[])
+{
+  return sendReq(connectionHandle, requestBuffer, requestLength, NULL, 0, responseBuffer);
+}
+
+int ATTClass::sendReq(uint16_t connectionHandle, void* requestBuffer, int requestLength, const uint8_t* data, int dataLength, uint8_t responseBuffer[])
 {
   _pendingResp.connectionHandle = connectionHandle;
   _pendingResp.op = ((uint8_t*)requestBuffer)[0] + 1;
   _pendingResp.buffer = responseBuffer;
   _pendingResp.length = 0;
 
-  HCI.sendAclPkt(connectionHandle, ATT_CID, requestLength, requestBuffer);
+  HCITransportIov request[] = {
+    { requestBuffer, (size_t)requestLength },
+    { data, (size_t)dataLength }
+  };
+
+  HCI.sendAclPkt(connectionHandle, ATT_CID, request, dataLength ? 2 : 1);
 
   if (responseBuffer == NULL) {
     // not waiting response
@@ -1829,14 +2018,9 @@ int ATTClass::writeReq(uint16_t connectionHandle, uint16_t handle, const uint8_t
   struct __attribute__ ((packed)) {
     uint8_t op;
     uint16_t handle;
-    uint8_t data[255];
-  } writeReq;
-
-  writeReq.op = ATT_OP_WRITE_REQ;
-  writeReq.handle = handle;
-  memcpy(writeReq.data, data, dataLen);
+  } writeReq = { ATT_OP_WRITE_REQ, handle };
 
-  return sendReq(connectionHandle, &writeReq, 3 + dataLen, responseBuffer);
+  return sendReq(connectionHandle, &writeReq, sizeof(writeReq), data, dataLen, responseBuffer);
 }
 
 void ATTClass::writeCmd(uint16_t connectionHandle, uint16_t handle, const uint8_t* data, uint8_t dataLen)
@@ -1844,14 +2028,9 @@ void ATTClass::writeCmd(uint16_t connectionHandle, uint16_t handle, const uint8_
   struct __attribute__ ((packed)) {
     uint8_t op;
     uint16_t handle;
-    uint8_t data[255];
-  } writeReq;
-
-  writeReq.op = ATT_OP_WRITE_CMD;
-  writeReq.handle = handle;
-  memcpy(writeReq.data, data, dataLen);
+  } writeCmd = { ATT_OP_WRITE_CMD, handle };
 
-  sendReq(connectionHandle, &writeReq, 3 + dataLen, NULL);
+  sendReq(connectionHandle, &writeCmd, sizeof(writeCmd), data, dataLen, NULL);
 }
 
 // Set encryption state for a peer
@@ -28,6 +28,9 @@
 #define ATT_CID       0x0004
 #define BLE_CTL       0x0008
 
+// Database Hash characteristic of the Generic Attribute service, see GATTCache.h
+#define GATT_DATABASE_HASH_UUID 0x2b2a
+
 #if DM_CONN_MAX
 #define ATT_MAX_PEERS DM_CONN_MAX // Mbed + Cordio
 #elif __AVR__
@@ -36,6 +39,14 @@
 #define ATT_MAX_PEERS 8
 #endif
 
+// largest MTU negotiated, HCI fragments and reassembles the PDUs that are longer
+// than the controller's ACL packets
+#ifdef __AVR__
+#define ATT_MAX_MTU 251
+#else
+#define ATT_MAX_MTU 517
+#endif
+
 enum PEER_ENCRYPTION {
   NO_ENCRYPTION         = 0,
   PAIRING_REQUEST       = 1 << 0,
@@ -58,6 +69,7 @@ public:
   virtual void setTimeout(unsigned long timeout);
 
   virtual bool connect(uint8_t peerBdaddrType, uint8_t peerBdaddr[6]);
+  virtual bool connectKnown(const uint8_t peerBdaddr[6], uint8_t& peerBdaddrType);
   virtual bool disconnect(uint8_t peerBdaddrType, uint8_t peerBdaddr[6]);
   virtual bool discoverAttributes(uint8_t peerBdaddrType, uint8_t peerBdaddr[6], const char* serviceUuidFilter);
 
@@ -66,7 +78,7 @@ public:
                     uint16_t latency, uint16_t supervisionTimeout,
                     uint8_t masterClockAccuracy);
 
-  virtual void handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
+  virtual void handleData(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
 
   virtual void removeConnection(uint16_t handle, uint8_t reason);
 
@@ -78,6 +90,10 @@ public:
   virtual bool paired() const;
   virtual bool paired(uint16_t handle) const;
   virtual uint16_t mtu(uint16_t handle) const;
+  virtual bool connectionParameters(uint16_t handle, uint16_t& interval, uint16_t& latency, uint16_t& supervisionTimeout) const;
+  virtual uint8_t role(uint16_t handle) const;
+
+  virtual void updateConnectionParameters(uint16_t handle, uint16_t interval, uint16_t latency, uint16_t supervisionTimeout);
 
   virtual bool disconnect();
 
@@ -110,36 +126,41 @@ public:
   /// This is just a random number... Not sure it has use unless privacy mode is active.
   uint8_t localIRK[16] = {0x54,0x83,0x63,0x7c,0xc5,0x1e,0xf7,0xec,0x32,0xdd,0xad,0x51,0x89,0x4b,0x9e,0x07};
 private:
-  virtual void error(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
+  virtual void error(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
   virtual void mtuReq(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
   virtual int mtuReq(uint16_t connectionHandle, uint16_t mtu, uint8_t responseBuffer[]);
-  virtual void mtuResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
+  virtual void mtuResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
   virtual void findInfoReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[]);
   virtual int findInfoReq(uint16_t connectionHandle, uint16_t startHandle, uint16_t endHandle, uint8_t responseBuffer[]);
-  virtual void findInfoResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
-  virtual void findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[]);
-  virtual void readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[]);
+  virtual void findInfoResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
+  virtual void findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[]);
+  virtual void readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[]);
   virtual int readByTypeReq(uint16_t connectionHandle, uint16_t startHandle, uint16_t endHandle, uint16_t type, uint8_t responseBuffer[]);
-  virtual void readByTypeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
-  virtual void readOrReadBlobReq(uint16_t connectionHandle, uint16_t mtu, uint8_t opcode, uint8_t dlen, uint8_t data[]);
-  virtual void readResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
-  virtual void readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[]);
+  virtual void readByTypeResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
+  virtual void readOrReadBlobReq(uint16_t connectionHandle, uint16_t mtu, uint8_t opcode, uint16_t dlen, uint8_t data[]);
+  virtual void readResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
+  virtual void readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[]);
   virtual int readByGroupReq(uint16_t connectionHandle, uint16_t startHandle, uint16_t endHandle, uint16_t uuid, uint8_t responseBuffer[]);
-  virtual void readByGroupResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
-  virtual void writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op, uint8_t dlen, uint8_t data[]);
-  virtual void writeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
-  virtual void prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[]);
-  virtual void execWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[]);
-  virtual void handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint8_t dlen, uint8_t data[]);
-  virtual void handleCnf(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
+  virtual void readByGroupResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
+  virtual void writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op, uint16_t dlen, uint8_t data[]);
+  virtual void writeResp(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
+  virtual void prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[]);
+  virtual void execWriteReq(uint16_t connectionHandle, uint16_t mtu, uint16_t dlen, uint8_t data[]);
+  virtual void handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint16_t dlen, uint8_t data[]);
+  virtual void handleCnf(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
   virtual void sendError(uint16_t connectionHandle, uint8_t opcode, uint16_t handle, uint8_t code);
 
+  virtual int createConnection(uint8_t initiatorFilter, uint8_t peerBdaddrType, uint8_t peerBdaddr[6]);
   virtual bool exchangeMtu(uint16_t connectionHandle);
+  virtual bool readDatabaseHash(uint16_t connectionHandle, uint8_t hash[]);
+  virtual void identityAddress(int peerIndex, uint8_t& addressType, uint8_t address[6]) const;
   virtual bool discoverServices(uint16_t connectionHandle, BLERemoteDevice* device, const char* serviceUuidFilter);
   virtual bool discoverCharacteristics(uint16_t connectionHandle, BLERemoteDevice* device);
   virtual bool discoverDescriptors(uint16_t connectionHandle, BLERemoteDevice* device);
 
   virtual int sendReq(uint16_t connectionHandle, void* requestBuffer, int requestLength, uint8_t responseBuffer[]);
+  // request header and data in two pieces, the data is not copied on the way to the transport
+  virtual int sendReq(uint16_t connectionHandle, void* requestBuffer, int requestLength, const uint8_t* data, int dataLength, uint8_t responseBuffer[]);
 
 private:
   uint16_t _maxMtu;
@@ -151,6 +172,9 @@ private:
     uint8_t address[6];
     uint8_t resolvedAddress[6];
     uint16_t mtu;
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t supervisionTimeout;
     BLERemoteDevice* device;
     uint8_t encryption;
     uint8_t IOCap[3];
@@ -166,7 +190,7 @@ private:
     uint16_t connectionHandle;
     uint8_t op;
     uint8_t* buffer;
-    uint8_t length;
+    uint16_t length;
   } _pendingResp;
 
   BLEDeviceEventHandler _eventHandlers[2];
@@ -0,0 +1,475 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "utility/ATT.h"
+#include "utility/BLEUuid.h"
+
+#include "GATTCache.h"
+
+// bump when the record layout changes, stored tables of another layout are dropped
+#define GATT_CACHE_MAGIC          0x47434101
+
+#define GATT_CACHE_SERVICE        0x01
+#define GATT_CACHE_CHARACTERISTIC 0x02
+#define GATT_CACHE_DESCRIPTOR     0x03
+
+static void putUint16(uint8_t* data, uint16_t value)
+{
+  data[0] = value & 0xff;
+  data[1] = value >> 8;
+}
+
+static uint16_t getUint16(const uint8_t* data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+GATTCacheClass::GATTCacheClass() :
+  _enabled(false),
+  _loaded(false),
+  _store(NULL),
+  _load(NULL)
+{
+  memset(&_table, 0x00, sizeof(_table));
+  _table.magic = GATT_CACHE_MAGIC;
+
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    _active[i].connectionHandle = 0xffff;
+    _active[i].entry = NULL;
+  }
+}
+
+GATTCacheClass::~GATTCacheClass()
+{
+}
+
+void GATTCacheClass::setEnabled(bool enabled)
+{
+  _enabled = enabled;
+}
+
+bool GATTCacheClass::enabled() const
+{
+  return _enabled;
+}
+
+void GATTCacheClass::setStore(int (*store)(const uint8_t* data, uint16_t length))
+{
+  _store = store;
+}
+
+void GATTCacheClass::setLoad(int (*load)(uint8_t* data, uint16_t length))
+{
+  _load = load;
+  _loaded = false;
+}
+
+bool GATTCacheClass::store(uint8_t addressType, const uint8_t address[6], const uint8_t* hash, uint16_t connectionHandle, BLERemoteDevice* device)
+{
+  load();
+
+  Entry* entry = find(addressType, address);
+
+  if (entry == NULL) {
+    // take a free entry, or the one used least recently
+    entry = &_table.entries[0];
+
+    for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+      if (!_table.entries[i].valid) {
+        entry = &_table.entries[i];
+        break;
+      }
+
+      if (_table.entries[i].stamp < entry->stamp) {
+        entry = &_table.entries[i];
+      }
+    }
+  }
+
+  disconnected(connectionHandle);
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    if (_active[i].entry == entry) {
+      _active[i].connectionHandle = 0xffff;
+      _active[i].entry = NULL;
+    }
+  }
+
+  entry->valid = 0;
+  entry->addressType = addressType;
+  memcpy(entry->address, address, sizeof(entry->address));
+  entry->hasHash = (hash != NULL);
+  if (hash) {
+    memcpy(entry->hash, hash, GATT_CACHE_HASH_SIZE);
+  } else {
+    memset(entry->hash, 0x00, GATT_CACHE_HASH_SIZE);
+  }
+  entry->stamp = ++_table.stamp;
+
+  if (!serialize(*entry, device)) {
+    // too many attributes to remember, the peer is discovered every time
+    save();
+    return false;
+  }
+  entry->valid = 1;
+
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    if (_active[i].entry == NULL) {
+      _active[i].connectionHandle = connectionHandle;
+      _active[i].entry = entry;
+      break;
+    }
+  }
+
+  save();
+  return true;
+}
+
+bool GATTCacheClass::restore(uint8_t addressType, const uint8_t address[6], const uint8_t* hash, bool bonded, uint16_t connectionHandle, BLERemoteDevice* device)
+{
+  load();
+
+  Entry* entry = find(addressType, address);
+
+  if (entry == NULL) {
+    return false;
+  }
+
+  if (entry->hasHash != (hash != NULL) || (hash && memcmp(entry->hash, hash, GATT_CACHE_HASH_SIZE) != 0)) {
+    // the peer changed its attribute table
+    forget(addressType, address);
+    return false;
+  }
+
+  if (!deserialize(*entry, connectionHandle, device)) {
+    device->clearServices();
+    forget(addressType, address);
+    return false;
+  }
+
+  if (hash == NULL && !bonded && !verify(connectionHandle, device)) {
+    // nothing vouches for the table, and it is not the one cached
+    device->clearServices();
+    forget(addressType, address);
+    return false;
+  }
+
+  disconnected(connectionHandle);
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    if (_active[i].entry == NULL) {
+      _active[i].connectionHandle = connectionHandle;
+      _active[i].entry = entry;
+      break;
+    }
+  }
+
+  entry->stamp = ++_table.stamp;
+
+  // peers clear their CCCDs on disconnect, subscribe again straight away
+  int serviceCount = device->serviceCount();
+
+  for (int i = 0; i < serviceCount; i++) {
+    BLERemoteService* service = device->service(i);
+    int characteristicCount = service->characteristicCount();
+
+    for (int j = 0; j < characteristicCount; j++) {
+      BLERemoteCharacteristic* characteristic = service->characteristic(j);
+
+      if (characteristic->_cccdValue != 0x0000 && !characteristic->writeCccd(characteristic->_cccdValue)) {
+        device->clearServices();
+        forget(addressType, address);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void GATTCacheClass::cccdWritten(uint16_t connectionHandle, uint16_t valueHandle, uint16_t value)
+{
+  Entry* entry = NULL;
+
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    if (_active[i].entry && _active[i].connectionHandle == connectionHandle) {
+      entry = _active[i].entry;
+      break;
+    }
+  }
+
+  if (entry == NULL) {
+    return;
+  }
+
+  for (uint16_t offset = 0; offset < entry->length;) {
+    uint8_t type = entry->records[offset];
+    uint8_t uuidLen = entry->records[offset + 1];
+    uint8_t* fields = &entry->records[offset + 2 + uuidLen];
+
+    if (type == GATT_CACHE_SERVICE) {
+      offset += 2 + uuidLen + 4;
+    } else if (type == GATT_CACHE_CHARACTERISTIC) {
+      if (getUint16(&fields[3]) == valueHandle) {
+        if (getUint16(&fields[5]) != value) {
+          putUint16(&fields[5], value);
+          save();
+        }
+        return;
+      }
+      offset += 2 + uuidLen + 7;
+    } else {
+      offset += 2 + uuidLen + 2;
+    }
+  }
+}
+
+void GATTCacheClass::disconnected(uint16_t connectionHandle)
+{
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    if (_active[i].connectionHandle == connectionHandle) {
+      _active[i].connectionHandle = 0xffff;
+      _active[i].entry = NULL;
+    }
+  }
+}
+
+void GATTCacheClass::forget(uint8_t addressType, const uint8_t address[6])
+{
+  Entry* entry = find(addressType, address);
+
+  if (entry == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    if (_active[i].entry == entry) {
+      _active[i].connectionHandle = 0xffff;
+      _active[i].entry = NULL;
+    }
+  }
+
+  entry->valid = 0;
+  save();
+}
+
+void GATTCacheClass::clear()
+{
+  memset(&_table, 0x00, sizeof(_table));
+  _table.magic = GATT_CACHE_MAGIC;
+  _loaded = true;
+
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    _active[i].connectionHandle = 0xffff;
+    _active[i].entry = NULL;
+  }
+
+  save();
+}
+
+void GATTCacheClass::load()
+{
+  if (_loaded) {
+    return;
+  }
+  _loaded = true;
+
+  if (_load == NULL) {
+    return;
+  }
+
+  if (_load((uint8_t*)&_table, sizeof(_table)) != (int)sizeof(_table) || _table.magic != GATT_CACHE_MAGIC) {
+    memset(&_table, 0x00, sizeof(_table));
+    _table.magic = GATT_CACHE_MAGIC;
+  }
+}
+
+void GATTCacheClass::save()
+{
+  if (_store) {
+    _store((const uint8_t*)&_table, sizeof(_table));
+  }
+}
+
+/*
+ * Reads the declaration of the first characteristic with notifications or
+ * indications enabled, or of the first one if there is none, and compares its
+ * properties, value handle and UUID with the restored ones.
+ */
+bool GATTCacheClass::verify(uint16_t connectionHandle, BLERemoteDevice* device)
+{
+  BLERemoteCharacteristic* checked = NULL;
+  int serviceCount = device->serviceCount();
+
+  for (int i = 0; i < serviceCount; i++) {
+    BLERemoteService* service = device->service(i);
+    int characteristicCount = service->characteristicCount();
+
+    for (int j = 0; j < characteristicCount; j++) {
+      BLERemoteCharacteristic* characteristic = service->characteristic(j);
+
+      if (checked == NULL || (checked->_cccdValue == 0x0000 && characteristic->_cccdValue != 0x0000)) {
+        checked = characteristic;
+      }
+    }
+  }
+
+  if (checked == NULL) {
+    // no characteristic whose handles could be stale
+    return true;
+  }
+
+  BLEUuid uuid(checked->uuid());
+  uint8_t response[ATT_MAX_MTU];
+  int responseLength = ATT.readReq(connectionHandle, checked->startHandle(), response);
+
+  // Read Response: properties, value handle, UUID
+  return responseLength == (1 + 3 + uuid.length()) &&
+         response[0] == 0x0b &&
+         response[1] == checked->properties() &&
+         getUint16(&response[2]) == checked->valueHandle() &&
+         memcmp(&response[4], uuid.data(), uuid.length()) == 0;
+}
+
+GATTCacheClass::Entry* GATTCacheClass::find(uint8_t addressType, const uint8_t address[6])
+{
+  for (int i = 0; i < GATT_CACHE_MAX_PEERS; i++) {
+    Entry* entry = &_table.entries[i];
+
+    if (entry->valid && entry->addressType == addressType && memcmp(entry->address, address, 6) == 0) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+bool GATTCacheClass::serialize(Entry& entry, BLERemoteDevice* device)
+{
+  uint16_t offset = 0;
+  uint8_t* records = entry.records;
+
+  int serviceCount = device->serviceCount();
+
+  for (int i = 0; i < serviceCount; i++) {
+    BLERemoteService* service = device->service(i);
+    BLEUuid serviceUuid(service->uuid());
+
+    if (offset + 2 + serviceUuid.length() + 4 > GATT_CACHE_RECORDS_SIZE) {
+      return false;
+    }
+    records[offset++] = GATT_CACHE_SERVICE;
+    records[offset++] = serviceUuid.length();
+    memcpy(&records[offset], serviceUuid.data(), serviceUuid.length());
+    offset += serviceUuid.length();
+    putUint16(&records[offset], service->startHandle());
+    putUint16(&records[offset + 2], service->endHandle());
+    offset += 4;
+
+    int characteristicCount = service->characteristicCount();
+
+    for (int j = 0; j < characteristicCount; j++) {
+      BLERemoteCharacteristic* characteristic = service->characteristic(j);
+      BLEUuid characteristicUuid(characteristic->uuid());
+
+      if (offset + 2 + characteristicUuid.length() + 7 > GATT_CACHE_RECORDS_SIZE) {
+        return false;
+      }
+      records[offset++] = GATT_CACHE_CHARACTERISTIC;
+      records[offset++] = characteristicUuid.length();
+      memcpy(&records[offset], characteristicUuid.data(), characteristicUuid.length());
+      offset += characteristicUuid.length();
+      putUint16(&records[offset], characteristic->startHandle());
+      records[offset + 2] = characteristic->properties();
+      putUint16(&records[offset + 3], characteristic->valueHandle());
+      putUint16(&records[offset + 5], characteristic->_cccdValue);
+      offset += 7;
+
+      int descriptorCount = characteristic->descriptorCount();
+
+      for (int k = 0; k < descriptorCount; k++) {
+        BLERemoteDescriptor* descriptor = characteristic->descriptor(k);
+        BLEUuid descriptorUuid(descriptor->uuid());
+
+        if (offset + 2 + descriptorUuid.length() + 2 > GATT_CACHE_RECORDS_SIZE) {
+          return false;
+        }
+        records[offset++] = GATT_CACHE_DESCRIPTOR;
+        records[offset++] = descriptorUuid.length();
+        memcpy(&records[offset], descriptorUuid.data(), descriptorUuid.length());
+        offset += descriptorUuid.length();
+        putUint16(&records[offset], descriptor->handle());
+        offset += 2;
+      }
+    }
+  }
+
+  entry.length = offset;
+  return true;
+}
+
+bool GATTCacheClass::deserialize(const Entry& entry, uint16_t connectionHandle, BLERemoteDevice* device)
+{
+  BLERemoteService* service = NULL;
+  BLERemoteCharacteristic* characteristic = NULL;
+
+  for (uint16_t offset = 0; offset < entry.length;) {
+    uint8_t type = entry.records[offset];
+    uint8_t uuidLen = entry.records[offset + 1];
+    const uint8_t* uuid = &entry.records[offset + 2];
+    const uint8_t* fields = uuid + uuidLen;
+
+    if (uuidLen > BLE_UUID_MAX_LENGTH) {
+      return false;
+    }
+
+    if (type == GATT_CACHE_SERVICE) {
+      service = new BLERemoteService(uuid, uuidLen, getUint16(&fields[0]), getUint16(&fields[2]));
+      if (service == NULL) {
+        return false;
+      }
+      device->addService(service);
+      characteristic = NULL;
+      offset += 2 + uuidLen + 4;
+    } else if (type == GATT_CACHE_CHARACTERISTIC && service) {
+      characteristic = new BLERemoteCharacteristic(uuid, uuidLen, connectionHandle,
+                                                   getUint16(&fields[0]), fields[2], getUint16(&fields[3]));
+      if (characteristic == NULL) {
+        return false;
+      }
+      characteristic->_cccdValue = getUint16(&fields[5]);
+      service->addCharacteristic(characteristic);
+      offset += 2 + uuidLen + 7;
+    } else if (type == GATT_CACHE_DESCRIPTOR && characteristic) {
+      BLERemoteDescriptor* descriptor = new BLERemoteDescriptor(uuid, uuidLen, connectionHandle, getUint16(&fields[0]));
+      if (descriptor == NULL) {
+        return false;
+      }
+      characteristic->addDescriptor(descriptor);
+      offset += 2 + uuidLen + 2;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#if !defined(FAKE_GATT_CACHE)
+GATTCacheClass GATTCacheObj;
+GATTCacheClass& GATTCache = GATTCacheObj;
+#endif
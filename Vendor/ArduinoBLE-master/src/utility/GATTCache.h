@@ -0,0 +1,120 @@
+/*
+  This file is part of the ArduinoBLE library.
+  Copyright (c) 2018 Arduino SA. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _GATT_CACHE_H_
+#define _GATT_CACHE_H_
+
+#include <Arduino.h>
+
+#include "remote/BLERemoteDevice.h"
+
+#ifdef __AVR__
+#define GATT_CACHE_MAX_PEERS   1
+#else
+#define GATT_CACHE_MAX_PEERS   4
+#endif
+// serialized services, characteristics and descriptors of one peer
+#define GATT_CACHE_RECORDS_SIZE 320
+
+#define GATT_CACHE_HASH_SIZE   16
+
+// size of the table handed to the store and load callbacks
+#define GATT_CACHE_STORAGE_SIZE (sizeof(GATTCacheClass::Table))
+
+/*
+ * Remembers the attribute handles discovered on a peer, keyed by its identity
+ * address, so the next discoverAttributes() on that peer can rebuild the remote
+ * services, characteristics and descriptors without any ATT discovery.
+ *
+ * An entry is only reused while the peer reports the same Database Hash (0x2B2A)
+ * it had when the entry was taken. A bonded peer without a Database Hash is trusted
+ * to keep its attribute table. One that is not bonded either may have been reflashed
+ * with another table since, so one read of a cached characteristic declaration, the
+ * first one subscribed to, has to match the cache before the entry is used.
+ *
+ * The CCCD values written on the peer are kept along with the handles and are
+ * written again on restore, since peers forget them on disconnect.
+ *
+ * The table lives in RAM. With store and load callbacks set it is also kept in
+ * flash or any other storage: it is loaded on first use and stored whenever an
+ * entry changes.
+ */
+class GATTCacheClass {
+public:
+  GATTCacheClass();
+  virtual ~GATTCacheClass();
+
+  void setEnabled(bool enabled);
+  bool enabled() const;
+
+  void setStore(int (*store)(const uint8_t* data, uint16_t length));
+  void setLoad(int (*load)(uint8_t* data, uint16_t length));
+
+  // hash is NULL for a peer without a Database Hash characteristic
+  bool store(uint8_t addressType, const uint8_t address[6], const uint8_t* hash, uint16_t connectionHandle, BLERemoteDevice* device);
+  // bonded tells whether the link is encrypted with the peer's stored keys
+  bool restore(uint8_t addressType, const uint8_t address[6], const uint8_t* hash, bool bonded, uint16_t connectionHandle, BLERemoteDevice* device);
+
+  void cccdWritten(uint16_t connectionHandle, uint16_t valueHandle, uint16_t value);
+  void disconnected(uint16_t connectionHandle);
+
+  void forget(uint8_t addressType, const uint8_t address[6]);
+  void clear();
+
+  struct Entry {
+    uint8_t valid;
+    uint8_t hasHash;
+    uint8_t addressType;
+    uint8_t address[6];
+    uint8_t hash[GATT_CACHE_HASH_SIZE];
+    uint32_t stamp;
+    uint16_t length;
+    uint8_t records[GATT_CACHE_RECORDS_SIZE];
+  };
+
+  struct Table {
+    uint32_t magic;
+    uint32_t stamp;
+    Entry entries[GATT_CACHE_MAX_PEERS];
+  };
+
+private:
+  void load();
+  void save();
+  Entry* find(uint8_t addressType, const uint8_t address[6]);
+  bool serialize(Entry& entry, BLERemoteDevice* device);
+  bool deserialize(const Entry& entry, uint16_t connectionHandle, BLERemoteDevice* device);
+  bool verify(uint16_t connectionHandle, BLERemoteDevice* device);
+
+  bool _enabled;
+  bool _loaded;
+  Table _table;
+  // entry in use by each connection, for the CCCD updates
+  struct {
+    uint16_t connectionHandle;
+    Entry* entry;
+  } _active[GATT_CACHE_MAX_PEERS];
+
+  int (*_store)(const uint8_t* data, uint16_t length);
+  int (*_load)(uint8_t* data, uint16_t length);
+};
+
+extern GATTCacheClass& GATTCache;
+
+#endif
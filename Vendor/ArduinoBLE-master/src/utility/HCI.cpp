@@ -70,6 +70,10 @@
 #define OCF_LE_SET_SCAN_ENABLE            0x000c
 #define OCF_LE_CREATE_CONN                0x000d
 #define OCF_LE_CANCEL_CONN                0x000e
+#define OCF_LE_READ_FILTER_ACCEPT_LIST_SIZE          0x000f
+#define OCF_LE_CLEAR_FILTER_ACCEPT_LIST              0x0010
+#define OCF_LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST      0x0011
+#define OCF_LE_REMOVE_DEVICE_FROM_FILTER_ACCEPT_LIST 0x0012
 #define OCF_LE_CONN_UPDATE                0x0013
 
 #define HCI_OE_USER_ENDED_CONNECTION 0x13
@@ -79,6 +83,7 @@ String metaEventToString(LE_META_EVENT event)
   switch(event){
     case CONN_COMPLETE: return F("CONN_COMPLETE");
     case ADVERTISING_REPORT: return F("ADVERTISING_REPORT");
+    case CONN_UPDATE_COMPLETE: return F("CONN_UPDATE_COMPLETE");
     case LONG_TERM_KEY_REQUEST: return F("LE_LONG_TERM_KEY_REQUEST");
     case READ_LOCAL_P256_COMPLETE: return F("READ_LOCAL_P256_COMPLETE");
     case GENERATE_DH_KEY_COMPLETE: return F("GENERATE_DH_KEY_COMPLETE");
@@ -101,9 +106,15 @@ String commandToString(LE_COMMAND command){
 HCIClass::HCIClass() :
   _debug(NULL),
   _recvIndex(0),
-  _pendingPkt(0),
-  _l2CapPduBufferSize(0)
+  _recvLength(0),
+  _recvSkip(0),
+  _cmdQueueHead(0),
+  _cmdQueueCount(0),
+  _cmdCredits(1),
+  _maxPkt(0),
+  _aclPktLen(27)
 {
+  resetAclLinks();
 }
 
 HCIClass::~HCIClass()
@@ -113,6 +124,15 @@ HCIClass::~HCIClass()
 int HCIClass::begin()
 {
   _recvIndex = 0;
+  _recvLength = 0;
+  _recvSkip = 0;
+
+  // the controller takes one command after power up
+  _cmdQueueHead = 0;
+  _cmdQueueCount = 0;
+  _cmdCredits = 1;
+
+  resetAclLinks();
 
   return HCITransport.begin();
 }
@@ -127,6 +147,12 @@ void HCIClass::poll()
   poll(0);
 }
 
+/*
+ * Reads whatever the transport has in packet sized pieces: the packet type, then
+ * the rest of its header, then the whole payload in a single bulk read. Every
+ * packet is handled as soon as its last byte is in, a partial one is finished by
+ * the next poll().
+ */
 void HCIClass::poll(unsigned long timeout)
 {
 #ifdef ARDUINO_AVR_UNO_WIFI_REV2
@@ -138,74 +164,107 @@ void HCIClass::poll(unsigned long timeout)
   }
 
   HCITransport.lockForRead();
-  while (HCITransport.available()) {
-    byte b = HCITransport.read();
+  for (;;) {
+    if (_recvSkip > 0) {
+      uint8_t discard[32];
+      size_t count = HCITransport.read(discard, _recvSkip < (int)sizeof(discard) ? _recvSkip : sizeof(discard));
+      if (count == 0) {
+        break;
+      }
+      _recvSkip -= count;
+      continue;
+    }
 
-    if (_recvIndex >= (int)sizeof(_recvBuffer)) {
-        _recvIndex = 0;
-        if (_debug) {
-            HCITransport.unlockForRead();
-            _debug->println("_recvBuffer overflow");
-            HCITransport.lockForRead();
-        }
+    int headerLength = 1;
+    if (_recvIndex > 0) {
+      headerLength = (_recvBuffer[0] == HCI_ACLDATA_PKT) ? 5 : 3;
     }
+    int wanted = (_recvLength ? _recvLength : headerLength) - _recvIndex;
 
-    _recvBuffer[_recvIndex++] = b;
+    size_t count = HCITransport.read(&_recvBuffer[_recvIndex], wanted);
+    if (count == 0) {
+      break;
+    }
+    _recvIndex += count;
 
-    if (_recvBuffer[0] == HCI_ACLDATA_PKT) {
-      if (_recvIndex > 5 && _recvIndex >= (5 + (_recvBuffer[3] + (_recvBuffer[4] << 8)))) {
+    if (_recvIndex == 1 && _recvBuffer[0] != HCI_ACLDATA_PKT && _recvBuffer[0] != HCI_EVENT_PKT) {
+      _recvIndex = 0;
+
+      if (_debug) {
         HCITransport.unlockForRead();
-        if (_debug) {
-          dumpPkt("HCI ACLDATA RX <- ", _recvIndex, _recvBuffer);
-        }
-#ifdef ARDUINO_AVR_UNO_WIFI_REV2
-        digitalWrite(NINA_RTS, HIGH);
-#endif
-        int pktLen = _recvIndex - 1;
-        _recvIndex = 0;
+        _debug->println(_recvBuffer[0], HEX);
+        HCITransport.lockForRead();
+      }
+      continue;
+    }
 
-        handleAclDataPkt(pktLen, &_recvBuffer[1]);
+    if (_recvLength == 0) {
+      headerLength = (_recvBuffer[0] == HCI_ACLDATA_PKT) ? 5 : 3;
+      if (_recvIndex < headerLength) {
+        continue;
+      }
 
-#ifdef ARDUINO_AVR_UNO_WIFI_REV2
-        digitalWrite(NINA_RTS, LOW);
-#endif
-        HCITransport.lockForRead();
+      if (_recvBuffer[0] == HCI_ACLDATA_PKT) {
+        _recvLength = 5 + (_recvBuffer[3] + (_recvBuffer[4] << 8));
+      } else {
+        _recvLength = 3 + _recvBuffer[2];
       }
-    } else if (_recvBuffer[0] == HCI_EVENT_PKT) {
-      if (_recvIndex > 3 && _recvIndex >= (3 + _recvBuffer[2])) {
-        HCITransport.unlockForRead();
+
+      if (_recvLength > (int)sizeof(_recvBuffer)) {
+        _recvSkip = _recvLength - _recvIndex;
+        _recvIndex = 0;
+        _recvLength = 0;
         if (_debug) {
-          dumpPkt("HCI EVENT RX <- ", _recvIndex, _recvBuffer);
+          HCITransport.unlockForRead();
+          _debug->println("_recvBuffer overflow");
+          HCITransport.lockForRead();
         }
+        continue;
+      }
+    }
+
+    if (_recvIndex == _recvLength) {
+      HCITransport.unlockForRead();
+      dispatchRecvPkt();
+      HCITransport.lockForRead();
+    }
+  }
+
 #ifdef ARDUINO_AVR_UNO_WIFI_REV2
-        digitalWrite(NINA_RTS, HIGH);
+  digitalWrite(NINA_RTS, HIGH);
 #endif
-        // received full event
-        int pktLen = _recvIndex - 1;
-        _recvIndex = 0;
+  HCITransport.unlockForRead();
 
-        handleEventPkt(pktLen, &_recvBuffer[1]);
+  serviceCommands();
+  scheduleAcl();
+}
 
+/*
+ * Hands the complete packet in _recvBuffer to its handler, called without the read lock.
+ */
+void HCIClass::dispatchRecvPkt()
+{
+  if (_debug) {
+    dumpPkt(_recvBuffer[0] == HCI_ACLDATA_PKT ? "HCI ACLDATA RX <- " : "HCI EVENT RX <- ", _recvIndex, _recvBuffer);
+  }
 #ifdef ARDUINO_AVR_UNO_WIFI_REV2
-        digitalWrite(NINA_RTS, LOW);
+  digitalWrite(NINA_RTS, HIGH);
 #endif
-        HCITransport.lockForRead();
-      }
-    } else {
-      _recvIndex = 0;
+  // the handlers may poll again, the next packet starts from scratch
+  int pktLen = _recvIndex - 1;
+  _recvIndex = 0;
+  _recvLength = 0;
 
-      if (_debug) {
-        HCITransport.unlockForRead();
-        _debug->println(b, HEX);
-        HCITransport.lockForRead();
-      }
-    }
+  if (_recvBuffer[0] == HCI_ACLDATA_PKT) {
+    handleAclDataPkt(pktLen, &_recvBuffer[1]);
+  } else {
+    // received full event
+    handleEventPkt(pktLen, &_recvBuffer[1]);
   }
 
 #ifdef ARDUINO_AVR_UNO_WIFI_REV2
-  digitalWrite(NINA_RTS, HIGH);
+  digitalWrite(NINA_RTS, LOW);
 #endif
-  HCITransport.unlockForRead();
 }
 
 int HCIClass::reset()
@@ -277,6 +336,12 @@ int HCIClass::readRssi(uint16_t handle)
   return rssi;
 }
 
+int HCIClass::readRssiAsync(uint16_t handle, HCICommandCallback callback, void* context)
+{
+  // the return parameters are the handle and the RSSI, as for readRssi()
+  return sendCommandAsync(OGF_STATUS_PARAM << 10 | OCF_READ_RSSI, sizeof(handle), &handle, callback, context);
+}
+
 int HCIClass::setEventMask(uint64_t eventMask)
 {
   return sendCommand(OGF_HOST_CTL << 10 | OCF_SET_EVENT_MASK, sizeof(eventMask), &eventMask);
@@ -297,11 +362,11 @@ int HCIClass::readLeBufferSize(uint16_t& pktLen, uint8_t& maxPkt)
       uint8_t maxPkt;
     } *leBufferSize = (HCILeBufferSize*)_cmdResponse;
 
-    pktLen = leBufferSize->pktLen;
+    _aclPktLen = pktLen = leBufferSize->pktLen;
     _maxPkt = maxPkt = leBufferSize->maxPkt;
 
 #ifndef __AVR__
-    ATT.setMaxMtu(pktLen - 9); // max pkt len - ACL header size
+    ATT.setMaxMtu(ATT_MAX_MTU);
 #endif
   }
 
@@ -449,6 +514,48 @@ int HCIClass::leCancelConn()
   return sendCommand(OGF_LE_CTL << 10 | OCF_LE_CANCEL_CONN, 0, NULL);
 }
 
+int HCIClass::leReadFilterAcceptListSize(uint8_t& size)
+{
+  int result = sendCommand(OGF_LE_CTL << 10 | OCF_LE_READ_FILTER_ACCEPT_LIST_SIZE);
+
+  if (result == 0) {
+    size = _cmdResponse[0];
+  }
+
+  return result;
+}
+
+int HCIClass::leClearFilterAcceptList()
+{
+  return sendCommand(OGF_LE_CTL << 10 | OCF_LE_CLEAR_FILTER_ACCEPT_LIST, 0, NULL);
+}
+
+int HCIClass::leAddDeviceToFilterAcceptList(uint8_t addressType, const uint8_t address[6])
+{
+  struct __attribute__ ((packed)) HCILeFilterAcceptListData {
+    uint8_t addressType;
+    uint8_t address[6];
+  } leFilterAcceptListData;
+
+  leFilterAcceptListData.addressType = addressType;
+  memcpy(leFilterAcceptListData.address, address, sizeof(leFilterAcceptListData.address));
+
+  return sendCommand(OGF_LE_CTL << 10 | OCF_LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST, sizeof(leFilterAcceptListData), &leFilterAcceptListData);
+}
+
+int HCIClass::leRemoveDeviceFromFilterAcceptList(uint8_t addressType, const uint8_t address[6])
+{
+  struct __attribute__ ((packed)) HCILeFilterAcceptListData {
+    uint8_t addressType;
+    uint8_t address[6];
+  } leFilterAcceptListData;
+
+  leFilterAcceptListData.addressType = addressType;
+  memcpy(leFilterAcceptListData.address, address, sizeof(leFilterAcceptListData.address));
+
+  return sendCommand(OGF_LE_CTL << 10 | OCF_LE_REMOVE_DEVICE_FROM_FILTER_ACCEPT_LIST, sizeof(leFilterAcceptListData), &leFilterAcceptListData);
+}
+
 int HCIClass::leConnUpdate(uint16_t handle, uint16_t minInterval, uint16_t maxInterval,
                           uint16_t latency, uint16_t supervisionTimeout)
 {
@@ -635,40 +742,363 @@ int HCIClass::tryResolveAddress(uint8_t* BDAddr, uint8_t* address){
   return 0;
 }
 
-int HCIClass::sendAclPkt(uint16_t handle, uint8_t cid, uint8_t plen, void* data)
+int HCIClass::sendAclPkt(uint16_t handle, uint8_t cid, uint16_t plen, void* data)
 {
-  while (_pendingPkt >= _maxPkt) {
+  HCITransportIov payload = { data, plen };
+
+  return sendAclPkt(handle, cid, &payload, 1);
+}
+
+int HCIClass::sendAclPkt(uint16_t handle, uint8_t cid, const HCITransportIov* payload, int count)
+{
+  while (trySendAclPkt(handle, cid, payload, count) != 0) {
+    if (!aclLink(handle)) {
+      // disconnected, the packet has nowhere to go
+      return -1;
+    }
     poll();
   }
 
-  struct __attribute__ ((packed)) HCIACLHdr {
+  return 0;
+}
+
+struct __attribute__ ((packed)) HCIACLTxHdr {
+  uint8_t pktType;
+  uint16_t handle;
+  uint16_t dlen;
+  uint16_t plen;
+  uint16_t cid;
+};
+
+int HCIClass::trySendAclPkt(uint16_t handle, uint8_t cid, const HCITransportIov* payload, int count)
+{
+  HCIAclLink* link = aclLink(handle);
+  if (!link) {
+    return -1;
+  }
+
+  size_t plen = 0;
+  for (int i = 0; i < count; i++) {
+    plen += payload[i].length;
+  }
+  if (plen > HCI_ACL_PAYLOAD_MAX) {
+    return -1;
+  }
+
+  HCIACLTxHdr aclHdr = { HCI_ACLDATA_PKT, handle, uint16_t(plen + 4), uint16_t(plen), cid };
+
+  // straight to the controller while it has room, nobody is waiting for it and
+  // the PDU is not longer than one ACL packet
+  if (_aclQueued == 0 && _pendingPkt < _maxPkt && plen + 4 <= _aclPktLen) {
+    HCITransportIov iov[1 + count];
+    iov[0].data = &aclHdr;
+    iov[0].length = sizeof(aclHdr);
+    for (int i = 0; i < count; i++) {
+      iov[1 + i] = payload[i];
+    }
+
+    writeAclPkt(*link, iov, 1 + count);
+    return 0;
+  }
+
+  if (link->queueCount == HCI_ACL_LINK_QUEUE) {
+    return -1;
+  }
+  int buffer = allocAclBuffer();
+  if (buffer < 0) {
+    return -1;
+  }
+
+  uint8_t* p = _aclPool[buffer].data;
+  memcpy(p, &aclHdr, sizeof(aclHdr));
+  p += sizeof(aclHdr);
+  for (int i = 0; i < count; i++) {
+    memcpy(p, payload[i].data, payload[i].length);
+    p += payload[i].length;
+  }
+  _aclPool[buffer].length = sizeof(aclHdr) + plen;
+  _aclPool[buffer].sent = 0;
+
+  queueAclBuffer(*link, buffer);
+
+  return 0;
+}
+
+uint8_t* HCIClass::reserveAclPkt(uint16_t handle)
+{
+  HCIAclLink* link = aclLink(handle);
+  if (!link || link->queueCount == HCI_ACL_LINK_QUEUE) {
+    return NULL;
+  }
+
+  _aclReserved = allocAclBuffer();
+  if (_aclReserved < 0) {
+    return NULL;
+  }
+
+  return &_aclPool[_aclReserved].data[HCI_ACL_HEADROOM];
+}
+
+int HCIClass::sendReservedAclPkt(uint16_t handle, uint8_t cid, uint16_t plen)
+{
+  int buffer = _aclReserved;
+  _aclReserved = -1;
+
+  HCIAclLink* link = aclLink(handle);
+  if (buffer < 0 || !link || link->queueCount == HCI_ACL_LINK_QUEUE) {
+    if (buffer >= 0) {
+      _aclPool[buffer].used = false;
+    }
+    return -1;
+  }
+
+  HCIACLTxHdr aclHdr = { HCI_ACLDATA_PKT, handle, uint16_t(plen + 4), plen, cid };
+  memcpy(_aclPool[buffer].data, &aclHdr, sizeof(aclHdr));
+  _aclPool[buffer].length = sizeof(aclHdr) + plen;
+  _aclPool[buffer].sent = 0;
+
+  if (_aclQueued == 0 && _pendingPkt < _maxPkt && plen + 4 <= _aclPktLen) {
+    HCITransportIov iov = { _aclPool[buffer].data, _aclPool[buffer].length };
+    writeAclPkt(*link, &iov, 1);
+    _aclPool[buffer].used = false;
+    return 0;
+  }
+
+  queueAclBuffer(*link, buffer);
+
+  return 0;
+}
+
+int HCIClass::aclPending(uint16_t handle) const
+{
+  for (int i = 0; i < HCI_ACL_LINKS; i++) {
+    if (_aclLinks[i].handle == handle) {
+      return _aclLinks[i].pending;
+    }
+  }
+
+  return 0;
+}
+
+int HCIClass::aclQueued(uint16_t handle) const
+{
+  for (int i = 0; i < HCI_ACL_LINKS; i++) {
+    if (_aclLinks[i].handle == handle) {
+      return _aclLinks[i].queueCount;
+    }
+  }
+
+  return 0;
+}
+
+void HCIClass::resetAclLinks()
+{
+  for (int i = 0; i < HCI_ACL_LINKS; i++) {
+    _aclLinks[i].handle = 0xffff;
+    _aclLinks[i].pending = 0;
+    _aclLinks[i].queueHead = 0;
+    _aclLinks[i].queueCount = 0;
+  }
+  for (int i = 0; i < HCI_ACL_POOL_SIZE; i++) {
+    _aclPool[i].used = false;
+  }
+  for (int i = 0; i < HCI_L2CAP_RX_BUFFERS; i++) {
+    _l2CapRx[i].handle = 0xffff;
+  }
+
+  _pendingPkt = 0;
+  _aclQueued = 0;
+  _aclReserved = -1;
+  _aclNextLink = 0;
+}
+
+HCIClass::HCIAclLink* HCIClass::aclLink(uint16_t handle)
+{
+  for (int i = 0; i < HCI_ACL_LINKS; i++) {
+    if (_aclLinks[i].handle == handle) {
+      return &_aclLinks[i];
+    }
+  }
+
+  return NULL;
+}
+
+void HCIClass::addAclLink(uint16_t handle)
+{
+  HCIAclLink* link = aclLink(0xffff);
+
+  if (link) {
+    link->handle = handle;
+    link->pending = 0;
+    link->queueHead = 0;
+    link->queueCount = 0;
+  }
+}
+
+/*
+ * The controller drops what it still had of a closed connection, its buffers count
+ * as completed, and what is queued here goes too.
+ */
+void HCIClass::removeAclLink(uint16_t handle)
+{
+  HCIAclLink* link = aclLink(handle);
+
+  if (!link) {
+    return;
+  }
+
+  _pendingPkt -= link->pending;
+  for (int i = 0; i < link->queueCount; i++) {
+    _aclPool[link->queue[(link->queueHead + i) % HCI_ACL_LINK_QUEUE]].used = false;
+  }
+  _aclQueued -= link->queueCount;
+
+  link->handle = 0xffff;
+  link->pending = 0;
+  link->queueCount = 0;
+
+  scheduleAcl();
+}
+
+int HCIClass::allocAclBuffer()
+{
+  for (int i = 0; i < HCI_ACL_POOL_SIZE; i++) {
+    if (!_aclPool[i].used) {
+      _aclPool[i].used = true;
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void HCIClass::queueAclBuffer(HCIAclLink& link, int buffer)
+{
+  link.queue[(link.queueHead + link.queueCount) % HCI_ACL_LINK_QUEUE] = buffer;
+  link.queueCount++;
+  _aclQueued++;
+
+  scheduleAcl();
+}
+
+void HCIClass::writeAclPkt(HCIAclLink& link, const HCITransportIov* iov, int count)
+{
+  dumpAclPkt(iov, count);
+
+  link.pending++;
+  _pendingPkt++;
+  HCITransport.write(iov, count);
+}
+
+/*
+ * Hands free controller buffers to the queued packets, one connection after the
+ * other, so a connection whose peer does not keep up only holds back its own. A
+ * PDU longer than an ACL packet takes its turns one fragment at a time.
+ */
+void HCIClass::scheduleAcl()
+{
+  while (_aclQueued > 0 && _pendingPkt < _maxPkt) {
+    for (int i = 0; i < HCI_ACL_LINKS; i++) {
+      int index = (_aclNextLink + i) % HCI_ACL_LINKS;
+      HCIAclLink& link = _aclLinks[index];
+
+      if (link.queueCount == 0) {
+        continue;
+      }
+
+      HCIAclBuffer& buffer = _aclPool[link.queue[link.queueHead]];
+      _aclNextLink = (index + 1) % HCI_ACL_LINKS;
+
+      writeAclFragment(link, buffer);
+
+      if (buffer.sent == buffer.length - 5) {
+        link.queueHead = (link.queueHead + 1) % HCI_ACL_LINK_QUEUE;
+        link.queueCount--;
+        _aclQueued--;
+        buffer.used = false;
+      }
+      break;
+    }
+  }
+}
+
+void HCIClass::writeAclFragment(HCIAclLink& link, HCIAclBuffer& buffer)
+{
+  // the L2CAP PDU follows the packet type and ACL header the buffer starts with
+  uint16_t pduLength = buffer.length - 5;
+  uint16_t fragmentLength = pduLength - buffer.sent;
+
+  if (fragmentLength > _aclPktLen) {
+    fragmentLength = _aclPktLen;
+  }
+
+  struct __attribute__ ((packed)) {
     uint8_t pktType;
     uint16_t handle;
     uint16_t dlen;
-    uint16_t plen;
-    uint16_t cid;
-  } aclHdr = { HCI_ACLDATA_PKT, handle, uint8_t(plen + 4), plen, cid };
+  } aclHdr = { HCI_ACLDATA_PKT, uint16_t(link.handle | (buffer.sent ? 0x1000 : 0x0000)), fragmentLength };
 
-  uint8_t txBuffer[sizeof(aclHdr) + plen];
-  memcpy(txBuffer, &aclHdr, sizeof(aclHdr));
-  memcpy(&txBuffer[sizeof(aclHdr)], data, plen);
+  HCITransportIov iov[] = {
+    { &aclHdr, sizeof(aclHdr) },
+    { &buffer.data[5 + buffer.sent], fragmentLength }
+  };
+
+  writeAclPkt(link, iov, 2);
+  buffer.sent += fragmentLength;
+}
+
+HCIClass::HCIL2CapRx* HCIClass::l2CapRx(uint16_t handle)
+{
+  for (int i = 0; i < HCI_L2CAP_RX_BUFFERS; i++) {
+    if (_l2CapRx[i].handle == handle) {
+      return &_l2CapRx[i];
+    }
+  }
+
+  return NULL;
+}
+
+void HCIClass::releaseL2CapRx(uint16_t handle)
+{
+  HCIL2CapRx* rx = l2CapRx(handle);
+
+  if (rx) {
+    rx->handle = 0xffff;
+  }
+}
+
+void HCIClass::dumpAclPkt(const HCITransportIov* iov, int count)
+{
+#ifndef _BLE_TRACE_
+  if (!_debug) {
+    return;
+  }
+#endif
+
+  // only the dumps need the packet in one piece
+  size_t length = 0;
+  for (int i = 0; i < count; i++) {
+    length += iov[i].length;
+  }
+
+  uint8_t txBuffer[length];
+  uint8_t* p = txBuffer;
+  for (int i = 0; i < count; i++) {
+    memcpy(p, iov[i].data, iov[i].length);
+    p += iov[i].length;
+  }
 
   if (_debug) {
-    dumpPkt("HCI ACLDATA TX -> ", sizeof(aclHdr) + plen, txBuffer);
+    dumpPkt("HCI ACLDATA TX -> ", length, txBuffer);
   }
 #ifdef _BLE_TRACE_
   Serial.print("Data tx -> ");
-  for(int i=0; i< sizeof(aclHdr) + plen;i++){
+  for(int i=0; i< length;i++){
     Serial.print(" 0x");
     Serial.print(txBuffer[i],HEX);
   }
   Serial.println(".");
 #endif
-
-  _pendingPkt++;
-  HCITransport.write(txBuffer, sizeof(aclHdr) + plen);
-
-  return 0;
 }
 
 int HCIClass::disconnect(uint16_t handle)
@@ -691,7 +1121,82 @@ void HCIClass::noDebug()
   _debug = NULL;
 }
 
+struct HCISyncCommand {
+  bool done;
+  int status;
+};
+
+static void syncCommandDone(uint16_t /*opcode*/, int status, uint8_t /*responseLength*/, uint8_t /*response*/[], void* context)
+{
+  HCISyncCommand* command = (HCISyncCommand*)context;
+
+  command->done = true;
+  command->status = status;
+}
+
 int HCIClass::sendCommand(uint16_t opcode, uint8_t plen, void* parameters)
+{
+  HCISyncCommand command = { false, -1 };
+
+  for (unsigned long start = millis(); sendCommandAsync(opcode, plen, parameters, syncCommandDone, &command) != 0;) {
+    if (millis() - start >= HCI_COMMAND_TIMEOUT) {
+      return -1;
+    }
+    poll();
+  }
+
+  // _cmdResponse points to the return parameters once it is done
+  while (!command.done) {
+    poll();
+  }
+
+  return command.status;
+}
+
+int HCIClass::sendCommandAsync(uint16_t opcode, uint8_t plen, void* parameters, HCICommandCallback callback, void* context)
+{
+  if (_cmdQueueCount == HCI_COMMAND_QUEUE_SIZE) {
+    return -1;
+  }
+
+  // commands leave in order, one that is still waiting goes first
+  bool waiting = false;
+  for (int i = 0; i < _cmdQueueCount; i++) {
+    waiting |= !_cmdQueue[(_cmdQueueHead + i) % HCI_COMMAND_QUEUE_SIZE].sent;
+  }
+
+  bool send = !waiting && _cmdCredits > 0;
+  if (!send && plen > HCI_COMMAND_PARAMS_MAX) {
+    return -1;
+  }
+
+  HCICommand& command = _cmdQueue[(_cmdQueueHead + _cmdQueueCount) % HCI_COMMAND_QUEUE_SIZE];
+  _cmdQueueCount++;
+
+  command.opcode = opcode;
+  command.sent = send;
+  command.done = false;
+  command.sentAt = millis();
+  command.callback = callback;
+  command.context = context;
+  command.plen = plen;
+
+  if (send) {
+    _cmdCredits--;
+    writeCommand(opcode, plen, parameters);
+  } else {
+    memcpy(command.parameters, parameters, plen);
+  }
+
+  return 0;
+}
+
+bool HCIClass::commandsPending() const
+{
+  return _cmdQueueCount > 0;
+}
+
+void HCIClass::writeCommand(uint16_t opcode, uint8_t plen, const void* parameters)
 {
   struct __attribute__ ((packed)) {
     uint8_t pktType;
@@ -699,31 +1204,103 @@ int HCIClass::sendCommand(uint16_t opcode, uint8_t plen, void* parameters)
     uint8_t plen;
   } pktHdr = {HCI_COMMAND_PKT, opcode, plen};
 
-  uint8_t txBuffer[sizeof(pktHdr) + plen];
-  memcpy(txBuffer, &pktHdr, sizeof(pktHdr));
-  memcpy(&txBuffer[sizeof(pktHdr)], parameters, plen);
+  HCITransportIov iov[] = {
+    { &pktHdr, sizeof(pktHdr) },
+    { parameters, plen }
+  };
 
   if (_debug) {
+    uint8_t txBuffer[sizeof(pktHdr) + plen];
+    memcpy(txBuffer, &pktHdr, sizeof(pktHdr));
+    memcpy(&txBuffer[sizeof(pktHdr)], parameters, plen);
+
     dumpPkt("HCI COMMAND TX -> ", sizeof(pktHdr) + plen, txBuffer);
   }
 #ifdef _BLE_TRACE_
   Serial.print("Command tx -> ");
-  for(int i=0; i< sizeof(pktHdr) + plen;i++){
+  for(int i=0; i< sizeof(pktHdr);i++){
     Serial.print(" 0x");
-    Serial.print(txBuffer[i],HEX);
+    Serial.print(((uint8_t*)&pktHdr)[i],HEX);
+  }
+  for(int i=0; i< plen;i++){
+    Serial.print(" 0x");
+    Serial.print(((const uint8_t*)parameters)[i],HEX);
   }
   Serial.println("");
 #endif
-  HCITransport.write(txBuffer, sizeof(pktHdr) + plen);
 
-  _cmdCompleteOpcode = 0xffff;
-  _cmdCompleteStatus = -1;
+  HCITransport.write(iov, plen ? 2 : 1);
+}
 
-  for (unsigned long start = millis(); _cmdCompleteOpcode != opcode && millis() < (start + 1000);) {
-    poll();
+/*
+ * Gives up on commands the controller never answered and writes the queued ones
+ * it has credits for, called at the end of every poll().
+ */
+void HCIClass::serviceCommands()
+{
+  unsigned long now = millis();
+
+  for (int i = 0; i < _cmdQueueCount; i++) {
+    HCICommand& command = _cmdQueue[(_cmdQueueHead + i) % HCI_COMMAND_QUEUE_SIZE];
+
+    if (command.sent && !command.done && (now - command.sentAt) >= HCI_COMMAND_TIMEOUT) {
+      // lost on the way, its credit is not coming back on its own
+      if (_cmdCredits == 0) {
+        _cmdCredits = 1;
+      }
+      finishCommand(command, -1, 0, NULL);
+
+      // the callback may have queued more, start over
+      i = -1;
+    }
   }
 
-  return _cmdCompleteStatus;
+  for (int i = 0; i < _cmdQueueCount && _cmdCredits > 0; i++) {
+    HCICommand& command = _cmdQueue[(_cmdQueueHead + i) % HCI_COMMAND_QUEUE_SIZE];
+
+    if (!command.sent) {
+      command.sent = true;
+      command.sentAt = now;
+      _cmdCredits--;
+      writeCommand(command.opcode, command.plen, command.parameters);
+    }
+  }
+}
+
+/*
+ * Command Complete or Status: hands the result to the oldest sent command with
+ * that opcode. Opcode 0 only returns credits.
+ */
+void HCIClass::completeCommand(uint8_t ncmd, uint16_t opcode, int status, uint8_t responseLength, uint8_t response[])
+{
+  _cmdCredits = ncmd;
+
+  for (int i = 0; i < _cmdQueueCount; i++) {
+    HCICommand& command = _cmdQueue[(_cmdQueueHead + i) % HCI_COMMAND_QUEUE_SIZE];
+
+    if (command.sent && !command.done && command.opcode == opcode) {
+      finishCommand(command, status, responseLength, response);
+      break;
+    }
+  }
+}
+
+void HCIClass::finishCommand(HCICommand& command, int status, uint8_t responseLength, uint8_t response[])
+{
+  HCICommandCallback callback = command.callback;
+  void* context = command.context;
+  uint16_t opcode = command.opcode;
+
+  // finished ones leave from the front, the slot can be reused from the callback on
+  command.done = true;
+  while (_cmdQueueCount > 0 && _cmdQueue[_cmdQueueHead].done) {
+    _cmdQueueHead = (_cmdQueueHead + 1) % HCI_COMMAND_QUEUE_SIZE;
+    _cmdQueueCount--;
+  }
+
+  if (callback) {
+    callback(opcode, status, responseLength, response, context);
+  }
 }
 
 void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
@@ -752,26 +1329,48 @@ void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
 
   // Pointer to the L2CAP PDU (might be reconstructed from multiple fragments)
   uint8_t *l2CapPdu;
-  uint8_t l2CapPduSize;
+  uint16_t l2CapPduSize;
+  // The reassembly buffer of this connection, fragments of other connections go to theirs
+  HCIL2CapRx* rx = l2CapRx(connectionHandle);
 
   if (pbFlag == 0b10) {
     // "First automatically flushable packet" = Start of our L2CAP PDU
+#ifdef _BLE_TRACE_
+    if (rx) {
+      Serial.print("Warning: Discarding ");
+      Serial.print(rx->length, DEC);
+      Serial.println(" bytes of an unfinished L2CAP PDU");
+    }
+#endif
 
     l2CapPdu = aclSdu;
     l2CapPduSize = aclHeader->dlen;
   } else if (pbFlag == 0b01) {
     // "Continuing Fragment" = Continued L2CAP PDU
+    if (!rx) {
+#ifdef _BLE_TRACE_
+      Serial.println("Continued packet without a start, discarding packet");
+#endif
+      return;
+    }
 #ifdef _BLE_TRACE_
     Serial.print("Continued packet. Appending to L2CAP PDU buffer (previously ");
-    Serial.print(_l2CapPduBufferSize, DEC);
+    Serial.print(rx->length, DEC);
     Serial.println(" bytes in buffer)");
 #endif
-    // If we receive a fragment, we always need to append it to the L2CAP PDU buffer
-    memcpy(&_l2CapPduBuffer[_l2CapPduBufferSize], aclSdu, aclHeader->dlen);
-    _l2CapPduBufferSize += aclHeader->dlen;
+    if (rx->length + aclHeader->dlen > HCI_L2CAP_PDU_MAX) {
+#ifdef _BLE_TRACE_
+      Serial.println("L2CAP PDU too long, discarding it");
+#endif
+      rx->handle = 0xffff;
+      return;
+    }
+
+    memcpy(&rx->data[rx->length], aclSdu, aclHeader->dlen);
+    rx->length += aclHeader->dlen;
 
-    l2CapPdu = _l2CapPduBuffer;
-    l2CapPduSize = _l2CapPduBufferSize;
+    l2CapPdu = rx->data;
+    l2CapPduSize = rx->length;
   } else {
     // I don't think other values are allowed for BLE
 #ifdef _BLE_TRACE_
@@ -796,7 +1395,7 @@ void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
 #endif
 
   // -4 because the buffer is the L2CAP PDU (with L2CAP header). The len field is only the L2CAP SDU (without L2CAP header).
-  if (l2CapPduSize - 4 != l2CapHeader->len) {
+  if (l2CapPduSize < sizeof(HCIL2CapHdr) || l2CapPduSize - 4 < l2CapHeader->len) {
 #ifdef _BLE_TRACE_
     Serial.println("L2CAP SDU incomplete");
 #endif
@@ -805,21 +1404,35 @@ void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
     if (pbFlag == 0b10) {
 #ifdef _BLE_TRACE_
       Serial.println("Storing first packet to L2CAP PDU buffer");
-      if (_l2CapPduBufferSize != 0) {
-        Serial.print("Warning: Discarding ");
-        Serial.print(_l2CapPduBufferSize, DEC);
-        Serial.println(" bytes from buffer");
+#endif
+      if (!rx) {
+        rx = l2CapRx(0xffff);
       }
+      if (!rx || l2CapPduSize > HCI_L2CAP_PDU_MAX) {
+#ifdef _BLE_TRACE_
+        Serial.println("No L2CAP PDU buffer free, discarding packet");
 #endif
+        releaseL2CapRx(connectionHandle);
+        return;
+      }
 
-      memcpy(_l2CapPduBuffer, l2CapPdu, l2CapPduSize);
-      _l2CapPduBufferSize = l2CapPduSize;
+      rx->handle = connectionHandle;
+      memcpy(rx->data, l2CapPdu, l2CapPduSize);
+      rx->length = l2CapPduSize;
     }
 
     // We need to wait for the missing parts of the L2CAP SDU
     return;
   }
 
+  if (l2CapPduSize - 4 > l2CapHeader->len) {
+#ifdef _BLE_TRACE_
+    Serial.println("L2CAP SDU longer than its header says, discarding it");
+#endif
+    releaseL2CapRx(connectionHandle);
+    return;
+  }
+
 #ifdef _BLE_TRACE_
     Serial.println("L2CAP SDU complete");
 #endif
@@ -857,16 +1470,23 @@ void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
   }
 
   // We have processed everything in the buffer. Discard the contents.
-  _l2CapPduBufferSize = 0;
+  releaseL2CapRx(connectionHandle);
 }
 
-void HCIClass::handleNumCompPkts(uint16_t /*handle*/, uint16_t numPkts)
+void HCIClass::handleNumCompPkts(uint16_t handle, uint16_t numPkts)
 {
-  if (numPkts && _pendingPkt > numPkts) {
-    _pendingPkt -= numPkts;
-  } else {
-    _pendingPkt = 0;
+  HCIAclLink* link = aclLink(handle);
+
+  if (!link) {
+    // closed, its buffers were given back then
+    return;
   }
+
+  uint8_t completed = (numPkts < link->pending) ? numPkts : link->pending;
+  link->pending -= completed;
+  _pendingPkt -= completed;
+
+  scheduleAcl();
 }
 
 void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
@@ -888,6 +1508,8 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
       uint8_t reason;
     } *disconnComplete = (DisconnComplete*)&pdata[sizeof(HCIEventHdr)];
 
+    removeAclLink(disconnComplete->handle);
+    releaseL2CapRx(disconnComplete->handle);
     ATT.removeConnection(disconnComplete->handle, disconnComplete->reason);
     L2CAPSignaling.removeConnection(disconnComplete->handle, disconnComplete->reason);
 
@@ -1001,6 +1623,8 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
     _cmdResponseLen = pdata[1] - sizeof(CmdComplete);
     _cmdResponse = &pdata[sizeof(HCIEventHdr) + sizeof(CmdComplete)];
 
+    completeCommand(cmdCompleteHeader->ncmd, _cmdCompleteOpcode, _cmdCompleteStatus, _cmdResponseLen, _cmdResponse);
+
   }
   else if (eventHdr->evt == EVT_CMD_STATUS)
   {
@@ -1021,6 +1645,8 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
     _cmdCompleteOpcode = cmdStatusHeader->opcode;
     _cmdCompleteStatus = cmdStatusHeader->status;
     _cmdResponseLen = 0;
+
+    completeCommand(cmdStatusHeader->ncmd, _cmdCompleteOpcode, _cmdCompleteStatus, 0, NULL);
   }
   else if (eventHdr->evt == EVT_NUM_COMP_PKTS)
   {
@@ -1077,6 +1703,7 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
         } *leConnectionComplete = (EvtLeConnectionComplete*)&pdata[sizeof(HCIEventHdr) + sizeof(LeMetaEventHeader)];
 
         if (leConnectionComplete->status == 0x00) {
+          addAclLink(leConnectionComplete->handle);
           ATT.addConnection(leConnectionComplete->handle,
                             leConnectionComplete->role,
                             leConnectionComplete->peerBdaddrType,
@@ -1126,6 +1753,7 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
         } *leConnectionComplete = (EvtLeConnectionComplete*)&pdata[sizeof(HCIEventHdr) + sizeof(LeMetaEventHeader)];
 
         if (leConnectionComplete->status == 0x00) {
+          addAclLink(leConnectionComplete->handle);
           ATT.addConnection(leConnectionComplete->handle,
                             leConnectionComplete->role,
                             leConnectionComplete->peerBdaddrType,
@@ -1151,6 +1779,34 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
         // btct.printBytes(address, 6);
         break;
       }
+      case CONN_UPDATE_COMPLETE:{
+        struct __attribute__ ((packed)) EvtLeConnectionUpdateComplete {
+          uint8_t status;
+          uint16_t handle;
+          uint16_t interval;
+          uint16_t latency;
+          uint16_t supervisionTimeout;
+        } *leConnectionUpdateComplete = (EvtLeConnectionUpdateComplete*)&pdata[sizeof(HCIEventHdr) + sizeof(LeMetaEventHeader)];
+
+        // the controller reports what was granted, which is not necessarily what was asked for
+        if (leConnectionUpdateComplete->status == 0x00) {
+          ATT.updateConnectionParameters(leConnectionUpdateComplete->handle,
+                                         leConnectionUpdateComplete->interval,
+                                         leConnectionUpdateComplete->latency,
+                                         leConnectionUpdateComplete->supervisionTimeout);
+        }
+#ifdef _BLE_TRACE_
+        Serial.print("Connection update status: 0x");
+        Serial.print(leConnectionUpdateComplete->status, HEX);
+        Serial.print(" interval: ");
+        Serial.print(leConnectionUpdateComplete->interval);
+        Serial.print(" latency: ");
+        Serial.print(leConnectionUpdateComplete->latency);
+        Serial.print(" timeout: ");
+        Serial.println(leConnectionUpdateComplete->supervisionTimeout);
+#endif
+        break;
+      }
       case ADVERTISING_REPORT:{
         struct __attribute__ ((packed)) EvtLeAdvertisingReport {
           uint8_t status;
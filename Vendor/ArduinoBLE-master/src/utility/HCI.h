@@ -24,6 +24,8 @@
 #include "bitDescriptions.h"
 
 #include "L2CAPSignaling.h"
+#include "HCITransport.h"
+#include "ATT.h"
 
 #define OGF_LINK_CTL           0x01
 #define OGF_HOST_CTL           0x03
@@ -31,6 +33,27 @@
 #define OGF_STATUS_PARAM       0x05
 #define OGF_LE_CTL             0x08
 
+// packet type, ACL header and L2CAP header in front of an outgoing L2CAP payload
+#define HCI_ACL_HEADROOM       9
+// largest L2CAP payload sent, it goes to the controller in as many ACL packets as it needs
+#define HCI_ACL_PAYLOAD_MAX    ATT_MAX_MTU
+// connections with their own ACL accounting and queue
+#define HCI_ACL_LINKS          ATT_MAX_PEERS
+// packets one connection may have waiting for a controller buffer
+#define HCI_ACL_LINK_QUEUE     4
+// buffers the waiting packets of all connections share
+#define HCI_ACL_POOL_SIZE      8
+// L2CAP PDUs that can be in reassembly at once, whatever their connection
+#define HCI_L2CAP_RX_BUFFERS   4
+#define HCI_L2CAP_PDU_MAX      (4 + ATT_MAX_MTU)
+
+// commands queued or waiting for their Command Complete/Status at once
+#define HCI_COMMAND_QUEUE_SIZE 4
+// parameters a queued command can hold, the longest ones are the 64 byte keys
+#define HCI_COMMAND_PARAMS_MAX 64
+// ms a command may wait for its Command Complete/Status once sent
+#define HCI_COMMAND_TIMEOUT    1000
+
 enum LE_COMMAND {
   ENCRYPT                      = 0x0017,
   RANDOM                       = 0x0018,
@@ -43,6 +66,7 @@ enum LE_COMMAND {
 enum LE_META_EVENT {
   CONN_COMPLETE             = 0x01,
   ADVERTISING_REPORT        = 0x02,
+  CONN_UPDATE_COMPLETE      = 0x03,
   LONG_TERM_KEY_REQUEST     = 0x05,
   REMOTE_CONN_PARAM_REQ     = 0x06,
   READ_LOCAL_P256_COMPLETE  = 0x08,
@@ -52,6 +76,10 @@ enum LE_META_EVENT {
 String metaEventToString(LE_META_EVENT event);
 String commandToString(LE_COMMAND command);
 
+// Called from poll() when a command finished: status is the controller's, -1 if it
+// timed out. The return parameters are only valid during the call.
+typedef void (*HCICommandCallback)(uint16_t opcode, int status, uint8_t responseLength, uint8_t response[], void* context);
+
 class HCIClass {
 public:
   HCIClass();
@@ -71,6 +99,7 @@ public:
   virtual int readBdAddr();
 
   virtual int readRssi(uint16_t handle);
+  virtual int readRssiAsync(uint16_t handle, HCICommandCallback callback, void* context = NULL);
 
   virtual int setEventMask(uint64_t eventMask);
   virtual int setLeEventMask(uint64_t leEventMask);
@@ -94,6 +123,11 @@ public:
   virtual int leConnUpdate(uint16_t handle, uint16_t minInterval, uint16_t maxInterval, 
                   uint16_t latency, uint16_t supervisionTimeout);
   virtual int leCancelConn();
+  // the filter accept list can not be changed while an initiator uses it
+  virtual int leReadFilterAcceptListSize(uint8_t& size);
+  virtual int leClearFilterAcceptList();
+  virtual int leAddDeviceToFilterAcceptList(uint8_t addressType, const uint8_t address[6]);
+  virtual int leRemoveDeviceFromFilterAcceptList(uint8_t addressType, const uint8_t address[6]);
   virtual int leEncrypt(uint8_t* Key, uint8_t* plaintext, uint8_t* status, uint8_t* ciphertext);
   // Generate a 64 bit random number
   virtual int leRand(uint8_t rand[]);
@@ -111,7 +145,24 @@ public:
   virtual void writeLK(uint8_t peerAddress[], uint8_t LK[]);
   virtual int tryResolveAddress(uint8_t* BDAddr, uint8_t* address);
 
-  virtual int sendAclPkt(uint16_t handle, uint8_t cid, uint8_t plen, void* data);
+  // Sends or queues the packet, polls while the connection's queue is full
+  virtual int sendAclPkt(uint16_t handle, uint8_t cid, uint16_t plen, void* data);
+  // Same with the payload in pieces, they go to the transport without being copied together here
+  virtual int sendAclPkt(uint16_t handle, uint8_t cid, const HCITransportIov* payload, int count);
+  // Never waits: -1 if the connection's queue is full or it is not connected
+  virtual int trySendAclPkt(uint16_t handle, uint8_t cid, const HCITransportIov* payload, int count);
+
+  // Builds an ACL packet in place: returns where the L2CAP payload goes, up to
+  // HCI_ACL_PAYLOAD_MAX bytes, or NULL if the connection cannot take another packet.
+  // sendReservedAclPkt() puts the headers in front and sends or queues it, nothing may
+  // poll in between.
+  virtual uint8_t* reserveAclPkt(uint16_t handle);
+  virtual int sendReservedAclPkt(uint16_t handle, uint8_t cid, uint16_t plen);
+
+  // packets of the connection the controller has not completed yet, and the ones
+  // still waiting for a controller buffer
+  virtual int aclPending(uint16_t handle) const;
+  virtual int aclQueued(uint16_t handle) const;
 
   virtual int disconnect(uint16_t handle);
 
@@ -120,6 +171,11 @@ public:
 
   // TODO: Send command be private again & use ATT implementation of send command within ATT.
   virtual int sendCommand(uint16_t opcode, uint8_t plen = 0, void* parameters = NULL);
+  // Queues the command and returns at once, 0 if it was taken. It is written as soon
+  // as the controller has a command credit, until then the parameters are copied.
+  virtual int sendCommandAsync(uint16_t opcode, uint8_t plen = 0, void* parameters = NULL,
+                               HCICommandCallback callback = NULL, void* context = NULL);
+  virtual bool commandsPending() const;
   uint8_t remotePublicKeyBuffer[64];
   uint8_t localPublicKeyBuffer[64];
   uint8_t remoteDHKeyCheckBuffer[16];
@@ -145,22 +201,100 @@ private:
   virtual void handleEventPkt(uint8_t plen, uint8_t pdata[]);
 
   virtual void dumpPkt(const char* prefix, uint8_t plen, uint8_t pdata[]);
+  void dumpAclPkt(const HCITransportIov* iov, int count);
+
+  void dispatchRecvPkt();
+
+  struct HCIAclLink {
+    // 0xffff when not connected
+    uint16_t handle;
+    uint8_t pending;
+    // pool buffers waiting for a controller buffer, oldest first
+    uint8_t queue[HCI_ACL_LINK_QUEUE];
+    uint8_t queueHead;
+    uint8_t queueCount;
+  };
+
+  struct HCIAclBuffer {
+    bool used;
+    uint16_t length;
+    // bytes of the L2CAP PDU the controller has already, a long one goes in fragments
+    uint16_t sent;
+    uint8_t data[HCI_ACL_HEADROOM + HCI_ACL_PAYLOAD_MAX];
+  };
+
+  struct HCIL2CapRx {
+    // 0xffff when free
+    uint16_t handle;
+    uint16_t length;
+    uint8_t data[HCI_L2CAP_PDU_MAX];
+  };
+
+  void resetAclLinks();
+  HCIAclLink* aclLink(uint16_t handle);
+  void addAclLink(uint16_t handle);
+  void removeAclLink(uint16_t handle);
+  int allocAclBuffer();
+  void queueAclBuffer(HCIAclLink& link, int buffer);
+  void writeAclPkt(HCIAclLink& link, const HCITransportIov* iov, int count);
+  void scheduleAcl();
+  void writeAclFragment(HCIAclLink& link, HCIAclBuffer& buffer);
+
+  HCIL2CapRx* l2CapRx(uint16_t handle);
+  void releaseL2CapRx(uint16_t handle);
+
+  struct HCICommand {
+    uint16_t opcode;
+    bool sent;
+    bool done;
+    unsigned long sentAt;
+    HCICommandCallback callback;
+    void* context;
+    uint8_t plen;
+    uint8_t parameters[HCI_COMMAND_PARAMS_MAX];
+  };
+
+  void writeCommand(uint16_t opcode, uint8_t plen, const void* parameters);
+  void serviceCommands();
+  void completeCommand(uint8_t ncmd, uint16_t opcode, int status, uint8_t responseLength, uint8_t response[]);
+  void finishCommand(HCICommand& command, int status, uint8_t responseLength, uint8_t response[]);
 
   Stream* _debug;
 
+  // framing of the packet being received: bytes so far, its full size once the
+  // header is in (0 before) and the bytes of an oversized packet left to drop
   int _recvIndex;
+  int _recvLength;
+  int _recvSkip;
   uint8_t _recvBuffer[3 + 255];
 
+  // commands in the order they were queued, the sent ones first
+  HCICommand _cmdQueue[HCI_COMMAND_QUEUE_SIZE];
+  uint8_t _cmdQueueHead;
+  uint8_t _cmdQueueCount;
+  // Num_HCI_Command_Packets of the last Command Complete/Status
+  uint8_t _cmdCredits;
+
   uint16_t _cmdCompleteOpcode;
   int _cmdCompleteStatus;
   uint8_t _cmdResponseLen;
   uint8_t* _cmdResponse;
 
+  // controller buffers, the ones all connections have in use and the data one takes
   uint8_t _maxPkt;
   uint8_t _pendingPkt;
+  uint16_t _aclPktLen;
+
+  HCIAclLink _aclLinks[HCI_ACL_LINKS];
+  HCIAclBuffer _aclPool[HCI_ACL_POOL_SIZE];
+  // packets waiting on all connections, the one reserveAclPkt() handed out
+  uint8_t _aclQueued;
+  int _aclReserved;
+  // the scheduler takes turns, this connection is asked first next time
+  uint8_t _aclNextLink;
 
-  uint8_t _l2CapPduBuffer[255];
-  uint8_t _l2CapPduBufferSize;
+  // L2CAP PDUs of the connections whose first fragments are in
+  HCIL2CapRx _l2CapRx[HCI_L2CAP_RX_BUFFERS];
 };
 
 extern HCIClass& HCI;
@@ -280,6 +280,18 @@ int HCICordioTransportClass::read()
   return _rxBuf.read_char();
 }
 
+size_t HCICordioTransportClass::read(uint8_t* data, size_t length)
+{
+  size_t count = 0;
+
+  // one call per packet, the ring buffer is only read from here
+  while (count < length && _rxBuf.available()) {
+    data[count++] = _rxBuf.read_char();
+  }
+
+  return count;
+}
+
 void HCICordioTransportClass::lockForRead() {
   mbed::CriticalSectionLock::enable();
 }
@@ -308,6 +320,45 @@ size_t HCICordioTransportClass::write(const uint8_t* data, size_t length)
 #endif
 }
 
+size_t HCICordioTransportClass::write(const HCITransportIov* iov, int count)
+{
+#if CORDIO_ZERO_COPY_HCI
+  if (!_begun) {
+    return 0;
+  }
+
+  size_t length = 0;
+  for (int i = 0; i < count; i++) {
+    length += iov[i].length;
+  }
+
+  uint8_t packetLength = length - 1;
+  uint8_t packetType   = ((const uint8_t*)iov[0].data)[0];
+
+  // the pieces go straight into the message handed to the stack, the type stays out
+  uint8_t* packet = (uint8_t*)WsfMsgAlloc(max(packetLength, MIN_WSF_ALLOC));
+  uint8_t* p = packet;
+
+  for (int i = 0; i < count; i++) {
+    const uint8_t* data = (const uint8_t*)iov[i].data;
+    size_t dataLength = iov[i].length;
+
+    if (i == 0) {
+      data++;
+      dataLength--;
+    }
+
+    memcpy(p, data, dataLength);
+    p += dataLength;
+  }
+
+  return CordioHCIHook::getTransportDriver().write(packetType, packetLength, packet);
+#else
+  // the driver wants the packet in one piece
+  return HCITransportInterface::write(iov, count);
+#endif
+}
+
 void HCICordioTransportClass::handleRxData(uint8_t* data, uint8_t len)
 {
   {
@@ -39,11 +39,13 @@ public:
   virtual int available();
   virtual int peek();
   virtual int read();
+  virtual size_t read(uint8_t* data, size_t length) override;
 
   virtual void lockForRead() override;
   virtual void unlockForRead() override;
 
   virtual size_t write(const uint8_t* data, size_t length);
+  virtual size_t write(const HCITransportIov* iov, int count) override;
 
 private:
   static void onDataReceived(uint8_t* data, uint8_t len);
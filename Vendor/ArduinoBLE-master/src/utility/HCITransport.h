@@ -22,6 +22,12 @@
 
 #include <Arduino.h>
 
+// One piece of an outgoing packet, see the gather write()
+struct HCITransportIov {
+  const void* data;
+  size_t length;
+};
+
 class HCITransportInterface {
 public:
   virtual int begin() = 0;
@@ -33,6 +39,19 @@ public:
   virtual int peek() = 0;
   virtual int read() = 0;
 
+  // Reads up to length bytes that are available right now, never waits for more.
+  // Returns the number of bytes read. The default reads byte by byte, transports
+  // that can hand out a whole packet in one copy override it.
+  virtual size_t read(uint8_t* data, size_t length) {
+    size_t count = 0;
+
+    while (count < length && available()) {
+      data[count++] = read();
+    }
+
+    return count;
+  }
+
   // Some transports require a lock to use available/peek/read
   // These methods allow to keep the lock while reading an unknown number of bytes
   // These methods might disable interrupts. Only keep the lock as long as necessary.
@@ -40,6 +59,27 @@ public:
   virtual void unlockForRead() {}
 
   virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+  // Writes one packet given as count pieces, like writev(). The default copies the
+  // pieces together for write(), transports that copy the packet out anyway
+  // override it to copy straight from the pieces.
+  virtual size_t write(const HCITransportIov* iov, int count) {
+    size_t length = 0;
+
+    for (int i = 0; i < count; i++) {
+      length += iov[i].length;
+    }
+
+    uint8_t packet[length];
+    uint8_t* p = packet;
+
+    for (int i = 0; i < count; i++) {
+      memcpy(p, iov[i].data, iov[i].length);
+      p += iov[i].length;
+    }
+
+    return write(packet, length);
+  }
 };
 
 extern HCITransportInterface& HCITransport;
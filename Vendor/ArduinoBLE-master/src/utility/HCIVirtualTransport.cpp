@@ -24,6 +24,8 @@
 StreamBufferHandle_t rec_buffer;
 StreamBufferHandle_t send_buffer;
 TaskHandle_t bleHandle;
+// task blocked in wait(), woken as soon as the controller hands us data
+static volatile TaskHandle_t waitingTask = NULL;
 
 
 static void notify_host_send_available(void)
@@ -33,6 +35,10 @@ static void notify_host_send_available(void)
 static int notify_host_recv(uint8_t *data, uint16_t length)
 {
   xStreamBufferSend(rec_buffer,data,length,portMAX_DELAY);  // !!!potentially waiting forever
+  TaskHandle_t task = waitingTask;
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
   return 0;
 }
 
@@ -101,13 +107,19 @@ void HCIVirtualTransportClass::end()
   vTaskDelete(bleHandle);
 }
 
+/*
+ * Blocks the calling task until the controller sends data or the timeout passed, so
+ * the CPU idles in the meantime. Anything else can end the wait early by giving the
+ * task a notification, e.g. a timer or pin interrupt with news for the sketch.
+ */
 void HCIVirtualTransportClass::wait(unsigned long timeout)
 {
-  for (unsigned long start = (esp_timer_get_time() / 1000ULL); ((esp_timer_get_time() / 1000ULL) - start) < timeout;) {
-    if (available()) {
-      break;
-    }
+  waitingTask = xTaskGetCurrentTaskHandle();
+  if (!available()) {
+    TickType_t ticks = pdMS_TO_TICKS(timeout);
+    ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
   }
+  waitingTask = NULL;
 }
 
 int HCIVirtualTransportClass::available()
@@ -131,6 +143,12 @@ int HCIVirtualTransportClass::read()
   return -1;
 }
 
+size_t HCIVirtualTransportClass::read(uint8_t* data, size_t length)
+{
+  // what is there already, in one copy
+  return xStreamBufferReceive(rec_buffer, data, length, 0);
+}
+
 size_t HCIVirtualTransportClass::write(const uint8_t* data, size_t length)
 {
   size_t result = xStreamBufferSend(send_buffer,data,length,portMAX_DELAY);
@@ -69,22 +69,28 @@ void L2CAPSignalingClass::addConnection(uint16_t handle, uint8_t role, uint8_t /
   }
 
   if (updateParameters) {
-    struct __attribute__ ((packed)) L2CAPConnectionParameterUpdateRequest {
-      uint8_t code;
-      uint8_t identifier;
-      uint16_t length;
-      uint16_t minInterval;
-      uint16_t maxInterval;
-      uint16_t latency;
-      uint16_t supervisionTimeout;
-    } request = { CONNECTION_PARAMETER_UPDATE_REQUEST, 0x01, 8,
-                  updatedMinInterval, updatedMaxInterval, 0x0000, updatedSupervisionTimeout };
-
-    HCI.sendAclPkt(handle, SIGNALING_CID, sizeof(request), &request);
+    requestConnectionParameters(handle, updatedMinInterval, updatedMaxInterval, 0x0000, updatedSupervisionTimeout);
   }
 }
 
-void L2CAPSignalingClass::handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void L2CAPSignalingClass::requestConnectionParameters(uint16_t handle, uint16_t minInterval, uint16_t maxInterval,
+                                                      uint16_t latency, uint16_t supervisionTimeout)
+{
+  struct __attribute__ ((packed)) L2CAPConnectionParameterUpdateRequest {
+    uint8_t code;
+    uint8_t identifier;
+    uint16_t length;
+    uint16_t minInterval;
+    uint16_t maxInterval;
+    uint16_t latency;
+    uint16_t supervisionTimeout;
+  } request = { CONNECTION_PARAMETER_UPDATE_REQUEST, 0x01, 8,
+                minInterval, maxInterval, latency, supervisionTimeout };
+
+  HCI.sendAclPkt(handle, SIGNALING_CID, sizeof(request), &request);
+}
+
+void L2CAPSignalingClass::handleData(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) L2CAPSignalingHdr {
     uint8_t code;
@@ -113,7 +119,7 @@ void L2CAPSignalingClass::handleData(uint16_t connectionHandle, uint8_t dlen, ui
     connectionParameterUpdateResponse(connectionHandle, identifier, length, data);
   }
 }
-void L2CAPSignalingClass::handleSecurityData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
+void L2CAPSignalingClass::handleSecurityData(uint16_t connectionHandle, uint16_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) L2CAPSignalingHdr {
     uint8_t code;
@@ -451,6 +457,21 @@ void L2CAPSignalingClass::setSupervisionTimeout(uint16_t supervisionTimeout)
   _supervisionTimeout = supervisionTimeout;
 }
 
+uint16_t L2CAPSignalingClass::minInterval() const
+{
+  return _minInterval;
+}
+
+uint16_t L2CAPSignalingClass::maxInterval() const
+{
+  return _maxInterval;
+}
+
+uint16_t L2CAPSignalingClass::supervisionTimeout() const
+{
+  return _supervisionTimeout;
+}
+
 void L2CAPSignalingClass::setPairingEnabled(uint8_t enabled)
 {
   _pairing_enabled = enabled;
@@ -61,15 +61,23 @@ public:
                     uint16_t latency, uint16_t supervisionTimeout,
                     uint8_t masterClockAccuracy);
 
-  virtual void handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
+  virtual void handleData(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
 
-  virtual void handleSecurityData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]);
+  virtual void handleSecurityData(uint16_t connectionHandle, uint16_t dlen, uint8_t data[]);
 
   virtual void removeConnection(uint8_t handle, uint16_t reason);
 
   virtual void setConnectionInterval(uint16_t minInterval, uint16_t maxInterval);
 
   virtual void setSupervisionTimeout(uint16_t supervisionTimeout);
+
+  virtual uint16_t minInterval() const;
+  virtual uint16_t maxInterval() const;
+  virtual uint16_t supervisionTimeout() const;
+
+  // sent by the peripheral, the central answers and applies it with an LE Connection Update
+  virtual void requestConnectionParameters(uint16_t handle, uint16_t minInterval, uint16_t maxInterval,
+                    uint16_t latency, uint16_t supervisionTimeout);
   
   virtual void setPairingEnabled(uint8_t enabled);
   virtual bool isPairingEnabled();
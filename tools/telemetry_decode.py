@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Decodes the binary telemetry records written by Shared/Telemetry.
+
+Reads a serial port (needs pyserial) or a capture file, prints one line per
+record and passes any plain text on the port through unchanged.
+
+    python3 tools/telemetry_decode.py /dev/ttyACM0
+    python3 tools/telemetry_decode.py capture.bin
+    cat capture.bin | python3 tools/telemetry_decode.py -
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+HEADER_SIZE = 7
+MAX_PAYLOAD = 32
+
+CONTROLLER_STATE = 0x01
+RAW_INPUTS = 0x02
+CHANNEL_STATE = 0x03
+BOT_STATUS = 0x04
+DROPPED = 0x7F
+
+BUTTONS = ["thumb", "yellow", "red", "green", "blue"]
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def buttons(bits):
+    pressed = [name for i, name in enumerate(BUTTONS) if bits & (1 << i)]
+    return ",".join(pressed) if pressed else "-"
+
+
+def describe_state(payload):
+    version, bits, sequence, timestamp, x, y = struct.unpack("<BBHIHH", payload[:12])
+    return "state v%d seq=%d sampled=%d x=%d y=%d buttons=%s" % (
+        version, sequence, timestamp, x, y, buttons(bits))
+
+
+def describe_bot_status(payload):
+    version, flags, sequence, motor1, motor2, age, overruns, timeouts, rssi = struct.unpack("<BBHhhIIHb", payload[:19])
+    return "bot v%d seq=%d %s duty=%d/%d age=%dus overruns=%d timeouts=%d rssi=%s%s" % (
+        version, sequence, "armed" if flags & 0x01 else "disarmed", motor1, motor2, age, overruns, timeouts,
+        "-" if rssi == 127 else "%ddBm" % rssi, " closed-loop" if flags & 0x02 else "")
+
+
+def describe(record_type, payload):
+    if record_type == CONTROLLER_STATE and len(payload) >= 12:
+        return describe_state(payload)
+    if record_type == CHANNEL_STATE and len(payload) >= 13:
+        return "ch%d %s" % (payload[0], describe_state(payload[1:]))
+    if record_type == BOT_STATUS and len(payload) >= 19:
+        return describe_bot_status(payload)
+    if record_type == RAW_INPUTS and len(payload) >= 5:
+        x, y, bits = struct.unpack("<HHB", payload[:5])
+        return "inputs x=%d y=%d buttons=%s" % (x, y, buttons(bits))
+    if record_type == DROPPED and len(payload) >= 4:
+        return "DROPPED %d records" % struct.unpack("<I", payload[:4])
+    return "type 0x%02x %s" % (record_type, payload.hex())
+
+
+class Decoder:
+    def __init__(self, out):
+        self.out = out
+        self.buffer = bytearray()
+        self.text = bytearray()
+        self.records = 0
+        self.bad_frames = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        while self.buffer:
+            if self.buffer[0] != SYNC:
+                self.pass_text(self.buffer.pop(0))
+                continue
+            if len(self.buffer) < HEADER_SIZE:
+                return
+            length = self.buffer[2]
+            size = HEADER_SIZE + length + 1
+            if length > MAX_PAYLOAD:
+                self.bad_frames += 1
+                self.buffer.pop(0)
+                continue
+            if len(self.buffer) < size:
+                return
+            frame = bytes(self.buffer[:size])
+            if crc8(frame[1:-1]) != frame[-1]:
+                # not a frame after all, resynchronise on the next byte
+                self.bad_frames += 1
+                self.buffer.pop(0)
+                continue
+            del self.buffer[:size]
+            self.flush_text()
+            timestamp = struct.unpack("<I", frame[3:7])[0]
+            self.out.write("%10d us  %s\n" % (timestamp, describe(frame[1], frame[HEADER_SIZE:-1])))
+            self.records += 1
+
+    def pass_text(self, byte):
+        if byte == ord("\n"):
+            self.flush_text()
+        elif byte != ord("\r"):
+            self.text.append(byte)
+
+    def flush_text(self):
+        if self.text:
+            self.out.write("# %s\n" % self.text.decode("ascii", "replace"))
+            self.text.clear()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="serial port, capture file or - for stdin")
+    parser.add_argument("--baud", type=int, default=9600)
+    args = parser.parse_args()
+
+    decoder = Decoder(sys.stdout)
+    try:
+        if args.source == "-":
+            for chunk in iter(lambda: sys.stdin.buffer.read(4096), b""):
+                decoder.feed(chunk)
+        elif args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+            import serial
+            with serial.Serial(args.source, args.baud, timeout=0.1) as port:
+                while True:
+                    decoder.feed(port.read(4096))
+                    sys.stdout.flush()
+        else:
+            with open(args.source, "rb") as capture:
+                for chunk in iter(lambda: capture.read(4096), b""):
+                    decoder.feed(chunk)
+    except KeyboardInterrupt:
+        pass
+
+    decoder.flush_text()
+    sys.stderr.write("%d records, %d bad frames\n" % (decoder.records, decoder.bad_frames))
+
+
+if __name__ == "__main__":
+    main()